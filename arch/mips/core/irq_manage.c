@@ -23,6 +23,10 @@
 
 #define MAX_PRIO_NUM	2
 
+#ifdef CONFIG_SYS_POWER_MANAGEMENT
+extern void _sys_power_save_idle_exit(s32_t ticks);
+#endif
+
 void _arch_irq_enable(unsigned int irq)
 {
 	u32_t reg, bit;
@@ -250,6 +254,19 @@ __ramfunc void _enter_irq(void)
 
 	_kernel.nested++;
 
+#ifdef CONFIG_SYS_POWER_MANAGEMENT
+	/*
+	 * The interrupt woke the CPU from idle: account the ticks slept
+	 * before the handlers read the clock or start timeouts.
+	 */
+	if (_kernel.idle) {
+		s32_t idle_val = _kernel.idle;
+
+		_kernel.idle = 0;
+		_sys_power_save_idle_exit(idle_val);
+	}
+#endif
+
 	max_prio = MAX_PRIO_NUM - find_lsb_set((mips32_getstatus() >> SR_HWIM_SHIFT) & 0x1f);
 
 	for (prio = 0; prio <= max_prio; prio++) {
@@ -63,6 +63,15 @@ struct __packed nvram_item {
 	char data[0];
 };
 
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+struct item_index_entry {
+	/* item offset in segment, in NVRAM_ITEM_ALIGN_SIZE units */
+	u16_t offs;
+	/* name hash, its low bits are the home slot */
+	u16_t hash;
+};
+#endif
+
 struct region_info
 {
 	struct device *storage;
@@ -85,6 +94,15 @@ struct region_info
 	u32_t *seg_item_map;
 	int seg_item_map_size;
 #endif
+
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	/* open addressing hash table of the valid items in current segment */
+	struct item_index_entry *item_index;
+	int item_index_size;
+	int item_index_used;
+	/* false if the table is full, items are searched in flash */
+	bool item_index_valid;
+#endif
 };
 
 /* region segment magic: 'NVRS' */
@@ -109,6 +127,22 @@ struct region_info
 u32_t user_region_item_map[CONFIG_NVRAM_USER_REGION_SEGMENT_SIZE / NVRAM_ITEM_ALIGN_SIZE / 32];
 #endif
 
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+static struct item_index_entry user_region_index[CONFIG_NVRAM_USER_REGION_INDEX_SIZE];
+static struct item_index_entry factory_region_index[CONFIG_NVRAM_FACTORY_REGION_INDEX_SIZE];
+#ifdef CONFIG_NVRAM_STORAGE_FACTORY_RW_REGION
+static struct item_index_entry factory_rw_region_index[CONFIG_NVRAM_FACTORY_REGION_INDEX_SIZE];
+#endif
+
+/* the index is probed with hash & (size - 1) */
+BUILD_ASSERT_MSG(CONFIG_NVRAM_USER_REGION_INDEX_SIZE > 0 &&
+	(CONFIG_NVRAM_USER_REGION_INDEX_SIZE & (CONFIG_NVRAM_USER_REGION_INDEX_SIZE - 1)) == 0,
+	"NVRAM_USER_REGION_INDEX_SIZE must be a power of 2");
+BUILD_ASSERT_MSG(CONFIG_NVRAM_FACTORY_REGION_INDEX_SIZE > 0 &&
+	(CONFIG_NVRAM_FACTORY_REGION_INDEX_SIZE & (CONFIG_NVRAM_FACTORY_REGION_INDEX_SIZE - 1)) == 0,
+	"NVRAM_FACTORY_REGION_INDEX_SIZE must be a power of 2");
+#endif
+
 /* user config region */
 struct region_info user_nvram_region = {
 	.name = "User Config",
@@ -120,6 +154,10 @@ struct region_info user_nvram_region = {
 	.seg_item_map = user_region_item_map,
 	.seg_item_map_size = sizeof(user_region_item_map),
 #endif
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	.item_index = user_region_index,
+	.item_index_size = ARRAY_SIZE(user_region_index),
+#endif
 };
 
 /* factory config region */
@@ -132,6 +170,10 @@ struct region_info factory_nvram_region = {
 	.seg_item_map = NULL,
 	.seg_item_map_size = 0,
 #endif
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	.item_index = factory_region_index,
+	.item_index_size = ARRAY_SIZE(factory_region_index),
+#endif
 };
 
 #ifdef CONFIG_NVRAM_STORAGE_FACTORY_RW_REGION
@@ -147,6 +189,10 @@ struct region_info factory_rw_nvram_region = {
 	.seg_item_map = NULL,
 	.seg_item_map_size = 0,
 #endif
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	.item_index = factory_rw_region_index,
+	.item_index_size = ARRAY_SIZE(factory_rw_region_index),
+#endif
 };
 #endif
 
@@ -463,6 +509,126 @@ static void item_bitmap_clear_all(unsigned int *seg_item_map, int item_map_size)
 }
 #endif
 
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+#define ITEM_INDEX_EMPTY	0x0
+
+/* FNV-1a folded to 16 bits, the 8 bit item hash is too weak for the table */
+static u16_t calc_index_hash(const char *name, int len)
+{
+	u32_t hash = 2166136261u;
+
+	while (len--) {
+		hash ^= (u8_t)*name++;
+		hash *= 16777619u;
+	}
+
+	return (u16_t)(hash ^ (hash >> 16));
+}
+
+static void item_index_clear_all(struct region_info *region)
+{
+	if (!region->item_index_size)
+		return;
+
+	memset(region->item_index, 0, region->item_index_size * sizeof(struct item_index_entry));
+	region->item_index_used = 0;
+	region->item_index_valid = true;
+}
+
+static void item_index_insert(struct region_info *region, u16_t hash, int seg_offs)
+{
+	int mask = region->item_index_size - 1;
+	int i;
+
+	if (!region->item_index_valid)
+		return;
+
+	if (region->item_index_used + 1 > region->item_index_size * 3 / 4) {
+		SYS_LOG_WRN("region %s: item index full, search in flash", region->name);
+		region->item_index_valid = false;
+		return;
+	}
+
+	for (i = hash & mask; region->item_index[i].offs != ITEM_INDEX_EMPTY; i = (i + 1) & mask)
+		;
+
+	region->item_index[i].offs = seg_offs / NVRAM_ITEM_ALIGN_SIZE;
+	region->item_index[i].hash = hash;
+	region->item_index_used++;
+}
+
+/*
+ * Linear probing without tombstones: entries after the removed one move
+ * back unless their home slot is between the hole and where they are.
+ */
+static void item_index_remove(struct region_info *region, u16_t hash, int seg_offs)
+{
+	struct item_index_entry *index = region->item_index;
+	int mask = region->item_index_size - 1;
+	int i, j, home;
+
+	if (!region->item_index_valid)
+		return;
+
+	for (i = hash & mask; index[i].offs != seg_offs / NVRAM_ITEM_ALIGN_SIZE; i = (i + 1) & mask) {
+		if (index[i].offs == ITEM_INDEX_EMPTY)
+			return;
+	}
+
+	for (j = (i + 1) & mask; index[j].offs != ITEM_INDEX_EMPTY; j = (j + 1) & mask) {
+		home = index[j].hash & mask;
+		if ((i < j) ? (home <= i || home > j) : (home <= i && home > j)) {
+			index[i] = index[j];
+			i = j;
+		}
+	}
+
+	index[i].offs = ITEM_INDEX_EMPTY;
+	region->item_index_used--;
+}
+
+static int item_index_find(struct region_info *region, const char *name, int name_size,
+			   struct nvram_item *item)
+{
+	struct item_index_entry *entry;
+	int mask = region->item_index_size - 1;
+	u32_t item_offs;
+	u16_t hash;
+	u8_t item_hash;
+	int i;
+
+	hash = calc_index_hash(name, name_size);
+	item_hash = calc_hash((const u8_t *)name, name_size);
+
+	for (i = hash & mask; ; i = (i + 1) & mask) {
+		entry = &region->item_index[i];
+		if (entry->offs == ITEM_INDEX_EMPTY)
+			break;
+
+		if (entry->hash != hash)
+			continue;
+
+		item_offs = region->seg_offset + entry->offs * NVRAM_ITEM_ALIGN_SIZE;
+
+		/* read item header */
+		region_read(region, item_offs, (u8_t *)item, sizeof(struct nvram_item));
+		if (item->magic != NVRAM_REGION_ITEM_MAGIC ||
+		    item->state != NVRAM_ITEM_STATE_VALID ||
+		    item->hash != item_hash || item->name_size != name_size)
+			continue;
+
+		/* read config name */
+		region_read(region, item_offs + sizeof(struct nvram_item),
+			nvram_buf, item->name_size);
+
+		if (!memcmp(name, (const char *)nvram_buf, item->name_size))
+			return item_offs;
+	}
+
+	return -ENOENT;
+}
+#endif
+
 
 static int item_is_empty(struct nvram_item *item)
 {
@@ -530,8 +696,9 @@ static u8_t item_calc_data_crc(struct region_info *region, u32_t offset, s32_t s
 	return crc;
 }
 
+/* index_hash, if not NULL, is set to the index hash of a valid item name */
 static int item_check_validity(struct region_info *region, int item_offs, struct nvram_item *item,
-			       int check_crc)
+			       int check_crc, u16_t *index_hash)
 {
 	u8_t name_hash, crc;
 	u32_t name_offset;
@@ -563,6 +730,12 @@ static int item_check_validity(struct region_info *region, int item_offs, struct
 		return ITEM_STATUS_INVALID;
 	}
 
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	/* data crc below reuses nvram_buf */
+	if (index_hash)
+		*index_hash = calc_index_hash((const char *)nvram_buf, item->name_size);
+#endif
+
 	if (check_crc) {
 		crc = calc_crc8((u8_t *)item + NVRAM_REGION_ITEM_CRC_OFFSET,
 			sizeof(struct nvram_item) - NVRAM_REGION_ITEM_CRC_OFFSET, 0);
@@ -591,6 +764,11 @@ static int region_find_item(struct region_info *region, const char *name,
 	if (!name || !item)
 		return -EINVAL;
 
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	if (region->item_index_valid)
+		return item_index_find(region, name, strlen(name) + 1, item);
+#endif
+
 	hash = calc_hash(name, strlen(name) + 1);
 
 #ifdef CONFIG_NVRAM_FAST_SEARCH
@@ -723,11 +901,15 @@ int region_copy_seg(struct region_info *region, u32_t new_seg_offset,
 	int item_offs, new_item_offs;
 	int item_size, item_total_size;
 	int status;
+	u16_t index_hash;
 
 #ifdef CONFIG_NVRAM_FAST_SEARCH
 	/* clear item bitmap for new segment */
 	item_bitmap_clear_all(region->seg_item_map, region->seg_item_map_size);
 #endif
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	item_index_clear_all(region);
+#endif
 
 	item_offs = old_seg_offset + NVRAM_SEG_ITEM_START_OFFSET;
 	new_item_offs = new_seg_offset + NVRAM_SEG_ITEM_START_OFFSET;
@@ -737,7 +919,7 @@ int region_copy_seg(struct region_info *region, u32_t new_seg_offset,
 		region_read(region, item_offs, (u8_t *)&item, sizeof(struct nvram_item));
 
 		/* check item */
-		status = item_check_validity(region, item_offs, &item, check_crc);
+		status = item_check_validity(region, item_offs, &item, check_crc, &index_hash);
 		SYS_LOG_DBG("item_offs: status 0x%x", status);
 
 		if (status == ITEM_STATUS_INVALID || status == ITEM_STATUS_EMPTY) {
@@ -750,6 +932,9 @@ int region_copy_seg(struct region_info *region, u32_t new_seg_offset,
 		item_total_size = item_get_aligned_size(&item);
 
 		if (status == ITEM_STATUS_VALID) {
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+			item_index_insert(region, index_hash, new_item_offs - new_seg_offset);
+#endif
 			item_size = item_get_real_size(&item);
 			SYS_LOG_DBG("valid item: copy from 0x%x to 0x%x, len 0x%x",
 				item_offs, new_item_offs, item_size);
@@ -796,6 +981,9 @@ static int region_init_new_seg(struct region_info *region, u32_t seg_offset)
 #ifdef CONFIG_NVRAM_FAST_SEARCH
 	item_bitmap_clear_all(region->seg_item_map, region->seg_item_map_size);
 #endif
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	item_index_clear_all(region);
+#endif
 
 	return 0;
 }
@@ -881,27 +1069,34 @@ static int region_is_same_config_data(struct region_info *region, const char *na
 
 }
 
-static int region_set(struct region_info *region, const char *name,
+static int region_check_config(const char *name, const void *data, int len)
+{
+	if (!name || (!data && len) || len > NVRAM_MAX_DATA_SIZE)
+		return -EINVAL;
+
+	if (strlen(name) + 1 > NVRAM_MAX_NAME_SIZE)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* write the new item, then obsolete the old one, len 0 only deletes it */
+static void region_update_item(struct region_info *region, const char *name,
 	const void *data, int len)
 {
 	struct nvram_item item;
 	int32_t name_len, new_item_size, item_len;
 	int old_item_offs;
-
-	if (!name || (!data && len) || len > NVRAM_MAX_DATA_SIZE)
-		return -EINVAL;
-
-	SYS_LOG_DBG("set config '%s', len %d\n", name, len);
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	u16_t index_hash;
+#endif
 
 	name_len = strlen(name) + 1;
-	if (name_len > NVRAM_MAX_NAME_SIZE)
-		return -EINVAL;
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	index_hash = calc_index_hash(name, name_len);
+#endif
 
 	if (len > 0) {
-		if(region_is_same_config_data(region, name, data, len)){
-			return 0;
-		}
-
 		/* write new config */
 		new_item_size = item_calc_aligned_size(name_len, len);
 
@@ -917,6 +1112,9 @@ static int region_set(struct region_info *region, const char *name,
 #ifdef CONFIG_NVRAM_FAST_SEARCH
 		item_bitmap_update(region->seg_item_map,
 			region->seg_write_offset - region->seg_offset, 1);
+#endif
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+		item_index_insert(region, index_hash, region->seg_write_offset - region->seg_offset);
 #endif
 		region->seg_write_offset += new_item_size;
 	}
@@ -932,8 +1130,81 @@ static int region_set(struct region_info *region, const char *name,
 
 #ifdef CONFIG_NVRAM_FAST_SEARCH
 		item_bitmap_update(region->seg_item_map, old_item_offs - region->seg_offset, 0);
+#endif
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+		item_index_remove(region, index_hash, old_item_offs - region->seg_offset);
 #endif
 	}
+}
+
+static int region_set(struct region_info *region, const char *name,
+	const void *data, int len)
+{
+	if (region_check_config(name, data, len))
+		return -EINVAL;
+
+	SYS_LOG_DBG("set config '%s', len %d\n", name, len);
+
+	if (len > 0 && region_is_same_config_data(region, name, data, len))
+		return 0;
+
+	region_update_item(region, name, data, len);
+
+	return 0;
+}
+
+/* at most 32 configs are checked against flash in one pass */
+#define NVRAM_SET_MANY_BATCH	32
+
+/*
+ * Unchanged configs are skipped, the space for the rest is made in one
+ * go, so a batch purges the segment at most once and its items are
+ * written back to back.
+ */
+static int region_set_many(struct region_info *region,
+	const struct nvram_config_entry *entries, int num)
+{
+	const struct nvram_config_entry *entry;
+	int i, batch, total_size;
+	u32_t changed;
+
+	for (i = 0; i < num; i++) {
+		entry = &entries[i];
+		if (region_check_config(entry->name, entry->data, entry->len))
+			return -EINVAL;
+	}
+
+	for (; num > 0; entries += batch, num -= batch) {
+		batch = min(num, NVRAM_SET_MANY_BATCH);
+		changed = 0;
+		total_size = 0;
+
+		for (i = 0; i < batch; i++) {
+			entry = &entries[i];
+			if (entry->len > 0) {
+				if (region_is_same_config_data(region, entry->name,
+							       entry->data, entry->len))
+					continue;
+
+				total_size += item_calc_aligned_size(strlen(entry->name) + 1,
+								     entry->len);
+			}
+
+			changed |= 1u << i;
+		}
+
+		SYS_LOG_DBG("set %d configs, changed 0x%x, size 0x%x\n", batch,
+			    changed, total_size);
+
+		if (total_size <= region->seg_size - NVRAM_SEG_ITEM_START_OFFSET)
+			region_prepare_write_item(region, total_size);
+
+		for (i = 0; i < batch; i++) {
+			entry = &entries[i];
+			if (changed & (1u << i))
+				region_update_item(region, entry->name, entry->data, entry->len);
+		}
+	}
 
 	return 0;
 }
@@ -1073,10 +1344,14 @@ static int region_seg_scan(struct region_info *region)
 	struct nvram_item item;
 	int err, offs, item_offs, status;
 	int need_purge = 0;
+	u16_t index_hash;
 
 #ifdef CONFIG_NVRAM_FAST_SEARCH
 	item_bitmap_clear_all(region->seg_item_map, region->seg_item_map_size);
 #endif
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+	item_index_clear_all(region);
+#endif
 
 	offs = NVRAM_SEG_ITEM_START_OFFSET;
 	item_offs = region->seg_offset + offs;
@@ -1090,12 +1365,15 @@ static int region_seg_scan(struct region_info *region)
 		}
 
 		/* read item header */
-		status = item_check_validity(region, item_offs, &item, 1);
+		status = item_check_validity(region, item_offs, &item, 1, &index_hash);
 		SYS_LOG_DBG("item_offs 0x%x: status 0x%x", item_offs, status);
 
 		if (status == ITEM_STATUS_VALID) {
 #ifdef CONFIG_NVRAM_FAST_SEARCH
 			item_bitmap_update(region->seg_item_map, offs, 1);
+#endif
+#ifdef CONFIG_NVRAM_ITEM_INDEX
+			item_index_insert(region, index_hash, offs);
 #endif
 		} else if (status == ITEM_STATUS_EMPTY) {
 			break;
@@ -1193,6 +1471,22 @@ int nvram_config_set(const char *name, const void *data, int len)
 	return ret;
 }
 
+int nvram_config_set_many(const struct nvram_config_entry *entries, int num)
+{
+	int ret;
+
+	if (!entries || num < 0)
+		return -EINVAL;
+
+	k_sem_take(&nvram_lock, K_FOREVER);
+
+	ret = region_set_many(&user_nvram_region, entries, num);
+
+	k_sem_give(&nvram_lock);
+
+	return ret;
+}
+
 int nvram_config_get_factory(const char *name, void *data, int max_len)
 {
 #ifdef CONFIG_NVRAM_STORAGE_FACTORY_RW_REGION
@@ -14,6 +14,11 @@
 
 #define TIMER_MAX_CYCLES_VALUE			0xfffffffful
 
+#if defined(CONFIG_TICKLESS_IDLE) && \
+	(!defined(CONFIG_ACTS_HRTIMER) || !defined(CONFIG_BUSY_WAIT_USES_ALTERNATE_CLOCK))
+#error "tickless idle needs the hrtimer tick and timer1 as clock source"
+#endif
+
 static void timer_reg_wait(void)
 {
 	volatile int i;
@@ -48,11 +53,75 @@ static void acts_timer0_isr(void *arg)
 #else
 static struct hrtimer tick_timer;
 
+#ifdef CONFIG_TICKLESS_IDLE
+/*
+ * The tick timer is one-shot: it is programmed to the next tick boundary
+ * while running and to the next kernel timeout while idle. The ticks are
+ * counted from the free running timer1 when the CPU wakes up, so sleeping
+ * over many ticks costs a single interrupt. Timer0 counts 24 bits, the
+ * hrtimer reload still wakes a long idle about every 0.7 s.
+ */
+#define CYCLES_PER_US		(CONFIG_SYS_CLOCK_HW_CYCLES_PER_SEC / 1000000)
+
+/* keep the idle time clear of the timer1 wrap */
+#define IDLE_MAX_TICKS		(0x7fffffff / sys_clock_hw_cycles_per_tick)
+
+/* timer1 cycle count of the last announced tick boundary */
+static u32_t tick_cycles;
+
+static void tick_timer_program(s32_t ticks)
+{
+	s32_t cycles;
+
+	cycles = tick_cycles + ticks * sys_clock_hw_cycles_per_tick -
+		 _timer_cycle_get_32();
+	if (cycles <= 0)
+		cycles = 1;
+
+	hrtimer_start(&tick_timer, (cycles + CYCLES_PER_US - 1) / CYCLES_PER_US, 0);
+}
+
+static void tick_announce_elapsed(void)
+{
+	u32_t ticks;
+
+	ticks = (_timer_cycle_get_32() - tick_cycles) / sys_clock_hw_cycles_per_tick;
+	if (!ticks)
+		return;
+
+	tick_cycles += ticks * sys_clock_hw_cycles_per_tick;
+
+	_sys_idle_elapsed_ticks = ticks;
+	_sys_clock_tick_announce();
+}
+
+void _timer_idle_enter(s32_t ticks)
+{
+	if (ticks == K_FOREVER || ticks > IDLE_MAX_TICKS)
+		ticks = IDLE_MAX_TICKS;
+
+	tick_timer_program(ticks);
+}
+
+/* called at the interrupt entry, before any handler looks at the clock */
+void _timer_idle_exit(void)
+{
+	tick_announce_elapsed();
+	tick_timer_program(1);
+}
+#endif /* CONFIG_TICKLESS_IDLE */
+
 static void acts_tick_timer(struct hrtimer *ttimer, void *arg)
 {
 	ARG_UNUSED(arg);
 
+#ifdef CONFIG_TICKLESS_IDLE
+	/* may be early by the us rounding, then it only reprograms */
+	tick_announce_elapsed();
+	tick_timer_program(1);
+#else
 	_sys_clock_tick_announce();
+#endif
 
 #ifndef CONFIG_BUSY_WAIT_USES_ALTERNATE_CLOCK
 	update_accumulated_count();
@@ -101,7 +170,12 @@ int _sys_clock_driver_init(struct device *device)
 
     hrtimer_init(&tick_timer, acts_tick_timer, NULL);
 
+#ifdef CONFIG_TICKLESS_IDLE
+	tick_cycles = _timer_cycle_get_32();
+	tick_timer_program(1);
+#else
     hrtimer_start(&tick_timer, 1000000 / CONFIG_SYS_CLOCK_TICKS_PER_SEC, 1000000 / CONFIG_SYS_CLOCK_TICKS_PER_SEC);   
+#endif
 #endif
 	return 0;
 }
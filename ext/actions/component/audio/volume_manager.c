@@ -34,7 +34,8 @@ static void _system_volume_set_notify(u32_t volume, bool is_limited)
 	new_msg.cmd = is_limited;
 	new_msg.value = volume;
 
-	send_async_msg("main", &new_msg);
+	/* only the latest volume matters */
+	send_async_msg_ex("main", &new_msg, MSG_PRIO_NORMAL, MSG_FLAG_COALESCE);
 }
 
 int system_volume_set(int stream_type, int volume, bool display)
@@ -122,7 +123,7 @@ static void _system_volume_change_notify(u32_t volume)
 	new_msg.value = volume;
 
 	if (current_app) {
-		send_async_msg(current_app, &new_msg);
+		send_async_msg_ex(current_app, &new_msg, MSG_PRIO_NORMAL, MSG_FLAG_COALESCE);
 	}
 }
 
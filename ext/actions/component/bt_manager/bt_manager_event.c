@@ -91,6 +91,6 @@ int bt_manager_state_notify(int state)
 	msg.type = MSG_BT_EVENT;
 	msg.cmd = state;
 
-	return send_async_msg("main", &msg);
+	return send_async_msg_ex("main", &msg, MSG_PRIO_NORMAL, MSG_FLAG_COALESCE);
 }
 
@@ -6,6 +6,13 @@
 
 /**
  * @file media mem interface
+ *
+ * Each stream type declares the buffers it needs from a shared pool as a
+ * plan structure. A pool is the union of the plans of all stream types
+ * using it, so the compiler lays out the buffers of one stream type
+ * without overlap, overlays the stream types on each other and sizes the
+ * pool by the largest plan. Per stream cell tables indexed by memory type
+ * then give O(1) lookup.
  */
 #define SYS_LOG_DOMAIN "media"
 #include <linker/section_tags.h>
@@ -17,15 +24,16 @@
 #include "media_mem.h"
 
 struct media_memory_cell {
-	u8_t mem_type;
-	u32_t mem_base;
+	void *mem_base;
 	u32_t mem_size;
 };
 
-struct media_memory_block {
-	u8_t stream_type;
-	struct media_memory_cell mem_cell[31];
-};
+/* a buffer of a stream plan, word aligned for dma and ring buffers */
+#define MEDIA_MEM_BUF(name, size)	char name[size] __aligned(4)
+
+/* cell of a plan table, buf is a planned buffer or a dedicated array */
+#define MEDIA_MEM_CELL(type, buf)	[type] = { .mem_base = (buf), .mem_size = sizeof(buf), }
+
 #ifdef CONFIG_MEDIA
 /*
  * sbc(msbc) dec: global - 0x0d10, share - 0x0000
@@ -44,10 +52,6 @@ static char msbc_dec2_global_bss[0x0d20] _NODATA_SECTION(.msbc.dec2.global_bss)
 static char sbc_enc2_global_bss[0x0bec] __in_section_unique(SBC_ENC2_BUF) __aligned(16);
 
 static char sbc_dec2_global_bss[0x0d20] _NODATA_SECTION(.btmusic_pcm_bss) __aligned(16);
-static char btmusic_pcm_bss[0x4800] _NODATA_SECTION(.btmusic_pcm_bss);
-#else
-/* btmusic and pcm codec based stream type, linein, usound, etc. */
-static char btmusic_pcm_bss[0x3000] _NODATA_SECTION(.btmusic_pcm_bss);
 #endif
 
 /*
@@ -62,9 +66,6 @@ static char wav_enc_adpcm_inbuf[0x1FE4 + 0x400] __in_section_unique(wav_enc.adpc
 static char wav_enc_adpcm_outbuf[0x800] __in_section_unique(wav_enc.adpcm.outbuf);
 #endif
 
-static char playback_input_buffer[13 * 1024] __in_section_unique(media.buff.noinit);
-
-
 #ifdef CONFIG_TOOL_ASQT
 /* asqt */
 static char asqt_tool_stub_buf[1548] _NODATA_SECTION(tool.asqt.buf.noinit);
@@ -79,24 +80,8 @@ static char ectt_tool_buf[3072] _NODATA_SECTION(tool.ectt.buf.noinit);
 static char codec_stack[2048] __aligned(STACK_ALIGN) __in_section_unique(codec.noinit.stack);
 #endif
 
-//#ifdef CONFIG_HFP_SPEECH
-//#ifdef CONFIG_AEC_TAIL_LENGTH
-//#define MSBC_AEC_TAIL_LENGTH (CONFIG_AEC_TAIL_LENGTH)
-//#else
-//#define MSBC_AEC_TAIL_LENGTH (32)
-//#endif
-//#define CVSD_AEC_TAIL_LENGTH (MSBC_AEC_TAIL_LENGTH * 2)
-//static char hfp_aec_global_bss[10536 * 2 + 1280 * 2 + MSBC_AEC_TAIL_LENGTH * 32 * 6] __hfp_aec_ovl_bss __aligned(4);
-//#ifdef CONFIG_OUTPUT_RESAMPLE
-//static char hfp_aec_share_bss[3082 * 2] __hfp_aec_ovl_bss __aligned(4);
-//#endif
-//#endif /* CONFIG_HFP_SPEECH */
-
 #ifdef CONFIG_HFP_PLC
 static char hfp_plc_global_bss[2030 * 2 + 120 * 2] __hfp_plc_ovl_bss __aligned(4);
-//#ifndef CONFIG_HFP_SPEECH
-//static char hfp_plc_share_bss[1950 * 2] __hfp_plc_ovl_bss __aligned(4);
-//#endif
 #endif /* CONFIG_HFP_PLC */
 
 
@@ -108,374 +93,460 @@ static char resample_share_hw_bss[1776] __aligned(4) _NODATA_SECTION(.resample.s
 static char resample_global_hw_bss[820 + 32] __aligned(4)  _NODATA_SECTION(.resample.global_buf);
 
 #endif
-static char cascade_extranel_buf[0x1600] __aligned(4) _NODATA_SECTION(.cascade.extranel_buf);
 static char sbc_dec_uac_global_bss[0x0d20] _NODATA_SECTION(.cascade.dec_uac_buf) __aligned(16);;
 
-static const struct media_memory_block media_memory_config[] = {
-	{
-		.stream_type = AUDIO_STREAM_MUSIC,
-		.mem_cell = {
-			{.mem_type = OUTPUT_DECODER,  .mem_base = (u32_t)&btmusic_pcm_bss[0x0000], .mem_size = 0x800,},
-			{.mem_type = OUTPUT_PLAYBACK, .mem_base = (u32_t)&btmusic_pcm_bss[0x0800], .mem_size = 0x800,},
-			{.mem_type = OUTPUT_PCM,      .mem_base = (u32_t)&btmusic_pcm_bss[0x1000], .mem_size = 0x800,},
-			{.mem_type = DECODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_dec_global_bss[0], .mem_size = sizeof(sbc_dec_global_bss),},
-
-		#ifdef CONFIG_TWS_MONO_MODE
-			{.mem_type = TWS_LOCAL_INPUT, .mem_base = (u32_t)&playback_input_buffer[0], .mem_size = sizeof(playback_input_buffer),},
-			{.mem_type = INPUT_PLAYBACK,  .mem_base = (u32_t)&btmusic_pcm_bss[0x1800], .mem_size = 0x3000,},
-			{.mem_type = SBC_DECODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_dec2_global_bss[0], .mem_size = sizeof(sbc_dec2_global_bss),},
-			{.mem_type = SBC_ENCODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc_global_bss[0], .mem_size = sizeof(sbc_enc_global_bss),},
-			{.mem_type = SBC_ENCODER_2_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc2_global_bss[0], .mem_size = sizeof(sbc_enc2_global_bss),},
-		#else
-			{.mem_type = SBC_ENCODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc_global_bss[0], .mem_size = sizeof(sbc_enc_global_bss),},
-			{.mem_type = INPUT_PLAYBACK,  .mem_base = (u32_t)&playback_input_buffer[0], .mem_size = sizeof(playback_input_buffer),},
-		#endif
-
-		#ifdef CONFIG_TOOL_ECTT
-			{.mem_type = TOOL_ECTT_BUF, .mem_base = (u32_t)&ectt_tool_buf[0], .mem_size = sizeof(ectt_tool_buf),},
-		#endif
-
-		#ifdef CONFIG_ACTIONS_DECODER
-			{.mem_type = CODEC_STACK, .mem_base = (u32_t)&codec_stack[0], .mem_size = sizeof(codec_stack),},
-		#endif
-
-		#ifdef CONFIG_RESAMPLE
-			{.mem_type = RESAMPLE_GLOBAL_HW_DATA,  .mem_base = (u32_t)resample_global_hw_bss, .mem_size = sizeof(resample_global_hw_bss),},
-			{.mem_type = RESAMPLE_SHARE_HW_DATA, .mem_base = (u32_t)resample_share_hw_bss, .mem_size = sizeof(resample_share_hw_bss),},
-		#endif
-		},
-	},
-
-	{
-		.stream_type = AUDIO_STREAM_LOCAL_MUSIC,
-		.mem_cell = {
-			{.mem_type = TWS_LOCAL_INPUT, .mem_base = (u32_t)&playback_input_buffer[0], .mem_size = 0x1400,},
-			{.mem_type = OUTPUT_PCM,      .mem_base = (u32_t)&playback_input_buffer[0x1400], .mem_size = 0x1800,},
-			{.mem_type = OUTPUT_DECODER,  .mem_base = (u32_t)&playback_input_buffer[0x2c00], .mem_size = 0x0200,},
-			{.mem_type = OUTPUT_PLAYBACK, .mem_base = (u32_t)&playback_input_buffer[0x2e00], .mem_size = 0x0200,},
-
-			{.mem_type = SBC_DECODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_dec_global_bss[0], .mem_size = sizeof(sbc_dec_global_bss),},
-			{.mem_type = SBC_ENCODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc_global_bss[0], .mem_size = sizeof(sbc_enc_global_bss),},
-		#ifdef CONFIG_TWS_MONO_MODE
-			{.mem_type = SBC_ENCODER_2_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc2_global_bss[0], .mem_size = sizeof(sbc_enc2_global_bss),},
-		#endif
-
-		#ifdef CONFIG_ACTIONS_DECODER
-			{.mem_type = CODEC_STACK, .mem_base = (u32_t)&codec_stack[0], .mem_size = sizeof(codec_stack),},
-		#endif
-
-		#ifdef CONFIG_TOOL_ECTT
-			{.mem_type = TOOL_ECTT_BUF, .mem_base = (u32_t)&ectt_tool_buf[0], .mem_size = sizeof(ectt_tool_buf),},
-		#endif
-
-		#ifdef CONFIG_RESAMPLE
-			{.mem_type = RESAMPLE_GLOBAL_HW_DATA,  .mem_base = (u32_t)resample_global_hw_bss, .mem_size = sizeof(resample_global_hw_bss),},
-			{.mem_type = RESAMPLE_SHARE_HW_DATA, .mem_base = (u32_t)resample_share_hw_bss, .mem_size = sizeof(resample_share_hw_bss),},
-		#endif
-		},
-	},
-
-	{
-		.stream_type = AUDIO_STREAM_LINEIN,
-		.mem_cell = {
-			{.mem_type = TWS_LOCAL_INPUT, .mem_base = (u32_t)&playback_input_buffer[0], .mem_size = 0x3000,},
-			{.mem_type = OUTPUT_DECODER,  .mem_base = (u32_t)&btmusic_pcm_bss[0x0000], .mem_size = 0x400,},
-			{.mem_type = OUTPUT_PLAYBACK, .mem_base = (u32_t)&btmusic_pcm_bss[0x0400], .mem_size = 0x400,},
-			{.mem_type = OUTPUT_PCM,      .mem_base = (u32_t)&btmusic_pcm_bss[0x0800], .mem_size = 0x400,},
-
-			{.mem_type = INPUT_PCM,       .mem_base = (u32_t)&btmusic_pcm_bss[0x1000], .mem_size = 0x400,},
-			{.mem_type = INPUT_ENCBUF,    .mem_base = (u32_t)&btmusic_pcm_bss[0x1800], .mem_size = 0x200,},
-			{.mem_type = OUTPUT_CAPTURE,  .mem_base = (u32_t)&btmusic_pcm_bss[0x1A00], .mem_size = 0x200,},
-			{.mem_type = INPUT_PLAYBACK,  .mem_base = (u32_t)&btmusic_pcm_bss[0x1C00], .mem_size = 0x400,},
-
-			{.mem_type = SBC_DECODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_dec_global_bss[0], .mem_size = sizeof(sbc_dec_global_bss),},
-			{.mem_type = SBC_ENCODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc_global_bss[0], .mem_size = sizeof(sbc_enc_global_bss),},
-		#ifdef CONFIG_TWS_MONO_MODE
-			{.mem_type = SBC_ENCODER_2_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc2_global_bss[0], .mem_size = sizeof(sbc_enc2_global_bss),},
-		#endif
-
-		#ifdef CONFIG_ACTIONS_DECODER
-			{.mem_type = CODEC_STACK, .mem_base = (u32_t)&codec_stack[0], .mem_size = sizeof(codec_stack),},
-		#endif
-
-		#ifdef CONFIG_RESAMPLE
-			{.mem_type = RESAMPLE_GLOBAL_HW_DATA,  .mem_base = (u32_t)resample_global_hw_bss, .mem_size = sizeof(resample_global_hw_bss),},
-			{.mem_type = RESAMPLE_SHARE_HW_DATA, .mem_base = (u32_t)resample_share_hw_bss, .mem_size = sizeof(resample_share_hw_bss),},
-			{.mem_type = RESAMPLE_SHARE_SW_DATA, .mem_base = (u32_t)resample_share_sw_bss, .mem_size = sizeof(resample_share_sw_bss),},
-			{.mem_type = RESAMPLE_SHARE_SW_DATA2, .mem_base = (u32_t)resample_share_sw_bss2, .mem_size = sizeof(resample_share_sw_bss2),},
-		#endif
-		},
-	},
-
-	{
-		.stream_type = AUDIO_STREAM_USOUND,
-		.mem_cell = {
-			{.mem_type = TWS_LOCAL_INPUT, .mem_base = (u32_t)&playback_input_buffer[0], .mem_size = 0x2400,},
-			{.mem_type = OUTPUT_DECODER,  .mem_base = (u32_t)&btmusic_pcm_bss[0x0000], .mem_size = 0x400,},
-			{.mem_type = OUTPUT_PLAYBACK, .mem_base = (u32_t)&btmusic_pcm_bss[0x0400], .mem_size = 0x400,},
-			{.mem_type = OUTPUT_PCM,      .mem_base = (u32_t)&btmusic_pcm_bss[0x0800], .mem_size = 0x800,},
-
-			{.mem_type = INPUT_CAPTURE_EXT, .mem_base = (u32_t)&cascade_extranel_buf[0x000], .mem_size = 0x400,},
-			{.mem_type = EXT_GLOBLE_BUF, .mem_base = (u32_t)&cascade_extranel_buf[0x400], .mem_size = 0x400,},
-			{.mem_type = INPUT_EXT_STREAM, .mem_base = (u32_t)&cascade_extranel_buf[0x800], .mem_size = 0x400,},
-			{.mem_type = INPUT_EXT_MIX_STREAM, .mem_base = (u32_t)&cascade_extranel_buf[0xC00], .mem_size = 0x200,},
-
-			{.mem_type = INPUT_PCM,       .mem_base = (u32_t)&btmusic_pcm_bss[0x1000], .mem_size = 0x800,},
-			{.mem_type = INPUT_ENCBUF,    .mem_base = (u32_t)&btmusic_pcm_bss[0x1800], .mem_size = 0x200,},
-			{.mem_type = OUTPUT_CAPTURE,  .mem_base = (u32_t)&btmusic_pcm_bss[0x1A00], .mem_size = 0x200,},
-			{.mem_type = INPUT_PLAYBACK,  .mem_base = (u32_t)&btmusic_pcm_bss[0x1C00], .mem_size = 0x1000,},
-			{.mem_type = RESAMPLE_UAC_OUT_STREAM, .mem_base = (u32_t)&cascade_extranel_buf[0xE00], .mem_size = 0x200,},
-			{.mem_type = RESAMPLE_UAC_IN_STREAM, .mem_base = (u32_t)&cascade_extranel_buf[0x1000], .mem_size = 0x200,},
-			{.mem_type = RESAMPLE_OUTPUT_DATA, .mem_base = (u32_t)&cascade_extranel_buf[0x1200], .mem_size = 0x200,},
-
-			{.mem_type = USB_UPLOAD_CACHE, .mem_base = (u32_t)&playback_input_buffer[0x24A0], .mem_size = 0x800,},
-			{.mem_type = USB_UPLOAD_PAYLOAD, .mem_base = (u32_t)&playback_input_buffer[0x2CA0], .mem_size = 0x60,},
-
-			{.mem_type = SBC_DECODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_dec_global_bss[0], .mem_size = sizeof(sbc_dec_global_bss),},
-			{.mem_type = SBC_DECODER_2_GLOBAL_DATA, .mem_base = (u32_t)&sbc_dec_uac_global_bss[0], .mem_size =sizeof(sbc_dec_uac_global_bss),},
-			{.mem_type = SBC_ENCODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc_global_bss[0], .mem_size = sizeof(sbc_enc_global_bss),},
-		#ifdef CONFIG_TWS_MONO_MODE
-			{.mem_type = SBC_ENCODER_2_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc2_global_bss[0], .mem_size = sizeof(sbc_enc2_global_bss),},
-		#endif
-
-		#ifdef CONFIG_ACTIONS_DECODER
-			{.mem_type = CODEC_STACK, .mem_base = (u32_t)&codec_stack[0], .mem_size = sizeof(codec_stack),},
-		#endif
-
-		#ifdef CONFIG_RESAMPLE
-			{.mem_type = RESAMPLE_GLOBAL_HW_DATA,  .mem_base = (u32_t)resample_global_hw_bss, .mem_size = sizeof(resample_global_hw_bss),},
-			{.mem_type = RESAMPLE_SHARE_HW_DATA, .mem_base = (u32_t)resample_share_hw_bss, .mem_size = sizeof(resample_share_hw_bss),},
-			{.mem_type = RESAMPLE_SHARE_SW_DATA, .mem_base = (u32_t)resample_share_sw_bss, .mem_size = sizeof(resample_share_sw_bss),},
-			{.mem_type = RESAMPLE_SHARE_SW_DATA2, .mem_base = (u32_t)resample_share_sw_bss2, .mem_size = sizeof(resample_share_sw_bss2),},
-		#endif
-		},
-	},
-
-	{
-		.stream_type = AUDIO_STREAM_VOICE,
-		.mem_cell = {
-			{.mem_type = INPUT_PLAYBACK,  .mem_base = (u32_t)&playback_input_buffer[0x000], .mem_size = 0x2A8,},
-			{.mem_type = OUTPUT_DECODER,  .mem_base = (u32_t)&playback_input_buffer[0x2A8], .mem_size = 0x200,},
-			{.mem_type = OUTPUT_PLAYBACK, .mem_base = (u32_t)&playback_input_buffer[0x4A8], .mem_size = 0x200,},
-			{.mem_type = INPUT_PCM,      .mem_base = (u32_t)&playback_input_buffer[0x6A8], .mem_size = 0x400,},
-			{.mem_type = INPUT_CAPTURE,  .mem_base = (u32_t)&playback_input_buffer[0xAA8], .mem_size = 0x200,},
-			{.mem_type = INPUT_ENCBUF,   .mem_base = (u32_t)&playback_input_buffer[0xCA8], .mem_size = 0x400,},
-			{.mem_type = OUTPUT_CAPTURE, .mem_base = (u32_t)&playback_input_buffer[0x10A8], .mem_size = 0x078,},
-			{.mem_type = AEC_REFBUF0,    .mem_base = (u32_t)&playback_input_buffer[0x1120], .mem_size = 0x400,},
-
-			{.mem_type = OUTPUT_SCO, .mem_base = (u32_t)&playback_input_buffer[0x1520], .mem_size = 0xE8,},
-			{.mem_type = TX_SCO,     .mem_base = (u32_t)&playback_input_buffer[0x1608], .mem_size = 0x7C,},
-			{.mem_type = RX_SCO,     .mem_base = (u32_t)&playback_input_buffer[0x1684], .mem_size = 0xF0,},
-
-			{.mem_type = OUTPUT_PCM,	  .mem_base = (u32_t)&playback_input_buffer[0x26bc], .mem_size = 0x800,},
-			//{.mem_type = OUTPUT_PCM,      .mem_base = (u32_t)&playback_input_buffer[0x6A8], .mem_size = 0x200,},
-
-
-			{.mem_type = INPUT_CAPTURE_EXT, .mem_base = (u32_t)&cascade_extranel_buf[0x000], .mem_size = 0x600,},
-			{.mem_type = RESAMPLE_OUTPUT_DATA, .mem_base = (u32_t)&cascade_extranel_buf[0x600], .mem_size = 0x200,},
-			{.mem_type = EXT_GLOBLE_BUF, .mem_base = (u32_t)&cascade_extranel_buf[0x800], .mem_size = 0x400,},
-			{.mem_type = INPUT_EXT_STREAM, .mem_base = (u32_t)&cascade_extranel_buf[0xC00], .mem_size = 0x800,},
-			{.mem_type = INPUT_EXT_MIX_STREAM, .mem_base = (u32_t)&cascade_extranel_buf[0x1400], .mem_size = 0x200,},
-
-			{.mem_type = SBC_DECODER_GLOBAL_DATA, .mem_base = (u32_t)&msbc_dec2_global_bss[0], .mem_size = sizeof(msbc_dec2_global_bss),},
-			{.mem_type = SBC_DECODER_2_GLOBAL_DATA, .mem_base = (u32_t)&sbc_dec_uac_global_bss[0], .mem_size =sizeof(sbc_dec_uac_global_bss),},
-
-		#ifdef CONFIG_TWS_MONO_MODE
-			{.mem_type = SBC_ENCODER_2_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc2_global_bss[0], .mem_size = sizeof(sbc_enc2_global_bss),},
-		#endif
-
-			{.mem_type = DECODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_dec_global_bss[0], .mem_size = sizeof(sbc_dec_global_bss),},
-			{.mem_type = ENCODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc_global_bss[0], .mem_size = sizeof(sbc_enc_global_bss),},
-		//#ifdef CONFIG_HFP_SPEECH
-			//{.mem_type = AEC_GLOBAL_DATA, .mem_base = (u32_t)&hfp_aec_global_bss[0], .mem_size = sizeof(hfp_aec_global_bss),},
-		//#ifndef CONFIG_OUTPUT_RESAMPLE
-		//	{.mem_type = AEC_SHARE_DATA,  .mem_base = (u32_t)&playback_input_buffer[0x1780], .mem_size = 3082 * 2,},
-		//#else
-		//	{.mem_type = AEC_SHARE_DATA,  .mem_base = (u32_t)&hfp_aec_share_bss[0], .mem_size = sizeof(hfp_aec_share_bss),},
-		//#endif
-		//#endif
-		#ifdef CONFIG_HFP_PLC
-			{.mem_type = PLC_GLOBAL_DATA, .mem_base = (u32_t)&hfp_plc_global_bss[0], .mem_size = sizeof(hfp_plc_global_bss),},
-			{.mem_type = PLC_SHARE_DATA,  .mem_base = (u32_t)&playback_input_buffer[0x1780], .mem_size = 1950 * 2,},
-
-		#endif
-
-		#ifdef CONFIG_TOOL_ASQT
-			{.mem_type = TOOL_ASQT_STUB_BUF, .mem_base = (u32_t)&asqt_tool_stub_buf[0], .mem_size = sizeof(asqt_tool_stub_buf),},
-			{.mem_type = TOOL_ASQT_DUMP_BUF, .mem_base = (u32_t)&asqt_tool_data_buf[0], .mem_size = sizeof(asqt_tool_data_buf),},
-		#endif
-
-		#ifdef CONFIG_ACTIONS_DECODER
-			{.mem_type = CODEC_STACK, .mem_base = (u32_t)&codec_stack[0], .mem_size = sizeof(codec_stack),},
-		#endif
-
-		#ifdef CONFIG_RESAMPLE
-			{.mem_type = RESAMPLE_GLOBAL_HW_DATA,  .mem_base = (u32_t)resample_global_hw_bss, .mem_size = sizeof(resample_global_hw_bss),},
-			{.mem_type = RESAMPLE_SHARE_HW_DATA, .mem_base = (u32_t)resample_share_hw_bss, .mem_size = sizeof(resample_share_hw_bss),},
-			{.mem_type = RESAMPLE_SHARE_SW_DATA, .mem_base = (u32_t)resample_share_sw_bss, .mem_size = sizeof(resample_share_sw_bss),},
-			{.mem_type = RESAMPLE_SHARE_SW_DATA2, .mem_base = (u32_t)resample_share_sw_bss2, .mem_size = sizeof(resample_share_sw_bss2),},
-		#endif
-		},
-	},
-
-	{
-		.stream_type = AUDIO_STREAM_TTS,
-		.mem_cell = {
-			{.mem_type = TWS_LOCAL_INPUT, .mem_base = (u32_t)&playback_input_buffer[0], .mem_size = 0x1400,},
-			{.mem_type = OUTPUT_PCM,      .mem_base = (u32_t)&playback_input_buffer[0x1400], .mem_size = 2048,},
-			{.mem_type = OUTPUT_DECODER,  .mem_base = (u32_t)&playback_input_buffer[0x2c00], .mem_size = 0x0100,},
-			{.mem_type = OUTPUT_PLAYBACK, .mem_base = (u32_t)&playback_input_buffer[0x2d00], .mem_size = 0x0100,},
-
-			{.mem_type = SBC_DECODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_dec_global_bss[0], .mem_size = sizeof(sbc_dec_global_bss),},
-			{.mem_type = SBC_ENCODER_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc_global_bss[0], .mem_size = sizeof(sbc_enc_global_bss),},
-		#ifdef CONFIG_TWS_MONO_MODE
-			{.mem_type = SBC_ENCODER_2_GLOBAL_DATA, .mem_base = (u32_t)&sbc_enc2_global_bss[0], .mem_size = sizeof(sbc_enc2_global_bss),},
-		#endif
-
-		#ifdef CONFIG_ACTIONS_DECODER
-			{.mem_type = CODEC_STACK, .mem_base = (u32_t)&codec_stack[0], .mem_size = sizeof(codec_stack),},
-		#endif
-
-		#ifdef CONFIG_TOOL_ECTT
-			{.mem_type = TOOL_ECTT_BUF, .mem_base = (u32_t)&ectt_tool_buf[0], .mem_size = sizeof(ectt_tool_buf),},
-		#endif
-
-		#ifdef CONFIG_RESAMPLE
-			{.mem_type = RESAMPLE_GLOBAL_HW_DATA,  .mem_base = (u32_t)resample_global_hw_bss, .mem_size = sizeof(resample_global_hw_bss),},
-			{.mem_type = RESAMPLE_SHARE_HW_DATA, .mem_base = (u32_t)resample_share_hw_bss, .mem_size = sizeof(resample_share_hw_bss),},
-			{.mem_type = RESAMPLE_SHARE_SW_DATA, .mem_base = (u32_t)resample_share_sw_bss, .mem_size = sizeof(resample_share_sw_bss),},
-			{.mem_type = RESAMPLE_SHARE_SW_DATA2, .mem_base = (u32_t)resample_share_sw_bss2, .mem_size = sizeof(resample_share_sw_bss2),},
-		#endif
-
-
-		},
-	},
-
-	{
-		.stream_type = AUDIO_STREAM_LOCAL_RECORD,
-		.mem_cell = {
-			{.mem_type = INPUT_PCM,      .mem_base = (u32_t)&playback_input_buffer[0x0000], .mem_size = 0x800,},
-			{.mem_type = INPUT_ENCBUF,   .mem_base = (u32_t)&playback_input_buffer[0x0800], .mem_size = 0x2000,},
-			{.mem_type = OUTPUT_CAPTURE, .mem_base = (u32_t)&playback_input_buffer[0x2800], .mem_size = 0x800,},
-
-		#ifdef CONFIG_ACTIONS_DECODER
-			{.mem_type = CODEC_STACK, .mem_base = (u32_t)&codec_stack[0], .mem_size = sizeof(codec_stack),},
-		#endif
-		},
-	},
-
-	{
-		.stream_type = AUDIO_STREAM_GMA_RECORD,
-		.mem_cell = {
-			{.mem_type = INPUT_PCM,      .mem_base = (u32_t)&playback_input_buffer[0x0000], .mem_size = 0x800,},
-			{.mem_type = INPUT_ENCBUF,   .mem_base = (u32_t)&playback_input_buffer[0x0800], .mem_size = 0x1200,},
-			{.mem_type = OUTPUT_CAPTURE, .mem_base = (u32_t)&playback_input_buffer[0x1A00], .mem_size = 0x600,},
-
-		#ifdef CONFIG_ACTIONS_DECODER
-			{.mem_type = CODEC_STACK, .mem_base = (u32_t)&codec_stack[0], .mem_size = sizeof(codec_stack),},
-		#endif
-		},
-	},
+/*
+ * playback_input_buffer: stream input, or all buffers of the stream types
+ * that do not use btmusic_pcm_bss.
+ */
+#define PLAYBACK_INPUT_BUFFER_SIZE	(13 * 1024)
 
-#ifdef CONFIG_RECORD_SERVICE
-	{
-		.stream_type = AUDIO_STREAM_BACKGROUND_RECORD,
-		.mem_cell = {
-			{.mem_type = INPUT_ENCBUF,   .mem_base = (u32_t)&wav_enc_adpcm_inbuf[0],  .mem_size = sizeof(wav_enc_adpcm_inbuf),},
-			{.mem_type = OUTPUT_CAPTURE, .mem_base = (u32_t)&wav_enc_adpcm_outbuf[0], .mem_size = sizeof(wav_enc_adpcm_outbuf),},
-		},
-	},
-#endif
-
-	{
-		.stream_type = AUDIO_STREAM_TWS,
-		.mem_cell = {
-			{.mem_type = INPUT_PLAYBACK,  .mem_base = (u32_t)&playback_input_buffer[0], .mem_size = sizeof(playback_input_buffer),},
-		},
-	},
+struct music_input_plan {
+	/* tws local input in mono mode, playback input otherwise */
+	MEDIA_MEM_BUF(input, PLAYBACK_INPUT_BUFFER_SIZE);
 };
 
-static const struct media_memory_block *_memdia_mem_find_memory_block(int stream_type)
-{
-	const struct media_memory_block *mem_block = NULL;
+struct local_music_input_plan {
+	MEDIA_MEM_BUF(tws_local_input, 0x1400);
+	MEDIA_MEM_BUF(output_pcm, 0x1800);
+	MEDIA_MEM_BUF(output_decoder, 0x0200);
+	MEDIA_MEM_BUF(output_playback, 0x0200);
+};
 
-	if (stream_type == AUDIO_STREAM_FM
-		|| stream_type == AUDIO_STREAM_I2SRX_IN
-		|| stream_type == AUDIO_STREAM_SPDIF_IN
-		|| stream_type == AUDIO_STREAM_MIC_IN) {
-		stream_type = AUDIO_STREAM_LINEIN;
-	}
+struct linein_input_plan {
+	MEDIA_MEM_BUF(tws_local_input, 0x3000);
+};
 
-	for (int i = 0; i < ARRAY_SIZE(media_memory_config) ; i++) {
-		mem_block = &media_memory_config[i];
-		if (mem_block->stream_type == stream_type) {
-			return mem_block;
-		}
-	}
+struct usound_input_plan {
+	MEDIA_MEM_BUF(tws_local_input, 0x2400);
+	MEDIA_MEM_BUF(usb_upload_cache, 0x800);
+	MEDIA_MEM_BUF(usb_upload_payload, 0x60);
+};
 
-	return NULL;
-}
+struct voice_input_plan {
+	MEDIA_MEM_BUF(input_playback, 0x2A8);
+	MEDIA_MEM_BUF(output_decoder, 0x200);
+	MEDIA_MEM_BUF(output_playback, 0x200);
+	MEDIA_MEM_BUF(input_pcm, 0x400);
+	MEDIA_MEM_BUF(input_capture, 0x200);
+	MEDIA_MEM_BUF(input_encbuf, 0x400);
+	MEDIA_MEM_BUF(output_capture, 0x078);
+	MEDIA_MEM_BUF(aec_refbuf0, 0x400);
+	MEDIA_MEM_BUF(output_sco, 0xE8);
+	MEDIA_MEM_BUF(tx_sco, 0x7C);
+	MEDIA_MEM_BUF(rx_sco, 0xF0);
+#ifdef CONFIG_HFP_PLC
+	MEDIA_MEM_BUF(plc_share, 1950 * 2);
+#endif
+	MEDIA_MEM_BUF(output_pcm, 0x800);
+};
 
-static const struct media_memory_cell *_memdia_mem_find_memory_cell(const struct media_memory_block *mem_block, int mem_type)
-{
-	const struct media_memory_cell *mem_cell = NULL;
+struct tts_input_plan {
+	MEDIA_MEM_BUF(tws_local_input, 0x1400);
+	MEDIA_MEM_BUF(output_pcm, 0x800);
+	MEDIA_MEM_BUF(output_decoder, 0x100);
+	MEDIA_MEM_BUF(output_playback, 0x100);
+};
 
-	for (int i = 0; i < ARRAY_SIZE(mem_block->mem_cell) ; i++) {
-		mem_cell = &mem_block->mem_cell[i];
-		if (mem_cell->mem_type == mem_type) {
-			return mem_cell;
-		}
-	}
+struct local_record_input_plan {
+	MEDIA_MEM_BUF(input_pcm, 0x800);
+	MEDIA_MEM_BUF(input_encbuf, 0x2000);
+	MEDIA_MEM_BUF(output_capture, 0x800);
+};
 
-	return NULL;
-}
+struct gma_record_input_plan {
+	MEDIA_MEM_BUF(input_pcm, 0x800);
+	MEDIA_MEM_BUF(input_encbuf, 0x1200);
+	MEDIA_MEM_BUF(output_capture, 0x600);
+};
 
-void *media_mem_get_cache_pool(int mem_type, int stream_type)
-{
-	const struct media_memory_block *mem_block = NULL;
-	const struct media_memory_cell *mem_cell = NULL;
-	void *addr = NULL;
+struct tws_input_plan {
+	MEDIA_MEM_BUF(input_playback, PLAYBACK_INPUT_BUFFER_SIZE);
+};
 
-	mem_block = _memdia_mem_find_memory_block(stream_type);
+static union {
+	struct music_input_plan music;
+	struct local_music_input_plan local_music;
+	struct linein_input_plan linein;
+	struct usound_input_plan usound;
+	struct voice_input_plan voice;
+	struct tts_input_plan tts;
+	struct local_record_input_plan local_record;
+	struct gma_record_input_plan gma_record;
+	struct tws_input_plan tws;
+} playback_input_buffer __in_section_unique(media.buff.noinit);
+
+/* btmusic_pcm_bss: btmusic and pcm codec based stream type, linein, usound, etc. */
+struct music_pcm_plan {
+	MEDIA_MEM_BUF(output_decoder, 0x800);
+	MEDIA_MEM_BUF(output_playback, 0x800);
+	MEDIA_MEM_BUF(output_pcm, 0x800);
+#ifdef CONFIG_TWS_MONO_MODE
+	MEDIA_MEM_BUF(input_playback, 0x3000);
+#endif
+};
 
-	if (!mem_block) {
-		goto exit;
-	}
+struct linein_pcm_plan {
+	MEDIA_MEM_BUF(output_decoder, 0x400);
+	MEDIA_MEM_BUF(output_playback, 0x400);
+	MEDIA_MEM_BUF(output_pcm, 0x400);
+	MEDIA_MEM_BUF(input_pcm, 0x400);
+	MEDIA_MEM_BUF(input_encbuf, 0x200);
+	MEDIA_MEM_BUF(output_capture, 0x200);
+	MEDIA_MEM_BUF(input_playback, 0x400);
+};
 
-	mem_cell = _memdia_mem_find_memory_cell(mem_block, mem_type);
+struct usound_pcm_plan {
+	MEDIA_MEM_BUF(output_decoder, 0x400);
+	MEDIA_MEM_BUF(output_playback, 0x400);
+	MEDIA_MEM_BUF(output_pcm, 0x800);
+	MEDIA_MEM_BUF(input_pcm, 0x800);
+	MEDIA_MEM_BUF(input_encbuf, 0x200);
+	MEDIA_MEM_BUF(output_capture, 0x200);
+	MEDIA_MEM_BUF(input_playback, 0x1000);
+};
 
-	if (!mem_cell) {
-		goto exit;
+static union {
+	struct music_pcm_plan music;
+	struct linein_pcm_plan linein;
+	struct usound_pcm_plan usound;
+} btmusic_pcm_bss _NODATA_SECTION(.btmusic_pcm_bss);
+
+/* cascade_extranel_buf: external capture and mix streams */
+struct usound_cascade_plan {
+	MEDIA_MEM_BUF(input_capture_ext, 0x400);
+	MEDIA_MEM_BUF(ext_globle_buf, 0x400);
+	MEDIA_MEM_BUF(input_ext_stream, 0x400);
+	MEDIA_MEM_BUF(input_ext_mix_stream, 0x200);
+	MEDIA_MEM_BUF(resample_uac_out_stream, 0x200);
+	MEDIA_MEM_BUF(resample_uac_in_stream, 0x200);
+	MEDIA_MEM_BUF(resample_output_data, 0x200);
+};
+
+struct voice_cascade_plan {
+	MEDIA_MEM_BUF(input_capture_ext, 0x600);
+	MEDIA_MEM_BUF(resample_output_data, 0x200);
+	MEDIA_MEM_BUF(ext_globle_buf, 0x400);
+	MEDIA_MEM_BUF(input_ext_stream, 0x800);
+	MEDIA_MEM_BUF(input_ext_mix_stream, 0x200);
+};
+
+static union {
+	struct usound_cascade_plan usound;
+	struct voice_cascade_plan voice;
+} cascade_extranel_buf __aligned(4) _NODATA_SECTION(.cascade.extranel_buf);
+
+/* pools must stay within the ram the linker script reserved for them */
+BUILD_ASSERT_MSG(sizeof(playback_input_buffer) <= PLAYBACK_INPUT_BUFFER_SIZE,
+		 "playback_input_buffer plan too large");
+#ifdef CONFIG_TWS_MONO_MODE
+BUILD_ASSERT_MSG(sizeof(btmusic_pcm_bss) <= 0x4800, "btmusic_pcm_bss plan too large");
+#else
+BUILD_ASSERT_MSG(sizeof(btmusic_pcm_bss) <= 0x3000, "btmusic_pcm_bss plan too large");
+#endif
+BUILD_ASSERT_MSG(sizeof(cascade_extranel_buf) <= 0x1600, "cascade_extranel_buf plan too large");
+
+/* a memory type declared twice for one stream type fails the build */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Woverride-init"
+
+static const struct media_memory_cell music_cells[CACHE_POOL_TYPE_NUM] = {
+	MEDIA_MEM_CELL(OUTPUT_DECODER, btmusic_pcm_bss.music.output_decoder),
+	MEDIA_MEM_CELL(OUTPUT_PLAYBACK, btmusic_pcm_bss.music.output_playback),
+	MEDIA_MEM_CELL(OUTPUT_PCM, btmusic_pcm_bss.music.output_pcm),
+	MEDIA_MEM_CELL(DECODER_GLOBAL_DATA, sbc_dec_global_bss),
+	MEDIA_MEM_CELL(SBC_ENCODER_GLOBAL_DATA, sbc_enc_global_bss),
+
+#ifdef CONFIG_TWS_MONO_MODE
+	MEDIA_MEM_CELL(TWS_LOCAL_INPUT, playback_input_buffer.music.input),
+	MEDIA_MEM_CELL(INPUT_PLAYBACK, btmusic_pcm_bss.music.input_playback),
+	MEDIA_MEM_CELL(SBC_DECODER_GLOBAL_DATA, sbc_dec2_global_bss),
+	MEDIA_MEM_CELL(SBC_ENCODER_2_GLOBAL_DATA, sbc_enc2_global_bss),
+#else
+	MEDIA_MEM_CELL(INPUT_PLAYBACK, playback_input_buffer.music.input),
+#endif
+
+#ifdef CONFIG_TOOL_ECTT
+	MEDIA_MEM_CELL(TOOL_ECTT_BUF, ectt_tool_buf),
+#endif
+
+#ifdef CONFIG_ACTIONS_DECODER
+	MEDIA_MEM_CELL(CODEC_STACK, codec_stack),
+#endif
+
+#ifdef CONFIG_RESAMPLE
+	MEDIA_MEM_CELL(RESAMPLE_GLOBAL_HW_DATA, resample_global_hw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_HW_DATA, resample_share_hw_bss),
+#endif
+};
+
+static const struct media_memory_cell local_music_cells[CACHE_POOL_TYPE_NUM] = {
+	MEDIA_MEM_CELL(TWS_LOCAL_INPUT, playback_input_buffer.local_music.tws_local_input),
+	MEDIA_MEM_CELL(OUTPUT_PCM, playback_input_buffer.local_music.output_pcm),
+	MEDIA_MEM_CELL(OUTPUT_DECODER, playback_input_buffer.local_music.output_decoder),
+	MEDIA_MEM_CELL(OUTPUT_PLAYBACK, playback_input_buffer.local_music.output_playback),
+
+	MEDIA_MEM_CELL(SBC_DECODER_GLOBAL_DATA, sbc_dec_global_bss),
+	MEDIA_MEM_CELL(SBC_ENCODER_GLOBAL_DATA, sbc_enc_global_bss),
+#ifdef CONFIG_TWS_MONO_MODE
+	MEDIA_MEM_CELL(SBC_ENCODER_2_GLOBAL_DATA, sbc_enc2_global_bss),
+#endif
+
+#ifdef CONFIG_ACTIONS_DECODER
+	MEDIA_MEM_CELL(CODEC_STACK, codec_stack),
+#endif
+
+#ifdef CONFIG_TOOL_ECTT
+	MEDIA_MEM_CELL(TOOL_ECTT_BUF, ectt_tool_buf),
+#endif
+
+#ifdef CONFIG_RESAMPLE
+	MEDIA_MEM_CELL(RESAMPLE_GLOBAL_HW_DATA, resample_global_hw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_HW_DATA, resample_share_hw_bss),
+#endif
+};
+
+static const struct media_memory_cell linein_cells[CACHE_POOL_TYPE_NUM] = {
+	MEDIA_MEM_CELL(TWS_LOCAL_INPUT, playback_input_buffer.linein.tws_local_input),
+	MEDIA_MEM_CELL(OUTPUT_DECODER, btmusic_pcm_bss.linein.output_decoder),
+	MEDIA_MEM_CELL(OUTPUT_PLAYBACK, btmusic_pcm_bss.linein.output_playback),
+	MEDIA_MEM_CELL(OUTPUT_PCM, btmusic_pcm_bss.linein.output_pcm),
+
+	MEDIA_MEM_CELL(INPUT_PCM, btmusic_pcm_bss.linein.input_pcm),
+	MEDIA_MEM_CELL(INPUT_ENCBUF, btmusic_pcm_bss.linein.input_encbuf),
+	MEDIA_MEM_CELL(OUTPUT_CAPTURE, btmusic_pcm_bss.linein.output_capture),
+	MEDIA_MEM_CELL(INPUT_PLAYBACK, btmusic_pcm_bss.linein.input_playback),
+
+	MEDIA_MEM_CELL(SBC_DECODER_GLOBAL_DATA, sbc_dec_global_bss),
+	MEDIA_MEM_CELL(SBC_ENCODER_GLOBAL_DATA, sbc_enc_global_bss),
+#ifdef CONFIG_TWS_MONO_MODE
+	MEDIA_MEM_CELL(SBC_ENCODER_2_GLOBAL_DATA, sbc_enc2_global_bss),
+#endif
+
+#ifdef CONFIG_ACTIONS_DECODER
+	MEDIA_MEM_CELL(CODEC_STACK, codec_stack),
+#endif
+
+#ifdef CONFIG_RESAMPLE
+	MEDIA_MEM_CELL(RESAMPLE_GLOBAL_HW_DATA, resample_global_hw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_HW_DATA, resample_share_hw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_SW_DATA, resample_share_sw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_SW_DATA2, resample_share_sw_bss2),
+#endif
+};
+
+static const struct media_memory_cell usound_cells[CACHE_POOL_TYPE_NUM] = {
+	MEDIA_MEM_CELL(TWS_LOCAL_INPUT, playback_input_buffer.usound.tws_local_input),
+	MEDIA_MEM_CELL(OUTPUT_DECODER, btmusic_pcm_bss.usound.output_decoder),
+	MEDIA_MEM_CELL(OUTPUT_PLAYBACK, btmusic_pcm_bss.usound.output_playback),
+	MEDIA_MEM_CELL(OUTPUT_PCM, btmusic_pcm_bss.usound.output_pcm),
+
+	MEDIA_MEM_CELL(INPUT_CAPTURE_EXT, cascade_extranel_buf.usound.input_capture_ext),
+	MEDIA_MEM_CELL(EXT_GLOBLE_BUF, cascade_extranel_buf.usound.ext_globle_buf),
+	MEDIA_MEM_CELL(INPUT_EXT_STREAM, cascade_extranel_buf.usound.input_ext_stream),
+	MEDIA_MEM_CELL(INPUT_EXT_MIX_STREAM, cascade_extranel_buf.usound.input_ext_mix_stream),
+
+	MEDIA_MEM_CELL(INPUT_PCM, btmusic_pcm_bss.usound.input_pcm),
+	MEDIA_MEM_CELL(INPUT_ENCBUF, btmusic_pcm_bss.usound.input_encbuf),
+	MEDIA_MEM_CELL(OUTPUT_CAPTURE, btmusic_pcm_bss.usound.output_capture),
+	MEDIA_MEM_CELL(INPUT_PLAYBACK, btmusic_pcm_bss.usound.input_playback),
+	MEDIA_MEM_CELL(RESAMPLE_UAC_OUT_STREAM, cascade_extranel_buf.usound.resample_uac_out_stream),
+	MEDIA_MEM_CELL(RESAMPLE_UAC_IN_STREAM, cascade_extranel_buf.usound.resample_uac_in_stream),
+	MEDIA_MEM_CELL(RESAMPLE_OUTPUT_DATA, cascade_extranel_buf.usound.resample_output_data),
+
+	MEDIA_MEM_CELL(USB_UPLOAD_CACHE, playback_input_buffer.usound.usb_upload_cache),
+	MEDIA_MEM_CELL(USB_UPLOAD_PAYLOAD, playback_input_buffer.usound.usb_upload_payload),
+
+	MEDIA_MEM_CELL(SBC_DECODER_GLOBAL_DATA, sbc_dec_global_bss),
+	MEDIA_MEM_CELL(SBC_DECODER_2_GLOBAL_DATA, sbc_dec_uac_global_bss),
+	MEDIA_MEM_CELL(SBC_ENCODER_GLOBAL_DATA, sbc_enc_global_bss),
+#ifdef CONFIG_TWS_MONO_MODE
+	MEDIA_MEM_CELL(SBC_ENCODER_2_GLOBAL_DATA, sbc_enc2_global_bss),
+#endif
+
+#ifdef CONFIG_ACTIONS_DECODER
+	MEDIA_MEM_CELL(CODEC_STACK, codec_stack),
+#endif
+
+#ifdef CONFIG_RESAMPLE
+	MEDIA_MEM_CELL(RESAMPLE_GLOBAL_HW_DATA, resample_global_hw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_HW_DATA, resample_share_hw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_SW_DATA, resample_share_sw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_SW_DATA2, resample_share_sw_bss2),
+#endif
+};
+
+static const struct media_memory_cell voice_cells[CACHE_POOL_TYPE_NUM] = {
+	MEDIA_MEM_CELL(INPUT_PLAYBACK, playback_input_buffer.voice.input_playback),
+	MEDIA_MEM_CELL(OUTPUT_DECODER, playback_input_buffer.voice.output_decoder),
+	MEDIA_MEM_CELL(OUTPUT_PLAYBACK, playback_input_buffer.voice.output_playback),
+	MEDIA_MEM_CELL(INPUT_PCM, playback_input_buffer.voice.input_pcm),
+	MEDIA_MEM_CELL(INPUT_CAPTURE, playback_input_buffer.voice.input_capture),
+	MEDIA_MEM_CELL(INPUT_ENCBUF, playback_input_buffer.voice.input_encbuf),
+	MEDIA_MEM_CELL(OUTPUT_CAPTURE, playback_input_buffer.voice.output_capture),
+	MEDIA_MEM_CELL(AEC_REFBUF0, playback_input_buffer.voice.aec_refbuf0),
+
+	MEDIA_MEM_CELL(OUTPUT_SCO, playback_input_buffer.voice.output_sco),
+	MEDIA_MEM_CELL(TX_SCO, playback_input_buffer.voice.tx_sco),
+	MEDIA_MEM_CELL(RX_SCO, playback_input_buffer.voice.rx_sco),
+
+	MEDIA_MEM_CELL(OUTPUT_PCM, playback_input_buffer.voice.output_pcm),
+
+	MEDIA_MEM_CELL(INPUT_CAPTURE_EXT, cascade_extranel_buf.voice.input_capture_ext),
+	MEDIA_MEM_CELL(RESAMPLE_OUTPUT_DATA, cascade_extranel_buf.voice.resample_output_data),
+	MEDIA_MEM_CELL(EXT_GLOBLE_BUF, cascade_extranel_buf.voice.ext_globle_buf),
+	MEDIA_MEM_CELL(INPUT_EXT_STREAM, cascade_extranel_buf.voice.input_ext_stream),
+	MEDIA_MEM_CELL(INPUT_EXT_MIX_STREAM, cascade_extranel_buf.voice.input_ext_mix_stream),
+
+	MEDIA_MEM_CELL(SBC_DECODER_GLOBAL_DATA, msbc_dec2_global_bss),
+	MEDIA_MEM_CELL(SBC_DECODER_2_GLOBAL_DATA, sbc_dec_uac_global_bss),
+
+#ifdef CONFIG_TWS_MONO_MODE
+	MEDIA_MEM_CELL(SBC_ENCODER_2_GLOBAL_DATA, sbc_enc2_global_bss),
+#endif
+
+	MEDIA_MEM_CELL(DECODER_GLOBAL_DATA, sbc_dec_global_bss),
+	MEDIA_MEM_CELL(ENCODER_GLOBAL_DATA, sbc_enc_global_bss),
+
+#ifdef CONFIG_HFP_PLC
+	MEDIA_MEM_CELL(PLC_GLOBAL_DATA, hfp_plc_global_bss),
+	MEDIA_MEM_CELL(PLC_SHARE_DATA, playback_input_buffer.voice.plc_share),
+#endif
+
+#ifdef CONFIG_TOOL_ASQT
+	MEDIA_MEM_CELL(TOOL_ASQT_STUB_BUF, asqt_tool_stub_buf),
+	MEDIA_MEM_CELL(TOOL_ASQT_DUMP_BUF, asqt_tool_data_buf),
+#endif
+
+#ifdef CONFIG_ACTIONS_DECODER
+	MEDIA_MEM_CELL(CODEC_STACK, codec_stack),
+#endif
+
+#ifdef CONFIG_RESAMPLE
+	MEDIA_MEM_CELL(RESAMPLE_GLOBAL_HW_DATA, resample_global_hw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_HW_DATA, resample_share_hw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_SW_DATA, resample_share_sw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_SW_DATA2, resample_share_sw_bss2),
+#endif
+};
+
+static const struct media_memory_cell tts_cells[CACHE_POOL_TYPE_NUM] = {
+	MEDIA_MEM_CELL(TWS_LOCAL_INPUT, playback_input_buffer.tts.tws_local_input),
+	MEDIA_MEM_CELL(OUTPUT_PCM, playback_input_buffer.tts.output_pcm),
+	MEDIA_MEM_CELL(OUTPUT_DECODER, playback_input_buffer.tts.output_decoder),
+	MEDIA_MEM_CELL(OUTPUT_PLAYBACK, playback_input_buffer.tts.output_playback),
+
+	MEDIA_MEM_CELL(SBC_DECODER_GLOBAL_DATA, sbc_dec_global_bss),
+	MEDIA_MEM_CELL(SBC_ENCODER_GLOBAL_DATA, sbc_enc_global_bss),
+#ifdef CONFIG_TWS_MONO_MODE
+	MEDIA_MEM_CELL(SBC_ENCODER_2_GLOBAL_DATA, sbc_enc2_global_bss),
+#endif
+
+#ifdef CONFIG_ACTIONS_DECODER
+	MEDIA_MEM_CELL(CODEC_STACK, codec_stack),
+#endif
+
+#ifdef CONFIG_TOOL_ECTT
+	MEDIA_MEM_CELL(TOOL_ECTT_BUF, ectt_tool_buf),
+#endif
+
+#ifdef CONFIG_RESAMPLE
+	MEDIA_MEM_CELL(RESAMPLE_GLOBAL_HW_DATA, resample_global_hw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_HW_DATA, resample_share_hw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_SW_DATA, resample_share_sw_bss),
+	MEDIA_MEM_CELL(RESAMPLE_SHARE_SW_DATA2, resample_share_sw_bss2),
+#endif
+};
+
+static const struct media_memory_cell local_record_cells[CACHE_POOL_TYPE_NUM] = {
+	MEDIA_MEM_CELL(INPUT_PCM, playback_input_buffer.local_record.input_pcm),
+	MEDIA_MEM_CELL(INPUT_ENCBUF, playback_input_buffer.local_record.input_encbuf),
+	MEDIA_MEM_CELL(OUTPUT_CAPTURE, playback_input_buffer.local_record.output_capture),
+
+#ifdef CONFIG_ACTIONS_DECODER
+	MEDIA_MEM_CELL(CODEC_STACK, codec_stack),
+#endif
+};
+
+static const struct media_memory_cell gma_record_cells[CACHE_POOL_TYPE_NUM] = {
+	MEDIA_MEM_CELL(INPUT_PCM, playback_input_buffer.gma_record.input_pcm),
+	MEDIA_MEM_CELL(INPUT_ENCBUF, playback_input_buffer.gma_record.input_encbuf),
+	MEDIA_MEM_CELL(OUTPUT_CAPTURE, playback_input_buffer.gma_record.output_capture),
+
+#ifdef CONFIG_ACTIONS_DECODER
+	MEDIA_MEM_CELL(CODEC_STACK, codec_stack),
+#endif
+};
+
+#ifdef CONFIG_RECORD_SERVICE
+static const struct media_memory_cell background_record_cells[CACHE_POOL_TYPE_NUM] = {
+	MEDIA_MEM_CELL(INPUT_ENCBUF, wav_enc_adpcm_inbuf),
+	MEDIA_MEM_CELL(OUTPUT_CAPTURE, wav_enc_adpcm_outbuf),
+};
+#endif
+
+static const struct media_memory_cell tws_cells[CACHE_POOL_TYPE_NUM] = {
+	MEDIA_MEM_CELL(INPUT_PLAYBACK, playback_input_buffer.tws.input_playback),
+};
+
+/* stream type to plan, capture like inputs share the linein plan */
+static const struct media_memory_cell *const media_memory_plan[AUDIO_STREAM_EXT + 1] = {
+	[AUDIO_STREAM_MUSIC] = music_cells,
+	[AUDIO_STREAM_LOCAL_MUSIC] = local_music_cells,
+	[AUDIO_STREAM_LINEIN] = linein_cells,
+	[AUDIO_STREAM_FM] = linein_cells,
+	[AUDIO_STREAM_I2SRX_IN] = linein_cells,
+	[AUDIO_STREAM_SPDIF_IN] = linein_cells,
+	[AUDIO_STREAM_MIC_IN] = linein_cells,
+	[AUDIO_STREAM_USOUND] = usound_cells,
+	[AUDIO_STREAM_VOICE] = voice_cells,
+	[AUDIO_STREAM_TTS] = tts_cells,
+	[AUDIO_STREAM_LOCAL_RECORD] = local_record_cells,
+	[AUDIO_STREAM_GMA_RECORD] = gma_record_cells,
+#ifdef CONFIG_RECORD_SERVICE
+	[AUDIO_STREAM_BACKGROUND_RECORD] = background_record_cells,
+#endif
+	[AUDIO_STREAM_TWS] = tws_cells,
+};
+
+#pragma GCC diagnostic pop
+
+static const struct media_memory_cell *_memdia_mem_find_memory_cell(int mem_type, int stream_type)
+{
+	if (stream_type < 0 || stream_type >= ARRAY_SIZE(media_memory_plan)
+		|| !media_memory_plan[stream_type]) {
+		return NULL;
 	}
 
-	return (void *)mem_cell->mem_base;
+	if (mem_type < 0 || mem_type >= CACHE_POOL_TYPE_NUM) {
+		return NULL;
+	}
 
-exit:
-	return addr;
+	return &media_memory_plan[stream_type][mem_type];
 }
 
-int media_mem_get_cache_pool_size(int mem_type, int stream_type)
+void *media_mem_get_cache_pool(int mem_type, int stream_type)
 {
-	const struct media_memory_block *mem_block = NULL;
-	const struct media_memory_cell *mem_cell = NULL;
-	int mem_size = 0;
+	const struct media_memory_cell *mem_cell;
 
-	mem_block = _memdia_mem_find_memory_block(stream_type);
-
-	if (!mem_block) {
-		goto exit;
+	mem_cell = _memdia_mem_find_memory_cell(mem_type, stream_type);
+	if (!mem_cell) {
+		return NULL;
 	}
 
-	mem_cell = _memdia_mem_find_memory_cell(mem_block, mem_type);
+	return mem_cell->mem_base;
+}
 
+int media_mem_get_cache_pool_size(int mem_type, int stream_type)
+{
+	const struct media_memory_cell *mem_cell;
+
+	mem_cell = _memdia_mem_find_memory_cell(mem_type, stream_type);
 	if (!mem_cell) {
-		goto exit;
+		return 0;
 	}
 
 	return mem_cell->mem_size;
-
-exit:
-	return mem_size;
 }
 #else
 void *media_mem_get_cache_pool(int mem_type, int stream_type)
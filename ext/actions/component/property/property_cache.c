@@ -6,8 +6,13 @@
 
 /**
  * @file property cache interface
+ *
+ * Write back cache of nvram configs. Sets only touch RAM, dirty items
+ * are committed to nvram in one batch on flush, when the system is idle,
+ * or when they have waited too long. Gets read through and keep a clean
+ * copy, clean items are dropped least recently used first.
  */
- #include <os_common_api.h>
+#include <os_common_api.h>
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
@@ -20,86 +25,228 @@
 #endif
 #include <logging/sys_log.h>
 
-#define MAX_NVRAM_ITEM_CACHE_NUM 10
+#define PROPERTY_CACHE_BUCKETS	16
+#define PROPERTY_CACHE_NONE	0xff
 
-struct cahce_item_data {
+struct cache_item_data {
 	char *name;
 	char *data;
-	u32_t data_len:16;
-	u32_t used_flag:2;
-	u32_t flush_req:1;
+	u32_t lru_seq;
+	u16_t data_len;
+	u8_t next;
+	u8_t used_flag : 1;
+	u8_t dirty : 1;
+	u8_t flush_req : 1;
 };
 
-OS_MUTEX_DEFINE(nvram_cache_mutex);
+struct property_cache {
+	struct cache_item_data items[CONFIG_PROPERTY_CACHE_SIZE];
+	u8_t buckets[PROPERTY_CACHE_BUCKETS];
+	/* name and data bytes held */
+	int cache_bytes;
+	int dirty_num;
+	/* uptime of the oldest uncommitted set */
+	u32_t dirty_timestamp;
+	u32_t lru_seq;
+};
 
-static struct cahce_item_data globle_property_cache[MAX_NVRAM_ITEM_CACHE_NUM];
+OS_MUTEX_DEFINE(nvram_cache_mutex);
 
+static struct property_cache globle_property_cache;
 
-static struct cahce_item_data *find_property_cache(const char *name)
+static u8_t property_cache_hash(const char *name)
 {
-	int i;
-	struct cahce_item_data *item = NULL;
+	u32_t hash = 0;
+
+	while (*name)
+		hash = hash * 31 + (u8_t)*name++;
 
-	for (i = 0; i < MAX_NVRAM_ITEM_CACHE_NUM; i++) {
-		item = &globle_property_cache[i];
-		if (item->used_flag && !memcmp(item->name, name, strlen(name))) {
-			SYS_LOG_INF(" %d %s\n", i, item->name);
+	return (hash ^ (hash >> 8)) % PROPERTY_CACHE_BUCKETS;
+}
+
+static struct cache_item_data *find_property_cache(const char *name)
+{
+	struct property_cache *cache = &globle_property_cache;
+	struct cache_item_data *item;
+	u8_t i;
+
+	for (i = cache->buckets[property_cache_hash(name)]; i != PROPERTY_CACHE_NONE; i = item->next) {
+		item = &cache->items[i];
+		if (!strcmp(item->name, name)) {
+			item->lru_seq = ++cache->lru_seq;
 			return item;
 		}
 	}
+
 	return NULL;
 }
 
-static struct cahce_item_data *get_property_cache(const char *name, int len)
+static void put_property_cache(struct cache_item_data *item)
 {
+	struct property_cache *cache = &globle_property_cache;
+	u8_t *link = &cache->buckets[property_cache_hash(item->name)];
+	u8_t index = item - cache->items;
+
+	while (*link != index)
+		link = &cache->items[*link].next;
+	*link = item->next;
+
+	cache->cache_bytes -= strlen(item->name) + 1 + item->data_len;
+	if (item->dirty)
+		cache->dirty_num--;
+	mem_free(item->data);
+	mem_free(item->name);
+	memset(item, 0, sizeof(*item));
+}
+
+static bool property_cache_is_full(int size)
+{
+	struct property_cache *cache = &globle_property_cache;
 	int i;
-	struct cahce_item_data *item = NULL;
-
-	for (i = 0; i < MAX_NVRAM_ITEM_CACHE_NUM; i++) {
-		item = &globle_property_cache[i];
-		if (!item->used_flag) {
-			item->name = mem_malloc(strlen(name) + 1);
-			if (!item->name) {
-				item = NULL;
-				goto exit;
-			}
-			memset(item->name, 0, strlen(name) + 1);
-			item->data = mem_malloc(len);
-			if (!item->data) {
-				mem_free(item->name);
-				item = NULL;
-				goto exit;
-			}
-			memset(item->data, 0, len);
-exit:
-			return item;
-		}
+
+	if (cache->cache_bytes + size > CONFIG_PROPERTY_CACHE_MAX_BYTES)
+		return true;
+
+	for (i = 0; i < CONFIG_PROPERTY_CACHE_SIZE; i++) {
+		if (!cache->items[i].used_flag)
+			return false;
 	}
-	return NULL;
+
+	return true;
 }
 
-static int put_property_cache(struct cahce_item_data *item)
+/* drop clean items, least recently used first, until size fits */
+static bool property_cache_make_room(int size)
 {
-	if (item) {
-		if (item->data) {
-			mem_free(item->data);
+	struct property_cache *cache = &globle_property_cache;
+	struct cache_item_data *item, *victim;
+	int i;
+
+	while (property_cache_is_full(size)) {
+		victim = NULL;
+		for (i = 0; i < CONFIG_PROPERTY_CACHE_SIZE; i++) {
+			item = &cache->items[i];
+			if (item->used_flag && !item->dirty &&
+			    (!victim || (s32_t)(item->lru_seq - victim->lru_seq) < 0))
+				victim = item;
 		}
-		if (item->name) {
-			mem_free(item->name);
+
+		if (!victim)
+			return false;
+
+		put_property_cache(victim);
+	}
+
+	return true;
+}
+
+static struct cache_item_data *get_property_cache(const char *name, const void *data, int len)
+{
+	struct property_cache *cache = &globle_property_cache;
+	struct cache_item_data *item = NULL;
+	int name_len = strlen(name) + 1;
+	u8_t *bucket;
+	int i;
+
+	if (!property_cache_make_room(name_len + len))
+		return NULL;
+
+	for (i = 0; i < CONFIG_PROPERTY_CACHE_SIZE; i++) {
+		if (!cache->items[i].used_flag) {
+			item = &cache->items[i];
+			break;
 		}
-		item->data = NULL;
+	}
+
+	item->name = mem_malloc(name_len);
+	if (!item->name)
+		return NULL;
+
+	item->data = mem_malloc(len ? len : 1);
+	if (!item->data) {
+		mem_free(item->name);
 		item->name = NULL;
-		item->used_flag = 0;
-		item->data_len = 0;
+		return NULL;
+	}
+
+	memcpy(item->name, name, name_len);
+	memcpy(item->data, data, len);
+	item->data_len = len;
+	item->used_flag = 1;
+	item->lru_seq = ++cache->lru_seq;
+
+	bucket = &cache->buckets[property_cache_hash(name)];
+	item->next = *bucket;
+	*bucket = i;
+
+	cache->cache_bytes += name_len + len;
+	return item;
+}
+
+static void property_cache_set_dirty(struct cache_item_data *item)
+{
+	struct property_cache *cache = &globle_property_cache;
+
+	if (item->dirty)
+		return;
+
+	if (!cache->dirty_num++)
+		cache->dirty_timestamp = os_uptime_get_32();
+	item->dirty = 1;
+}
+
+/*
+ * Commit dirty items matching the filter in one nvram batch, they stay
+ * cached as clean items. name NULL matches every item, otherwise items
+ * whose name starts with name; req_only keeps only flush requested items.
+ */
+static int property_cache_commit(const char *name, bool req_only)
+{
+	struct property_cache *cache = &globle_property_cache;
+	struct nvram_config_entry entries[CONFIG_PROPERTY_CACHE_SIZE];
+	u8_t index[CONFIG_PROPERTY_CACHE_SIZE];
+	struct cache_item_data *item;
+	int i, num = 0, ret;
+
+	for (i = 0; i < CONFIG_PROPERTY_CACHE_SIZE; i++) {
+		item = &cache->items[i];
+		if (!item->used_flag || (req_only && !item->flush_req))
+			continue;
+
+		if (name && strncmp(item->name, name, strlen(name)))
+			continue;
+
 		item->flush_req = 0;
+		if (!item->dirty)
+			continue;
+
+		entries[num].name = item->name;
+		entries[num].data = item->data;
+		entries[num].len = item->data_len;
+		index[num++] = i;
 	}
+
+	if (!num)
+		return 0;
+
+	ret = nvram_config_set_many(entries, num);
+	if (ret) {
+		SYS_LOG_ERR("commit %d items failed %d\n", num, ret);
+		return ret;
+	}
+
+	for (i = 0; i < num; i++)
+		cache->items[index[i]].dirty = 0;
+	cache->dirty_num -= num;
+
+	SYS_LOG_INF("commit %d items\n", num);
 	return 0;
 }
 
 int property_cache_get(const char *name, void *data, int len)
 {
 	int read_len = 0;
-	struct cahce_item_data *item = NULL;
+	struct cache_item_data *item = NULL;
 
 	os_mutex_lock(&nvram_cache_mutex, OS_FOREVER);
 
@@ -107,15 +254,20 @@ int property_cache_get(const char *name, void *data, int len)
 
 	/**read from nvram cache */
 	if (item) {
-		if (item->data_len > len) {
-			read_len = len;
+		if (!item->data_len) {
+			/* deleted, not committed yet */
+			read_len = -ENOENT;
 		} else {
-			read_len = item->data_len;
+			read_len = min(len, item->data_len);
+			memcpy(data, item->data, read_len);
 		}
-		memcpy(data, item->data, read_len);
 	} else {
 		/** read from nvram*/
 		read_len = nvram_config_get(name, data, len);
+
+		/* only a value shorter than the buffer is known to be whole */
+		if (read_len > 0 && read_len < len)
+			get_property_cache(name, data, read_len);
 	}
 
 	os_mutex_unlock(&nvram_cache_mutex);
@@ -126,41 +278,48 @@ int property_cache_get(const char *name, void *data, int len)
 int property_cache_set(const char *name, const void *data, int len)
 {
 	int ret = 0;
-	struct cahce_item_data *item = NULL;
+	struct cache_item_data *item = NULL;
 
 	os_mutex_lock(&nvram_cache_mutex, OS_FOREVER);
 
+	/* too large to cache */
+	if (strlen(name) + 1 + len > CONFIG_PROPERTY_CACHE_MAX_BYTES) {
+		item = find_property_cache(name);
+		if (item)
+			put_property_cache(item);
+		goto direct;
+	}
+
 	item = find_property_cache(name);
 	/**write to old nvram cache */
 	if (item) {
 		if (item->data_len == len) {
-			memcpy(item->data, data, len);
-			ret = 0;
-		} else {
-			void *old_data = item->data;
+			if (!memcmp(item->data, data, len))
+				goto exit;
 
-			item->data = mem_malloc(len);
 			memcpy(item->data, data, len);
-			item->data_len = len;
-			ret = 0;
-			if (old_data)
-				mem_free(old_data);
+			property_cache_set_dirty(item);
+			goto exit;
 		}
-		goto exit;
+
+		/* reinsert with the new size */
+		put_property_cache(item);
 	}
 
 	/**write to new nvram cache */
-	item = get_property_cache(name, len);
+	item = get_property_cache(name, data, len);
+	if (!item && globle_property_cache.dirty_num) {
+		/* no clean item to drop, commit the dirty ones and retry */
+		property_cache_commit(NULL, false);
+		item = get_property_cache(name, data, len);
+	}
+
 	if (item) {
-		/** new item */
-		memcpy(item->name, name, strlen(name));
-		memcpy(item->data, data, len);
-		item->data_len = len;
-		item->used_flag = 1;
-		ret = 0;
+		property_cache_set_dirty(item);
 		goto exit;
 	}
 
+direct:
 	/** direct write to nvram*/
 	SYS_LOG_INF("direct write to nvram\n");
 	ret = nvram_config_set(name, data, len);
@@ -172,74 +331,73 @@ exit:
 
 int property_cache_flush(const char *name)
 {
-	int i;
-	struct cahce_item_data *item = NULL;
+	int ret;
 
 	os_mutex_lock(&nvram_cache_mutex, OS_FOREVER);
 
-	for (i = 0; i < MAX_NVRAM_ITEM_CACHE_NUM; i++) {
-		item = &globle_property_cache[i];
-		if (item->used_flag &&
-	     ((!name) || memcmp(item->name, name, strlen(name)) == 0)) {
-			if (!nvram_config_set(item->name, item->data, item->data_len)) {
-				put_property_cache(item);
-				item->flush_req = false;
-			}
-		}
-	}
+	ret = property_cache_commit(name, false);
 
 	os_mutex_unlock(&nvram_cache_mutex);
 
-	SYS_LOG_INF("ok\n");
-	return 0;
+	return ret;
 }
 
 int property_cache_flush_req(const char *name)
 {
 	int i;
-	struct cahce_item_data *item = NULL;
+	struct cache_item_data *item = NULL;
 
 	os_mutex_lock(&nvram_cache_mutex, OS_FOREVER);
 
-	for (i = 0; i < MAX_NVRAM_ITEM_CACHE_NUM; i++) {
-		item = &globle_property_cache[i];
+	for (i = 0; i < CONFIG_PROPERTY_CACHE_SIZE; i++) {
+		item = &globle_property_cache.items[i];
 		if (item->used_flag &&
-	     ((!name) || memcmp(item->name, name, strlen(name)) == 0)) {
+		    ((!name) || strncmp(item->name, name, strlen(name)) == 0)) {
 			item->flush_req = true;
 		}
 	}
 
 	os_mutex_unlock(&nvram_cache_mutex);
 
-	SYS_LOG_INF("ok\n");
 	return 0;
 }
 
 int property_cache_flush_req_deal(void)
 {
-	int i;
-	struct cahce_item_data *item = NULL;
+	int ret;
 
 	os_mutex_lock(&nvram_cache_mutex, OS_FOREVER);
 
-	for (i = 0; i < MAX_NVRAM_ITEM_CACHE_NUM; i++) {
-		item = &globle_property_cache[i];
-		if (item->used_flag && item->flush_req) {
-			if (!nvram_config_set(item->name, item->data, item->data_len)) {
-				put_property_cache(item);
-			}
-			item->flush_req = false;
-		}
+	ret = property_cache_commit(NULL, true);
+
+	os_mutex_unlock(&nvram_cache_mutex);
+
+	return ret;
+}
+
+int property_cache_flush_idle(u32_t idle_time)
+{
+	struct property_cache *cache = &globle_property_cache;
+	int ret = 0;
+
+	os_mutex_lock(&nvram_cache_mutex, OS_FOREVER);
+
+	if (cache->dirty_num &&
+	    (idle_time >= CONFIG_PROPERTY_CACHE_IDLE_COMMIT_MS ||
+	     os_uptime_get_32() - cache->dirty_timestamp >=
+	     CONFIG_PROPERTY_CACHE_MAX_DIRTY_SEC * 1000)) {
+		ret = property_cache_commit(NULL, false);
 	}
 
 	os_mutex_unlock(&nvram_cache_mutex);
 
-	SYS_LOG_INF("flush ok\n");
-	return 0;
+	return ret;
 }
 
 int property_cache_init(void)
 {
-	memset(globle_property_cache, 0, sizeof(globle_property_cache));
+	memset(&globle_property_cache, 0, sizeof(globle_property_cache));
+	memset(globle_property_cache.buckets, PROPERTY_CACHE_NONE,
+	       sizeof(globle_property_cache.buckets));
 	return 0;
 }
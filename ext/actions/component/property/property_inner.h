@@ -27,6 +27,8 @@ int property_cache_flush_req(const char *name);
 
 int property_cache_flush_req_deal(void);
 
+int property_cache_flush_idle(u32_t idle_time);
+
 int property_cache_init(void);
 
 #endif
@@ -187,6 +187,15 @@ int property_flush_req(const char *key)
 	return 0;
 }
 
+int property_flush_idle(u32_t idle_time)
+{
+#ifdef CONFIG_PROPERTY_CACHE
+	return property_cache_flush_idle(idle_time);
+#else
+	return 0;
+#endif
+}
+
 int property_flush_req_deal(void)
 {
 #ifdef CONFIG_PROPERTY_CACHE
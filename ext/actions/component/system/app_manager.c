@@ -42,25 +42,27 @@ OS_MUTEX_DEFINE(app_manager_mutex);
 
 static sys_slist_t	global_app_list;
 
+/* running apps by app entry index, which is also their listener id */
+static struct app_info **app_info_table;
+static int app_num;
+
 static struct app_entry_t *actived_app = NULL;
 static struct app_entry_t *prev_app = NULL;
 static struct app_entry_t *default_app = NULL;
 static bool exit_to_default = false;
 
-static struct app_info *app_manager_get_app_info(char *app_name)
+static int app_manager_get_app_id(char *app_name)
 {
-	sys_snode_t *node, *tmp;
-
-	SYS_SLIST_FOR_EACH_NODE_SAFE(&global_app_list, node, tmp) {
+	int id = msg_manager_get_listener_id(app_name);
 
-		struct app_info *app = APP_INFO(node);
+	return (id >= 0 && id < app_num) ? id : -ENOENT;
+}
 
-		if (!strcmp(app->name, app_name))	{
-			return app;
-		}
+static struct app_info *app_manager_get_app_info(char *app_name)
+{
+	int id = app_manager_get_app_id(app_name);
 
-	}
-	return NULL;
+	return (id >= 0) ? app_info_table[id] : NULL;
 }
 
 static bool app_manager_check_stack_safe(struct app_info *appinfo)
@@ -91,15 +93,12 @@ static void _app_exit_callback(struct app_msg *msg, int result, void *reply)
 
 static struct app_entry_t *get_app_entry_byname(char *app_name)
 {
-	struct app_entry_t *app_entry;
+	int id;
 
 	if (app_name) {
-		for (app_entry = __app_entry_table;
-		     app_entry < __app_entry_end;
-		     app_entry++) {
-			if (!strcmp(app_entry->name, app_name)) {
-				return app_entry;
-			}
+		id = app_manager_get_app_id(app_name);
+		if (id >= 0) {
+			return &__app_entry_table[id];
 		}
 	}
 
@@ -159,6 +158,7 @@ static bool app_manager_init_app(struct app_entry_t *app, bool create_thread)
 	}
 
 	sys_slist_append(&global_app_list, (sys_snode_t *)appinfo);
+	app_info_table[app - __app_entry_table] = appinfo;
 
 	if (!msg_manager_add_listener(appinfo->name, appinfo->tid)) {
 		SYS_LOG_ERR("%s add listener failed\n", appinfo->name);
@@ -240,6 +240,7 @@ bool app_manager_thread_exit(char *app_name)
 	}
 
 	sys_slist_find_and_remove(&global_app_list, (sys_snode_t *)appinfo);
+	app_info_table[appinfo->entry - __app_entry_table] = NULL;
 
 	if (!msg_manager_remove_listener(appinfo->name)) {
 		SYS_LOG_ERR("%s remove listener failed\n", appinfo->name);
@@ -386,6 +387,12 @@ bool app_manager_init(void)
 
 	sys_slist_init(&global_app_list);
 
+	app_num = __app_entry_end - __app_entry_table;
+	app_info_table = mem_malloc(app_num * sizeof(struct app_info *));
+	if (!app_info_table)
+		return false;
+	memset(app_info_table, 0, app_num * sizeof(struct app_info *));
+
 	target_app_entry = get_app_entry_byname("main");
 
 	if (!target_app_entry)
@@ -17,6 +17,7 @@
 
 #include <os_common_api.h>
 #include <srv_manager.h>
+#include <app_manager.h>
 #include <mem_manager.h>
 #include <msg_manager.h>
 #include <sys_wakelock.h>
@@ -28,24 +29,113 @@ extern int os_get_pending_msg_cnt(void);
 /*global data mailbox for all app thread*/
 OS_MUTEX_DEFINE(msg_manager_mutex);
 
-static sys_slist_t	global_receiver_list;
+extern struct app_entry_t __app_entry_table[];
+extern struct app_entry_t __app_entry_end[];
+extern struct service_entry_t __service_entry_table[];
+extern struct service_entry_t __service_entry_end[];
+
+#define MSG_LISTENER_BUCKETS	32
+#define MSG_LISTENER_NONE	0xff
+
+/*
+ * Listener ids are fixed at init, apps in app entry order, then services
+ * in service entry order, then other names as they are added. Names and
+ * tids are hashed to ids, a lookup only compares one bucket. An app and a
+ * service may share a name, name buckets keep ids in ascending order so
+ * the app id is found first.
+ */
+static struct msg_listener *listeners;
+static u8_t listener_num;
+static u8_t listener_app_num;
+static u8_t listener_max;
+static u8_t name_buckets[MSG_LISTENER_BUCKETS];
+static u8_t tid_buckets[MSG_LISTENER_BUCKETS];
+
+static u8_t msg_manager_name_hash(const char *name)
+{
+	u32_t hash = 0;
+
+	while (*name)
+		hash = hash * 31 + (u8_t)*name++;
+
+	return (hash ^ (hash >> 8)) % MSG_LISTENER_BUCKETS;
+}
+
+static u8_t msg_manager_tid_hash(os_tid_t tid)
+{
+	/* threads are word aligned structures */
+	return (((u32_t)tid >> 3) ^ ((u32_t)tid >> 10)) % MSG_LISTENER_BUCKETS;
+}
+
+/* first id from first_id on with this name, must be called with interrupts locked */
+static int msg_manager_find_id(const char *name, int first_id)
+{
+	u8_t id;
+
+	for (id = name_buckets[msg_manager_name_hash(name)];
+	     id != MSG_LISTENER_NONE; id = listeners[id].name_next) {
+		if (id >= first_id && !strcmp(listeners[id].name, name))
+			return id;
+	}
+
+	return -ENOENT;
+}
+
+/* first id with this name that has a thread, must be called with interrupts locked */
+static int msg_manager_find_added_id(const char *name)
+{
+	int id;
+
+	for (id = msg_manager_find_id(name, 0); id >= 0; id = msg_manager_find_id(name, id + 1)) {
+		if (listeners[id].tid)
+			return id;
+	}
+
+	return -ENOENT;
+}
+
+static int msg_manager_new_id(char *name)
+{
+	u8_t *link = &name_buckets[msg_manager_name_hash(name)];
+	u8_t id;
+
+	if (listener_num >= listener_max)
+		return -ENOMEM;
+
+	while (*link != MSG_LISTENER_NONE)
+		link = &listeners[*link].name_next;
+
+	id = listener_num++;
+	listeners[id].name = name;
+	listeners[id].tid = NULL;
+	listeners[id].tid_next = MSG_LISTENER_NONE;
+	listeners[id].name_next = MSG_LISTENER_NONE;
+	*link = id;
+
+	return id;
+}
+
+static void msg_manager_unlink_tid(u8_t id)
+{
+	u8_t *link = &tid_buckets[msg_manager_tid_hash(listeners[id].tid)];
+
+	while (*link != id)
+		link = &listeners[*link].tid_next;
+	*link = listeners[id].tid_next;
+	listeners[id].tid = NULL;
+}
 
 static struct msg_listener *msg_manager_find_by_name(char *name)
 {
-	int key;
-	sys_snode_t *node, *tmp;
+	int key, id;
 	struct msg_listener *listener = NULL;
 
 	key = irq_lock();
 
-	SYS_SLIST_FOR_EACH_NODE_SAFE(&global_receiver_list, node, tmp) {
-		listener = LISTENER_INFO(node);
-		if (!strcmp(listener->name, name)) {
-			goto exit;
-		}
-	}
-	listener = NULL;
-exit:
+	id = msg_manager_find_added_id(name);
+	if (id >= 0)
+		listener = &listeners[id];
+
 	irq_unlock(key);
 	return listener;
 }
@@ -54,19 +144,19 @@ exit:
 static struct msg_listener *msg_manager_find_by_tid(os_tid_t tid)
 {
 	int key;
-	sys_snode_t *node, *tmp;
+	u8_t id;
 	struct msg_listener *listener = NULL;
 
 	key = irq_lock();
 
-	SYS_SLIST_FOR_EACH_NODE_SAFE(&global_receiver_list, node, tmp) {
-		listener = LISTENER_INFO(node);
-		if (listener->tid == tid) {
-			goto exit;
+	for (id = tid_buckets[msg_manager_tid_hash(tid)];
+	     id != MSG_LISTENER_NONE; id = listeners[id].tid_next) {
+		if (listeners[id].tid == tid) {
+			listener = &listeners[id];
+			break;
 		}
 	}
-	listener = NULL;
-exit:
+
 	irq_unlock(key);
 	return listener;
 }
@@ -93,41 +183,49 @@ char *msg_manager_get_name_by_tid(int tid)
 
 bool msg_manager_add_listener(char *name, os_tid_t tid)
 {
-
-	struct msg_listener *listener = NULL;
+	u8_t *bucket = &tid_buckets[msg_manager_tid_hash(tid)];
+	bool result = false;
+	int id;
 
 	int key = irq_lock();
 
-	listener = mem_malloc(sizeof(struct msg_listener));
-	if (!listener) {
-		goto exit;
+	/* first id of this name not in use, a new one if all are */
+	for (id = msg_manager_find_id(name, 0); id >= 0; id = msg_manager_find_id(name, id + 1)) {
+		if (!listeners[id].tid)
+			break;
 	}
 
-	listener->name = name;
-
-	listener->tid = tid;
+	if (id < 0) {
+		id = msg_manager_new_id(name);
+		if (id < 0) {
+			SYS_LOG_ERR("too many listeners, %s\n", name);
+			goto exit;
+		}
+	}
 
-	sys_slist_append(&global_receiver_list, (sys_snode_t *)listener);
+	listeners[id].tid = tid;
+	listeners[id].tid_next = *bucket;
+	*bucket = id;
+	result = true;
 
 exit:
 	irq_unlock(key);
-	return true;
+	return result;
 }
 
 bool msg_manager_remove_listener(char *name)
 {
-	struct msg_listener *listener = msg_manager_find_by_name(name);
 	bool result = false;
+	int id;
 
 	int key = irq_lock();
 
-	if (listener != NULL) {
-		sys_slist_find_and_remove(&global_receiver_list, (sys_snode_t *)listener);
-		mem_free(listener);
+	id = msg_manager_find_added_id(name);
+	if (id >= 0) {
+		msg_manager_unlink_tid(id);
 		result = true;
-		goto exit;
 	}
-exit:
+
 	irq_unlock(key);
 	return result;
 }
@@ -142,13 +240,89 @@ os_tid_t  msg_manager_listener_tid(char *name)
 
 	return NULL;
 }
+
+int msg_manager_get_listener_id(const char *name)
+{
+	int key, id;
+
+	key = irq_lock();
+	id = msg_manager_find_id(name, 0);
+	irq_unlock(key);
+
+	return id;
+}
+
+int msg_manager_get_service_listener_id(const char *name)
+{
+	int key, id;
+
+	key = irq_lock();
+	id = msg_manager_find_id(name, listener_app_num);
+	irq_unlock(key);
+
+	return id;
+}
+
+os_tid_t msg_manager_get_listener_tid(int id)
+{
+	if (id < 0 || id >= listener_num)
+		return NULL;
+
+	return listeners[id].tid;
+}
+
 /*init manager*/
 bool msg_manager_init(void)
 {
+	int app_num = __app_entry_end - __app_entry_table;
+	int srv_num = __service_entry_end - __service_entry_table;
+	int max = app_num + srv_num + CONFIG_MSG_MANAGER_MAX_LISTENERS;
+	int i;
+
+	/* ids are u8_t, MSG_LISTENER_NONE ends the lists */
+	__ASSERT(max < MSG_LISTENER_NONE, "too many listeners");
+
+	/* empty buckets first, lookups then find nothing if this fails */
+	listener_num = 0;
+	listener_max = 0;
+	memset(name_buckets, MSG_LISTENER_NONE, sizeof(name_buckets));
+	memset(tid_buckets, MSG_LISTENER_NONE, sizeof(tid_buckets));
+
+	if (max >= MSG_LISTENER_NONE)
+		return false;
+
+	listeners = mem_malloc(max * sizeof(struct msg_listener));
+	if (!listeners)
+		return false;
+
+	listener_max = max;
+
+	for (i = 0; i < app_num; i++)
+		msg_manager_new_id(__app_entry_table[i].name);
+	listener_app_num = app_num;
+
+	for (i = 0; i < srv_num; i++)
+		msg_manager_new_id(__service_entry_table[i].name);
+
 	os_msg_init();
 	return true;
 }
 
+/* key and input events overtake housekeeping traffic */
+static int msg_manager_default_prio(u8_t type)
+{
+	switch (type) {
+	case MSG_KEY_INPUT:
+	case MSG_INPUT_EVENT:
+	case MSG_SR_INPUT:
+		return MSG_PRIO_HIGH;
+	case MSG_BAT_CHARGE_EVENT:
+		return MSG_PRIO_LOW;
+	default:
+		return MSG_PRIO_NORMAL;
+	}
+}
+
 /*@brief Provide send async mesg interface
  *Note:
  *
@@ -157,22 +331,46 @@ bool msg_manager_init(void)
  */
 
 bool msg_manager_send_async_msg(char *receiver, struct app_msg *msg)
+{
+	return msg_manager_send_async_msg_ex(receiver, msg,
+			msg_manager_default_prio(msg->type), 0);
+}
+
+bool msg_manager_send_async_msg_ex(char *receiver, struct app_msg *msg, int prio, u32_t flags)
+{
+	int id = MSG_LISTENER_ALL;
+
+	if (strcmp(receiver, ALL_RECEIVER_NAME)) {
+		int key = irq_lock();
+
+		id = msg_manager_find_added_id(receiver);
+		irq_unlock(key);
+		if (id < 0) {
+			SYS_LOG_ERR("app %s not ready\n", receiver);
+			return false;
+		}
+	}
+
+	return msg_manager_send_async_msg_id(id, msg, prio, flags);
+}
+
+bool msg_manager_send_async_msg_id(int id, struct app_msg *msg, int prio, u32_t flags)
 {
 	bool result = false;
 	os_tid_t target_thread_tid = OS_ANY;
 #ifdef CONFIG_SYS_WAKELOCK
 	sys_wake_lock(WAKELOCK_MESSAGE);
 #endif
-	if (strcmp(receiver, ALL_RECEIVER_NAME)) {
-		target_thread_tid = msg_manager_listener_tid(receiver);
+	if (id != MSG_LISTENER_ALL) {
+		target_thread_tid = msg_manager_get_listener_tid(id);
 		if (target_thread_tid == NULL) {
-			SYS_LOG_ERR("app %s not ready\n", receiver);
+			SYS_LOG_ERR("app %d not ready\n", id);
 			result = false;
 			goto exit;
 		}
 	}
 
-	if (!os_send_async_msg(target_thread_tid, msg, sizeof(struct app_msg))) {
+	if (!os_send_async_msg_ex(target_thread_tid, msg, sizeof(struct app_msg), prio, flags)) {
 		result = true;
 	} else {
 		result = false;
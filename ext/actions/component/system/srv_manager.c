@@ -32,33 +32,34 @@ extern struct service_entry_t __service_entry_table[];
 
 extern struct service_entry_t __service_entry_end[];
 
-static struct service_entry_t *get_srv_entry_byname(char *srv_name)
+extern struct app_entry_t __app_entry_table[];
+
+extern struct app_entry_t __app_entry_end[];
+
+/* running services by service entry index */
+static struct service_info **srv_info_table;
+static int srv_num;
+
+/* listener ids of services follow the app ids */
+static int srv_manager_get_service_id(char *srv_name)
 {
-	struct service_entry_t *srv_entry;
+	int id = msg_manager_get_service_listener_id(srv_name) - (__app_entry_end - __app_entry_table);
 
-	for (srv_entry = __service_entry_table;
-	     srv_entry < __service_entry_end;
-	     srv_entry++) {
+	return (id >= 0 && id < srv_num) ? id : -ENOENT;
+}
 
-		if (!strcmp(srv_entry->name, srv_name)) {
-			return srv_entry;
-		}
-	}
-	return NULL;
+static struct service_entry_t *get_srv_entry_byname(char *srv_name)
+{
+	int id = srv_manager_get_service_id(srv_name);
+
+	return (id >= 0) ? &__service_entry_table[id] : NULL;
 }
 
 static struct service_info *srv_manager_get_service_info(char *srv_name)
 {
-	sys_snode_t *node, *tmp;
-
-	SYS_SLIST_FOR_EACH_NODE_SAFE(&global_srv_list, node, tmp) {
-		struct service_info *srv = SRV_INFO(node);
+	int id = srv_manager_get_service_id(srv_name);
 
-		if (!strcmp(srv->name, srv_name)) {
-			return srv;
-		}
-	}
-	return NULL;
+	return (id >= 0) ? srv_info_table[id] : NULL;
 }
 
 static bool srv_manager_check_stack_safe(struct service_info *srvinfo)
@@ -110,6 +111,7 @@ static bool srv_manager_init_service(struct service_entry_t *srv)
 		os_thread_priority_set(srvinfo->tid, srv->priority);
 
 		sys_slist_append(&global_srv_list, (sys_snode_t *)srvinfo);
+		srv_info_table[srv - __service_entry_table] = srvinfo;
 
 		if (!msg_manager_add_listener(srvinfo->name, srvinfo->tid)) {
 			SYS_LOG_ERR(" %s add listener failed\n",
@@ -171,6 +173,7 @@ bool srv_manager_thread_exit(char *srv_name)
 	}
 
 	sys_slist_find_and_remove(&global_srv_list, (sys_snode_t *)srvinfo);
+	srv_info_table[srvinfo->entry - __service_entry_table] = NULL;
 
 	if (!msg_manager_remove_listener(srvinfo->name)) {
 		SYS_LOG_ERR(" %s remove listener failed\n", srvinfo->name);
@@ -278,6 +281,15 @@ bool srv_manager_check_service_is_actived(char *srv_name)
 bool srv_manager_init(void)
 {
 	sys_slist_init(&global_srv_list);
+
+	srv_num = __service_entry_end - __service_entry_table;
+	if (srv_num > 0) {
+		srv_info_table = mem_malloc(srv_num * sizeof(struct service_info *));
+		if (!srv_info_table)
+			return false;
+		memset(srv_info_table, 0, srv_num * sizeof(struct service_info *));
+	}
+
 	return true;
 }
 
@@ -79,7 +79,8 @@ void sys_event_notify(u32_t event)
 	msg.type = MSG_SYS_EVENT;
 	msg.cmd = event;
 
-	send_async_msg("main", &msg);
+	/* the same event pending twice, such as battery low, is shown once */
+	send_async_msg_ex("main", &msg, MSG_PRIO_NORMAL, MSG_FLAG_COALESCE);
 }
 
 void sys_event_map_register(const struct sys_event_ui_map *event_map, int size, int sys_view_id)
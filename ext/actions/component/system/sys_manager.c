@@ -66,7 +66,11 @@ void system_init(void)
 	fs_manager_init();
 #endif
 
-	msg_manager_init();
+	/* services and apps cannot run without message listeners */
+	if (!msg_manager_init()) {
+		SYS_LOG_ERR("msg manager init failed");
+		return;
+	}
 
 	srv_manager_init();
 
@@ -25,6 +25,12 @@
 #include <limits.h>
 #include <stack_backtrace.h>
 #include <property_manager.h>
+#ifdef CONFIG_STREAM
+#include <stream.h>
+#endif
+#ifdef CONFIG_AUDIO_TRACK_IRQ_STATS
+#include <audio_track.h>
+#endif
 
 #define SYSTEM_SHELL "system"
 
@@ -54,21 +60,24 @@ static int shell_set_config(int argc, char *argv[])
 	SYS_LOG_INF("%s : %s ok\n", argv[1], argv[2]);
 	return 0;
 }
-extern const struct  slabs_info app_slab;
-extern const struct  slabs_info system_slab;
+#ifdef CONFIG_APP_USED_MEM_SLAB
+extern struct slabs_info sys_slab;
+extern void mem_slabs_dump(struct slabs_info *slabs, int index);
+#endif
+
 static int shell_dump_meminfo(int argc, char *argv[])
 {
+#ifdef CONFIG_APP_USED_MEM_SLAB
 	int index = -1;
 
-	if (argv[1] != NULL) {
+	if (argc > 1) {
 		index = atoi(argv[1]);
 	}
-#ifdef CONFIG_USED_MEM_SLAB
-	mem_dump((struct slabs_info *)&system_slab, index);
-#endif
 
-#ifdef CONFIG_APP_USED_MEM_SLAB
-	mem_dump((struct slabs_info *)&app_slab, index);
+	/* the blocks of slab index are dumped too */
+	mem_slabs_dump(&sys_slab, index);
+#else
+	mem_manager_dump();
 #endif
 	return 0;
 }
@@ -97,10 +106,56 @@ static int shell_set_hosc_cap(int argc, char *argv[])
 
 }
 
+#ifdef CONFIG_STREAM
+static int shell_stream(int argc, char *argv[])
+{
+	if (argc < 2 || strcmp(argv[1], "stats")) {
+		printk("usage: stream stats [reset]\n");
+		return 0;
+	}
+
+	stream_dump_stats(argc > 2 && !strcmp(argv[2], "reset"));
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_MEM_PROFILER
+static int shell_memprof(int argc, char *argv[])
+{
+	int ret;
+
+	if (argc > 1 && !strcmp(argv[1], "emit")) {
+		ret = mem_profiler_emit();
+		SYS_LOG_INF("emit %d\n", ret);
+		return 0;
+	}
+
+	mem_profiler_dump(argc > 1 && !strcmp(argv[1], "reset"));
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_AUDIO_TRACK_IRQ_STATS
+static int shell_audio_irq(int argc, char *argv[])
+{
+	audio_track_dump_irq_stats(argc > 1 && !strcmp(argv[1], "reset"));
+	return 0;
+}
+#endif
+
 static const struct shell_cmd system_commands[] = {
 	{ "dumpmem", shell_dump_meminfo, "dump mem info" },
 	{ "set_config", shell_set_config, "set system config " },
 	{ "set_hosc_cap", shell_set_hosc_cap, "set hosc cap " },
+#ifdef CONFIG_STREAM
+	{ "stream", shell_stream, "stream stats [reset]: dump stream statistics" },
+#endif
+#ifdef CONFIG_MEM_PROFILER
+	{ "memprof", shell_memprof, "memprof [reset|emit]: dump heap profile per caller" },
+#endif
+#ifdef CONFIG_AUDIO_TRACK_IRQ_STATS
+	{ "audio_irq", shell_audio_irq, "audio_irq [reset]: dump audio track dma irq time" },
+#endif
 	{ NULL, NULL, NULL }
 };
 
@@ -149,6 +149,11 @@ static int _sys_standby_enter_s1(void)
 
 	standby_context->standby_state = STANDBY_S1;
 
+#ifdef CONFIG_PROPERTY
+	/** no flash write may wait for wake up */
+	property_flush(NULL);
+#endif
+
 	/**disable device for adc */
 	/* power_manager_disable_bat_adc(); */
 
@@ -304,6 +309,10 @@ static int _sys_standby_process_normal(void)
 {
 	u32_t wakelocks = sys_wakelocks_check();
 
+#ifdef CONFIG_PROPERTY
+	property_flush_idle(sys_wakelocks_get_free_time());
+#endif
+
 	/**have sys wake lock*/
 	if (wakelocks) {
 		SYS_LOG_DBG("wakelocks: 0x%08x\n", wakelocks);
@@ -142,15 +142,16 @@ struct audio_track_t {
 	/* fade in/out */
 	void *fade_handle;
 
-	/* mix */
-	void *mix_handle;
-
 	//debug info
 	u32_t irq_cnt;
 	u8_t track_rate;
 	u8_t current_level;
 	s32_t rel_diff;
 	u32_t count;
+
+	/* Q15 gains applied when mixing mix_stream into the track */
+	s16_t track_gain;
+	s16_t mix_gain;
 };
 
 struct audio_record_t {
@@ -121,10 +121,24 @@ int audio_track_compensate_samples(struct audio_track_t *handle, int samples_cnt
 int audio_track_set_mix_stream(struct audio_track_t *handle, io_stream_t mix_stream,
 		u8_t sample_rate, u8_t channels, u8_t stream_type);
 io_stream_t audio_track_get_mix_stream(struct audio_track_t *handle);
+int audio_track_set_mix_gain(struct audio_track_t *handle, s16_t track_gain, s16_t mix_gain);
 int audio_track_set_mute(struct audio_track_t *handle, bool mute);
 int audio_track_set_fade_out(struct audio_track_t *handle, int fade_time);
 int audio_track_get_remain_pcm_samples(struct audio_track_t *handle);
 int audio_track_is_started(void);
+
+/** execution time of the track dma irq callback, in hw cycles */
+struct audio_track_irq_stats {
+	u32_t count;
+	u32_t min_cycles;
+	u32_t max_cycles;
+	u64_t total_cycles;
+	/** periods played before the reload pipeline refilled them */
+	u32_t underrun;
+};
+
+int audio_track_get_irq_stats(struct audio_track_irq_stats *stats, bool reset);
+void audio_track_dump_irq_stats(bool reset);
 /**
  * INTERNAL_HIDDEN @endcond
  */
@@ -116,6 +116,9 @@ typedef enum {
 	EXT_GLOBLE_BUF,
 	SBC_DECODER_2_GLOBAL_DATA,
 	SBC_DECODER_2_SHARE_DATA,
+
+	/** number of memory types, keep it last */
+	CACHE_POOL_TYPE_NUM,
 } cache_pool_type_e;
 
 /**
@@ -35,6 +35,11 @@ extern void _trace_malloc(uint32_t address, uint32_t malloc_size, uint32_t calle
 
 extern void _trace_free(uint32_t address, uint32_t caller);
 
+/* heap profile trace function */
+extern int _trace_mem_snapshot(uint32_t sites, uint32_t live_bytes, uint32_t peak_bytes, uint32_t dropped);
+
+extern int _trace_mem_site(uint32_t caller, uint32_t live_bytes, uint32_t peak_bytes, uint32_t count);
+
 /* task trace */
 #define TRACE_TASK_SWITCH(from, to)                    _trace_task_switch(from, to)
 
@@ -44,6 +49,11 @@ extern void _trace_free(uint32_t address, uint32_t caller);
 
 #define TRACE_FREE(address, caller)                    _trace_free(address, caller) 
 
+/* heap profile trace */
+#define TRACE_MEM_SNAPSHOT(sites, live, peak, dropped) _trace_mem_snapshot(sites, live, peak, dropped)
+
+#define TRACE_MEM_SITE(caller, live, peak, count)      _trace_mem_site(caller, live, peak, count)
+
 #else
 
 /* task trace */
@@ -54,6 +64,11 @@ extern void _trace_free(uint32_t address, uint32_t caller);
 
 #define TRACE_FREE(address, caller)  
 
+/* heap profile trace */
+#define TRACE_MEM_SNAPSHOT(sites, live, peak, dropped) (-ENOSYS)
+
+#define TRACE_MEM_SITE(caller, live, peak, count)      (-ENOSYS)
+
 #endif
 
 
@@ -75,15 +75,31 @@ typedef enum
 } msg_type;
 
 
+/** message priority classes, higher classes are received first */
+typedef enum
+{
+	/* key, input and media control */
+	MSG_PRIO_HIGH = OS_MSG_PRIO_HIGH,
+	MSG_PRIO_NORMAL = OS_MSG_PRIO_NORMAL,
+	/* housekeeping, battery and status updates */
+	MSG_PRIO_LOW = OS_MSG_PRIO_LOW,
+} msg_prio;
+
+/** the latest pending message of the same type and cmd is replaced by the new one */
+#define MSG_FLAG_COALESCE	OS_MSG_COALESCE
+
+/** listener id of every receiver, same as ALL_RECEIVER_NAME */
+#define MSG_LISTENER_ALL	(-1)
+
 struct msg_listener
 {
-	sys_snode_t node;
 	char * name;
 	k_tid_t tid;
+	/* next listener id in the same name and tid hash buckets */
+	u8_t name_next;
+	u8_t tid_next;
 };
 
-#define LISTENER_INFO(_node) CONTAINER_OF(_node, struct msg_listener, node)
-
 
 
 /**
@@ -99,6 +115,9 @@ typedef void (*MSG_CALLBAK)(struct app_msg*, int, void*);
 #define send_async_msg(receiver, msg) \
 			msg_manager_send_async_msg(receiver, msg)
 
+#define send_async_msg_ex(receiver, msg, prio, flags) \
+			msg_manager_send_async_msg_ex(receiver, msg, prio, flags)
+
 #define receive_msg(msg, timeout) \
 			msg_manager_receive_msg(msg, timeout)
 
@@ -151,6 +170,25 @@ bool msg_manager_init(void);
  */
 bool msg_manager_send_async_msg(char * receiver , struct app_msg *msg);
 
+/**
+ * @brief Send a Asynchronous message with priority
+ *
+ * This routine Send a Asynchronous message, received before every pending
+ * message of a lower priority. With MSG_FLAG_COALESCE, if the latest pending
+ * message of the same type and priority has the same cmd, it takes the new
+ * content and keeps its place, no message buffer is used. Messages with a
+ * callback are never coalesced.
+ *
+ * @param receiver name of message receiver
+ * @param msg store the received message
+ * @param prio priority class, MSG_PRIO_HIGH is received first
+ * @param flags 0 or MSG_FLAG_COALESCE
+ *
+ * @return true send success
+ * @return false send failed
+ */
+bool msg_manager_send_async_msg_ex(char *receiver, struct app_msg *msg, int prio, u32_t flags);
+
 /**
  * @brief receive message
  *
@@ -255,6 +293,54 @@ bool msg_manager_remove_listener(char * name);
  */
 
 k_tid_t  msg_manager_listener_tid(char * name);
+
+/**
+ * @brief get the listener id by name
+ *
+ * Every app and service has a fixed listener id, apps first in app entry
+ * order, then services in service entry order, then listeners added under
+ * other names. The id stays the same while the listener comes and goes.
+ *
+ * @param name app, service or listener name
+ *
+ * @return id of the listener, the app id if an app and a service share
+ * the name, negative if the name is unknown
+ */
+int msg_manager_get_listener_id(const char *name);
+
+/**
+ * @brief get the listener id of a service by name
+ *
+ * @param name service name
+ *
+ * @return id of the listener, negative if there is no such service
+ */
+int msg_manager_get_service_listener_id(const char *name);
+
+/**
+ * @brief get the thread id of a listener
+ *
+ * @param id listener id from msg_manager_get_listener_id
+ *
+ * @return NULL The listener is not added
+ * @return tid  target thread id of the message linsener
+ */
+k_tid_t msg_manager_get_listener_tid(int id);
+
+/**
+ * @brief Send a Asynchronous message to a listener id
+ *
+ * Same as msg_manager_send_async_msg_ex, without the name lookup.
+ *
+ * @param id listener id from msg_manager_get_listener_id, or MSG_LISTENER_ALL
+ * @param msg store the received message
+ * @param prio priority class, MSG_PRIO_HIGH is received first
+ * @param flags 0 or MSG_FLAG_COALESCE
+ *
+ * @return true send success
+ * @return false send failed
+ */
+bool msg_manager_send_async_msg_id(int id, struct app_msg *msg, int prio, u32_t flags);
 /**
  * @brief get receiver name by tid
  *
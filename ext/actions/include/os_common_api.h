@@ -1021,9 +1021,18 @@ int system_check_low_latencey_mode(void);
 
 void system_set_low_latencey_mode(bool low_latencey);
 
+/** message priority, higher priority messages are received first */
+#define OS_MSG_PRIO_HIGH	0
+#define OS_MSG_PRIO_NORMAL	1
+#define OS_MSG_PRIO_LOW		2
+
+/** the latest pending async message of the same type and cmd is replaced in place */
+#define OS_MSG_COALESCE		BIT(0)
+
 int msg_pool_get_free_msg_num(void);
 int os_send_sync_msg(void *receiver, void *msg, int msg_size);
 int os_send_async_msg(void *receiver, void *msg, int msg_size);
+int os_send_async_msg_ex(void *receiver, void *msg, int msg_size, int prio, u32_t flags);
 int os_receive_msg(void *msg, int msg_size,int timeout);
 void os_msg_clean(void);
 void os_msg_init(void);
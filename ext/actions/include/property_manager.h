@@ -242,6 +242,22 @@ int property_flush(const char *key);
 
 int property_flush_req(const char *key);
 
+/**
+ * @brief flush property cache when system idle
+ *
+ * @details This routine is called periodically by system standby, it
+ * commits all changed properties in one batch once system has been idle
+ * for CONFIG_PROPERTY_CACHE_IDLE_COMMIT_MS, or once the oldest change has
+ * waited CONFIG_PROPERTY_CACHE_MAX_DIRTY_SEC.
+ *
+ * @param idle_time system idle time in ms
+ *
+ * @return != 0  flush failed
+ * @return == 0  flush success or nothing to flush
+ */
+
+int property_flush_idle(u32_t idle_time);
+
 /**
  * @brief init property manager
  *
@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <srv_manager.h>
+#include <mem_manager.h>
 
 
 /*share stack for app thread */
@@ -27,11 +28,20 @@ char __stack_noinit  __aligned(STACK_ALIGN) share_stack_area[CONFIG_APP_STACKSIZ
 char __stack_noinit  __aligned(STACK_ALIGN) meidasrv_stack_area[CONFIG_MEDIASRV_STACKSIZE];
 
 extern void media_service_main_loop(void * parama1, void * parama2, void * parama3);
+
+/* media service allocates often, give it a private cache of small blocks */
+static void media_service_thread_loop(void * parama1, void * parama2, void * parama3)
+{
+	mem_manager_thread_cache_attach();
+	media_service_main_loop(parama1, parama2, parama3);
+	mem_manager_thread_cache_detach();
+}
+
 SERVICE_DEFINE(media, \
 				meidasrv_stack_area, CONFIG_MEDIASRV_STACKSIZE, \
 				CONFIG_MEDIASRV_PRIORITY, BACKGROUND_APP, \
 				NULL, NULL, NULL, \
-				media_service_main_loop);
+				media_service_thread_loop);
 #endif
 
 
@@ -40,11 +50,19 @@ SERVICE_DEFINE(media, \
 char __in_section_unique(bthost.noinit.stack)  __aligned(STACK_ALIGN) btsrv_stack_area[CONFIG_BTSRV_STACKSIZE];
 
 extern void bt_service_main_loop(void * parama1, void * parama2, void * parama3);
+
+static void bt_service_thread_loop(void * parama1, void * parama2, void * parama3)
+{
+	mem_manager_thread_cache_attach();
+	bt_service_main_loop(parama1, parama2, parama3);
+	mem_manager_thread_cache_detach();
+}
+
 SERVICE_DEFINE(bluetooth, \
 				btsrv_stack_area,	CONFIG_BTSRV_STACKSIZE, \
 				CONFIG_BTSRV_PRIORITY, BACKGROUND_APP, \
 				NULL, NULL, NULL, \
-				bt_service_main_loop);
+				bt_service_thread_loop);
 #endif
 
 #ifdef CONFIG_BT_HCI
@@ -133,6 +133,26 @@ int hal_aout_channel_write_data(void* aout_channel_handle, u8_t *data, u32_t dat
 	return result;
 }
 
+int hal_aout_channel_write_data_seg(void *aout_channel_handle, struct acts_ringbuf_seg *seg, int num)
+{
+	int i, result = 0;
+
+	hal_audio_out_context_t*  audio_out = _hal_audio_out_get_context();
+
+	assert(audio_out->aout_dev);
+
+	for (i = 0; i < num; i++) {
+		if (!seg[i].len)
+			continue;
+
+		result = audio_out_write(audio_out->aout_dev, aout_channel_handle, seg[i].data, seg[i].len);
+		if (result)
+			break;
+	}
+
+	return result;
+}
+
 int hal_aout_channel_stop(void* aout_channel_handle)
 {
 	int result;
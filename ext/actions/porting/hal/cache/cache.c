@@ -129,6 +129,12 @@ int cache_write(io_cache_t handle, const void *buf, int num)
 		ret = cache_write_nonblock(handle, buf, num);
 	}
 
+	/* the file cache may have both stages waiting for the disk */
+	while (ret == 0 && num > 0 && !handle->write_finished) {
+		os_sem_take(&handle->sem, OS_MSEC(10));
+		ret = cache_write_nonblock(handle, buf, num);
+	}
+
 	if(ret > 0){
 		os_sem_give(&handle->sem);
 	}
@@ -196,6 +202,20 @@ int cache_destroy(io_cache_t handle)
 	return 0;
 }
 
+int cache_io_pending(io_cache_t handle)
+{
+	switch (handle->cache_type) {
+#ifdef CONFIG_FILE_CACHE
+	case TYPE_FILE_CACHE:
+		return file_cache_io_pending(handle);
+#endif
+
+	default:
+		break;
+	}
+	return 0;
+}
+
 io_cache_t cache_create(char *parama, int size, cache_type_e type)
 {
 	io_cache_t cache = NULL;
@@ -240,7 +260,7 @@ int cache_reset(io_cache_t handle)
 	os_sem_give(&handle->sem);
 #ifdef CONFIG_FILE_CACHE
 	if(handle->cache_type == TYPE_FILE_CACHE){
-		file_cache_reset();
+		file_cache_reset(handle);
 	}
 #endif
 	return 0;
@@ -38,6 +38,7 @@ int file_cache_read(io_cache_t handle, void *buf, int num);
 int file_cache_write(io_cache_t handle, const void *buf, int num);
 int file_cache_destroy(io_cache_t handle);
 int file_cache_reset(io_cache_t handle);
+int file_cache_io_pending(io_cache_t handle);
 #endif
 
 #ifdef CONFIG_PSRAM_CACHE
@@ -7,160 +7,317 @@
 /**
  * @file
  * @brief file cache interface
-*/
+ *
+ * The cache file is used as a ring of stage sized blocks. Writers copy into
+ * one of two staging buffers and a full stage is written by the file cache
+ * work queue in a single aligned fs_write, so the writer never waits for
+ * the disk. Readers load whole stages with one aligned fs_read and take
+ * data that is not on the disk yet straight from the staging buffers.
+ */
 
 #include <os_common_api.h>
+#include <mem_manager.h>
 #include <acts_cache.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include "cache_internel.h"
 
-int file_cache_read(io_cache_t handle, void *buf, int num)
+#define FILE_CACHE_STAGES	(2)
+#define FILE_CACHE_IO_STACKSIZE	(1536)
+
+enum {
+	STAGE_FREE,
+	STAGE_FILLING,
+	/* full, or the last one after write finished, waiting for io */
+	STAGE_PENDING,
+};
+
+struct file_cache_stage {
+	u8_t *buf;
+	/* cache offset of buf[0] */
+	int pos;
+	int len;
+	u8_t state;
+};
+
+struct file_cache {
+	fs_file_t fp;
+	io_cache_t handle;
+	/* protects the stages, flushed and io_err */
+	os_mutex lock;
+	/* protects the file position */
+	os_mutex io_lock;
+	os_work io_work;
+	struct file_cache_stage stage[FILE_CACHE_STAGES];
+	/* stage the writer copies into */
+	u8_t fill;
+	/* next stage to write to the file */
+	u8_t flush;
+	u8_t io_busy;
+	/* data before this cache offset is in the file */
+	int flushed;
+	int io_err;
+	/* whole stage read from the file */
+	u8_t *rbuf;
+	int rpos;
+	int rlen;
+};
+
+static os_work_q file_cache_work_q;
+static char __noinit __aligned(STACK_ALIGN) file_cache_io_stack[FILE_CACHE_IO_STACKSIZE];
+static bool file_cache_work_q_started;
+
+static inline struct file_cache *_file_cache_get(io_cache_t handle)
+{
+	return CONTAINER_OF(handle->fp, struct file_cache, fp);
+}
+
+static int _file_cache_seek(struct file_cache *fc, int pos)
+{
+	int res;
+
+	res = fs_seek(&fc->fp, pos % fc->handle->size, FS_SEEK_SET);
+	if (res)
+		SYS_LOG_WRN("fs_seek failed [%d], pos=%d\n", res, pos);
+
+	return res;
+}
+
+static void _file_cache_io_work(os_work *work)
 {
+	struct file_cache *fc = CONTAINER_OF(work, struct file_cache, io_work);
+	struct file_cache_stage *st;
 	ssize_t brw;
-	int read_len = 0;
-	int file_off = 0;
-	int avail;
 
-	while (num > 0) {
-		avail = cache_length(handle);
+	os_mutex_lock(&fc->lock, OS_FOREVER);
+	fc->io_busy = 1;
 
-		if (!avail)
+	while (!fc->io_err) {
+		st = &fc->stage[fc->flush];
+		if (st->state != STAGE_PENDING)
 			break;
 
-		if (avail > num)
-			avail = num;
+		/* the stage buffer stays valid until it is marked free */
+		os_mutex_unlock(&fc->lock);
 
-		num -= avail;
+		os_mutex_lock(&fc->io_lock, OS_FOREVER);
+		brw = _file_cache_seek(fc, st->pos);
+		if (!brw) {
+			brw = fs_write(&fc->fp, st->buf, st->len);
+			if (brw >= 0 && brw != st->len)
+				brw = -ENOSPC;
+		}
+		os_mutex_unlock(&fc->io_lock);
 
-		file_off = handle->rofs % handle->size;
-		brw = fs_seek(handle->fp, file_off, FS_SEEK_SET);
-		if (brw) {
-			SYS_LOG_WRN("fs_seek failed [%zd], file_off=%d\n", brw, file_off);
-			goto err_out;
+		os_mutex_lock(&fc->lock, OS_FOREVER);
+		if (brw < 0) {
+			SYS_LOG_ERR("Failed writing to file [%zd], pos=%d\n", brw, st->pos);
+			fc->io_err = brw;
+			break;
 		}
 
-		brw = handle->size - file_off;
-		if (avail > brw) {
-			brw = fs_read(handle->fp, buf, brw);
-			if (brw < 0) {
-				SYS_LOG_WRN("Failed read to file [%zd]\n", brw);
-				goto err_out;
+		fc->flushed = st->pos + st->len;
+		st->state = STAGE_FREE;
+		st->len = 0;
+		fc->flush = (fc->flush + 1) % FILE_CACHE_STAGES;
+	}
+
+	fc->io_busy = 0;
+	os_mutex_unlock(&fc->lock);
+
+	/* wake up a writer waiting for a free stage */
+	os_sem_give(&fc->handle->sem);
+}
+
+/* must be called with fc->lock held */
+static void _file_cache_queue_stage(struct file_cache *fc, struct file_cache_stage *st)
+{
+	st->state = STAGE_PENDING;
+	fc->fill = (fc->fill + 1) % FILE_CACHE_STAGES;
+	os_work_submit_to_queue(&file_cache_work_q, &fc->io_work);
+}
+
+static int _file_cache_load(struct file_cache *fc, int pos)
+{
+	int stage_pos = pos - pos % CONFIG_FILE_CACHE_STAGE_SIZE;
+	int len = min(fc->flushed - stage_pos, CONFIG_FILE_CACHE_STAGE_SIZE);
+	ssize_t brw;
+
+	/* no writer reuses this part of the file before rofs passes it */
+	os_mutex_lock(&fc->io_lock, OS_FOREVER);
+	brw = _file_cache_seek(fc, stage_pos);
+	if (!brw)
+		brw = fs_read(&fc->fp, fc->rbuf, len);
+	os_mutex_unlock(&fc->io_lock);
+
+	if (brw != len) {
+		SYS_LOG_WRN("Failed read to file [%zd], pos=%d\n", brw, stage_pos);
+		fc->rlen = 0;
+		return (brw < 0) ? brw : -EIO;
+	}
+
+	fc->rpos = stage_pos;
+	fc->rlen = len;
+	return 0;
+}
+
+int file_cache_read(io_cache_t handle, void *buf, int num)
+{
+	struct file_cache *fc = _file_cache_get(handle);
+	struct file_cache_stage *st;
+	int read_len = 0;
+	int avail, pos, i;
+
+	while (num > 0) {
+		avail = min(cache_length(handle), num);
+		if (!avail)
+			break;
+
+		pos = handle->rofs;
+		if (pos >= fc->rpos && pos < fc->rpos + fc->rlen) {
+			avail = min(avail, fc->rpos + fc->rlen - pos);
+			memcpy((u8_t *)buf + read_len, fc->rbuf + (pos - fc->rpos), avail);
+		} else {
+			os_mutex_lock(&fc->lock, OS_FOREVER);
+			if (pos < fc->flushed) {
+				os_mutex_unlock(&fc->lock);
+				if (_file_cache_load(fc, pos))
+					break;
+				continue;
 			}
 
-			avail -= brw;
-			read_len += brw;
-			handle->rofs += brw;
+			/* not in the file yet, copy from the stage holding it */
+			for (i = 0; i < FILE_CACHE_STAGES; i++) {
+				st = &fc->stage[i];
+				if (st->state != STAGE_FREE && pos >= st->pos && pos < st->pos + st->len)
+					break;
+			}
 
-			brw = fs_seek(handle->fp, 0, FS_SEEK_SET);
-			if (brw) {
-				SYS_LOG_WRN("fs_seek failed [%zd]\n", brw);
-				goto err_out;
+			if (i == FILE_CACHE_STAGES) {
+				os_mutex_unlock(&fc->lock);
+				SYS_LOG_ERR("pos %d lost\n", pos);
+				break;
 			}
-		}
 
-		brw = fs_read(handle->fp, (u8_t*)buf + read_len, avail);
-		if (brw < 0) {
-			SYS_LOG_WRN("Failed read to file [%zd]\n", brw);
-			goto err_out;
+			avail = min(avail, st->pos + st->len - pos);
+			memcpy((u8_t *)buf + read_len, st->buf + (pos - st->pos), avail);
+			os_mutex_unlock(&fc->lock);
 		}
 
+		num -= avail;
 		read_len += avail;
 		handle->rofs += avail;
-
-		if (handle->write_finished) {
-			break;
-		}
 	}
 
-err_out:
-out_exit:
 	return read_len;
-
 }
 
 int file_cache_write(io_cache_t handle, const void *buf, int num)
 {
-	ssize_t brw = 0;
-	int wirte_len = 0;
-	int file_off = 0;
+	struct file_cache *fc = _file_cache_get(handle);
+	struct file_cache_stage *st;
+	int write_len = 0;
 	int avail;
 
 	handle->write_finished = (num > 0) ? false : true;
 
+	os_mutex_lock(&fc->lock, OS_FOREVER);
+
+	if (fc->io_err) {
+		write_len = fc->io_err;
+		goto out_unlock;
+	}
+
 	while (num > 0) {
-		avail = cache_free_space(handle);
-		if (!avail)
+		st = &fc->stage[fc->fill];
+		/* both stages wait for the disk, do not stall the writer */
+		if (st->state == STAGE_PENDING)
 			break;
 
-		if (avail > num)
-			avail = num;
+		if (st->state == STAGE_FREE) {
+			st->pos = handle->wofs;
+			st->state = STAGE_FILLING;
+		}
+
+		/* a stage never wraps around the end of the file */
+		avail = min(cache_free_space(handle), num);
+		avail = min(avail, CONFIG_FILE_CACHE_STAGE_SIZE - st->len);
+		avail = min(avail, handle->size - st->pos % handle->size - st->len);
+		if (!avail)
+			break;
 
+		memcpy(st->buf + st->len, (const u8_t *)buf + write_len, avail);
+		st->len += avail;
 		num -= avail;
+		write_len += avail;
+		handle->wofs += avail;
 
-		file_off = handle->wofs % handle->size;
-		brw = fs_seek(handle->fp, file_off, FS_SEEK_SET);
-		if (brw) {
-			SYS_LOG_WRN("fs_seek failed [%zd], file_off=%d\n", brw, file_off);
-			goto err_out;
-		}
+		if (st->len == CONFIG_FILE_CACHE_STAGE_SIZE ||
+		    (st->pos + st->len) % handle->size == 0)
+			_file_cache_queue_stage(fc, st);
+	}
 
-		brw = handle->size - file_off;
-		if (avail > brw) {
-			brw = fs_write(handle->fp, buf, brw);
-			if (brw < 0) {
-				SYS_LOG_WRN("Failed writing to file [%zd]\n", brw);
-				goto err_out;
-			}
+	if (handle->write_finished) {
+		st = &fc->stage[fc->fill];
+		if (st->state == STAGE_FILLING)
+			_file_cache_queue_stage(fc, st);
+	}
 
-			avail -= brw;
-			wirte_len += brw;
-			handle->wofs += brw;
+out_unlock:
+	os_mutex_unlock(&fc->lock);
+	return write_len;
+}
 
-			brw = fs_seek(handle->fp, 0, FS_SEEK_SET);
-			if (brw) {
-				SYS_LOG_WRN("fs_seek failed [%zd]\n", brw);
-				goto err_out;
-			}
-		}
+int file_cache_io_pending(io_cache_t handle)
+{
+	struct file_cache *fc = _file_cache_get(handle);
+	int pending;
 
-		brw = fs_write(handle->fp, (u8_t*)buf + wirte_len, avail);
-		if (brw < 0) {
-			SYS_LOG_WRN("Failed writing to file [%zd]\n", brw);
-			goto err_out;
+	os_mutex_lock(&fc->lock, OS_FOREVER);
+	pending = fc->io_err ? fc->io_err : handle->wofs - fc->flushed;
+	os_mutex_unlock(&fc->lock);
+
+	return pending;
+}
+
+/* drop the staged data and wait for the io work to finish */
+static int _file_cache_discard(struct file_cache *fc)
+{
+	int try_cnt = 0;
+	int i;
+
+	do {
+		os_mutex_lock(&fc->lock, OS_FOREVER);
+		for (i = 0; i < FILE_CACHE_STAGES; i++) {
+			fc->stage[i].state = STAGE_FREE;
+			fc->stage[i].len = 0;
 		}
 
-		wirte_len += avail;
-		handle->wofs += avail;
-		if (handle->write_finished) {
-			break;
+		if (!fc->io_busy && !os_work_pending(&fc->io_work)) {
+			os_mutex_unlock(&fc->lock);
+			return 0;
 		}
-	}
+		os_mutex_unlock(&fc->lock);
 
-out_exit:
-#if 0
-	/* sync is unnecessary */
-	if (fs_sync(&handle->fp))
-		SYS_LOG_ERR("Fail to sync file \n");
-#endif
-	return wirte_len;
-err_out:
-	/* FIXME: update the cache size to the file size ? */
-	if (handle->size > file_off) {
-		SYS_LOG_WRN("shrink cache size from %d to %d\n", handle->size, file_off);
-		handle->size = file_off; //f_size(&handle->fp.fp);
-	}
-	goto out_exit;
+		os_sleep(10);
+	} while (try_cnt++ < 100);
+
+	return -EBUSY;
 }
 
 int file_cache_destroy(io_cache_t handle)
 {
+	struct file_cache *fc = _file_cache_get(handle);
+	int try_cnt = 0;
 	int res;
 
 	handle->write_finished = true;
 
-	res = fs_close(handle->fp);
+	if (_file_cache_discard(fc))
+		SYS_LOG_ERR("io work not finished\n");
+
+	res = fs_close(&fc->fp);
 	if (res) {
 		SYS_LOG_ERR("Error closing file [%d]\n", res);
 		goto exit;
@@ -171,7 +328,7 @@ int file_cache_destroy(io_cache_t handle)
 exit:
 	os_sem_give(&handle->sem);
 
-	while(!handle->work_finished && try_cnt++ > 100){
+	while (!handle->work_finished && try_cnt++ < 100) {
 		os_sleep(10);
 	}
 
@@ -179,21 +336,42 @@ exit:
 		SYS_LOG_ERR("work not filishend\n");
 	}
 
-	mem_free(handle->fp);
+	mem_free(fc->rbuf);
+	mem_free(fc->stage[0].buf);
+	mem_free(fc);
 	mem_free(handle);
 	return res;
 }
 
 int file_cache_reset(io_cache_t handle)
 {
-	fs_trunc_quick(handle->fp, 0);
+	struct file_cache *fc = _file_cache_get(handle);
+
+	if (_file_cache_discard(fc))
+		SYS_LOG_ERR("io work not finished\n");
+
+	fc->fill = 0;
+	fc->flush = 0;
+	fc->flushed = 0;
+	fc->io_err = 0;
+	fc->rlen = 0;
+
+	fs_trunc_quick(&fc->fp, 0);
 	return 0;
 }
 
 io_cache_t file_cache_create(const char * cachename, int size)
 {
 	io_cache_t cache;
-	int res;
+	struct file_cache *fc;
+	int res, i;
+
+	/* every stage maps to one aligned block of the file */
+	size -= size % CONFIG_FILE_CACHE_STAGE_SIZE;
+	if (size < FILE_CACHE_STAGES * CONFIG_FILE_CACHE_STAGE_SIZE) {
+		SYS_LOG_ERR("cache size %d too small\n", size);
+		return NULL;
+	}
 
 	cache = mem_malloc(sizeof(struct acts_cache));
 	if (cache == NULL) {
@@ -201,42 +379,71 @@ io_cache_t file_cache_create(const char * cachename, int size)
 		return NULL;
 	}
 
-	cache->fp = mem_malloc(sizeof(fs_file_t));
-	if(!cache->fp) {
+	fc = mem_malloc(sizeof(struct file_cache));
+	if (!fc) {
 		goto failed;
 	}
 
-	res = fs_open(cache->fp, cachename);
+	memset(fc, 0, sizeof(struct file_cache));
+
+	fc->stage[0].buf = mem_malloc(FILE_CACHE_STAGES * CONFIG_FILE_CACHE_STAGE_SIZE);
+	fc->rbuf = mem_malloc(CONFIG_FILE_CACHE_STAGE_SIZE);
+	if (!fc->stage[0].buf || !fc->rbuf) {
+		goto buf_failed;
+	}
+
+	for (i = 1; i < FILE_CACHE_STAGES; i++)
+		fc->stage[i].buf = fc->stage[0].buf + i * CONFIG_FILE_CACHE_STAGE_SIZE;
+
+	res = fs_open(&fc->fp, cachename);
 	if (res) {
 		SYS_LOG_ERR("Failed opening file [%d]\n", res);
-		goto fp_failed;
+		goto buf_failed;
 	}
 
 #if 0
 	/* the file may fail to increase upto size, due to the limited disk capacity */
-	res = fs_trunc_quick(cache->fp, size);
+	res = fs_trunc_quick(&fc->fp, size);
 	if (res) {
 		SYS_LOG_ERR("fs_truncate failed [%d]\n", res);
-		fs_close(cache->fp);
-		goto fp_failed;
+		fs_close(&fc->fp);
+		goto buf_failed;
 	}
 #else
-	fs_trunc_quick(cache->fp, 0);
+	fs_trunc_quick(&fc->fp, 0);
 #endif
 
+	if (!file_cache_work_q_started) {
+		os_work_q_start(&file_cache_work_q, (os_thread_stack_t)file_cache_io_stack,
+				sizeof(file_cache_io_stack), CONFIG_FILE_CACHE_IO_PRIORITY);
+		file_cache_work_q_started = true;
+	}
+
+	os_mutex_init(&fc->lock);
+	os_mutex_init(&fc->io_lock);
+	os_work_init(&fc->io_work, _file_cache_io_work);
+	fc->handle = cache;
+
+	cache->fp = &fc->fp;
 	cache->size = size;
+	cache->wofs = 0;
+	cache->rofs = 0;
 
 	SYS_LOG_INF("size:%d, name: %s \n", cache->size, cachename);
 
 	cache->write_finished = false;
+	cache->work_finished = true;
 
 	return cache;
 
-fp_failed:
-	mem_free(cache->fp);
+buf_failed:
+	if (fc->rbuf)
+		mem_free(fc->rbuf);
+	if (fc->stage[0].buf)
+		mem_free(fc->stage[0].buf);
+	mem_free(fc);
 failed:
 	mem_free(cache);
 	return NULL;
 
 }
-
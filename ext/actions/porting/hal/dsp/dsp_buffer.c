@@ -47,7 +47,7 @@ void dsp_ringbuf_free(struct dsp_ringbuf *buf)
 
 size_t dsp_ringbuf_get(struct dsp_ringbuf *buf, void *data, size_t size)
 {
-	size_t len = ACTS_RINGBUF_SIZE8(acts_ringbuf_get(&buf->buf, data, ACTS_RINGBUF_NELEM(size)));
+	size_t len = ACTS_RINGBUF_SIZE8(acts_ringbuf_spsc_get(&buf->buf, data, ACTS_RINGBUF_NELEM(size)));
 
 #if CONFIG_DSP_ACTIVE_POWER_LATENCY_MS >= 0
 	/* Supposed next read the same size */
@@ -62,7 +62,7 @@ size_t dsp_ringbuf_get(struct dsp_ringbuf *buf, void *data, size_t size)
 
 size_t dsp_ringbuf_put(struct dsp_ringbuf *buf, const void *data, size_t size)
 {
-	size_t len = ACTS_RINGBUF_SIZE8(acts_ringbuf_put(&buf->buf, data, ACTS_RINGBUF_NELEM(size)));
+	size_t len = ACTS_RINGBUF_SIZE8(acts_ringbuf_spsc_put(&buf->buf, data, ACTS_RINGBUF_NELEM(size)));
 
 #if CONFIG_DSP_ACTIVE_POWER_LATENCY_MS >= 0
 	/* Supposed next write the same size */
@@ -75,6 +75,43 @@ size_t dsp_ringbuf_put(struct dsp_ringbuf *buf, const void *data, size_t size)
 	return len;
 }
 
+size_t dsp_ringbuf_put_seg(struct dsp_ringbuf *buf, const struct acts_ringbuf_seg *seg, int num)
+{
+	struct acts_ringbuf_seg dst[2];
+	size_t size = 0, offset = 0;
+	int i;
+
+	for (i = 0; i < num; i++)
+		size += seg[i].len;
+
+	if (dsp_ringbuf_put_claim_seg(buf, dst, size) < size)
+		return 0;
+
+	/* gather source segments into the (possibly wrapped) free space */
+	for (i = 0; i < num; i++) {
+		const u8_t *src = seg[i].data;
+		size_t len = seg[i].len;
+
+		while (len > 0) {
+			size_t n;
+
+			if (offset < dst[0].len) {
+				n = min(len, dst[0].len - offset);
+				memcpy((u8_t *)dst[0].data + offset, src, n);
+			} else {
+				n = len;
+				memcpy((u8_t *)dst[1].data + offset - dst[0].len, src, n);
+			}
+
+			src += n;
+			len -= n;
+			offset += n;
+		}
+	}
+
+	return dsp_ringbuf_fill_none(buf, size);
+}
+
 size_t dsp_ringbuf_read(struct dsp_ringbuf *buf, void *stream, size_t size,
 			ssize_t (*stream_write)(void *, const void *, size_t))
 {
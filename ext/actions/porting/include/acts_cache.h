@@ -204,6 +204,21 @@ int cache_destroy(io_cache_t handle);
  */
 int cache_reset(io_cache_t handle);
 
+/**
+ * @brief cache io pending
+ *
+ * This routine provides get the number of bytes written to the cache
+ * that are not on the backing store yet, it never blocks. A file cache
+ * writes on its own work queue, poll this after cache_write_finished
+ * to know when all the data is in the file.
+ *
+ * @param handle handle of cache
+ *
+ * @return >=0 bytes still waiting for io, 0 for memory caches
+ * @return <0  the backing store failed
+ */
+int cache_io_pending(io_cache_t handle);
+
 /**
  * @brief cache size
  *
@@ -18,6 +18,7 @@
 #include <audio_out.h>
 #include <audio_in.h>
 #include <dma.h>
+#include <acts_ringbuf.h>
 
 /**
 **  audio out hal context struct
@@ -92,6 +93,9 @@ int hal_audio_out_init(void);
 void* hal_aout_channel_open(audio_out_init_param_t *init_param);
 int hal_aout_channel_start(void* aout_channel_handle);
 int hal_aout_channel_write_data(void* aout_channel_handle, u8_t *data, u32_t data_size);
+/* write a segment list (lengths in bytes), one dma transfer per segment,
+ * only for channels whose write completes synchronously (AOUT_FIFO_DAC0) */
+int hal_aout_channel_write_data_seg(void *aout_channel_handle, struct acts_ringbuf_seg *seg, int num);
 int hal_aout_channel_stop(void* aout_channel_handle);
 int hal_aout_channel_close(void* aout_channel_handle);
 int hal_aout_channel_set_aps(void *aout_channel_handle, unsigned int aps_level, unsigned int aps_mode);
@@ -507,6 +507,64 @@ size_t dsp_ringbuf_read(struct dsp_ringbuf *buf, void *stream, size_t size,
 size_t dsp_ringbuf_write(struct dsp_ringbuf *buf, void *stream, size_t size,
 		ssize_t (*stream_read)(void *, void *, size_t));
 
+/**
+ * @brief Get addresses of valid data in a dsp ring buffer.
+ *
+ * The data is described by up to 2 segments, wrap included, and the
+ * segment lengths are in bytes. Release it by dsp_ringbuf_drop.
+ *
+ * @param buf Address of ring buffer.
+ * @param seg Array of 2 segments filled with the claimed data.
+ * @param size Requested size in bytes.
+ *
+ * @return number of bytes claimed.
+ */
+static inline size_t dsp_ringbuf_get_claim_seg(struct dsp_ringbuf *buf,
+		struct acts_ringbuf_seg seg[2], size_t size)
+{
+	size_t len = ACTS_RINGBUF_SIZE8(acts_ringbuf_get_claim_seg(&buf->buf, seg, ACTS_RINGBUF_NELEM(size)));
+
+	seg[0].len = ACTS_RINGBUF_SIZE8(seg[0].len);
+	seg[1].len = ACTS_RINGBUF_SIZE8(seg[1].len);
+	return len;
+}
+
+/**
+ * @brief Allocate free space of a dsp ring buffer.
+ *
+ * The space is described by up to 2 segments, wrap included, and the
+ * segment lengths are in bytes. Commit it by dsp_ringbuf_fill_none.
+ *
+ * @param buf Address of ring buffer.
+ * @param seg Array of 2 segments filled with the allocated space.
+ * @param size Requested size in bytes.
+ *
+ * @return number of bytes allocated.
+ */
+static inline size_t dsp_ringbuf_put_claim_seg(struct dsp_ringbuf *buf,
+		struct acts_ringbuf_seg seg[2], size_t size)
+{
+	size_t len = ACTS_RINGBUF_SIZE8(acts_ringbuf_put_claim_seg(&buf->buf, seg, ACTS_RINGBUF_NELEM(size)));
+
+	seg[0].len = ACTS_RINGBUF_SIZE8(seg[0].len);
+	seg[1].len = ACTS_RINGBUF_SIZE8(seg[1].len);
+	return len;
+}
+
+/**
+ * @brief Write a segment list to a dsp ring buffer.
+ *
+ * This routine gathers all segments into the ring buffer at once, or
+ * writes nothing if there is not enough space.
+ *
+ * @param buf Address of ring buffer.
+ * @param seg Array of segments, lengths in bytes.
+ * @param num Number of segments.
+ *
+ * @return number of bytes successfully written.
+ */
+size_t dsp_ringbuf_put_seg(struct dsp_ringbuf *buf, const struct acts_ringbuf_seg *seg, int num);
+
 /**
  * @brief Drop data of a dsp ring buffer
  *
@@ -546,6 +604,19 @@ static inline size_t dsp_ringbuf_fill(struct dsp_ringbuf *buf, char c, size_t si
 	return ACTS_RINGBUF_SIZE8(acts_ringbuf_fill(&buf->buf, c, ACTS_RINGBUF_NELEM(size)));
 }
 
+/**
+ * @brief Commit data written to space claimed from a dsp ring buffer.
+ *
+ * @param buf Address of ring buffer.
+ * @param size Size of data.
+ *
+ * @return number of bytes committed.
+ */
+static inline size_t dsp_ringbuf_fill_none(struct dsp_ringbuf *buf, size_t size)
+{
+	return ACTS_RINGBUF_SIZE8(acts_ringbuf_spsc_fill_none(&buf->buf, ACTS_RINGBUF_NELEM(size)));
+}
+
 /**
  * @brief Reset a dsp ring buffer.
  *
@@ -25,6 +25,7 @@
 #include "stack_backtrace.h"
 #include <kernel.h>
 #include <ksched.h>
+#include <wait_q.h>
 
 #include <logging/sys_log.h>
 
@@ -51,12 +52,24 @@ int os_thread_create(char *stack, size_t stack_size,
 
 /**message function*/
 
-K_MBOX_DEFINE(global_mailbox);
+/*
+ * Each thread receives from its own queue in struct k_thread, one list
+ * per priority, so a send or a receive only touches the head or tail of
+ * one list. Messages sent to OS_ANY wait in a shared queue for the next
+ * thread that receives. Queues and the pool are short lists guarded by
+ * irq_lock, every operation is O(1) whatever the number of threads or
+ * pending messages, except coalescing which walks one priority list of
+ * one receiver, at most CONFIG_OS_MSG_MAX_PENDING messages.
+ */
 
 /** message pool */
 struct msg_info
 {
-	os_sem msg_sem;
+	sys_snode_t node;
+	/* taken from the pool, not yet received */
+	u8_t busy : 1;
+	/* on the stack of a sync sender */
+	u8_t sync : 1;
 #ifdef CONFIG_MESSAGE_DEBUG
 	char *sender;
 	char *receiver;
@@ -67,6 +80,8 @@ struct msg_info
 struct msg_pool
 {
 	int pool_size;
+	int free_num;
+	sys_slist_t free_list;
 	struct msg_info *pool;
 };
 
@@ -77,68 +92,196 @@ static struct msg_pool globle_msg_pool= {
 	.pool = (struct msg_info *)&msg_pool_buff,
 };
 
-static struct msg_info *msg_pool_get_free_msg_info(void)
+/* messages sent to OS_ANY */
+static sys_slist_t any_msg_q;
+
+/* receivers blocked in os_receive_msg, one is woken per message to OS_ANY */
+static sys_dlist_t any_msg_receivers;
+
+struct any_msg_receiver {
+	sys_dnode_t node;
+	struct k_thread *thread;
+	bool listed;
+};
+
+#ifdef CONFIG_MESSAGE_DEBUG
+static void msg_pool_dump_busy(void)
 {
 	struct msg_pool *pool = &globle_msg_pool;
-	struct msg_info *result = NULL;
+	static int flag = -1;
 
 	for (u8_t i = 0 ; i < pool->pool_size; i++) {
 		struct msg_info * msg_content = &pool->pool[i];
-		if (k_sem_take(&msg_content->msg_sem, OS_NO_WAIT) == 0) {
-			memset(&msg_content->msg, 0, sizeof(struct app_msg));
-			result = msg_content;
-			break;
-		} else 	{
-#ifdef CONFIG_MESSAGE_DEBUG
-			if(msg_pool_get_free_msg_num() < (CONFIG_NUM_MBOX_ASYNC_MSGS/5))
-			{
-				struct app_msg *msg = &msg_content->msg;
-				printk("busy msg: %d \n",i);
-				printk("--sender %s \n",msg_content->sender);
-				printk("--receiver %s \n",msg_content->receiver);
-				printk("--type %x \n",msg->type);
-				printk("--cmd %x \n",msg->cmd);
-				printk("--content %x \n",msg->value);
-			}
-#else
-		SYS_LOG_INF("buffer %d is busy \n",i);
+		struct app_msg *msg = &msg_content->msg;
+
+		if (!msg_content->busy)
+			continue;
+
+		printk("busy msg: %d \n",i);
+		printk("--sender %s \n",msg_content->sender);
+		printk("--receiver %s \n",msg_content->receiver);
+		printk("--type %x \n",msg->type);
+		printk("--cmd %x \n",msg->cmd);
+		printk("--content %x \n",msg->value);
+	}
+
+	if(++flag < 1)
+	{
+		show_all_threads_stack();
+	}
+}
 #endif
-		}
+
+static struct msg_info *msg_pool_get_free_msg_info(void)
+{
+	struct msg_pool *pool = &globle_msg_pool;
+	struct msg_info *result = NULL;
+	unsigned int key = irq_lock();
+
+	if (pool->free_num) {
+		result = CONTAINER_OF(sys_slist_get_not_empty(&pool->free_list),
+				      struct msg_info, node);
+		result->busy = 1;
+		pool->free_num--;
+	}
+
+	irq_unlock(key);
+
+	if (result) {
+		memset(&result->msg, 0, sizeof(struct app_msg));
 	}
 
 #ifdef CONFIG_MESSAGE_DEBUG
-	static int flag = -1;
-	if(msg_pool_get_free_msg_num() < (CONFIG_NUM_MBOX_ASYNC_MSGS/5))
+	if (pool->free_num < (CONFIG_NUM_MBOX_ASYNC_MSGS/5))
 	{
-		if(++flag < 1)
-		{
-			show_all_threads_stack();
-		}
+		msg_pool_dump_busy();
 	}
 #endif
-	
+
 	return result;
 }
 
-int msg_pool_get_free_msg_num(void)
+static void msg_pool_put_msg_info(struct msg_info *msg_content)
 {
 	struct msg_pool *pool = &globle_msg_pool;
-	int used_num = 0;
 	unsigned int key = irq_lock();
 
-	for (u8_t i = 0 ; i < pool->pool_size; i++) {
-		struct msg_info * msg_content = &pool->pool[i];
+	msg_content->busy = 0;
+	sys_slist_prepend(&pool->free_list, &msg_content->node);
+	pool->free_num++;
+
+	irq_unlock(key);
+}
+
+int msg_pool_get_free_msg_num(void)
+{
+	return globle_msg_pool.free_num;
+}
+
+static int msg_queue_put(os_tid_t receiver, struct msg_info *msg_content, int prio)
+{
+	struct k_thread *thread = (struct k_thread *)receiver;
+	struct any_msg_receiver *any;
+	struct k_thread *pending;
+	sys_dnode_t *node;
+	unsigned int key = irq_lock();
+
+	if (receiver == OS_ANY) {
+		sys_slist_append(&any_msg_q, &msg_content->node);
+
+		node = sys_dlist_get(&any_msg_receivers);
+		if (!node) {
+			irq_unlock(key);
+			return 0;
+		}
+
+		any = CONTAINER_OF(node, struct any_msg_receiver, node);
+		any->listed = false;
+		thread = any->thread;
+	} else {
+		if (!msg_content->sync && thread->msg_q_len >= CONFIG_OS_MSG_MAX_PENDING) {
+			irq_unlock(key);
+			return -ENOBUFS;
+		}
+
+		sys_slist_append(&thread->msg_q[prio], &msg_content->node);
+		thread->msg_q_len++;
+	}
 
-		if (os_sem_take(&msg_content->msg_sem, OS_NO_WAIT) != 0) {
-			used_num++;
+	pending = _unpend_first_thread(&thread->msg_wait_q);
+	if (pending) {
+		_abort_thread_timeout(pending);
+		_ready_thread(pending);
+		_set_thread_return_value(pending, 0);
+
+		if (_must_switch_threads()) {
+			_Swap(key);
+			return 0;
+		}
+	}
+
+	irq_unlock(key);
+	return 0;
+}
+
+/*
+ * Replace the latest pending async message of the same type if it has the
+ * same cmd, it keeps its place in the queue. A message of that type with
+ * another cmd after it, such as a disconnect between two connects, keeps
+ * the new one out so the receiver still sees the last state. Messages
+ * with a callback are never replaced, the callback may own the data.
+ */
+static bool msg_queue_coalesce(struct k_thread *thread, void *msg, int msg_size, int prio)
+{
+	struct app_msg *new_msg = msg;
+	struct msg_info *msg_content, *last = NULL;
+	unsigned int key = irq_lock();
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&thread->msg_q[prio], msg_content, node) {
+		if (msg_content->msg.type != new_msg->type)
+			continue;
+
+		if (msg_content->busy && !msg_content->msg.callback &&
+		    msg_content->msg.cmd == new_msg->cmd) {
+			last = msg_content;
 		} else {
-			os_sem_give(&msg_content->msg_sem);
+			last = NULL;
 		}
 	}
 
+	if (last) {
+		memcpy(&last->msg, msg, msg_size);
+	}
+
 	irq_unlock(key);
+	return last != NULL;
+}
+
+/*
+ * Take the next message of thread, then one sent to OS_ANY if any is set.
+ * Must be called with interrupts locked.
+ */
+static struct msg_info *msg_queue_get(struct k_thread *thread, bool any)
+{
+	sys_snode_t *node;
+	int prio;
+
+	for (prio = 0; prio < CONFIG_THREAD_MSG_QUEUE_PRIO; prio++) {
+		node = sys_slist_get(&thread->msg_q[prio]);
+		if (node) {
+			thread->msg_q_len--;
+			return CONTAINER_OF(node, struct msg_info, node);
+		}
+	}
+
+	if (!any)
+		return NULL;
+
+	node = sys_slist_get(&any_msg_q);
+	if (!node)
+		return NULL;
 
-	return pool->pool_size - used_num;
+	return CONTAINER_OF(node, struct msg_info, node);
 }
 
 static void os_sync_msg_callback(struct app_msg* msg, int result, void* not_used)
@@ -160,41 +303,54 @@ static void os_sync_msg_callback(struct app_msg* msg, int result, void* not_used
 
 int os_send_sync_msg(void *receiver, void *msg, int msg_size)
 {
-	os_mbox_msg send_msg;
-	struct app_msg msg_content;
+	struct msg_info msg_content;
 	struct k_sem sync_sem;
 	struct app_msg *tmp_msg = NULL;
 
 	__ASSERT(!_is_in_isr(),"send messag in isr");
 
-	memcpy(&msg_content, msg, msg_size);
-
-	tmp_msg = &msg_content;
-    tmp_msg->callback = os_sync_msg_callback;
-    tmp_msg->sync_sem = &sync_sem;
-    k_sem_init(&sync_sem, 0, UINT_MAX);
+	memset(&msg_content, 0, sizeof(msg_content));
+	memcpy(&msg_content.msg, msg, msg_size);
+	msg_content.sync = 1;
+#ifdef CONFIG_MESSAGE_DEBUG
+	msg_content.receiver = msg_manager_get_name_by_tid((int)receiver);
+	msg_content.sender = msg_manager_get_name_by_tid((int)os_current_get());
+#endif
 
-    /* prepare to send message */
-    send_msg.info = sizeof(struct app_msg);
-    send_msg.size = sizeof(struct app_msg);
-    send_msg.tx_data = &msg_content;
-    send_msg.tx_target_thread = (os_tid_t)receiver;
+	tmp_msg = &msg_content.msg;
+	tmp_msg->callback = os_sync_msg_callback;
+	tmp_msg->sync_sem = &sync_sem;
+	k_sem_init(&sync_sem, 0, UINT_MAX);
 
-    /* send message containing most current data and loop around */
-    os_mbox_put(&global_mailbox, &send_msg, OS_FOREVER);
+	msg_queue_put(receiver, &msg_content,
+		      min(OS_MSG_PRIO_NORMAL, CONFIG_THREAD_MSG_QUEUE_PRIO - 1));
 
-    os_sem_take(&sync_sem, OS_FOREVER);
+	/* the receiver calls back once the message is handled */
+	os_sem_take(&sync_sem, OS_FOREVER);
 
 	return 0;
 }
 
 int os_send_async_msg(void *receiver, void *msg, int msg_size)
 {
-	os_mbox_msg send_msg;
+	return os_send_async_msg_ex(receiver, msg, msg_size, OS_MSG_PRIO_NORMAL, 0);
+}
+
+int os_send_async_msg_ex(void *receiver, void *msg, int msg_size, int prio, u32_t flags)
+{
 	struct msg_info *msg_content;
-	
+	int ret;
+
 	__ASSERT(!_is_in_isr(),"send messag in isr");
 
+	prio = min(max(prio, 0), CONFIG_THREAD_MSG_QUEUE_PRIO - 1);
+
+	if ((flags & OS_MSG_COALESCE) && receiver != OS_ANY &&
+	    !((struct app_msg *)msg)->callback &&
+	    msg_queue_coalesce(receiver, msg, msg_size, prio)) {
+		return 0;
+	}
+
 	msg_content = msg_pool_get_free_msg_info();
 
 	if(!msg_content) {
@@ -211,69 +367,110 @@ int os_send_async_msg(void *receiver, void *msg, int msg_size)
 		msg_content->sender = (char *)os_current_get();
 	}
 #endif
-    /* prepare to send message */
-    send_msg.info = sizeof(struct app_msg);
-    send_msg.size = sizeof(struct app_msg);
-    send_msg.tx_data = &msg_content->msg;
-    send_msg.tx_target_thread = (os_tid_t)receiver;
 
-    /* send message containing most current data and loop around */
-    os_mbox_async_put(&global_mailbox, &send_msg, &msg_content->msg_sem);
+	ret = msg_queue_put(receiver, msg_content, prio);
+	if (ret) {
+		SYS_LOG_ERR("receiver %p has too many messages", receiver);
+		msg_pool_put_msg_info(msg_content);
+	}
 
-	return 0;
+	return ret;
 }
 
 int os_receive_msg(void *msg, int msg_size,int timeout)
 {
-	os_mbox_msg recv_msg;
-    char buffer[sizeof(struct app_msg)];
+	struct k_thread *thread = _current;
+	struct any_msg_receiver any = { .thread = thread };
+	struct msg_info *msg_content;
+	unsigned int key;
+	int ret;
+
+	key = irq_lock();
+
+	/*
+	 * Only this thread takes from its queue, one wakeup is one message.
+	 * Another receiver may take a message sent to OS_ANY first, then
+	 * this one waits again.
+	 */
+	while (!(msg_content = msg_queue_get(thread, true))) {
+		if (timeout == OS_NO_WAIT) {
+			irq_unlock(key);
+			return -ETIMEDOUT;
+		}
 
-	memset(buffer, 0, sizeof(struct app_msg));
+		sys_dlist_append(&any_msg_receivers, &any.node);
+		any.listed = true;
 
-	/* prepare to receive message */
-	recv_msg.info =  sizeof(struct app_msg);
-	recv_msg.size =  sizeof(struct app_msg);
-	recv_msg.rx_source_thread = OS_ANY;
+		_pend_current_thread(&thread->msg_wait_q, timeout);
+		ret = _Swap(key);
 
-    /* get a data item, waiting as long as needed */
-	if(os_mbox_get(&global_mailbox, &recv_msg, buffer, timeout))
-	{
-		//SYS_LOG_INF("no message");
-		return -ETIMEDOUT;
-	}
+		key = irq_lock();
+		if (any.listed) {
+			sys_dlist_remove(&any.node);
+			any.listed = false;
+		}
 
-	/* verify that message data was fully received */
-	if (recv_msg.info != recv_msg.size) {
-	    SYS_LOG_ERR("some message data dropped during transfer! \n ");
-	    SYS_LOG_ERR("sender tried to send %d bytes"
-					"only received %zu bytes receiver %p \n",
-					recv_msg.info ,recv_msg.size,os_current_get());
-	    return -EMSGSIZE;
+		if (ret) {
+			irq_unlock(key);
+			//SYS_LOG_INF("no message");
+			return -ETIMEDOUT;
+		}
 	}
 
+	irq_unlock(key);
+
 	/* copy msg from recvied buffer */
-	memcpy(msg, buffer, msg_size);
+	memcpy(msg, &msg_content->msg, min(msg_size, (int)sizeof(struct app_msg)));
+
+	if (msg_content->busy) {
+		msg_pool_put_msg_info(msg_content);
+	}
 
 	return 0;
 }
 
+/* messages sent to OS_ANY are left to the other receivers */
 void os_msg_clean(void)
 {
-	os_mbox_clear_msg(&global_mailbox);
+	struct msg_info *msg_content;
+	unsigned int key;
+
+	for (;;) {
+		key = irq_lock();
+		msg_content = msg_queue_get(_current, false);
+		irq_unlock(key);
+
+		if (!msg_content)
+			break;
+
+		if (msg_content->busy) {
+			msg_pool_put_msg_info(msg_content);
+		} else if (msg_content->sync) {
+			/* do not leave the sender waiting */
+			os_sem_give(msg_content->msg.sync_sem);
+		}
+	}
 }
 
+/* messages sent to this thread, not the ones sent to OS_ANY */
 int os_get_pending_msg_cnt(void)
 {
-	return k_mbox_get_pending_msg_cnt(&global_mailbox, os_current_get());
+	return _current->msg_q_len;
 }
 
 void os_msg_init(void)
 {
 	struct msg_pool *pool = &globle_msg_pool;
+
+	sys_slist_init(&pool->free_list);
+	sys_slist_init(&any_msg_q);
+	sys_dlist_init(&any_msg_receivers);
 	for (u8_t i = 0 ; i < pool->pool_size; i++) {
 		struct msg_info *msg_content = &pool->pool[i];
-		os_sem_init(&msg_content->msg_sem, 1, 1);
+		msg_content->busy = 0;
+		sys_slist_append(&pool->free_list, &msg_content->node);
 	}
+	pool->free_num = pool->pool_size;
 }
 
 static bool low_latency_mode = true;
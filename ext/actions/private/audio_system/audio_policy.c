@@ -53,6 +53,23 @@ int audio_policy_get_out_channel_mode(u8_t stream_type)
 	int out_channel_mode = AUDIO_DMA_MODE;
 
 	switch (stream_type) {
+#ifdef CONFIG_AUDIO_TRACK_RELOAD_PIPELINE
+	/* sco streams keep direct mode, their start sequence depends on it */
+	case AUDIO_STREAM_LINEIN:
+	case AUDIO_STREAM_SPDIF_IN:
+	case AUDIO_STREAM_FM:
+	case AUDIO_STREAM_I2SRX_IN:
+	case AUDIO_STREAM_MIC_IN:
+	case AUDIO_STREAM_MUSIC:
+	case AUDIO_STREAM_LOCAL_MUSIC:
+		out_channel_mode = AUDIO_DMA_MODE | AUDIO_DMA_RELOAD_MODE;
+		break;
+	case AUDIO_STREAM_TTS:
+	case AUDIO_STREAM_USOUND:
+	case AUDIO_STREAM_VOICE:
+		out_channel_mode = AUDIO_DMA_MODE;
+		break;
+#else
 	case AUDIO_STREAM_TTS:
 	case AUDIO_STREAM_LINEIN:
 	case AUDIO_STREAM_SPDIF_IN:
@@ -65,6 +82,7 @@ int audio_policy_get_out_channel_mode(u8_t stream_type)
 	case AUDIO_STREAM_VOICE:
 		out_channel_mode = AUDIO_DMA_MODE;
 		break;
+#endif
 	}
 	return out_channel_mode;
 }
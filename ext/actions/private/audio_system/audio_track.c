@@ -21,6 +21,7 @@
 #include <assert.h>
 #include <ringbuff_stream.h>
 #include <arithmetic.h>
+#include <pcm_dsp.h>
 
 #include <gpio.h>
 #include<device.h>
@@ -54,10 +55,6 @@ extern int media_fade_in_set(void *handle, int fade_time_ms);
 extern int media_fade_out_set(void *handle, int fade_time_ms);
 extern int media_fade_out_is_finished(void *handle);
 
-extern void *media_mix_open(u8_t sample_rate, u8_t channels, u8_t is_interweaved);
-extern void media_mix_close(void *handle);
-extern int media_mix_process(void *handle, void *inout_buf[2], void *mix_buf,
-			     int samples);
 
 static int _aduio_track_update_output_samples(struct audio_track_t *handle, u32_t length)
 {
@@ -96,22 +93,15 @@ static int _audio_track_data_mix(struct audio_track_t *handle, s16_t *src_buff,
 		};
 
 		/* 1) consume remain samples */
-		if (handle->mix_handle && dest_buff == src_buff) {
-			media_mix_process(handle->mix_handle, (void **)&dest_buff, mix_buff[0], mix_samples);
-			dest_buff += track_channels * mix_samples;
-			src_buff += track_channels * mix_samples;
+		if (track_channels > 1) {
+			pcm_mix_planar_q15(dest_buff, src_buff, handle->track_gain,
+					mix_buff[0], mix_buff[1], handle->mix_gain, mix_samples);
 		} else {
-			if (track_channels > 1) {
-				for (int i = 0; i < mix_samples; i++) {
-					*dest_buff++ = (*src_buff++) / 2 + mix_buff[0][i] / 2;
-					*dest_buff++ = (*src_buff++) / 2 + mix_buff[1][i] / 2;
-				}
-			} else {
-				for (int i = 0; i < mix_samples; i++) {
-					*dest_buff++ = (*src_buff++) / 2 + mix_buff[0][i] / 2;
-				}
-			}
+			pcm_mix_q15(dest_buff, src_buff, handle->track_gain,
+					mix_buff[0], handle->mix_gain, mix_samples);
 		}
+		dest_buff += track_channels * mix_samples;
+		src_buff += track_channels * mix_samples;
 
 		handle->res_remain_samples -= mix_samples;
 		samples -= mix_samples;
@@ -147,6 +137,45 @@ static int _audio_track_data_mix(struct audio_track_t *handle, s16_t *src_buff,
 	return mix_num;
 }
 
+/*
+ * DAC0 writes complete synchronously, so pcm can be sent straight from the
+ * track stream storage (a wrap takes 2 dma transfers) instead of being
+ * staged through pcm_frame_buff first. The claims go through the stream,
+ * which accounts the read and wakes the writer as stream_read does.
+ * Streams without in place access return 0, the caller then reads.
+ */
+static int _audio_track_write_from_stream(struct audio_track_t *audio_track, int len)
+{
+	void *data;
+	int claim, sent = 0;
+
+	if (stream_get_length(audio_track->audio_stream) < len)
+		return 0;
+
+	while (sent < len) {
+		claim = stream_read_claim(audio_track->audio_stream, &data, len - sent);
+		if (claim <= 0)
+			break;
+
+#if FADE_OUT_TIME_MS > 0
+		if (audio_track->flushed && audio_track->fade_handle) {
+			int samples = audio_track->audio_mode == AUDIO_MODE_MONO ?
+						claim / 2 : claim / 4;
+			media_fade_process(audio_track->fade_handle, &data, samples);
+		}
+#endif
+
+		hal_aout_channel_write_data(audio_track->audio_handle, data, claim);
+		stream_read_commit(audio_track->audio_stream, claim);
+		sent += claim;
+	}
+
+	if (sent > 0)
+		_aduio_track_update_output_samples(audio_track, sent);
+
+	return sent;
+}
+
 int audio_track_calc_bt_time(bt_clock_t *bt_clock, bt_clock_t *pre_bt_clock,int count)
 {
 	int rel_time;
@@ -163,6 +192,45 @@ int audio_track_calc_bt_time(bt_clock_t *bt_clock, bt_clock_t *pre_bt_clock,int
 }
 
 
+/* trim audio pll so that dac output follows the sco clock */
+static void _audio_track_adjust_aps(struct audio_track_t *audio_track,
+		bt_clock_t *bt_clock, bt_clock_t *bt_sco_clock, int count)
+{
+	s32_t bt_diff = 0;
+	u8_t level = audio_track->current_level;
+
+	if(!audio_track->count){
+		audio_track->count = 2;//first irq is 7.5ms
+		bt_diff =audio_track_calc_bt_time(bt_clock,bt_sco_clock,audio_track->count/2 - count);
+		audio_track->rel_diff = bt_diff;
+		printk("first %d us\n",audio_track->rel_diff);
+	}else{
+		audio_track->count++;
+		if(audio_track->count % 2 == 0){
+			bt_diff =audio_track_calc_bt_time(bt_clock,bt_sco_clock,audio_track->count/2 - count);
+
+			if (bt_diff > audio_track->rel_diff) {
+				//to quick
+				level++;
+				if (level <= APS_LEVEL_6) {
+					audio_track->current_level = level;
+					hal_aout_channel_set_aps(audio_track->audio_handle, audio_track->current_level, APS_LEVEL_AUDIOPLL);
+				}
+			} else if (bt_diff < audio_track->rel_diff){
+				//to low
+				level--;
+				if (level >= APS_LEVEL_4) {
+					audio_track->current_level = level;
+					hal_aout_channel_set_aps(audio_track->audio_handle, audio_track->current_level, APS_LEVEL_AUDIOPLL);
+				}
+			} else {
+				audio_track->current_level = APS_LEVEL_5;
+				hal_aout_channel_set_aps(audio_track->audio_handle, audio_track->current_level, APS_LEVEL_AUDIOPLL);
+			}
+		}
+	}
+}
+
 static int _audio_track_request_more_data(void *handle, u32_t reason)
 {
 	static u8_t printk_cnt;
@@ -174,44 +242,12 @@ static int _audio_track_request_more_data(void *handle, u32_t reason)
 	bt_clock_t bt_clock;
 	bt_clock_t bt_sco_clock;
 	int count;
-
-	s32_t bt_diff = 0;
-	u8_t level = audio_track->current_level;
+	bool sent = false;
 
 	if (bt_manager_tws_is_hfp_mode()) {
 		bt_manager_tws_get_bt_clock(&bt_clock);
 		bt_manager_tws_get_sco_bt_clk(&bt_sco_clock,&count);
-		if(!audio_track->count){
-			audio_track->count = 2;//first irq is 7.5ms
-			bt_diff =audio_track_calc_bt_time(&bt_clock,&bt_sco_clock,audio_track->count/2 - count);
-			audio_track->rel_diff = bt_diff;
-			printk("first %d us\n",audio_track->rel_diff);
-		}else{
-			audio_track->count++;
-			if(audio_track->count % 2 == 0){
-				bt_diff =audio_track_calc_bt_time(&bt_clock,&bt_sco_clock,audio_track->count/2 - count);
-
-				if (bt_diff > audio_track->rel_diff) {
-					//to quick
-					level++;
-					if (level <= APS_LEVEL_6) {
-						audio_track->current_level = level;
-						hal_aout_channel_set_aps(audio_track->audio_handle, audio_track->current_level, APS_LEVEL_AUDIOPLL);
-					}
-				} else if (bt_diff < audio_track->rel_diff){
-					//to low
-					level--;
-					if (level >= APS_LEVEL_4) {
-						audio_track->current_level = level;
-						hal_aout_channel_set_aps(audio_track->audio_handle, audio_track->current_level, APS_LEVEL_AUDIOPLL);
-					}
-				} else {
-					audio_track->current_level = APS_LEVEL_5;
-					hal_aout_channel_set_aps(audio_track->audio_handle, audio_track->current_level, APS_LEVEL_AUDIOPLL);
-				}
-			}
-		}
-
+		_audio_track_adjust_aps(audio_track, &bt_clock, &bt_sco_clock, count);
 	}
 
 	if (reload_mode) {
@@ -277,6 +313,12 @@ static int _audio_track_request_more_data(void *handle, u32_t reason)
 		}
 	}
 
+	if (!reload_mode && !audio_track->muted && audio_track->channel_id == AOUT_FIFO_DAC0
+		&& _audio_track_write_from_stream(audio_track, read_len) == read_len) {
+		sent = true;
+		goto exit;
+	}
+
 	ret = stream_read(audio_track->audio_stream, buf, read_len);
 	if (ret != read_len) {
 		memset(buf, 0, read_len);
@@ -296,7 +338,7 @@ static int _audio_track_request_more_data(void *handle, u32_t reason)
 
 
 exit:
-	if (!reload_mode && read_len > 0) {
+	if (!reload_mode && read_len > 0 && !sent) {
 #if FADE_OUT_TIME_MS > 0
 		if (audio_track->flushed && audio_track->fade_handle) {
 			int samples = audio_track->audio_mode == AUDIO_MODE_MONO ?
@@ -313,31 +355,11 @@ exit:
 		/**local music max send 3K pcm data */
 		if (audio_track->stream_type == AUDIO_STREAM_LOCAL_MUSIC) {
 			if (stream_get_length(audio_track->audio_stream) > audio_track->pcm_frame_size) {
-				stream_read(audio_track->audio_stream, buf, audio_track->pcm_frame_size);
-				_aduio_track_update_output_samples(audio_track, audio_track->pcm_frame_size);
-#if FADE_OUT_TIME_MS > 0
-				if (audio_track->flushed && audio_track->fade_handle) {
-					int samples = audio_track->audio_mode == AUDIO_MODE_MONO ?
-								audio_track->pcm_frame_size / 2 : audio_track->pcm_frame_size / 4;
-					media_fade_process(audio_track->fade_handle, (void **)&buf, samples);
-				}
-#endif
-				hal_aout_channel_write_data(audio_track->audio_handle, buf, audio_track->pcm_frame_size);
-				
+				_audio_track_write_from_stream(audio_track, audio_track->pcm_frame_size);
 			}
 
 			if (stream_get_length(audio_track->audio_stream) > audio_track->pcm_frame_size) {
-				stream_read(audio_track->audio_stream, buf, audio_track->pcm_frame_size);
-				_aduio_track_update_output_samples(audio_track, audio_track->pcm_frame_size);
-#if FADE_OUT_TIME_MS > 0
-				if (audio_track->flushed && audio_track->fade_handle) {
-					int samples = audio_track->audio_mode == AUDIO_MODE_MONO ?
-								audio_track->pcm_frame_size / 2 : audio_track->pcm_frame_size / 4;
-					media_fade_process(audio_track->fade_handle, (void **)&buf, samples);
-				}
-#endif
-				hal_aout_channel_write_data(audio_track->audio_handle, buf, audio_track->pcm_frame_size);
-				
+				_audio_track_write_from_stream(audio_track, audio_track->pcm_frame_size);
 			}
 		}
 
@@ -351,6 +373,275 @@ exit:
 	return 0;
 }
 
+#ifdef CONFIG_AUDIO_TRACK_IRQ_STATS
+static struct audio_track_irq_stats track_irq_stats;
+
+static void _audio_track_irq_stats_update(u32_t cycles)
+{
+	struct audio_track_irq_stats *stats = &track_irq_stats;
+
+	if (!stats->count || cycles < stats->min_cycles)
+		stats->min_cycles = cycles;
+	if (cycles > stats->max_cycles)
+		stats->max_cycles = cycles;
+
+	stats->total_cycles += cycles;
+	stats->count++;
+}
+#endif
+
+#ifdef CONFIG_AUDIO_TRACK_RELOAD_PIPELINE
+/*
+ * In reload mode dma plays pcm_frame_buff as two periods. The dma irq only
+ * marks the half it has just played as free and wakes the pipe thread,
+ * which prepares the next period there while dma plays the other half.
+ * Mix and fade in are already applied when pcm is written to the track.
+ */
+struct audio_track_pipe {
+	struct audio_track_t *track;
+	/* track playing from reload_pcm_buff, from create to destroy */
+	struct audio_track_t *owner;
+	os_sem sem;
+	os_mutex mutex;
+	/* halves played by dma and not refilled yet */
+	u8_t free_mask;
+	/* half dma has played last */
+	u8_t last_half;
+	/* sco clocks captured by the irqs not handled yet */
+	u8_t hfp_pending;
+	/* dma irqs taken, flush waits on it to drain the queued periods */
+	u32_t irq_count;
+	int sco_count;
+	bt_clock_t bt_clock;
+	bt_clock_t bt_sco_clock;
+};
+
+static struct audio_track_pipe track_pipe;
+static struct _k_thread_stack_element __aligned(STACK_ALIGN)
+	track_pipe_stack[CONFIG_AUDIO_TRACK_PIPELINE_STACKSIZE];
+
+static int _audio_track_pipe_irq(struct audio_track_t *audio_track, u32_t reason)
+{
+	u8_t half = (reason == AOUT_DMA_IRQ_HF) ? 0 : 1;
+
+	/* dma went on with a half the thread has not refilled in time */
+	if (track_pipe.free_mask & BIT(half ^ 1)) {
+#ifdef CONFIG_AUDIO_TRACK_IRQ_STATS
+		track_irq_stats.underrun++;
+#endif
+	}
+
+	track_pipe.free_mask |= BIT(half);
+	track_pipe.last_half = half;
+	track_pipe.irq_count++;
+
+	if (bt_manager_tws_is_hfp_mode()) {
+		bt_manager_tws_get_bt_clock(&track_pipe.bt_clock);
+		bt_manager_tws_get_sco_bt_clk(&track_pipe.bt_sco_clock, &track_pipe.sco_count);
+		track_pipe.hfp_pending++;
+	}
+
+	os_sem_give(&track_pipe.sem);
+	return 0;
+}
+
+static void _audio_track_pipe_fill(struct audio_track_t *audio_track, u8_t *buf, int len)
+{
+	SYS_IRQ_FLAGS flags;
+	int fill = 0, drop = 0, ret;
+
+	if (!bt_manager_tws_is_hfp_mode()) {
+		sys_irq_lock(&flags);
+		if (audio_track->compensate_samples > 0) {
+			/* insert data */
+			fill = min(audio_track->compensate_samples, len);
+			audio_track->compensate_samples -= fill;
+		} else if (audio_track->compensate_samples < 0) {
+			/* drop data */
+			drop = min(-audio_track->compensate_samples, len);
+			if (stream_get_length(audio_track->audio_stream) >= drop * 2)
+				audio_track->compensate_samples += drop;
+			else
+				drop = 0;
+		}
+		sys_irq_unlock(&flags);
+
+		if (fill > 0) {
+			memset(buf, 0, fill);
+			audio_track->fill_cnt += fill;
+		} else if (drop > 0) {
+			stream_read(audio_track->audio_stream, buf, drop);
+			_aduio_track_update_output_samples(audio_track, drop);
+			audio_track->fill_cnt -= drop;
+		}
+	}
+
+	buf += fill;
+	len -= fill;
+	if (len <= 0)
+		return;
+
+	if (len > stream_get_length(audio_track->audio_stream) && !audio_track->flushed) {
+		memset(buf, 0, len);
+		audio_track->fill_cnt += len;
+		return;
+	}
+
+	ret = stream_read(audio_track->audio_stream, buf, len);
+	if (ret < 0)
+		ret = 0;
+	if (ret > 0)
+		_aduio_track_update_output_samples(audio_track, ret);
+	if (ret < len)
+		memset(buf + ret, 0, len - ret);
+
+	if (audio_track->muted) {
+		memset(buf, 0, len);
+		audio_track->fill_cnt += len;
+		return;
+	}
+
+#if FADE_OUT_TIME_MS > 0
+	if (audio_track->flushed && audio_track->fade_handle && ret > 0) {
+		int samples = audio_track->audio_mode == AUDIO_MODE_MONO ?
+				    ret / 2 : ret / 4;
+		media_fade_process(audio_track->fade_handle, (void **)&buf, samples);
+	}
+#endif
+}
+
+static void _audio_track_pipe_loop(void *p1, void *p2, void *p3)
+{
+	struct audio_track_t *audio_track;
+	bt_clock_t bt_clock, bt_sco_clock;
+	SYS_IRQ_FLAGS flags;
+	u8_t free_mask, half, hfp_pending;
+	int sco_count, period, i;
+
+	while (1) {
+		os_sem_take(&track_pipe.sem, OS_FOREVER);
+
+		os_mutex_lock(&track_pipe.mutex, OS_FOREVER);
+
+		audio_track = track_pipe.track;
+		if (!audio_track) {
+			os_mutex_unlock(&track_pipe.mutex);
+			continue;
+		}
+
+		sys_irq_lock(&flags);
+		free_mask = track_pipe.free_mask;
+		half = track_pipe.last_half;
+		hfp_pending = track_pipe.hfp_pending;
+		track_pipe.hfp_pending = 0;
+		bt_clock = track_pipe.bt_clock;
+		bt_sco_clock = track_pipe.bt_sco_clock;
+		sco_count = track_pipe.sco_count;
+		sys_irq_unlock(&flags);
+
+		while (hfp_pending--)
+			_audio_track_adjust_aps(audio_track, &bt_clock, &bt_sco_clock, sco_count);
+
+		/* the half played last goes out next, prepare it first */
+		period = audio_track->pcm_frame_size / 2;
+		for (i = 0; i < 2; i++, half ^= 1) {
+			if (!(free_mask & BIT(half)))
+				continue;
+
+			_audio_track_pipe_fill(audio_track,
+				audio_track->pcm_frame_buff + half * period, period);
+
+			sys_irq_lock(&flags);
+			track_pipe.free_mask &= ~BIT(half);
+			sys_irq_unlock(&flags);
+		}
+
+		os_mutex_unlock(&track_pipe.mutex);
+	}
+}
+
+static void _audio_track_pipe_attach(struct audio_track_t *audio_track)
+{
+	static bool pipe_inited;
+
+	if (!pipe_inited) {
+		os_sem_init(&track_pipe.sem, 0, 2);
+		os_mutex_init(&track_pipe.mutex);
+		os_thread_create((char *)track_pipe_stack, sizeof(track_pipe_stack),
+				_audio_track_pipe_loop, NULL, NULL, NULL,
+				CONFIG_AUDIO_TRACK_PIPELINE_PRIORITY, 0, OS_NO_WAIT);
+		pipe_inited = true;
+	}
+
+	os_mutex_lock(&track_pipe.mutex, OS_FOREVER);
+	track_pipe.free_mask = 0;
+	track_pipe.hfp_pending = 0;
+	track_pipe.track = audio_track;
+	track_pipe.owner = audio_track;
+	os_mutex_unlock(&track_pipe.mutex);
+}
+
+/* once this returns the pipe thread no longer touches the track */
+static void _audio_track_pipe_detach(struct audio_track_t *audio_track)
+{
+	os_mutex_lock(&track_pipe.mutex, OS_FOREVER);
+	if (track_pipe.track == audio_track)
+		track_pipe.track = NULL;
+	os_mutex_unlock(&track_pipe.mutex);
+}
+
+/*
+ * Lets dma play the periods the thread has already queued, then detaches
+ * the track so that the stream can be closed. Called by flush once the
+ * stream is drained, so anything filled from here on is silence.
+ */
+static void _audio_track_pipe_drain(struct audio_track_t *audio_track)
+{
+	u32_t irq_count;
+	int try_cnt = 0;
+
+	/* wait for the thread to finish the period it may be filling */
+	os_mutex_lock(&track_pipe.mutex, OS_FOREVER);
+	if (track_pipe.track != audio_track) {
+		os_mutex_unlock(&track_pipe.mutex);
+		return;
+	}
+	irq_count = track_pipe.irq_count;
+	os_mutex_unlock(&track_pipe.mutex);
+
+	/* both halves are played once two more dma irqs came in */
+	while (audio_track->stared && track_pipe.irq_count - irq_count < 2
+			&& try_cnt++ < 100) {
+		os_sleep(2);
+	}
+
+	_audio_track_pipe_detach(audio_track);
+
+	/* halves not refilled yet still hold played pcm, do not repeat it */
+	memset(audio_track->pcm_frame_buff, 0, audio_track->pcm_frame_size);
+}
+#endif /* CONFIG_AUDIO_TRACK_RELOAD_PIPELINE */
+
+static int _audio_track_dma_callback(void *handle, u32_t reason)
+{
+#ifdef CONFIG_AUDIO_TRACK_IRQ_STATS
+	u32_t start = k_cycle_get_32();
+#endif
+	int ret;
+
+#ifdef CONFIG_AUDIO_TRACK_RELOAD_PIPELINE
+	if (handle == track_pipe.track)
+		ret = _audio_track_pipe_irq(handle, reason);
+	else
+#endif
+		ret = _audio_track_request_more_data(handle, reason);
+
+#ifdef CONFIG_AUDIO_TRACK_IRQ_STATS
+	_audio_track_irq_stats_update(k_cycle_get_32() - start);
+#endif
+	return ret;
+}
+
 static void *_audio_track_init(struct audio_track_t *handle)
 {
 	audio_out_init_param_t aout_param = {0};
@@ -371,7 +662,7 @@ static void *_audio_track_init(struct audio_track_t *handle)
 
 	aout_param.sample_cnt_enable = 1;
 
-	aout_param.callback = _audio_track_request_more_data;
+	aout_param.callback = _audio_track_dma_callback;
 	aout_param.callback_data = handle;
 
 	if ((handle->channel_mode & AUDIO_DMA_RELOAD_MODE) == AUDIO_DMA_RELOAD_MODE) {
@@ -466,6 +757,8 @@ struct audio_track_t *audio_track_create(u8_t stream_type, int sample_rate,
 	audio_track->output_sample_rate = audio_system_get_output_sample_rate();
 	audio_track->count = 0;
 	audio_track->current_level = APS_LEVEL_5;
+	audio_track->track_gain = PCM_GAIN_UNITY;
+	audio_track->mix_gain = PCM_GAIN_UNITY;
 	audio_track->rel_diff = 0;
 
 
@@ -493,6 +786,15 @@ struct audio_track_t *audio_track_create(u8_t stream_type, int sample_rate,
 		audio_track->pcm_frame_size = (sample_rate <= 16) ? 480 : 1024;
 	}
 
+#ifdef CONFIG_AUDIO_TRACK_RELOAD_PIPELINE
+	/* reload_pcm_buff and the pipe thread serve a single track */
+	if ((audio_track->channel_mode & AUDIO_DMA_RELOAD_MODE) == AUDIO_DMA_RELOAD_MODE
+		&& track_pipe.owner) {
+		SYS_LOG_ERR("reload track %p still active", track_pipe.owner);
+		goto err_exit;
+	}
+#endif
+
 	audio_track->pcm_frame_buff = reload_pcm_buff;
 	if (!audio_track->pcm_frame_buff)
 		goto err_exit;
@@ -569,6 +871,11 @@ struct audio_track_t *audio_track_create(u8_t stream_type, int sample_rate,
 	SYS_LOG_DBG("output_sr : %d", audio_track->output_sample_rate);
 	SYS_LOG_DBG("volume : %d", audio_track->volume);
 	SYS_LOG_DBG("audio_stream : %p", audio_track->audio_stream);
+
+#ifdef CONFIG_AUDIO_TRACK_RELOAD_PIPELINE
+	if ((audio_track->channel_mode & AUDIO_DMA_RELOAD_MODE) == AUDIO_DMA_RELOAD_MODE)
+		_audio_track_pipe_attach(audio_track);
+#endif
 	audio_system_mutex_unlock();
 	return audio_track;
 
@@ -595,6 +902,12 @@ int audio_track_destory(struct audio_track_t *handle)
 		hal_aout_channel_close(handle->audio_handle);
 	}
 
+#ifdef CONFIG_AUDIO_TRACK_RELOAD_PIPELINE
+	_audio_track_pipe_detach(handle);
+	if (track_pipe.owner == handle)
+		track_pipe.owner = NULL;
+#endif
+
 	if (handle->audio_stream)
 		stream_destroy(handle->audio_stream);
 
@@ -774,6 +1087,10 @@ int audio_track_flush(struct audio_track_t *handle)
 	SYS_LOG_INF("try_cnt %d, left_len %d\n", try_cnt,
 			stream_get_length(handle->audio_stream));
 
+#ifdef CONFIG_AUDIO_TRACK_RELOAD_PIPELINE
+	_audio_track_pipe_drain(handle);
+#endif
+
 	audio_track_set_mix_stream(handle, NULL, 0, 1, AUDIO_STREAM_TTS);
 
 	if (handle->audio_stream) {
@@ -1006,11 +1323,6 @@ int audio_track_set_mix_stream(struct audio_track_t *handle, io_stream_t mix_str
 
 		handle->res_out_samples = 0;
 		handle->res_remain_samples = 0;
-
-		/* open mix: only support 1 mix channels */
-		if (handle->mix_channels == 1) {
-			handle->mix_handle = media_mix_open(handle->sample_rate, track_channels, 1);
-		}
 	}
 
 	handle->mix_stream = mix_stream;
@@ -1025,11 +1337,6 @@ int audio_track_set_mix_stream(struct audio_track_t *handle, io_stream_t mix_str
 			media_resample_hw_close(handle->res_handle);
 			handle->res_handle = NULL;
 		}
-
-		if (handle->mix_handle) {
-			media_mix_close(handle->mix_handle);
-			handle->mix_handle = NULL;
-		}
 	}
 
 	SYS_LOG_INF("mix_stream %p, sample_rate %d->%d\n",
@@ -1046,3 +1353,46 @@ io_stream_t audio_track_get_mix_stream(struct audio_track_t *handle)
 
 	return handle->mix_stream;
 }
+
+int audio_track_set_mix_gain(struct audio_track_t *handle, s16_t track_gain, s16_t mix_gain)
+{
+	assert(handle);
+
+	audio_system_mutex_lock();
+	handle->track_gain = track_gain;
+	handle->mix_gain = mix_gain;
+	audio_system_mutex_unlock();
+
+	return 0;
+}
+
+#ifdef CONFIG_AUDIO_TRACK_IRQ_STATS
+int audio_track_get_irq_stats(struct audio_track_irq_stats *stats, bool reset)
+{
+	SYS_IRQ_FLAGS flags;
+
+	sys_irq_lock(&flags);
+
+	if (stats)
+		*stats = track_irq_stats;
+
+	if (reset)
+		memset(&track_irq_stats, 0, sizeof(track_irq_stats));
+
+	sys_irq_unlock(&flags);
+	return 0;
+}
+
+void audio_track_dump_irq_stats(bool reset)
+{
+	struct audio_track_irq_stats stats;
+
+	audio_track_get_irq_stats(&stats, reset);
+
+	printk("audio track irq: %u calls, min %u max %u avg %u ns, underrun %u\n",
+		stats.count, SYS_CLOCK_HW_CYCLES_TO_NS(stats.min_cycles),
+		SYS_CLOCK_HW_CYCLES_TO_NS(stats.max_cycles),
+		stats.count ? SYS_CLOCK_HW_CYCLES_TO_NS((u32_t)(stats.total_cycles / stats.count)) : 0,
+		stats.underrun);
+}
+#endif
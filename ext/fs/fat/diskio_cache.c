@@ -5,15 +5,41 @@
 #include <string.h>
 #include <init.h>
 #include <os_common_api.h>
-#include <mem_manager.h>
 
 #define SYS_LOG_DOMAIN "diskio_cache"
 #define SYS_LOG_LEVEL SYS_LOG_LEVEL_INFO
 #include <logging/sys_log.h>
 
-#define DISKIO_TIMEOUT OS_FOREVER
-#define DISKIO_CACHE_POOL_NUM 1
-#define DISKIO_CACHE_POOL_SIZE 2048
+/*
+ * Set associative sector cache. A line caches DISKIO_CACHE_LINE_SIZE bytes
+ * starting at a line aligned sector, line n lives in set n % SETS and
+ * evicts the least recently used of the set's ways.
+ *
+ * Misses are loaded by the calling thread. Whole lines that miss are read
+ * or written straight between the disk and the caller buffer, so large
+ * transfers do not flush the cache. Partial writes stay dirty in the cache
+ * and are written back when evicted, on flush or by the cache thread once
+ * half of the lines are dirty. Write back merges dirty neighbours of the
+ * same way, which are contiguous in memory, into one multi sector write.
+ *
+ * A read starting where the previous one ended queues the following lines
+ * for the cache thread to prefetch.
+ */
+
+#define DISKIO_CACHE_LINE_SIZE		CONFIG_DISKIO_CACHE_LINE_SIZE
+#define DISKIO_CACHE_SETS		CONFIG_DISKIO_CACHE_SETS
+#define DISKIO_CACHE_WAYS		CONFIG_DISKIO_CACHE_WAYS
+#define DISKIO_CACHE_LINES		(DISKIO_CACHE_SETS * DISKIO_CACHE_WAYS)
+#define DISKIO_CACHE_READAHEAD		CONFIG_DISKIO_CACHE_READAHEAD_LINES
+/*
+ * background write back starts at this number of dirty lines, a small
+ * cache leaves writing to eviction and flush until all lines are dirty
+ */
+#define DISKIO_CACHE_DIRTY_HIGH		(DISKIO_CACHE_LINES > 2 ? DISKIO_CACHE_LINES - 1 : 2)
+#define DISKIO_PREFETCH_QUEUE_SIZE	(4)
+
+BUILD_ASSERT((DISKIO_CACHE_SETS & (DISKIO_CACHE_SETS - 1)) == 0);
+BUILD_ASSERT(DISKIO_CACHE_READAHEAD <= DISKIO_PREFETCH_QUEUE_SIZE);
 
 static char __in_section_unique(diskio.cache.stack) __aligned(STACK_ALIGN) diskio_cache_thread_stack[1152];
 
@@ -21,148 +47,253 @@ OS_MUTEX_DEFINE(diskio_cache_mutex);
 
 struct  diskio_cache_item {
 	u32_t cache_valid:1;
-	u32_t busy_flag:1;
 	u32_t write_valid:1;
-	u32_t err_flag:1;
-	u32_t disk_type:8;
+	/* sector of the first byte of the line, line aligned */
 	u32_t cache_sector;
+	u32_t lru_stamp;
 	struct disk_info *disk;
-	u8_t  cache_data[DISKIO_CACHE_POOL_SIZE];
 };
 
-enum {
-	REQ_FLUSH,
-	REQ_LOAD,
-};
-
-
-struct  diskio_cache_req {
-	void *fifo_reserved;
-	struct disk_info *req_disk;
-	u8_t  req_type;
-	u32_t req_sector;
-	os_sem req_sem;
+struct  diskio_prefetch_req {
+	struct disk_info *disk;
+	u32_t sector;
 };
 
 struct  diskio_cache_context {
-	os_fifo cache_req_fifo;
+	os_sem thread_sem;
 	u8_t terminal:1;
 	u8_t inited:1;
-	u8_t cache_index;
+	u8_t prefetch_num;
+	u16_t dirty_num;
+	u32_t lru_clock;
 	u32_t thread_id;
-	struct  diskio_cache_item cache_pool[DISKIO_CACHE_POOL_NUM];
+
+	/* end of the last read, a read starting there is sequential */
+	struct disk_info *seq_disk;
+	u32_t seq_next_sector;
+
+	struct  diskio_prefetch_req prefetch[DISKIO_PREFETCH_QUEUE_SIZE];
+	struct  diskio_cache_item cache_pool[DISKIO_CACHE_WAYS][DISKIO_CACHE_SETS];
+	/* lines of a way are contiguous, so are sequential lines of a way */
+	u8_t cache_data[DISKIO_CACHE_WAYS][DISKIO_CACHE_SETS][DISKIO_CACHE_LINE_SIZE] __aligned(4);
 };
 
 struct  diskio_cache_context diskio_cache __in_section_unique(diskio.cache.pool);
 
-static struct  diskio_cache_item *_diskio_find_cache_item(struct disk_info *disk, DWORD sector, UINT count)
+static inline u32_t _diskio_line_sectors(struct disk_info *disk)
 {
-	struct  diskio_cache_item *cache_item = NULL;
-	u8_t cace_sector_cnt = DISKIO_CACHE_POOL_SIZE / disk->sector_size;
-
-	for (int i = 0; i < DISKIO_CACHE_POOL_NUM; i++) {
-		if (diskio_cache.cache_pool[i].cache_sector <= sector
-			&& diskio_cache.cache_pool[i].disk == disk
-			&& diskio_cache.cache_pool[i].cache_sector + cace_sector_cnt >= sector + count
-			&& diskio_cache.cache_pool[i].cache_valid == 1){
-			cache_item = &diskio_cache.cache_pool[i];
+	return DISKIO_CACHE_LINE_SIZE / disk->sector_size;
+}
+
+static inline u32_t _diskio_line_set(struct disk_info *disk, u32_t line_sector)
+{
+	return (line_sector / _diskio_line_sectors(disk)) & (DISKIO_CACHE_SETS - 1);
+}
+
+static inline u8_t *_diskio_line_data(int way, u32_t set)
+{
+	return diskio_cache.cache_data[way][set];
+}
+
+static int _diskio_find_way(struct disk_info *disk, u32_t line_sector)
+{
+	u32_t set = _diskio_line_set(disk, line_sector);
+	struct  diskio_cache_item *cache_item;
+
+	for (int way = 0; way < DISKIO_CACHE_WAYS; way++) {
+		cache_item = &diskio_cache.cache_pool[way][set];
+		if (cache_item->cache_valid
+			&& cache_item->disk == disk
+			&& cache_item->cache_sector == line_sector) {
+			return way;
 		}
 	}
 
-	return cache_item;
+	return -1;
 }
 
-static void _diskio_cache_invalid(struct disk_info *disk, DWORD sector, UINT count)
+static void _diskio_touch(struct  diskio_cache_item *cache_item)
 {
-	struct  diskio_cache_item *cache_item = NULL;
-	u8_t cace_sector_cnt = DISKIO_CACHE_POOL_SIZE / disk->sector_size;
-
-	for (int i = 0; i < DISKIO_CACHE_POOL_NUM; i++) {
-		if (diskio_cache.cache_pool[i].cache_sector  +  cace_sector_cnt >= sector
-			&& diskio_cache.cache_pool[i].cache_sector < sector + count
-			&& diskio_cache.cache_pool[i].disk == disk
-			&& diskio_cache.cache_pool[i].cache_valid == 1){
-			cache_item = &diskio_cache.cache_pool[i];
-			if (cache_item->write_valid) {
-				if (cache_item->disk->op->write(cache_item->disk, cache_item->cache_data, cache_item->cache_sector,
-							cace_sector_cnt)) {
-					SYS_LOG_ERR("sector %d len %d\n", cache_item->cache_sector, cace_sector_cnt);
-				}
-			}
-			cache_item->cache_valid = 0;
-			cache_item->write_valid = 0;
-		}
+	cache_item->lru_stamp = ++diskio_cache.lru_clock;
+}
+
+static void _diskio_mark_dirty(struct  diskio_cache_item *cache_item)
+{
+	if (!cache_item->write_valid) {
+		cache_item->write_valid = 1;
+		diskio_cache.dirty_num++;
+
+		if (diskio_cache.dirty_num == DISKIO_CACHE_DIRTY_HIGH)
+			os_sem_give(&diskio_cache.thread_sem);
 	}
 }
 
-static struct  diskio_cache_item *_diskio_new_cache_item(struct disk_info *disk, DWORD sector)
+static inline bool _diskio_run_next(struct  diskio_cache_item *cache_item,
+		struct  diskio_cache_item *next_item, u32_t line_sectors)
 {
-	struct  diskio_cache_item *cache_item = NULL;
-	u8_t cace_sector_cnt = DISKIO_CACHE_POOL_SIZE / disk->sector_size;
+	return cache_item->cache_valid && cache_item->write_valid
+		&& next_item->cache_valid && next_item->write_valid
+		&& next_item->disk == cache_item->disk
+		&& next_item->cache_sector == cache_item->cache_sector + line_sectors;
+}
 
-	os_mutex_lock(&diskio_cache_mutex, OS_FOREVER);
-	cache_item = &diskio_cache.cache_pool[diskio_cache.cache_index++];
-	diskio_cache.cache_index = diskio_cache.cache_index % DISKIO_CACHE_POOL_NUM;
+/* write back a dirty line together with its dirty neighbours of the same way */
+static int _diskio_write_back(int way, u32_t set)
+{
+	struct  diskio_cache_item *pool = diskio_cache.cache_pool[way];
+	struct disk_info *disk = pool[set].disk;
+	u32_t line_sectors = _diskio_line_sectors(disk);
+	u32_t first = set, last = set;
+	int ret;
+
+	while (first > 0 && _diskio_run_next(&pool[first - 1], &pool[first], line_sectors))
+		first--;
+
+	while (last + 1 < DISKIO_CACHE_SETS && _diskio_run_next(&pool[last], &pool[last + 1], line_sectors))
+		last++;
+
+	ret = disk->op->write(disk, _diskio_line_data(way, first), pool[first].cache_sector,
+			(last - first + 1) * line_sectors);
+	if (ret) {
+		SYS_LOG_ERR("sector %d len %d\n", pool[first].cache_sector,
+			(last - first + 1) * line_sectors);
+		return ret;
+	}
 
-	if (cache_item->write_valid && cache_item->cache_valid) {
-		if (cache_item->disk->op->write(cache_item->disk, cache_item->cache_data, cache_item->cache_sector,
-					cace_sector_cnt)) {
-			SYS_LOG_ERR("sector %d len %d\n", cache_item->cache_sector, cace_sector_cnt);
+	for (u32_t i = first; i <= last; i++) {
+		pool[i].write_valid = 0;
+		diskio_cache.dirty_num--;
+	}
+
+	return 0;
+}
+
+static int _diskio_flush_lines(struct disk_info *disk)
+{
+	int ret = 0;
+
+	for (int way = 0; way < DISKIO_CACHE_WAYS; way++) {
+		for (u32_t set = 0; set < DISKIO_CACHE_SETS; set++) {
+			struct  diskio_cache_item *cache_item = &diskio_cache.cache_pool[way][set];
+
+			if (cache_item->cache_valid && cache_item->write_valid
+				&& (!disk || cache_item->disk == disk)) {
+				if (_diskio_write_back(way, set))
+					ret = -EIO;
+			}
+		}
+	}
+
+	return ret;
+}
+
+/* pick the way of the set to replace, written back if dirty */
+static int _diskio_new_cache_item(struct disk_info *disk, u32_t line_sector)
+{
+	u32_t set = _diskio_line_set(disk, line_sector);
+	struct  diskio_cache_item *cache_item;
+	int victim = 0;
+
+	for (int way = 0; way < DISKIO_CACHE_WAYS; way++) {
+		cache_item = &diskio_cache.cache_pool[way][set];
+		if (!cache_item->cache_valid) {
+			victim = way;
+			break;
 		}
 
+		if ((s32_t)(cache_item->lru_stamp - diskio_cache.cache_pool[victim][set].lru_stamp) < 0)
+			victim = way;
 	}
 
-	cache_item->cache_valid = 1;
-	cache_item->cache_sector = sector;
-	cache_item->disk = disk;
+	cache_item = &diskio_cache.cache_pool[victim][set];
+	if (cache_item->cache_valid && cache_item->write_valid) {
+		if (_diskio_write_back(victim, set))
+			return -EIO;
+	}
+
+	cache_item->cache_valid = 0;
 	cache_item->write_valid = 0;
-	cache_item->err_flag = 0;
-	cache_item->busy_flag = 0;
-	os_mutex_unlock(&diskio_cache_mutex);
-	return cache_item;
+	cache_item->disk = disk;
+	cache_item->cache_sector = line_sector;
+
+	return victim;
 }
 
-static int _diskio_load_to_cache_req(struct disk_info *disk, DWORD sector)
+/* bring a line in the cache, loaded from disk */
+static int _diskio_get_line(struct disk_info *disk, u32_t line_sector)
 {
-	struct  diskio_cache_req  *cache_req = mem_malloc(sizeof(struct  diskio_cache_req));
-
-	os_sem_init(&cache_req->req_sem, 0, 1);
+	struct  diskio_cache_item *cache_item;
+	int way;
 
-	cache_req->req_disk = disk;
-	cache_req->req_sector = sector;
-	cache_req->req_type = REQ_LOAD;
+	way = _diskio_find_way(disk, line_sector);
+	if (way >= 0)
+		return way;
 
-	os_fifo_put(&diskio_cache.cache_req_fifo, cache_req);
+	way = _diskio_new_cache_item(disk, line_sector);
+	if (way < 0)
+		return way;
 
-	if (os_sem_take(&cache_req->req_sem, DISKIO_TIMEOUT) == -EAGAIN) {
-		SYS_LOG_ERR("timeout");
-		mem_free(cache_req);
-		return -EAGAIN;
+	if (disk->op->read(disk, _diskio_line_data(way, _diskio_line_set(disk, line_sector)),
+			line_sector, _diskio_line_sectors(disk))) {
+		SYS_LOG_ERR("load sector %d failed\n", line_sector);
+		return -EIO;
 	}
 
-	mem_free(cache_req);
-	return 0;
+	cache_item = &diskio_cache.cache_pool[way][_diskio_line_set(disk, line_sector)];
+	cache_item->cache_valid = 1;
+	return way;
 }
 
-static int _diskio_flush_cache_req(struct disk_info *disk)
+/* number of whole lines from line_sector on that are not cached, at most max */
+static u32_t _diskio_miss_run(struct disk_info *disk, u32_t line_sector, u32_t max)
 {
-	struct  diskio_cache_req  *cache_req = mem_malloc(sizeof(struct  diskio_cache_req));
+	u32_t line_sectors = _diskio_line_sectors(disk);
+	u32_t n = 0;
 
-	os_sem_init(&cache_req->req_sem, 0, 1);
+	while (n < max && _diskio_find_way(disk, line_sector + n * line_sectors) < 0)
+		n++;
 
-	cache_req->req_disk = disk;
-	cache_req->req_type = REQ_FLUSH;
+	return n;
+}
 
-	os_fifo_put(&diskio_cache.cache_req_fifo, cache_req);
+static bool _diskio_prefetch_queued(struct disk_info *disk, u32_t line_sector)
+{
+	for (int i = 0; i < diskio_cache.prefetch_num; i++) {
+		if (diskio_cache.prefetch[i].disk == disk
+			&& diskio_cache.prefetch[i].sector == line_sector)
+			return true;
+	}
 
-	if (os_sem_take(&cache_req->req_sem, DISKIO_TIMEOUT) == -EAGAIN) {
-		SYS_LOG_ERR("timeout");
-		mem_free(cache_req);
-		return -EAGAIN;
+	return false;
+}
+
+static void _diskio_readahead(struct disk_info *disk, u32_t sector, u32_t count)
+{
+	u32_t line_sectors = _diskio_line_sectors(disk);
+	u32_t next = ROUND_UP(sector + count, line_sectors);
+	bool queued = false;
+
+	if (diskio_cache.seq_disk == disk && diskio_cache.seq_next_sector == sector) {
+		for (int i = 0; i < DISKIO_CACHE_READAHEAD; i++, next += line_sectors) {
+			if (disk->sector_cnt && next + line_sectors > disk->sector_offset + disk->sector_cnt)
+				break;
+			if (diskio_cache.prefetch_num >= DISKIO_PREFETCH_QUEUE_SIZE)
+				break;
+			if (_diskio_find_way(disk, next) >= 0 || _diskio_prefetch_queued(disk, next))
+				continue;
+
+			diskio_cache.prefetch[diskio_cache.prefetch_num].disk = disk;
+			diskio_cache.prefetch[diskio_cache.prefetch_num].sector = next;
+			diskio_cache.prefetch_num++;
+			queued = true;
+		}
 	}
 
-	mem_free(cache_req);
-	return 0;
+	diskio_cache.seq_disk = disk;
+	diskio_cache.seq_next_sector = sector + count;
+
+	if (queued)
+		os_sem_give(&diskio_cache.thread_sem);
 }
 
 int diskio_cache_read(
@@ -173,40 +304,59 @@ int diskio_cache_read(
 	DWORD sector,		/* Start sector in LBA */
 	UINT count		/* Number of sectors to read */)
 {
-	int ret = 0;
-	struct  diskio_cache_item *cache_item = NULL;
+	u32_t line_sectors, line_sector, offset, num, run;
+	u32_t start_sector = sector, start_count = count;
+	int way, ret = 0;
 
-	if (!diskio_cache.inited
-			|| count * disk->sector_size > DISKIO_CACHE_POOL_SIZE) {
-		if (diskio_cache.inited) {
-			_diskio_cache_invalid(disk, sector, count);
-		}
+	if (!diskio_cache.inited || DISKIO_CACHE_LINE_SIZE % disk->sector_size) {
 		return disk->op->read(disk, buff, sector, count);
 	}
 
-try_to_read:
+	line_sectors = _diskio_line_sectors(disk);
+
 	os_mutex_lock(&diskio_cache_mutex, OS_FOREVER);
-	cache_item = _diskio_find_cache_item(disk, sector, count);
-	/**cache hit */
-	if (cache_item) {
-		cache_item->busy_flag = 1;
-		if (!cache_item->err_flag) {
-			memcpy(buff, cache_item->cache_data
-					+ (sector - cache_item->cache_sector) * disk->sector_size,
-					count * disk->sector_size);
-			ret = 0;
-		} else {
-			cache_item->cache_valid = 0;
-			ret = -EIO;
+
+	while (count > 0) {
+		line_sector = sector - sector % line_sectors;
+		offset = sector - line_sector;
+		num = min(line_sectors - offset, count);
+
+		way = _diskio_find_way(disk, line_sector);
+
+		/* whole lines not cached go straight to the caller buffer */
+		if (way < 0 && offset == 0 && num == line_sectors) {
+			run = _diskio_miss_run(disk, line_sector, count / line_sectors);
+			ret = disk->op->read(disk, buff, sector, run * line_sectors);
+			if (ret)
+				break;
+
+			buff += run * line_sectors * disk->sector_size;
+			sector += run * line_sectors;
+			count -= run * line_sectors;
+			continue;
+		}
+
+		if (way < 0) {
+			way = _diskio_get_line(disk, line_sector);
+			if (way < 0) {
+				ret = way;
+				break;
+			}
 		}
-		cache_item->busy_flag = 0;
+
+		_diskio_touch(&diskio_cache.cache_pool[way][_diskio_line_set(disk, line_sector)]);
+		memcpy(buff, _diskio_line_data(way, _diskio_line_set(disk, line_sector))
+				+ offset * disk->sector_size, num * disk->sector_size);
+
+		buff += num * disk->sector_size;
+		sector += num;
+		count -= num;
 	}
+
+	if (!ret && DISKIO_CACHE_READAHEAD > 0)
+		_diskio_readahead(disk, start_sector, start_count);
+
 	os_mutex_unlock(&diskio_cache_mutex);
-	/**cache miss */
-	if (!cache_item) {
-		_diskio_load_to_cache_req(disk, sector);
-		goto try_to_read;
-	}
 
 	return ret;
 }
@@ -219,139 +369,148 @@ int diskio_cache_write(
 	DWORD sector,		/* Start sector in LBA */
 	UINT count		/* Number of sectors to write */)
 {
-	int ret = 0;
-	struct  diskio_cache_item *cache_item = NULL;
+	u32_t line_sectors, line_sector, offset, num, run;
+	int way, ret = 0;
 
-	if (!diskio_cache.inited
-			|| count * disk->sector_size > DISKIO_CACHE_POOL_SIZE) {
-		if (diskio_cache.inited) {
-			_diskio_cache_invalid(disk, sector, count);
-		}
+	if (!diskio_cache.inited || DISKIO_CACHE_LINE_SIZE % disk->sector_size) {
 		return disk->op->write(disk, buff, sector, count);
 	}
 
-try_to_write:
+	line_sectors = _diskio_line_sectors(disk);
+
 	os_mutex_lock(&diskio_cache_mutex, OS_FOREVER);
 
-	cache_item = _diskio_find_cache_item(disk, sector, count);
-	/**cache hit */
-	if (cache_item) {
-		cache_item->busy_flag = 1;
-		if (!cache_item->err_flag) {
-			memcpy(cache_item->cache_data
-					+ (sector - cache_item->cache_sector) * disk->sector_size,
-					buff, count * disk->sector_size);
-			cache_item->write_valid = 1;
-			ret = 0;
-		} else {
-			cache_item->cache_valid = 0;
-			ret = -EIO;
+	while (count > 0) {
+		line_sector = sector - sector % line_sectors;
+		offset = sector - line_sector;
+		num = min(line_sectors - offset, count);
+
+		way = _diskio_find_way(disk, line_sector);
+
+		/* whole lines not cached are written through */
+		if (way < 0 && offset == 0 && num == line_sectors) {
+			run = _diskio_miss_run(disk, line_sector, count / line_sectors);
+			ret = disk->op->write(disk, buff, sector, run * line_sectors);
+			if (ret)
+				break;
+
+			buff += run * line_sectors * disk->sector_size;
+			sector += run * line_sectors;
+			count -= run * line_sectors;
+			continue;
 		}
-		cache_item->busy_flag = 0;
-	}
 
-	os_mutex_unlock(&diskio_cache_mutex);
+		if (way < 0) {
+			way = _diskio_get_line(disk, line_sector);
+			if (way < 0) {
+				ret = way;
+				break;
+			}
+		}
 
-	/**cache miss */
-	if (!cache_item) {
-		_diskio_load_to_cache_req(disk, sector);
-		goto try_to_write;
+		memcpy(_diskio_line_data(way, _diskio_line_set(disk, line_sector))
+				+ offset * disk->sector_size, buff, num * disk->sector_size);
+		_diskio_touch(&diskio_cache.cache_pool[way][_diskio_line_set(disk, line_sector)]);
+		_diskio_mark_dirty(&diskio_cache.cache_pool[way][_diskio_line_set(disk, line_sector)]);
+
+		buff += num * disk->sector_size;
+		sector += num;
+		count -= num;
 	}
 
+	os_mutex_unlock(&diskio_cache_mutex);
+
 	return ret;
 }
 
 int diskio_cache_flush(struct disk_info *disk)
 {
-	return _diskio_flush_cache_req(disk);
+	int ret;
+
+	if (!diskio_cache.inited)
+		return 0;
+
+	os_mutex_lock(&diskio_cache_mutex, OS_FOREVER);
+	ret = _diskio_flush_lines(disk);
+	os_mutex_unlock(&diskio_cache_mutex);
+
+	return ret;
 }
 
 int diskio_cache_invalid(struct disk_info *disk)
 {
 	struct  diskio_cache_item *cache_item = NULL;
+
 	os_mutex_lock(&diskio_cache_mutex, OS_FOREVER);
-	for (int i = 0; i < DISKIO_CACHE_POOL_NUM; i++) {
-		if (diskio_cache.cache_pool[i].disk == disk
-			&& diskio_cache.cache_pool[i].cache_valid == 1) {
-			cache_item = &diskio_cache.cache_pool[i];
-			cache_item->cache_valid = 0;
-			cache_item->write_valid = 0;
+	for (int way = 0; way < DISKIO_CACHE_WAYS; way++) {
+		for (int set = 0; set < DISKIO_CACHE_SETS; set++) {
+			cache_item = &diskio_cache.cache_pool[way][set];
+			if (cache_item->disk == disk && cache_item->cache_valid == 1) {
+				if (cache_item->write_valid)
+					diskio_cache.dirty_num--;
+				cache_item->cache_valid = 0;
+				cache_item->write_valid = 0;
+			}
 		}
 	}
+
+	for (int i = 0; i < diskio_cache.prefetch_num; i++) {
+		if (diskio_cache.prefetch[i].disk == disk)
+			diskio_cache.prefetch[i].disk = NULL;
+	}
+
+	if (diskio_cache.seq_disk == disk)
+		diskio_cache.seq_disk = NULL;
 	os_mutex_unlock(&diskio_cache_mutex);
 	return 0;
 }
 
 static void _diskio_cache_thread_loop(void *p1, void *p2, void *p3)
 {
-	int ret = 0;
 	struct  diskio_cache_context *diskio_cache_ctx = (struct  diskio_cache_context *)p1;
+	struct  diskio_prefetch_req req;
 
 	while (!diskio_cache_ctx->terminal) {
-		struct  diskio_cache_req  *cache_req = NULL;
-		struct  diskio_cache_item *cache_item  = NULL;
-		struct disk_info *disk = NULL;
+		os_sem_take(&diskio_cache_ctx->thread_sem, OS_FOREVER);
 
-		cache_req = os_fifo_get(&diskio_cache.cache_req_fifo, OS_FOREVER);
-		if (!cache_req) {
-			continue;
-		}
-		os_mutex_lock(&diskio_cache_mutex, OS_FOREVER);
-		switch (cache_req->req_type) {
-		case REQ_LOAD:
-		{
-			cache_item = _diskio_new_cache_item(cache_req->req_disk, cache_req->req_sector);
-			disk = cache_req->req_disk;
-			if (cache_item) {
-				ret = disk->op->read(disk, cache_item->cache_data, cache_req->req_sector,
-									 DISKIO_CACHE_POOL_SIZE / disk->sector_size);
-				if (ret) {
-					cache_item->err_flag = 1;
-				}
-				cache_item->cache_valid = 1;
+		/* one line per lock, so that demand reads wait for one load at most */
+		for (;;) {
+			os_mutex_lock(&diskio_cache_mutex, OS_FOREVER);
+
+			if (!diskio_cache_ctx->prefetch_num) {
+				os_mutex_unlock(&diskio_cache_mutex);
+				break;
 			}
 
-			break;
-		}
-		case REQ_FLUSH:
-		{
-			for (int i = 0; i < DISKIO_CACHE_POOL_NUM; i++) {
-				if (diskio_cache.cache_pool[i].disk == cache_req->req_disk
-					&& diskio_cache.cache_pool[i].cache_valid == 1
-					&& diskio_cache.cache_pool[i].write_valid == 1) {
-
-					cache_item = &diskio_cache.cache_pool[i];
-					disk = cache_req->req_disk;
-
-					ret = disk->op->write(disk, cache_item->cache_data,
-								cache_item->cache_sector,
-								DISKIO_CACHE_POOL_SIZE / disk->sector_size);
-
-					if (ret) {
-						SYS_LOG_ERR("sector %d len %d\n", cache_item->cache_sector, DISKIO_CACHE_POOL_SIZE);
-					} else {
-						cache_item->write_valid = 0;
-					}
-				}
+			req = diskio_cache_ctx->prefetch[0];
+			diskio_cache_ctx->prefetch_num--;
+			memmove(&diskio_cache_ctx->prefetch[0], &diskio_cache_ctx->prefetch[1],
+					diskio_cache_ctx->prefetch_num * sizeof(req));
+
+			if (req.disk && _diskio_get_line(req.disk, req.sector) >= 0) {
+				_diskio_touch(&diskio_cache_ctx->cache_pool
+					[_diskio_find_way(req.disk, req.sector)]
+					[_diskio_line_set(req.disk, req.sector)]);
 			}
 
-			break;
-		}
-		default:
-			break;
+			os_mutex_unlock(&diskio_cache_mutex);
 		}
+
+		os_mutex_lock(&diskio_cache_mutex, OS_FOREVER);
+		if (diskio_cache_ctx->dirty_num >= DISKIO_CACHE_DIRTY_HIGH)
+			_diskio_flush_lines(NULL);
 		os_mutex_unlock(&diskio_cache_mutex);
-		os_sem_give(&cache_req->req_sem);
 	}
 }
+
 int diskio_cache_init(struct device *unused)
 {
 	ARG_UNUSED(unused);
 
 	memset(&diskio_cache, 0, sizeof(struct diskio_cache_context));
 
-	os_fifo_init(&diskio_cache.cache_req_fifo);
-	
+	os_sem_init(&diskio_cache.thread_sem, 0, 1);
+
 	diskio_cache.thread_id = os_thread_create(diskio_cache_thread_stack,
 											sizeof(diskio_cache_thread_stack),
 											_diskio_cache_thread_loop,
@@ -370,5 +529,3 @@ int diskio_cache_deinit(void)
 }
 
 SYS_INIT(diskio_cache_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
-
-
@@ -3389,6 +3389,8 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 		if (1 << fs->win[BPB_BytsPerSecEx] != SS(fs))	/* (BPB_BytsPerSecEx must be equal to the physical sector size) */
 			return FR_NO_FILESYSTEM;
 
+		fs->vsn = ld_dword(fs->win + BPB_VolIDEx);		/* Volume serial number */
+
 		maxlba = ld_qword(fs->win + BPB_TotSecEx) + bsect;	/* Last LBA + 1 of the volume */
 		if (maxlba >= 0x100000000) return FR_NO_FILESYSTEM;	/* (It cannot be handled in 32-bit LBA) */
 
@@ -3455,6 +3457,8 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 		if (nclst <= MAX_FAT16) fmt = FS_FAT16;
 		if (nclst <= MAX_FAT12) fmt = FS_FAT12;
 
+		fs->vsn = ld_dword(fs->win + (fmt == FS_FAT32 ? BS_VolID32 : BS_VolID));	/* Volume serial number */
+
 		/* Boundaries and Limits */
 		fs->n_fatent = nclst + 2;							/* Number of FAT entries */
 		fs->volbase = bsect;								/* Volume start sector */
@@ -4574,9 +4578,11 @@ FRESULT f_lseek (
 					ofs -= bcs; fp->fptr += bcs;
 #if !_FS_READONLY
 					if (fp->flag & FA_WRITE) {			/* Check if in write mode or not */
-						if (fp->fptr > fp->obj.objsize) {	/* No FAT chain object needs correct objsize to generate FAT value */
-							fp->obj.objsize = fp->fptr;
-							fp->flag |= FA_MODIFIED;
+						if (fp->fptr >= fp->obj.objsize) {	/* A chain may end at a cluster aligned size */
+							if (fp->fptr > fp->obj.objsize) {	/* No FAT chain object needs correct objsize to generate FAT value */
+								fp->obj.objsize = fp->fptr;
+								fp->flag |= FA_MODIFIED;
+							}
 							clst = create_chain(&fp->obj, clst);	/* Follow chain with forceed stretch */
 						} else {
 							clst = get_fat(&fp->obj, clst);	/* Follow cluster chain if not in write mode */
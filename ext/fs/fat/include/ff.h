@@ -130,6 +130,7 @@ typedef struct {
 	DWORD	cdc_ofs;		/* Offset in the containing directory (invalid when cdir is 0) */
 #endif
 #endif
+	DWORD	vsn;			/* Volume serial number */
 	DWORD	n_fatent;		/* Number of FAT entries (number of clusters + 2) */
 	DWORD	fsize;			/* Size of an FAT [sectors] */
 	DWORD	volbase;		/* Volume base sector */
@@ -11,11 +11,75 @@
 #include <ctype.h>
 
 
+#if CONFIG_SD_FS_CACHE_ENTRIES > 0
+/* recently found entries, key tones and tts are opened again and again */
+static struct sd_dir sd_dir_cache[CONFIG_SD_FS_CACHE_ENTRIES];
+static u8_t sd_dir_cache_next;
+
+static struct sd_dir * sd_cache_find(const char *filename, void *buf_size_32)
+{
+	unsigned int key;
+	int i;
+
+	key = irq_lock();
+	for (i = 0; i < CONFIG_SD_FS_CACHE_ENTRIES; i++) {
+		if (sd_dir_cache[i].fname[0] &&
+			strncasecmp(filename, (const char *)sd_dir_cache[i].fname, 12) == 0) {
+			memcpy(buf_size_32, &sd_dir_cache[i], sizeof(struct sd_dir));
+			irq_unlock(key);
+			return buf_size_32;
+		}
+	}
+	irq_unlock(key);
+
+	return NULL;
+}
+
+static void sd_cache_add(const struct sd_dir *sd_dir)
+{
+	unsigned int key;
+
+	key = irq_lock();
+	memcpy(&sd_dir_cache[sd_dir_cache_next], sd_dir, sizeof(*sd_dir));
+	if (++sd_dir_cache_next >= CONFIG_SD_FS_CACHE_ENTRIES)
+		sd_dir_cache_next = 0;
+	irq_unlock(key);
+}
+#endif
+
+/* binary search of a sorted image, return 0 if found */
+static int sd_sorted_find(const char *filename, struct sd_dir *sd_dir, int total)
+{
+	int low = 1, high = total, mid, res;
+
+	while (low <= high) {
+		mid = (low + high) / 2;
+		memcpy_flash_data(sd_dir, (void *)(CONFIG_SD_FS_VADDR_START + mid * sizeof(*sd_dir)),
+			sizeof(*sd_dir));
+
+		res = strncasecmp(filename, (const char *)sd_dir->fname, 12);
+		if (res == 0)
+			return 0;
+
+		if (res < 0)
+			high = mid - 1;
+		else
+			low = mid + 1;
+	}
+
+	return -ENOENT;
+}
+
 static struct sd_dir * sd_find_dir(const char *filename, void *buf_size_32)
 {
 	int num, total, offset;
 	struct sd_dir *sd_dir = buf_size_32;
 
+#if CONFIG_SD_FS_CACHE_ENTRIES > 0
+	if (sd_cache_find(filename, buf_size_32))
+		return sd_dir;
+#endif
+
 	memcpy_flash_data(buf_size_32, (void *)CONFIG_SD_FS_VADDR_START, sizeof(*sd_dir));
 
 	//printk("sd_dir->fname %s CONFIG_SD_FS_START 0x%x \n",sd_dir->fname,CONFIG_SD_FS_VADDR_START);
@@ -25,18 +89,31 @@ static struct sd_dir * sd_find_dir(const char *filename, void *buf_size_32)
 	}
 	total = sd_dir->offset;
 
+	/* images built without sorting are scanned */
+	if (sd_dir->reserved[0] == SD_DIR_SORTED) {
+		if (sd_sorted_find(filename, sd_dir, total))
+			return NULL;
+		goto found;
+	}
+
 	for(offset = CONFIG_SD_FS_VADDR_START + sizeof(*sd_dir), num = 0; num < total; offset += 32)
 	{
 		memcpy_flash_data(buf_size_32, (void *)offset, 32);
 
 		if(strncasecmp(filename, sd_dir->fname, 12) == 0)
 		{
-			return sd_dir;
+			goto found;
 		}
 		num++;
 	}
 
 	return NULL;
+
+found:
+#if CONFIG_SD_FS_CACHE_ENTRIES > 0
+	sd_cache_add(sd_dir);
+#endif
+	return sd_dir;
 }
 
 struct sd_file * sd_fopen (const char *filename)
@@ -147,34 +224,29 @@ int sd_fseek(struct sd_file *sd_file, int offset, unsigned char whence)
 
 int sd_fsize(const char *filename)
 {
-	struct sd_file *fd = sd_fopen(filename);
-	int file_size;
+	struct sd_dir sd_dir;
 
-	if (!fd) {
+	if (!sd_find_dir(filename, &sd_dir)) {
 		return -EINVAL;
 	}
 
-	file_size = fd->size;
-
-	sd_fclose(fd);
-
-	return file_size;
+	return sd_dir.size;
 }
 
 int sd_fmap(const char *filename, void** addr, int* len)
 {
-	struct sd_file *fd = sd_fopen(filename);
-	if (!fd) {
+	struct sd_dir sd_dir;
+
+	/* no sd_file needed, nothing to allocate */
+	if (!sd_find_dir(filename, &sd_dir)) {
 		return -EINVAL;
 	}
 
 	if (addr)
-		*addr = (void *)fd->start;
+		*addr = (void *)(sd_dir.offset + CONFIG_SD_FS_VADDR_START);
 
 	if (len)
-		*len = fd->size;
-
-	sd_fclose(fd);
+		*len = sd_dir.size;
 
 	return 0;
 }
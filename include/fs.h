@@ -276,6 +276,23 @@ int fs_truncate(fs_file_t *zfp, off_t length);
  */
 int fs_trunc_quick(fs_file_t *zfp, off_t length);
 
+/**
+ * @brief Allocate space for an open file without writing it
+ *
+ * Grows the file to length bytes for later writes in place, the new
+ * space is not cleared. An empty file gets one contiguous run of
+ * clusters when the volume has one, a longer file is grown from its
+ * last cluster. The file position is kept and fast seek is disabled.
+ *
+ * @param zfp Pointer to the file object
+ * @param length New size of the file in bytes, not below the current size
+ *
+ * @retval 0 Success
+ * @retval -ENOSPC not enough free space, the file may have grown less
+ * @retval -ERRNO errno code if error
+ */
+int fs_expand(fs_file_t *zfp, off_t length);
+
 /**
  * @brief Flushes any cached write of an open file
  *
@@ -390,6 +407,31 @@ int fs_opendir_cluster(fs_dir_t *zdp, const char *path, unsigned int cluster, un
 
 int fs_open_cluster(fs_file_t *zfp, char *dir, u32_t cluster, u32_t blk_ofs);
 
+/**
+ * @brief Enable fast seek on an open file
+ *
+ * Builds the cluster link map of the file, seeks then find the cluster
+ * of an offset in the map instead of following the cluster chain from
+ * the start of the file. The map takes 8 bytes per contiguous fragment
+ * of the file and is freed on close. A write past the end of the file
+ * or a truncate disables fast seek.
+ *
+ * @param zfp Pointer to the file object
+ * @param max_fragments Largest number of fragments to map
+ *
+ * @retval 0 Success
+ * @retval -ENOMEM file has more than max_fragments fragments or no memory
+ * @retval -ERRNO errno code if error
+ */
+int fs_fastseek_enable(fs_file_t *zfp, int max_fragments);
+
+/**
+ * @brief Disable fast seek on an open file and free its cluster map
+ *
+ * @param zfp Pointer to the file object
+ */
+void fs_fastseek_disable(fs_file_t *zfp);
+
 /**
  * @}
  */
@@ -212,6 +212,24 @@ struct _thread_stack_info {
 typedef struct _thread_stack_info _thread_stack_info_t;
 #endif /* CONFIG_THREAD_STACK_INFO */
 
+#ifdef CONFIG_THREAD_TIMER
+#define _THREAD_TIMER_WHEEL_SLOTS	(1 << CONFIG_THREAD_TIMER_WHEEL_BITS)
+
+/* Timing wheel of the thread timers of a thread, see kernel/thread_timer.c */
+struct _thread_timer_q {
+	/* a slot of level n spans 2^(bits * n) ms */
+	sys_dlist_t slots[CONFIG_THREAD_TIMER_WHEEL_LEVELS][_THREAD_TIMER_WHEEL_SLOTS];
+	/* slots that may hold timers, cleared lazily */
+	u32_t pending[CONFIG_THREAD_TIMER_WHEEL_LEVELS];
+	/* timers started when their time was already handled */
+	sys_dlist_t due;
+	/* next ms of the wheel to handle */
+	u32_t time;
+	/* number of armed timers */
+	u16_t num;
+};
+#endif /* CONFIG_THREAD_TIMER */
+
 struct k_thread {
 
 	struct _thread_base base;
@@ -259,7 +277,15 @@ struct k_thread {
 #endif
 
 #ifdef CONFIG_THREAD_TIMER
-	sys_dlist_t thread_timer_q;
+	/* timing wheel, taken from a pool while the thread has timers */
+	struct _thread_timer_q *thread_timer_q;
+#endif
+
+#ifdef CONFIG_THREAD_MSG_QUEUE
+	/* messages sent to this thread, one list per priority, oldest first */
+	sys_slist_t msg_q[CONFIG_THREAD_MSG_QUEUE_PRIO];
+	_wait_q_t msg_wait_q;
+	u16_t msg_q_len;
 #endif
 	/* arch-specifics: must always be at the end */
 	struct _thread_arch arch;
@@ -16,8 +16,30 @@
 extern "C" {
 #endif
 
+/** one config of nvram_config_set_many(), len 0 deletes it */
+struct nvram_config_entry {
+	const char *name;
+	const void *data;
+	int len;
+};
+
 int nvram_config_get(const char *name, void *data, int max_len);
 int nvram_config_set(const char *name, const void *data, int len);
+
+/**
+ * @brief Set several user configs at once
+ *
+ * Configs whose data is unchanged are skipped. The rest are written
+ * back to back after making room for all of them, so the segment is
+ * purged at most once per call instead of once per config.
+ *
+ * @param entries configs to set, len 0 deletes a config
+ * @param num number of entries
+ *
+ * @return 0 on success, -EINVAL if an entry is invalid, nothing is
+ * written then
+ */
+int nvram_config_set_many(const struct nvram_config_entry *entries, int num);
 int nvram_config_clear(int len);
 int nvram_config_clear_all(void);
 void nvram_config_dump(void);
@@ -42,6 +42,13 @@ struct sd_dir
 	unsigned int reserved[2];
 	unsigned int checksum;
 };
+
+/*
+ * reserved[0] of the first sd_dir ("sdfs.bin") when build_sdfs.py sorted
+ * the entries after it by lower case name, 0 in older images.
+ */
+#define SD_DIR_SORTED	0x54524F53	/* "SORT" */
+
 #ifdef CONFIG_MEMORY
 #define sd_alloc mem_malloc
 #define sd_free mem_free
@@ -139,6 +139,49 @@ extern int thread_timer_next_timeout(void);
  */
 extern void thread_timer_handle_expired(void);
 
+#ifdef CONFIG_THREAD_TIMER_STATS
+/** thread timer statistics of all threads */
+struct thread_timer_stats {
+	/** timers started and not yet expired or stopped */
+	u32_t armed;
+	/** max armed timers seen */
+	u32_t max_armed;
+	/** expiry functions called */
+	u32_t expired;
+	/** wheel slots expired, each one is a batch of timers */
+	u32_t batches;
+	/** timers moved down a wheel level */
+	u32_t cascaded;
+	/** sum of expiry delays, in ms */
+	u32_t jitter_total_ms;
+	/** max expiry delay, in ms */
+	u32_t jitter_max_ms;
+	/** wheels taken by threads with timers */
+	u32_t wheels;
+	/** max wheels taken */
+	u32_t max_wheels;
+};
+
+/**
+ * @brief get thread timer statistics
+ *
+ * The expiry delay is the time from the expiry time of a timer to the
+ * call of its expiry function by the thread message looper.
+ *
+ * @param stats counters returned
+ *
+ * @return N/A
+ */
+extern void thread_timer_get_stats(struct thread_timer_stats *stats);
+
+/**
+ * @brief reset thread timer statistics
+ *
+ * @return N/A
+ */
+extern void thread_timer_reset_stats(void);
+#endif /* CONFIG_THREAD_TIMER_STATS */
+
 #else
 
 #define thread_timer_next_timeout()		(K_FOREVER)
@@ -188,7 +188,15 @@ static ALWAYS_INLINE void _new_thread_init(struct k_thread *thread,
 #endif
 
 #ifdef CONFIG_THREAD_TIMER
-	sys_dlist_init(&thread->thread_timer_q);
+	thread->thread_timer_q = NULL;
+#endif
+
+#ifdef CONFIG_THREAD_MSG_QUEUE
+	for (int i = 0; i < CONFIG_THREAD_MSG_QUEUE_PRIO; i++) {
+		sys_slist_init(&thread->msg_q[i]);
+	}
+	sys_dlist_init(&thread->msg_wait_q);
+	thread->msg_q_len = 0;
 #endif
 }
 
@@ -89,6 +89,14 @@ extern void _thread_monitor_exit(struct k_thread *thread);
 	} while (0)
 #endif /* CONFIG_THREAD_MONITOR */
 
+#ifdef CONFIG_THREAD_TIMER
+extern void _thread_timer_release(struct k_thread *thread);
+#else
+#define _thread_timer_release(thread) \
+	do {/* nothing */    \
+	} while (0)
+#endif /* CONFIG_THREAD_TIMER */
+
 #ifdef __cplusplus
 }
 #endif
@@ -223,6 +223,7 @@ static inline void handle_timeouts(s32_t ticks)
 {
 	sys_dlist_t expired;
 	unsigned int key;
+	s32_t late;
 
 	/* init before locking interrupts */
 	sys_dlist_init(&expired);
@@ -247,15 +248,18 @@ static inline void handle_timeouts(s32_t ticks)
 	 * pressure between each of them, allowing handling of higher priority
 	 * interrupts. We know that no new timeout will be prepended in front
 	 * of a timeout which delta is 0, since timeouts of 0 ticks are
-	 * prohibited.
+	 * prohibited. A late wakeup from tickless idle can announce more
+	 * ticks than the head had left: a negative delta is expired too and
+	 * the excess is carried to the next timeout.
 	 */
 	sys_dnode_t *next = &head->node;
 	struct _timeout *timeout = (struct _timeout *)next;
 
 	_handling_timeouts = 1;
 
-	while (timeout && timeout->delta_ticks_from_prev == 0) {
+	while (timeout && timeout->delta_ticks_from_prev <= 0) {
 
+		late = timeout->delta_ticks_from_prev;
 		sys_dlist_remove(next);
 
 		/*
@@ -271,6 +275,11 @@ static inline void handle_timeouts(s32_t ticks)
 
 		timeout->delta_ticks_from_prev = _EXPIRED;
 
+		next = sys_dlist_peek_head(&_timeout_q);
+		if (next) {
+			((struct _timeout *)next)->delta_ticks_from_prev += late;
+		}
+
 		irq_unlock(key);
 		key = irq_lock();
 
@@ -412,6 +412,7 @@ void _k_thread_single_abort(struct k_thread *thread)
 		}
 	}
 	_mark_thread_as_dead(thread);
+	_thread_timer_release(thread);
 }
 
 #ifdef CONFIG_MULTITHREADING
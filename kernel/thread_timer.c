@@ -9,16 +9,25 @@
  * @brief Kernel thread timer support
  *
  * This module provides thread timer support.
+ *
+ * The timers of a thread are kept in a hierarchical timing wheel, a slot
+ * of level n holds the timers of a 2^(bits * n) ms window. Start and stop
+ * link and unlink a timer in O(1). When the wheel time reaches a window,
+ * the timers of its higher level slot move down a level, and the timers
+ * of a level 0 slot all expire in one batch.
+ *
+ * The wheels come from a pool: a thread takes one when it starts its
+ * first timer and gives it back when its looper finds no timer left.
  */
 
 #include <kernel.h>
 #include <kernel_structs.h>
 #include <thread_timer.h>
+#include <misc/printk.h>
 
 #undef THREAD_TIMER_DEBUG
 
 #ifdef THREAD_TIMER_DEBUG
-#include <misc/printk.h>
 #define TT_DEBUG(fmt, ...) printk("[%d] thread %p: " fmt, k_uptime_get_32(), \
 				(void *)_current, ##__VA_ARGS__)
 #else
@@ -27,6 +36,96 @@
 
 #define compare_time(a, b) ((int)((u32_t)(a) - (u32_t)(b)))
 
+#define WHEEL_BITS		CONFIG_THREAD_TIMER_WHEEL_BITS
+#define WHEEL_LEVELS		CONFIG_THREAD_TIMER_WHEEL_LEVELS
+#define WHEEL_SLOTS		_THREAD_TIMER_WHEEL_SLOTS
+#define WHEEL_MASK		(WHEEL_SLOTS - 1)
+#define LEVEL_SHIFT(level)	((level) * WHEEL_BITS)
+#define LEVEL_SPAN(level)	(1 << LEVEL_SHIFT(level))
+
+/* farthest expiry time from the wheel time a timer is placed at */
+#define WHEEL_RANGE		(LEVEL_SPAN(WHEEL_LEVELS) - 1)
+
+static struct _thread_timer_q thread_timer_wheels[CONFIG_THREAD_TIMER_WHEELS];
+static u32_t thread_timer_wheels_used;
+
+#ifdef CONFIG_THREAD_TIMER_STATS
+static struct thread_timer_stats thread_timer_stats;
+
+static void _thread_timer_stats_armed(int num)
+{
+	unsigned int key = irq_lock();
+
+	thread_timer_stats.armed += num;
+	if (thread_timer_stats.armed > thread_timer_stats.max_armed)
+		thread_timer_stats.max_armed = thread_timer_stats.armed;
+
+	irq_unlock(key);
+}
+
+static void _thread_timer_stats_expired(int num, u32_t jitter_total, u32_t jitter_max)
+{
+	unsigned int key = irq_lock();
+
+	thread_timer_stats.expired += num;
+	thread_timer_stats.batches++;
+	thread_timer_stats.jitter_total_ms += jitter_total;
+	if (jitter_max > thread_timer_stats.jitter_max_ms)
+		thread_timer_stats.jitter_max_ms = jitter_max;
+
+	irq_unlock(key);
+}
+
+static void _thread_timer_stats_wheels(int num)
+{
+	unsigned int key = irq_lock();
+
+	thread_timer_stats.wheels += num;
+	if (thread_timer_stats.wheels > thread_timer_stats.max_wheels)
+		thread_timer_stats.max_wheels = thread_timer_stats.wheels;
+
+	irq_unlock(key);
+}
+
+static void _thread_timer_stats_cascaded(int num)
+{
+	unsigned int key = irq_lock();
+
+	thread_timer_stats.cascaded += num;
+
+	irq_unlock(key);
+}
+
+void thread_timer_get_stats(struct thread_timer_stats *stats)
+{
+	unsigned int key = irq_lock();
+
+	*stats = thread_timer_stats;
+
+	irq_unlock(key);
+}
+
+void thread_timer_reset_stats(void)
+{
+	unsigned int key = irq_lock();
+	u32_t armed = thread_timer_stats.armed;
+	u32_t wheels = thread_timer_stats.wheels;
+
+	memset(&thread_timer_stats, 0, sizeof(thread_timer_stats));
+	thread_timer_stats.armed = armed;
+	thread_timer_stats.max_armed = armed;
+	thread_timer_stats.wheels = wheels;
+	thread_timer_stats.max_wheels = wheels;
+
+	irq_unlock(key);
+}
+#else
+#define _thread_timer_stats_armed(num)				do { } while (0)
+#define _thread_timer_stats_expired(num, total, max)		do { } while (0)
+#define _thread_timer_stats_wheels(num)				do { } while (0)
+#define _thread_timer_stats_cascaded(num)			do { } while (0)
+#endif
+
 #ifdef CONFIG_THREAD_TIMER_DEBUG
 static void _dump_thread_timer(struct thread_timer *ttimer)
 {
@@ -43,46 +142,317 @@ static void _dump_thread_timer(struct thread_timer *ttimer)
 
 void _dump_thread_timer_q(void)
 {
-	sys_dlist_t *thread_timer_q = &_current->thread_timer_q;
+	struct _thread_timer_q *q = _current->thread_timer_q;
 	struct thread_timer *ttimer;
+	int level, slot;
 
-	printk("thread: %p, thread_timer_q: %p, head: %p, tail: %p\n",
-		_current, thread_timer_q, thread_timer_q->head,
-		thread_timer_q->tail);
+	if (!q) {
+		printk("thread: %p, no thread timer\n", _current);
+		return;
+	}
+
+	printk("thread: %p, thread_timer_q: %p, time: %u, num: %d\n",
+		_current, q, q->time, q->num);
 
-	SYS_DLIST_FOR_EACH_CONTAINER(thread_timer_q, ttimer, node) {
+	SYS_DLIST_FOR_EACH_CONTAINER(&q->due, ttimer, node) {
+		printk("due: ");
 		_dump_thread_timer(ttimer);
 	}
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		for (slot = 0; slot < WHEEL_SLOTS; slot++) {
+			SYS_DLIST_FOR_EACH_CONTAINER(&q->slots[level][slot], ttimer, node) {
+				printk("level %d slot %d: ", level, slot);
+				_dump_thread_timer(ttimer);
+			}
+		}
+	}
 }
 #endif
 
+/*
+ * A timer not in a wheel has its node pointing to itself, or still zeroed
+ * when it is not initialized yet. A timer left in the wheel of an exited
+ * thread is no longer pointed to by its neighbours.
+ */
+static inline bool _thread_timer_is_linked(struct thread_timer *ttimer)
+{
+	sys_dnode_t *node = &ttimer->node;
+
+	return node->next != NULL && node->next != node &&
+	       node->next->prev == node && node->prev->next == node;
+}
+
+static void _thread_timer_unlink(struct thread_timer *ttimer)
+{
+	sys_dlist_remove(&ttimer->node);
+	sys_dlist_init(&ttimer->node);
+}
+
+/* take a wheel from the pool for the first timer of a thread */
+static struct _thread_timer_q *_thread_timer_q_get(struct k_thread *thread)
+{
+	struct _thread_timer_q *q = thread->thread_timer_q;
+	unsigned int key;
+	int i, j;
+
+	if (q)
+		return q;
+
+	key = irq_lock();
+	i = find_lsb_set(~thread_timer_wheels_used) - 1;
+	if (i < 0 || i >= CONFIG_THREAD_TIMER_WHEELS) {
+		irq_unlock(key);
+		printk("thread %p: no thread timer wheel left\n", thread);
+		__ASSERT(0, "no thread timer wheel left");
+		return NULL;
+	}
+	thread_timer_wheels_used |= BIT(i);
+	irq_unlock(key);
+
+	q = &thread_timer_wheels[i];
+	for (i = 0; i < WHEEL_LEVELS; i++) {
+		for (j = 0; j < WHEEL_SLOTS; j++)
+			sys_dlist_init(&q->slots[i][j]);
+		q->pending[i] = 0;
+	}
+	sys_dlist_init(&q->due);
+	q->num = 0;
+
+	thread->thread_timer_q = q;
+	_thread_timer_stats_wheels(1);
+
+	return q;
+}
+
+/*
+ * Give the wheel back. The timers left in it by an exited thread may be
+ * freed already, they are not touched: the lists are initialized again
+ * when the wheel is taken.
+ */
+static void _thread_timer_q_put(struct k_thread *thread)
+{
+	struct _thread_timer_q *q = thread->thread_timer_q;
+	unsigned int key;
+
+	if (!q)
+		return;
+
+	if (q->num)
+		_thread_timer_stats_armed(-q->num);
+
+	thread->thread_timer_q = NULL;
+
+	key = irq_lock();
+	thread_timer_wheels_used &= ~BIT(q - thread_timer_wheels);
+	irq_unlock(key);
+
+	_thread_timer_stats_wheels(-1);
+}
+
+/* called when a thread is aborted */
+void _thread_timer_release(struct k_thread *thread)
+{
+	_thread_timer_q_put(thread);
+}
+
+static void _thread_timer_place(struct _thread_timer_q *q, struct thread_timer *ttimer)
+{
+	u32_t expiry_time = ttimer->expiry_time;
+	int delta = compare_time(expiry_time, q->time);
+	int level = 0;
+	int slot;
+
+	if (delta < 0) {
+		/* its time is handled already, expires on the next call */
+		sys_dlist_append(&q->due, &ttimer->node);
+		return;
+	}
+
+	if (delta > WHEEL_RANGE) {
+		/* parked at the end of the wheel, placed again from there */
+		delta = WHEEL_RANGE;
+		expiry_time = q->time + WHEEL_RANGE;
+	}
+
+	while (level < WHEEL_LEVELS - 1 && delta >= LEVEL_SPAN(level + 1))
+		level++;
+
+	slot = (expiry_time >> LEVEL_SHIFT(level)) & WHEEL_MASK;
+	sys_dlist_append(&q->slots[level][slot], &ttimer->node);
+	q->pending[level] |= BIT(slot);
+}
+
 static void _thread_timer_remove(struct k_thread *thread, struct thread_timer *ttimer)
 {
-	struct thread_timer *in_q, *next;
+	struct _thread_timer_q *q = thread->thread_timer_q;
+
+	if (!q || !_thread_timer_is_linked(ttimer))
+		return;
+
+	_thread_timer_unlink(ttimer);
+	q->num--;
+	_thread_timer_stats_armed(-1);
+}
+
+static void _thread_timer_insert(struct k_thread *thread, struct thread_timer *ttimer)
+{
+	struct _thread_timer_q *q = _thread_timer_q_get(thread);
+
+	if (!q)
+		return;
+
+	/* an empty wheel just follows the clock */
+	if (!q->num)
+		q->time = k_uptime_get_32();
+
+	_thread_timer_place(q, ttimer);
+	q->num++;
+	_thread_timer_stats_armed(1);
+}
+
+/* search the wheel, for timers that may not be initialized yet */
+static bool _thread_timer_find(struct k_thread *thread, struct thread_timer *ttimer)
+{
+	struct _thread_timer_q *q = thread->thread_timer_q;
+	struct thread_timer *in_q;
+	int level, slot;
+
+	if (!q)
+		return false;
 
-	SYS_DLIST_FOR_EACH_CONTAINER_SAFE(&thread->thread_timer_q, in_q, next, node) {
-		if (ttimer == in_q) {
-			sys_dlist_remove(&in_q->node);
-			return;
+	SYS_DLIST_FOR_EACH_CONTAINER(&q->due, in_q, node) {
+		if (in_q == ttimer)
+			return true;
+	}
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		for (slot = 0; slot < WHEEL_SLOTS; slot++) {
+			SYS_DLIST_FOR_EACH_CONTAINER(&q->slots[level][slot], in_q, node) {
+				if (in_q == ttimer)
+					return true;
+			}
 		}
 	}
+
+	return false;
 }
 
-static void _thread_timer_insert(struct k_thread *thread, struct thread_timer *ttimer,
-				 u32_t expiry_time)
+/*
+ * Find the first slot of a level handled from the wheel time on. A slot
+ * of level n is handled when the wheel time enters the window it holds.
+ */
+static bool _thread_timer_next_slot(struct _thread_timer_q *q, int level,
+				    int *slot, u32_t *time)
 {
-	sys_dlist_t *thread_timer_q = &thread->thread_timer_q;
-	struct thread_timer *in_q;
+	int shift = LEVEL_SHIFT(level);
+	/* first window of this level starting at or after the wheel time */
+	u32_t window = (q->time >> shift) + ((q->time & (LEVEL_SPAN(level) - 1)) != 0);
+	int start = window & WHEEL_MASK;
+	u32_t pending;
+	int offset;
+
+	while (q->pending[level]) {
+		pending = q->pending[level];
+		pending = ((pending >> start) | (pending << (WHEEL_SLOTS - start))) &
+			  (BIT(WHEEL_SLOTS) - 1);
+
+		offset = find_lsb_set(pending) - 1;
+		*slot = (start + offset) & WHEEL_MASK;
+
+		if (sys_dlist_is_empty(&q->slots[level][*slot])) {
+			q->pending[level] &= ~BIT(*slot);
+			continue;
+		}
 
-	SYS_DLIST_FOR_EACH_CONTAINER(thread_timer_q, in_q, node) {
-		if (compare_time(ttimer->expiry_time, in_q->expiry_time) < 0) {
-			sys_dlist_insert_before(thread_timer_q, &in_q->node,
-						&ttimer->node);
-			return;
+		*time = (window + offset) << shift;
+		return true;
+	}
+
+	return false;
+}
+
+/* the next wheel time with a slot to handle */
+static bool _thread_timer_next_event(struct _thread_timer_q *q, u32_t *time)
+{
+	u32_t level_time;
+	bool found = false;
+	int level, slot;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		if (_thread_timer_next_slot(q, level, &slot, &level_time) &&
+		    (!found || compare_time(level_time, *time) < 0)) {
+			*time = level_time;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+static void _thread_timer_min_expiry(sys_dlist_t *slot, u32_t *expiry_time, bool *found)
+{
+	struct thread_timer *ttimer;
+
+	SYS_DLIST_FOR_EACH_CONTAINER(slot, ttimer, node) {
+		if (!*found || compare_time(ttimer->expiry_time, *expiry_time) < 0) {
+			*expiry_time = ttimer->expiry_time;
+			*found = true;
 		}
 	}
+}
+
+/*
+ * The earliest expiry time of the wheel. Windows of a level are handled
+ * in time order, so only the first slot of each level is looked at. The
+ * top level also holds parked timers out of window order, all its slots
+ * are looked at.
+ */
+static bool _thread_timer_next_expiry(struct _thread_timer_q *q, u32_t *expiry_time)
+{
+	struct thread_timer *ttimer;
+	bool found = false;
+	u32_t time;
+	int level, slot;
+
+	ttimer = SYS_DLIST_PEEK_HEAD_CONTAINER(&q->due, ttimer, node);
+	if (ttimer) {
+		/* due before the wheel time, so before anything in the wheel */
+		*expiry_time = ttimer->expiry_time;
+		return true;
+	}
 
-	sys_dlist_append(thread_timer_q, &ttimer->node);
+	for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+		if (_thread_timer_next_slot(q, level, &slot, &time))
+			_thread_timer_min_expiry(&q->slots[level][slot], expiry_time, &found);
+	}
+
+	for (slot = 0; slot < WHEEL_SLOTS; slot++) {
+		if (q->pending[WHEEL_LEVELS - 1] & BIT(slot))
+			_thread_timer_min_expiry(&q->slots[WHEEL_LEVELS - 1][slot], expiry_time, &found);
+	}
+
+	return found;
+}
+
+/* move the timers of a slot down to the lower levels */
+static void _thread_timer_cascade(struct _thread_timer_q *q, int level, int slot)
+{
+	sys_dlist_t list;
+	sys_dnode_t *node;
+	int num = 0;
+
+	sys_dlist_init(&list);
+	while ((node = sys_dlist_get(&q->slots[level][slot])) != NULL)
+		sys_dlist_append(&list, node);
+	q->pending[level] &= ~BIT(slot);
+
+	while ((node = sys_dlist_get(&list)) != NULL) {
+		_thread_timer_place(q, CONTAINER_OF(node, struct thread_timer, node));
+		num++;
+	}
+
+	_thread_timer_stats_cascaded(num);
 }
 
 void thread_timer_init(struct thread_timer *ttimer, thread_timer_expiry_t expiry_fn,
@@ -98,7 +468,8 @@ void thread_timer_init(struct thread_timer *ttimer, thread_timer_expiry_t expiry
 		ttimer->expiry_fn, ttimer->expiry_fn_arg);
 
 	/* remove thread timer if already submited */
-	_thread_timer_remove(_current, ttimer);
+	if (_thread_timer_find(_current, ttimer))
+		_thread_timer_remove(_current, ttimer);
 
 	memset(ttimer, 0, sizeof(struct thread_timer));
 	ttimer->expiry_fn = expiry_fn;
@@ -126,7 +497,7 @@ void thread_timer_start(struct thread_timer *ttimer, s32_t duration, s32_t perio
 	TT_DEBUG("timer %p: start duration %d period %d, expiry_time %d\n",
 		ttimer, duration, period, ttimer->expiry_time);
 
-	_thread_timer_insert(_current, ttimer, ttimer->expiry_time);
+	_thread_timer_insert(_current, ttimer);
 }
 
 void thread_timer_stop(struct thread_timer *ttimer)
@@ -140,59 +511,114 @@ void thread_timer_stop(struct thread_timer *ttimer)
 
 bool thread_timer_is_running(struct thread_timer *ttimer)
 {
-	struct thread_timer *in_q;
-
 	__ASSERT(ttimer != NULL, "");
 
-	SYS_DLIST_FOR_EACH_CONTAINER(&_current->thread_timer_q, in_q, node) {
-		if (ttimer == in_q)
-			return true;
-	}
-
-	return false;
+	return _thread_timer_is_linked(ttimer);
 }
 
 int thread_timer_next_timeout(void)
 {
-	struct thread_timer *ttimer;
+	u32_t expiry_time;
 	int timeout;
 
-	ttimer = SYS_DLIST_PEEK_HEAD_CONTAINER(&_current->thread_timer_q, ttimer, node);
-	if (ttimer) {
-		timeout = (int)((u32_t)ttimer->expiry_time - k_uptime_get_32());
+	if (_current->thread_timer_q &&
+	    _thread_timer_next_expiry(_current->thread_timer_q, &expiry_time)) {
+		timeout = (int)(expiry_time - k_uptime_get_32());
 		return (timeout < 0) ? K_NO_WAIT : timeout;
 	}
 
 	return K_FOREVER;
 }
 
+/* expire the timers of a list in one batch */
+static void _thread_timer_expire(struct _thread_timer_q *q, sys_dlist_t *list, u32_t cur_time)
+{
+	struct thread_timer *ttimer;
+	sys_dlist_t expired;
+	sys_dnode_t *node;
+	int num = 0;
+#ifdef CONFIG_THREAD_TIMER_STATS
+	u32_t jitter, jitter_total = 0, jitter_max = 0;
+#endif
+
+	/* take the whole list, expiry functions may start and stop timers */
+	sys_dlist_init(&expired);
+	while ((node = sys_dlist_get(list)) != NULL)
+		sys_dlist_append(&expired, node);
+
+	while ((node = sys_dlist_get(&expired)) != NULL) {
+		ttimer = CONTAINER_OF(node, struct thread_timer, node);
+
+		/* remove this expiry thread timer */
+		sys_dlist_init(&ttimer->node);
+		q->num--;
+		_thread_timer_stats_armed(-1);
+
+		if (!ttimer->expiry_fn)
+			continue;
+
+#ifdef CONFIG_THREAD_TIMER_STATS
+		jitter = cur_time - ttimer->expiry_time;
+		jitter_total += jitter;
+		if (jitter > jitter_max)
+			jitter_max = jitter;
+#endif
+		num++;
+
+		/* resubmit this thread timer if it is a period timer */
+		if (ttimer->period != 0) {
+			thread_timer_start(ttimer, ttimer->period,
+					   ttimer->period);
+		}
+
+		TT_DEBUG("timer %p: call %p\n", ttimer, ttimer->expiry_fn);
+
+		/* invoke thread timer expiry function */
+		ttimer->expiry_fn(ttimer, ttimer->expiry_fn_arg);
+	}
+
+	if (num) {
+		_thread_timer_stats_expired(num, jitter_total, jitter_max);
+	}
+}
+
 void thread_timer_handle_expired(void)
 {
-	struct thread_timer *ttimer, *next;
-	u32_t cur_time;
+	struct _thread_timer_q *q = _current->thread_timer_q;
+	u32_t cur_time, time = 0;
+	int level, slot;
+
+	if (!q)
+		return;
 
 	cur_time = k_uptime_get_32();
 
-	SYS_DLIST_FOR_EACH_CONTAINER_SAFE(&_current->thread_timer_q, ttimer, next, node) {
-		if (compare_time(ttimer->expiry_time, cur_time) > 0) {
-			/* no expired thread timer */
-			return;
-		}
+	if (!sys_dlist_is_empty(&q->due)) {
+		_thread_timer_expire(q, &q->due, cur_time);
+	}
 
-		/* remove this expiry thread timer */
-		sys_dlist_remove(&ttimer->node);
+	while (_thread_timer_next_event(q, &time) && compare_time(time, cur_time) <= 0) {
+		q->time = time;
 
-		if (ttimer->expiry_fn) {
-			/* resubmit this thread timer if it is a period timer */
-			if (ttimer->period != 0) {
-				thread_timer_start(ttimer, ttimer->period,
-						   ttimer->period);
+		/* windows entered at this time, higher levels first */
+		for (level = WHEEL_LEVELS - 1; level > 0; level--) {
+			if (!(time & (LEVEL_SPAN(level) - 1))) {
+				_thread_timer_cascade(q, level,
+					(time >> LEVEL_SHIFT(level)) & WHEEL_MASK);
 			}
+		}
 
-			TT_DEBUG("timer %p: call %p\n", ttimer, ttimer->expiry_fn);
+		q->time = time + 1;
 
-			/* invoke thread timer expiry function */
-			ttimer->expiry_fn(ttimer, ttimer->expiry_fn_arg);
-		}
+		slot = time & WHEEL_MASK;
+		q->pending[0] &= ~BIT(slot);
+		_thread_timer_expire(q, &q->slots[0][slot], cur_time);
 	}
+
+	/* nothing left to handle up to now */
+	if (compare_time(q->time, cur_time + 1) < 0)
+		q->time = cur_time + 1;
+
+	if (!q->num)
+		_thread_timer_q_put(_current);
 }
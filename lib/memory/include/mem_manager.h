@@ -103,6 +103,55 @@ void mem_manager_dump(void);
  */
 void *mem_malloc_debug(unsigned int num_bytes, void *caller);
 
+/**
+ * @brief Attach a cache of free blocks to current thread.
+ *
+ * Small allocations and frees of the thread are then served from its own
+ * cache without locking irq. Only the slab backend supports it, and
+ * CONFIG_SLAB_MAGAZINE_THREADS limits how many threads can attach.
+ *
+ * @return 0 if attached; -ENOMEM no cache left; -ENOSYS not supported.
+ */
+int mem_manager_thread_cache_attach(void);
+
+/**
+ * @brief Give back the cached blocks of current thread and detach its cache.
+ *
+ * Must be called by the thread before it exits.
+ *
+ * @return N/A
+ */
+void mem_manager_thread_cache_detach(void);
+
+/**
+ * @brief Dump live and peak heap bytes per allocation caller.
+ *
+ * Only available with CONFIG_MEM_PROFILER.
+ *
+ * @param reset restart peaks and allocation counts from current usage.
+ *
+ * @return N/A
+ */
+void mem_profiler_dump(bool reset);
+
+/**
+ * @brief Restart peaks and allocation counts from current usage.
+ *
+ * @return N/A
+ */
+void mem_profiler_reset(void);
+
+/**
+ * @brief Emit the heap profile as binary records into the trace buffer.
+ *
+ * One snapshot record is followed by one record per caller, which
+ * scripts/support/actions/mem_profile.py decodes on the host.
+ *
+ * @return number of caller records; -ENOSYS without CONFIG_TRACE_EVENT;
+ * -ENODEV trace buffer not initialized.
+ */
+int mem_profiler_emit(void);
+
 /**
  * @} end defgroup mem_manager_apis
  */
@@ -11,54 +11,66 @@
 #ifndef __MEM_INNER_H__
 #define __MEM_INNER_H__
 
-#ifdef APP_USED_MEM_POOL
+#ifdef CONFIG_APP_USED_MEM_POOL
 void *mem_pool_malloc(unsigned int num_bytes);
 void mem_pool_free(void *ptr);
 #endif
 
-#ifdef APP_USED_MEM_SLAB
-#define SLAB0_BUSY 		0x01
-#define SLAB1_BUSY 		0x02
-#define ALL_SLAB_BUSY 	0x03
-
+#ifdef CONFIG_APP_USED_MEM_SLAB
 #define SYSTEM_MEM_SLAB 0
 #define APP_MEM_SLAB    1
 
-struct dynamic_slab_info
-{
-	sys_snode_t node;
-	void * base_addr;
-	uint32_t alloc_mask;
-	uint16_t block_size;
-	uint16_t block_num;
-};
+/* size class lookup granule, block sizes should be multiple of it */
+#define SLAB_SIZE_GRANULE_SHIFT	3
+#define SLAB_MAX_BLOCK_SIZE	CONFIG_SLAB8_BLOCK_SIZE
+#define SLAB_SIZE_LOOKUP_NUM	((SLAB_MAX_BLOCK_SIZE >> SLAB_SIZE_GRANULE_SHIFT) + 1)
 
 struct slab_info
 {
-	struct k_mem_slab *slab;
-	char * slab_base;
+	/** first block, classes are laid out in ascending address order */
+	char *slab_base;
+	char *slab_end;
+	/** free blocks linked through their first word */
+	void *free_list;
 	uint16_t block_num;
 	uint16_t block_size;
-#ifdef CONFIG_USED_DYNAMIC_SLAB
-	sys_slist_t	* dynamic_slab_list;
-#endif
+	uint16_t num_used;
+	uint16_t max_used;
+	uint16_t max_size;
 };
 
+#if CONFIG_SLAB_MAGAZINE_THREADS > 0
+/** per thread cache of free blocks, only touched by its owner thread */
+struct slab_magazine
+{
+	k_tid_t owner;
+	uint8_t count[CONFIG_SLAB_TOTAL_NUM];
+	void *blocks[CONFIG_SLAB_TOTAL_NUM][CONFIG_SLAB_MAGAZINE_DEPTH];
+};
+#endif
+
 struct slabs_info
 {
 	uint16_t slab_num;
 	uint16_t slab_flag;
-	uint8_t * max_used;
-	uint16_t * max_size;
+	/** bit n set when slabs[n] has free blocks */
+	uint32_t avail_mask;
+	/** smallest class fitting ((size + granule - 1) >> granule shift) */
+	uint8_t size_to_class[SLAB_SIZE_LOOKUP_NUM];
 	struct slab_info slabs[CONFIG_SLAB_TOTAL_NUM];
+#if CONFIG_SLAB_MAGAZINE_THREADS > 0
+	struct slab_magazine magazines[CONFIG_SLAB_MAGAZINE_THREADS];
+#endif
 };
 
-#define DYNAMIC_SLAB_INFO(_node) CONTAINER_OF(_node, struct dynamic_slab_info, node)
+extern struct slabs_info sys_slab;
 
 void mem_slabs_init(struct slabs_info * slabs);
 void mem_slabs_free(struct slabs_info * slabs, void *ptr);
 void *mem_slabs_malloc(struct slabs_info * slabs, unsigned int num_bytes);
 void mem_slabs_dump(struct slabs_info * slabs,int index);
+int mem_slabs_magazine_attach(struct slabs_info *slabs);
+void mem_slabs_magazine_detach(struct slabs_info *slabs);
 #endif
 
 #ifdef CONFIG_APP_USED_MEM_PAGE
@@ -68,6 +80,10 @@ void mem_page_free(void *ptr, void *caller);
 void mem_page_dump(u32_t dump_detail);
 #endif
 
+#ifdef CONFIG_MEM_PROFILER
+void mem_profiler_malloc(void *ptr, unsigned int num_bytes, void *caller);
+void mem_profiler_free(void *ptr);
+#endif
 
 void *mem_malloc_debug(unsigned int num_bytes, void *caller);
 
@@ -18,27 +18,17 @@
 
 void * app_mem_malloc(unsigned int num_bytes)
 {
-#ifdef CONFIG_APP_USED_MEM_SLAB
-#ifdef CONFIG_APP_USED_SYSTEM_SLAB
-	return mem_slabs_malloc((struct slabs_info *)&sys_slab, num_bytes);
-#else
-	return mem_slabs_malloc((struct slabs_info *)&app_slab, num_bytes);
-#endif
-#elif defined(CONFIG_APP_USED_MEM_PAGE)
-	return mem_page_malloc(num_bytes, __builtin_return_address(0));
-#elif defined(CONFIG_APP_USED_MEM_POOL)
-	return mem_pool_malloc(num_bytes);
-#endif
+	return mem_malloc_debug(num_bytes, __builtin_return_address(0));
 }
 
 void app_mem_free(void *ptr)
 {
-#ifdef CONFIG_APP_USED_MEM_SLAB
-#ifdef CONFIG_APP_USED_SYSTEM_SLAB
-	mem_slabs_free((struct slabs_info *)&sys_slab, ptr);
-#else
-	mem_slabs_free((struct slabs_info *)&app_slab, ptr);
+#ifdef CONFIG_MEM_PROFILER
+	mem_profiler_free(ptr);
 #endif
+
+#ifdef CONFIG_APP_USED_MEM_SLAB
+	mem_slabs_free(&sys_slab, ptr);
 #elif defined(CONFIG_APP_USED_MEM_PAGE)
 	mem_page_free(ptr, __builtin_return_address(0));
 #elif defined(CONFIG_APP_USED_MEM_POOL)
@@ -48,13 +38,20 @@ void app_mem_free(void *ptr)
 
 void *mem_malloc_debug(unsigned int num_bytes, void *caller)
 {
+	void *ptr = NULL;
+
 #ifdef CONFIG_APP_USED_MEM_SLAB
-	return mem_slabs_malloc((struct slabs_info *)&sys_slab, num_bytes);
+	ptr = mem_slabs_malloc(&sys_slab, num_bytes);
 #elif defined(CONFIG_APP_USED_MEM_PAGE)
-	return mem_page_malloc(num_bytes,caller);
+	ptr = mem_page_malloc(num_bytes,caller);
 #elif defined(CONFIG_APP_USED_MEM_POOL)
-	return mem_pool_malloc(num_bytes);
+	ptr = mem_pool_malloc(num_bytes);
+#endif
+
+#ifdef CONFIG_MEM_PROFILER
+	mem_profiler_malloc(ptr, num_bytes, caller);
 #endif
+	return ptr;
 }
 
 void *mem_malloc(unsigned int num_bytes)
@@ -64,8 +61,13 @@ void *mem_malloc(unsigned int num_bytes)
 
 void mem_free(void *ptr)
 {
+	/* drop the profile entry first, the block may be reused right away */
+#ifdef CONFIG_MEM_PROFILER
+	mem_profiler_free(ptr);
+#endif
+
 #ifdef CONFIG_APP_USED_MEM_SLAB
-	mem_slabs_free((struct slabs_info *)&sys_slab, ptr);
+	mem_slabs_free(&sys_slab, ptr);
 #elif defined(CONFIG_APP_USED_MEM_PAGE)
 	mem_page_free(ptr, __builtin_return_address(0));
 #elif defined(CONFIG_APP_USED_MEM_POOL)
@@ -73,10 +75,26 @@ void mem_free(void *ptr)
 #endif
 }
 
+int mem_manager_thread_cache_attach(void)
+{
+#ifdef CONFIG_APP_USED_MEM_SLAB
+	return mem_slabs_magazine_attach(&sys_slab);
+#else
+	return -ENOSYS;
+#endif
+}
+
+void mem_manager_thread_cache_detach(void)
+{
+#ifdef CONFIG_APP_USED_MEM_SLAB
+	mem_slabs_magazine_detach(&sys_slab);
+#endif
+}
+
 void mem_manager_dump(void)
 {
 #ifdef CONFIG_APP_USED_MEM_SLAB
-	mem_slabs_dump((struct slabs_info *)&sys_slab, 0);
+	mem_slabs_dump(&sys_slab, 0);
 #elif defined(CONFIG_APP_USED_MEM_PAGE)
 	mem_page_dump(1);
 #elif defined(CONFIG_APP_USED_MEM_POOL)
@@ -89,7 +107,7 @@ static int mem_manager_init(struct device *unused)
 	ARG_UNUSED(unused);
 
 #ifdef CONFIG_APP_USED_MEM_SLAB
-	mem_slab_init(void);
+	mem_slabs_init(&sys_slab);
 #elif defined(CONFIG_APP_USED_MEM_PAGE)
 	mem_page_init();
 #endif
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief allocation site heap profiler.
+ *
+ * Live allocations are kept in an open addressing table keyed by address,
+ * each one remembers its size and the caller site it was charged to, so
+ * mem_free can give the bytes back to the right caller. Both tables are
+ * fixed size and only touched with irq locked.
+ */
+
+#include <kernel.h>
+#include <string.h>
+#include <errno.h>
+#include <misc/printk.h>
+#include <trace.h>
+#if defined(CONFIG_KALLSYMS)
+#include <kallsyms.h>
+#endif
+#include "mem_inner.h"
+
+#define MEM_PROF_SITE_NUM	CONFIG_MEM_PROFILER_SITES
+#define MEM_PROF_LIVE_NUM	CONFIG_MEM_PROFILER_LIVE_ALLOCS
+/* keep probe sequences short, refuse to fill the live table above 3/4 */
+#define MEM_PROF_LIVE_LIMIT	(MEM_PROF_LIVE_NUM - MEM_PROF_LIVE_NUM / 4)
+/* site index of the entry collecting callers that did not fit */
+#define MEM_PROF_SITE_OTHER	MEM_PROF_SITE_NUM
+
+BUILD_ASSERT((MEM_PROF_SITE_NUM & (MEM_PROF_SITE_NUM - 1)) == 0);
+BUILD_ASSERT(MEM_PROF_SITE_NUM <= 128);
+BUILD_ASSERT((MEM_PROF_LIVE_NUM & (MEM_PROF_LIVE_NUM - 1)) == 0);
+
+struct mem_prof_live
+{
+	void *ptr;
+	u32_t size : 24;
+	u32_t site : 8;
+};
+
+struct mem_prof_site
+{
+	void *caller;
+	u32_t live_bytes;
+	u32_t peak_bytes;
+	u16_t live_count;
+	u16_t peak_count;
+	u32_t total_count;
+};
+
+struct mem_profiler
+{
+	u32_t live_num;
+	u32_t live_bytes;
+	u32_t peak_bytes;
+	/** allocations not profiled because the live table was full */
+	u32_t dropped;
+	/** frees of addresses not in the live table */
+	u32_t untracked_frees;
+	struct mem_prof_live live[MEM_PROF_LIVE_NUM];
+	struct mem_prof_site sites[MEM_PROF_SITE_NUM + 1];
+};
+
+static struct mem_profiler mem_prof;
+
+static inline u32_t mem_prof_hash(void *addr, u32_t mask)
+{
+	u32_t h = ((u32_t)(uintptr_t)addr >> 2) * 0x9E3779B1u;
+
+	return (h ^ (h >> 16)) & mask;
+}
+
+static int mem_prof_site_get(void *caller)
+{
+	u32_t i = mem_prof_hash(caller, MEM_PROF_SITE_NUM - 1);
+	int n;
+
+	for (n = 0; n < MEM_PROF_SITE_NUM; n++) {
+		if (mem_prof.sites[i].caller == caller)
+			return i;
+
+		if (!mem_prof.sites[i].caller) {
+			mem_prof.sites[i].caller = caller;
+			return i;
+		}
+
+		i = (i + 1) & (MEM_PROF_SITE_NUM - 1);
+	}
+
+	return MEM_PROF_SITE_OTHER;
+}
+
+static int mem_prof_live_find(void *ptr)
+{
+	u32_t i = mem_prof_hash(ptr, MEM_PROF_LIVE_NUM - 1);
+
+	while (mem_prof.live[i].ptr) {
+		if (mem_prof.live[i].ptr == ptr)
+			return i;
+
+		i = (i + 1) & (MEM_PROF_LIVE_NUM - 1);
+	}
+
+	return -1;
+}
+
+/* backward shift deletion, keeps linear probing tombstone free */
+static void mem_prof_live_remove(u32_t hole)
+{
+	u32_t i = hole, home;
+
+	for (;;) {
+		i = (i + 1) & (MEM_PROF_LIVE_NUM - 1);
+		if (!mem_prof.live[i].ptr)
+			break;
+
+		home = mem_prof_hash(mem_prof.live[i].ptr, MEM_PROF_LIVE_NUM - 1);
+
+		/* entry may move only if its home is not within (hole, i] */
+		if (((i - home) & (MEM_PROF_LIVE_NUM - 1)) >=
+		    ((i - hole) & (MEM_PROF_LIVE_NUM - 1))) {
+			mem_prof.live[hole] = mem_prof.live[i];
+			hole = i;
+		}
+	}
+
+	mem_prof.live[hole].ptr = NULL;
+}
+
+void mem_profiler_malloc(void *ptr, unsigned int num_bytes, void *caller)
+{
+	struct mem_prof_site *site;
+	unsigned int key;
+	u32_t i;
+
+	if (!ptr)
+		return;
+
+	key = irq_lock();
+
+	if (mem_prof.live_num >= MEM_PROF_LIVE_LIMIT) {
+		mem_prof.dropped++;
+		irq_unlock(key);
+		return;
+	}
+
+	i = mem_prof_hash(ptr, MEM_PROF_LIVE_NUM - 1);
+	while (mem_prof.live[i].ptr)
+		i = (i + 1) & (MEM_PROF_LIVE_NUM - 1);
+
+	mem_prof.live[i].ptr = ptr;
+	mem_prof.live[i].size = num_bytes;
+	mem_prof.live[i].site = mem_prof_site_get(caller);
+	mem_prof.live_num++;
+
+	site = &mem_prof.sites[mem_prof.live[i].site];
+	site->live_bytes += num_bytes;
+	site->live_count++;
+	site->total_count++;
+	if (site->live_bytes > site->peak_bytes)
+		site->peak_bytes = site->live_bytes;
+	if (site->live_count > site->peak_count)
+		site->peak_count = site->live_count;
+
+	mem_prof.live_bytes += num_bytes;
+	if (mem_prof.live_bytes > mem_prof.peak_bytes)
+		mem_prof.peak_bytes = mem_prof.live_bytes;
+
+	irq_unlock(key);
+}
+
+void mem_profiler_free(void *ptr)
+{
+	struct mem_prof_site *site;
+	unsigned int key;
+	int i;
+
+	if (!ptr)
+		return;
+
+	key = irq_lock();
+
+	i = mem_prof_live_find(ptr);
+	if (i < 0) {
+		mem_prof.untracked_frees++;
+		irq_unlock(key);
+		return;
+	}
+
+	site = &mem_prof.sites[mem_prof.live[i].site];
+	site->live_bytes -= mem_prof.live[i].size;
+	site->live_count--;
+	mem_prof.live_bytes -= mem_prof.live[i].size;
+	mem_prof.live_num--;
+
+	mem_prof_live_remove(i);
+
+	irq_unlock(key);
+}
+
+/* copy one site under lock, the table may change while it is printed */
+static int mem_prof_site_snapshot(int index, struct mem_prof_site *site)
+{
+	unsigned int key = irq_lock();
+
+	*site = mem_prof.sites[index];
+
+	irq_unlock(key);
+
+	return site->caller || site->total_count;
+}
+
+void mem_profiler_reset(void)
+{
+	unsigned int key;
+	int i;
+
+	key = irq_lock();
+
+	for (i = 0; i <= MEM_PROF_SITE_NUM; i++) {
+		mem_prof.sites[i].peak_bytes = mem_prof.sites[i].live_bytes;
+		mem_prof.sites[i].peak_count = mem_prof.sites[i].live_count;
+		mem_prof.sites[i].total_count = mem_prof.sites[i].live_count;
+	}
+
+	mem_prof.peak_bytes = mem_prof.live_bytes;
+	mem_prof.dropped = 0;
+	mem_prof.untracked_frees = 0;
+
+	irq_unlock(key);
+}
+
+void mem_profiler_dump(bool reset)
+{
+	struct mem_prof_site site;
+	int i;
+
+	printk("heap profile: live %u bytes in %u blocks, peak %u bytes, dropped %u, untracked free %u\n",
+		mem_prof.live_bytes, mem_prof.live_num, mem_prof.peak_bytes,
+		mem_prof.dropped, mem_prof.untracked_frees);
+	printk("  caller       live(cnt)      peak(cnt)    allocs\n");
+
+	for (i = 0; i <= MEM_PROF_SITE_NUM; i++) {
+		if (!mem_prof_site_snapshot(i, &site))
+			continue;
+
+		printk("  %08x %7u(%4u) %7u(%4u) %8u", (u32_t)(uintptr_t)site.caller,
+			site.live_bytes, site.live_count,
+			site.peak_bytes, site.peak_count, site.total_count);
+#ifdef CONFIG_KALLSYMS
+		if (site.caller)
+			print_symbol(" %s\n", (unsigned long)site.caller);
+		else
+			printk(" <other>\n");
+#else
+		printk("\n");
+#endif
+	}
+
+	if (reset)
+		mem_profiler_reset();
+}
+
+int mem_profiler_emit(void)
+{
+	struct mem_prof_site site;
+	int i, sites = 0, ret;
+
+	for (i = 0; i <= MEM_PROF_SITE_NUM; i++) {
+		if (mem_prof_site_snapshot(i, &site))
+			sites++;
+	}
+
+	ret = TRACE_MEM_SNAPSHOT(sites, mem_prof.live_bytes,
+				 mem_prof.peak_bytes, mem_prof.dropped);
+	if (ret)
+		return ret;
+
+	for (i = 0; i <= MEM_PROF_SITE_NUM; i++) {
+		if (!mem_prof_site_snapshot(i, &site))
+			continue;
+
+		TRACE_MEM_SITE((u32_t)(uintptr_t)site.caller, site.live_bytes,
+			       site.peak_bytes, site.total_count);
+	}
+
+	return sites;
+}
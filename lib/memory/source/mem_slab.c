@@ -7,29 +7,29 @@
 /**
  * @file
  * @brief mem slab manager.
+ *
+ * Size class allocator: every slab is a free list of fixed size blocks,
+ * the class of a request is found with one table lookup and irq is only
+ * locked around the free list update. Threads that attach a magazine keep
+ * a few free small blocks of their own and do not lock irq at all while
+ * the magazine can serve them.
 */
 
-#include <os_common_api.h>
+#define SYS_LOG_DOMAIN "mem_slab"
+#include <logging/sys_log.h>
 #include <mem_manager.h>
 #include <kernel.h>
-#include <kernel_structs.h>
-#include <atomic.h>
-#include <init.h>
 #include <toolchain.h>
-#include <linker/sections.h>
 #include <string.h>
-#include <stack_backtrace.h>
-
-struct k_mem_slab mem_slab[CONFIG_SLAB_TOTAL_NUM];
-uint8_t system_max_used[CONFIG_SLAB_TOTAL_NUM];
-uint16_t system_max_size[CONFIG_SLAB_TOTAL_NUM];
+#include <misc/printk.h>
+#include "mem_inner.h"
 
-#ifdef CONFIG_USED_DYNAMIC_SLAB
-sys_slist_t dynamic_slab_list[CONFIG_SLAB_TOTAL_NUM];
+BUILD_ASSERT_MSG(CONFIG_SLAB_TOTAL_NUM == 9, "slab table below has 9 classes");
+BUILD_ASSERT(CONFIG_SLAB_TOTAL_NUM <= 32);
+#if CONFIG_SLAB_MAGAZINE_THREADS > 0
+BUILD_ASSERT(CONFIG_SLAB_MAGAZINE_DEPTH > 0 && CONFIG_SLAB_MAGAZINE_DEPTH < 256);
 #endif
 
-#define CONFIG_SLAB_TOTAL_NUM 9
-
 #define SLAB_TOTAL_SIZE (CONFIG_SLAB0_BLOCK_SIZE * CONFIG_SLAB0_NUM_BLOCKS \
 				+ CONFIG_SLAB1_BLOCK_SIZE * CONFIG_SLAB1_NUM_BLOCKS \
 				+ CONFIG_SLAB2_BLOCK_SIZE * CONFIG_SLAB2_NUM_BLOCKS \
@@ -42,7 +42,6 @@ sys_slist_t dynamic_slab_list[CONFIG_SLAB_TOTAL_NUM];
 
 char __aligned(4) mem_slab_buffer[SLAB_TOTAL_SIZE];
 
-
 #define SLAB0_BLOCK_OFF 0
 
 #define SLAB1_BLOCK_OFF \
@@ -77,583 +76,383 @@ char __aligned(4) mem_slab_buffer[SLAB_TOTAL_SIZE];
 		SLAB7_BLOCK_OFF + \
 		CONFIG_SLAB7_BLOCK_SIZE * CONFIG_SLAB7_NUM_BLOCKS
 
-const struct  slabs_info sys_slab =
+#define SLAB_INFO(n) \
+	{ \
+		.slab_base = &mem_slab_buffer[SLAB##n##_BLOCK_OFF], \
+		.block_num = CONFIG_SLAB##n##_NUM_BLOCKS, \
+		.block_size = CONFIG_SLAB##n##_BLOCK_SIZE, \
+	}
+
+struct slabs_info sys_slab =
 {
 	.slab_num = CONFIG_SLAB_TOTAL_NUM,
-	.max_used = system_max_used,
-	.max_size = system_max_size,
 	.slab_flag = SYSTEM_MEM_SLAB,
 	.slabs = {
-			 {
-				.slab = &mem_slab[0],
-				.slab_base = &mem_slab_buffer[SLAB0_BLOCK_OFF],
-			    .block_num = CONFIG_SLAB0_NUM_BLOCKS,
-				.block_size = CONFIG_SLAB0_BLOCK_SIZE,
-			#ifdef CONFIG_USED_DYNAMIC_SLAB
-				.dynamic_slab_list = &dynamic_slab_list[0],
-			#endif
-			 },
-
-			 {
-				.slab = &mem_slab[1],
-				.slab_base = &mem_slab_buffer[SLAB1_BLOCK_OFF],
-			    .block_num = CONFIG_SLAB1_NUM_BLOCKS,
-				.block_size = CONFIG_SLAB1_BLOCK_SIZE,
-			#ifdef CONFIG_USED_DYNAMIC_SLAB
-				.dynamic_slab_list = &dynamic_slab_list[1],
-			#endif
-			 },
-
-			 {
-				.slab = &mem_slab[2],
-				.slab_base = &mem_slab_buffer[SLAB2_BLOCK_OFF],
-			    .block_num = CONFIG_SLAB2_NUM_BLOCKS,
-				.block_size = CONFIG_SLAB2_BLOCK_SIZE,
-			#ifdef CONFIG_USED_DYNAMIC_SLAB
-				.dynamic_slab_list = &dynamic_slab_list[2],
-			#endif
-			 },
-
-			 {
-				.slab = &mem_slab[3],
-				.slab_base = &mem_slab_buffer[SLAB3_BLOCK_OFF],
-			    .block_num = CONFIG_SLAB3_NUM_BLOCKS,
-				.block_size = CONFIG_SLAB3_BLOCK_SIZE,
-			#ifdef CONFIG_USED_DYNAMIC_SLAB
-				.dynamic_slab_list = &dynamic_slab_list[3],
-			#endif
-			 },
-
-			 {
-				.slab = &mem_slab[4],
-				.slab_base = &mem_slab_buffer[SLAB4_BLOCK_OFF],
-			    .block_num = CONFIG_SLAB4_NUM_BLOCKS,
-				.block_size = CONFIG_SLAB4_BLOCK_SIZE,
-			#ifdef CONFIG_USED_DYNAMIC_SLAB
-				.dynamic_slab_list = &dynamic_slab_list[4],
-			#endif
-			 },
-
-			 {
-				.slab = &mem_slab[5],
-				.slab_base = &mem_slab_buffer[SLAB5_BLOCK_OFF],
-			    .block_num = CONFIG_SLAB5_NUM_BLOCKS,
-				.block_size = CONFIG_SLAB5_BLOCK_SIZE,
-			#ifdef CONFIG_USED_DYNAMIC_SLAB
-				.dynamic_slab_list = &dynamic_slab_list[5],
-			#endif
-			 },
-
-			 {
-				.slab = &mem_slab[6],
-				.slab_base = &mem_slab_buffer[SLAB6_BLOCK_OFF],
-			    .block_num = CONFIG_SLAB6_NUM_BLOCKS,
-				.block_size = CONFIG_SLAB6_BLOCK_SIZE,
-			#ifdef CONFIG_USED_DYNAMIC_SLAB
-				.dynamic_slab_list = &dynamic_slab_list[6],
-			#endif
-			 },
-
-			 {
-				.slab = &mem_slab[7],
-				.slab_base = &mem_slab_buffer[SLAB7_BLOCK_OFF],
-			    .block_num = CONFIG_SLAB7_NUM_BLOCKS,
-				.block_size = CONFIG_SLAB7_BLOCK_SIZE,
-			#ifdef CONFIG_USED_DYNAMIC_SLAB
-				.dynamic_slab_list = &dynamic_slab_list[7],
-			#endif
-			 },
-
-			 {
-				.slab = &mem_slab[8],
-				.slab_base = &mem_slab_buffer[SLAB8_BLOCK_OFF],
-			    .block_num = CONFIG_SLAB8_NUM_BLOCKS,
-				.block_size = CONFIG_SLAB8_BLOCK_SIZE,
-			#ifdef CONFIG_USED_DYNAMIC_SLAB
-				.dynamic_slab_list = &dynamic_slab_list[8],
-			#endif
-			 }
-			}
+		SLAB_INFO(0),
+		SLAB_INFO(1),
+		SLAB_INFO(2),
+		SLAB_INFO(3),
+		SLAB_INFO(4),
+		SLAB_INFO(5),
+		SLAB_INFO(6),
+		SLAB_INFO(7),
+		SLAB_INFO(8),
+	},
 };
 
-static int find_slab_by_addr(struct slabs_info * slabs, void * addr)
+static inline int size_to_slab_index(struct slabs_info *slabs, unsigned int num_bytes)
 {
-	int i = 0;
-	int target_slab_index = slabs->slab_num;
-	for (i = 0 ; i < slabs->slab_num; i++) {
-		if ((uint32_t)slabs->slabs[i].slab_base <= (uint32_t)addr
-			&& (uint32_t)((uint32_t)slabs->slabs[i].slab_base +
-				slabs->slabs[i].block_size *
-				slabs->slabs[i].block_num) > (uint32_t)addr) {
-			target_slab_index = i;
-			break;
-		}
-	}
-	return target_slab_index;
+	if (num_bytes > SLAB_MAX_BLOCK_SIZE)
+		return slabs->slab_num;
+
+	return slabs->size_to_class[(num_bytes + BIT(SLAB_SIZE_GRANULE_SHIFT) - 1)
+					>> SLAB_SIZE_GRANULE_SHIFT];
 }
-static void dump_mem_hex(struct slabs_info *slabs, int slab_index);
-static void* malloc_from_stable_slab(struct slabs_info * slabs,int slab_index)
+
+static int find_slab_by_addr(struct slabs_info *slabs, void *addr)
 {
-	void * block_ptr = NULL;
-	if (slab_index >= 0 && slab_index < slabs->slab_num)	{
-		if(!k_mem_slab_alloc(
-					slabs->slabs[slab_index].slab,
-					&block_ptr, K_NO_WAIT)) {
-			memset(block_ptr, 0, slabs->slabs[slab_index].block_size);
-			if (slabs->max_used[slab_index] <
-				k_mem_slab_num_used_get(slabs->slabs[slab_index].slab))	{
-				slabs->max_used[slab_index] =
-				k_mem_slab_num_used_get(slabs->slabs[slab_index].slab);
-			}
-		} else {
-//		    SYS_LOG_ERR("Memory allocation time-out"
-//				" free_list %p next freelist %p ",
-//				slabs->slabs[slab_index].slab->free_list,
-//				*(char **)(slabs->slabs[slab_index].slab->free_list));
-		#if DEBUG
-			dump_stack();
-			mem_dump(slabs,slab_index);
-		#endif
-		}
-	} else {
-		SYS_LOG_INF("slab_index %d overflow  max is %d",
-						slab_index, slabs->slab_num);
+	int low = 0;
+	int high = slabs->slab_num - 1;
+	int mid;
+
+	if ((char *)addr < slabs->slabs[0].slab_base ||
+		(char *)addr >= slabs->slabs[high].slab_end)
+		return slabs->slab_num;
+
+	/* classes are contiguous and in ascending address order */
+	while (low < high) {
+		mid = (low + high + 1) / 2;
+		if ((char *)addr >= slabs->slabs[mid].slab_base)
+			low = mid;
+		else
+			high = mid - 1;
 	}
-#ifdef DEBUG
-	SYS_LOG_DBG("mem_malloc from stable_slab %d : ptr %p",
-						slab_index, block_ptr);
-#endif
+
+	if (((char *)addr - slabs->slabs[low].slab_base) % slabs->slabs[low].block_size)
+		return slabs->slab_num;
+
+	return low;
+}
+
+/* pop a block from the class free list, irq must be locked */
+static void *slab_pop(struct slabs_info *slabs, int slab_index)
+{
+	struct slab_info *slab = &slabs->slabs[slab_index];
+	void *block_ptr = slab->free_list;
+
+	slab->free_list = *(void **)block_ptr;
+	if (!slab->free_list)
+		slabs->avail_mask &= ~BIT(slab_index);
+
+	if (++slab->num_used > slab->max_used)
+		slab->max_used = slab->num_used;
+
 	return block_ptr;
 }
 
-static bool free_to_stable_slab(struct slabs_info *slabs, void * ptr)
+/* push a block to the class free list, irq must be locked */
+static void slab_push(struct slabs_info *slabs, int slab_index, void *ptr)
 {
-	int slab_index = find_slab_by_addr(slabs, ptr);
-	if (slab_index >= 0 && slab_index < slabs->slab_num) {
-		memset(ptr,
-				0, slabs->slabs[slab_index].block_size);
-
-		k_mem_slab_free(slabs->slabs[slab_index].slab,
-						&ptr);
-	#ifdef DEBUG
-		SYS_LOG_DBG("mem_free to stable slab %d "
-						": ptr %p ",slab_index, ptr);
-	#endif
-		return true;
-	}
-	return false;
+	struct slab_info *slab = &slabs->slabs[slab_index];
+
+	*(void **)ptr = slab->free_list;
+	slab->free_list = ptr;
+	slab->num_used--;
+	slabs->avail_mask |= BIT(slab_index);
 }
 
-#ifdef CONFIG_USED_DYNAMIC_SLAB
-static void * malloc_from_dynamic_slab(struct slabs_info *slabs, int slab_index)
+#if CONFIG_SLAB_MAGAZINE_THREADS > 0
+static struct slab_magazine *find_magazine(struct slabs_info *slabs, int slab_index)
 {
-	sys_snode_t *node, *tmp;
-	void * alloc_block = NULL;
-	sys_slist_t	* dynamic_list =
-			slabs->slabs[slab_index].dynamic_slab_list;
-
-	SYS_SLIST_FOR_EACH_NODE_SAFE(dynamic_list, node, tmp) {
-
-		struct dynamic_slab_info * slab = DYNAMIC_SLAB_INFO(node);
-
-		if (((uint32_t)slab->base_addr & ALL_SLAB_BUSY) != ALL_SLAB_BUSY) {
-			if (((uint32_t)slab->base_addr & SLAB0_BUSY) != SLAB0_BUSY) {
-				alloc_block = slab->base_addr;
-				slab->base_addr =
-					(void *)((uint32_t)slab->base_addr | SLAB0_BUSY);
-				#ifdef DEBUG
-				SYS_LOG_DBG("mem_malloc from dynamic slab %d  slab 0 : ptr %p ",
-						slab_index,
-						(void *)((uint32_t)alloc_block & (~ALL_SLAB_BUSY)));
-				#endif
-				break;
-			} else if(((uint32_t)slab->base_addr & SLAB1_BUSY) != SLAB1_BUSY) {
-				alloc_block = slab->base_addr
-							+ slabs->slabs[slab_index].block_size;
-				slab->base_addr =
-					(void *)((uint32_t)slab->base_addr | SLAB1_BUSY);
-			#ifdef DEBUG
-				SYS_LOG_DBG("mem_malloc from dynamic slab %d  slab 1 : ptr %p ",
-						slab_index,
-						(void *)((uint32_t)alloc_block & (~ALL_SLAB_BUSY)));
-			#endif
-				break;
-			}
-		}
+	k_tid_t tid;
+	int i;
+
+	if (slabs->slabs[slab_index].block_size > CONFIG_SLAB_MAGAZINE_MAX_BLOCK_SIZE)
+		return NULL;
+
+	/* an isr borrows the interrupted thread, so it must not use its magazine */
+	if (k_is_in_isr())
+		return NULL;
+
+	tid = k_current_get();
+	for (i = 0; i < CONFIG_SLAB_MAGAZINE_THREADS; i++) {
+		if (slabs->magazines[i].owner == tid)
+			return &slabs->magazines[i];
 	}
 
-	return  (void *)((uint32_t)alloc_block & (~ALL_SLAB_BUSY));
+	return NULL;
 }
 
-static bool free_to_dynamic_slab(struct slabs_info *slabs, void * ptr)
+/* refill half of the magazine and return one more block for the caller */
+static void *magazine_refill(struct slabs_info *slabs,
+				struct slab_magazine *magazine, int slab_index)
 {
-	bool found = false;
-	bool free_to_parent = false;
-	int slab_index = 0;
-	struct dynamic_slab_info * slab = NULL;
-	sys_slist_t	* dynamic_list = NULL;
-	void * base_addr = NULL;
-	uint16_t block_size = 0;
-
-found_begin:
-	for (slab_index = 0 ; slab_index < slabs->slab_num; slab_index++) {
-		sys_snode_t *node, *tmp;
-		dynamic_list =
-				 slabs->slabs[slab_index].dynamic_slab_list;
-
-		SYS_SLIST_FOR_EACH_NODE_SAFE(dynamic_list, node, tmp) {
-			slab = DYNAMIC_SLAB_INFO(node);
-			base_addr = (void *)((uint32_t)slab->base_addr
-								& (~ALL_SLAB_BUSY));
-			block_size = slabs->slabs[slab_index].block_size * 2;
-
-			if (base_addr <= ptr
-				&& (base_addr +  block_size) > ptr) {
-				found = true;
-				goto found_end;
-			} else {
-				slab = NULL;
-			}
-		}
-	}
+	void *block_ptr = NULL;
+	unsigned int key = irq_lock();
+	int num = CONFIG_SLAB_MAGAZINE_DEPTH / 2;
 
-found_end:
-	if (slab == NULL) {
-		if (!free_to_parent) {
-			return false;
-		} else {
-			/*target to stable slab ,mem_free to parent*/
-		#ifdef DEBUG
-			SYS_LOG_DBG("target to stable slab ,mem_free to parent %d ,ptr %p ",
-					slab_index, ptr);
-		#endif
-			if (!free_to_stable_slab(slabs, ptr)) {
-				SYS_LOG_ERR("mem_free to stable slab"
-								": ptr %p failed ",ptr);
-			}
-			return true;
+	if (slabs->avail_mask & BIT(slab_index)) {
+		block_ptr = slab_pop(slabs, slab_index);
+
+		while (num-- > 0 && (slabs->avail_mask & BIT(slab_index))) {
+			magazine->blocks[slab_index][magazine->count[slab_index]++] =
+				slab_pop(slabs, slab_index);
 		}
 	}
 
-	/*mem_free to slab 0 , remove busy flag for slab0*/
-	if(base_addr == ptr
-		&& ((uint32_t)slab->base_addr & SLAB0_BUSY) == SLAB0_BUSY)
-	{
-		slab->base_addr =
-			(void *)((uint32_t)slab->base_addr & (~SLAB0_BUSY));
-	#ifdef DEBUG
-		SYS_LOG_DBG("mem_free to dynamic slab %d slab 0: ptr %p ",slab_index,ptr);
-	#endif
-	}
+	irq_unlock(key);
+	return block_ptr;
+}
 
-	/*mem_free to slab 1 , remove busy flag for slab1*/
-	if(base_addr == (ptr + block_size / 2)
-		&& ((uint32_t)slab->base_addr & SLAB1_BUSY) == SLAB1_BUSY)
-	{
-		slab->base_addr =
-			(void *)((uint32_t)slab->base_addr & (~SLAB1_BUSY));
-	#ifdef DEBUG
-		SYS_LOG_DBG("mem_free to dynamic slab %d slab 1: ptr %p ",slab_index,ptr);
-	#endif
-	}
+/* return the older half of a full magazine and the block being freed */
+static void magazine_flush(struct slabs_info *slabs,
+				struct slab_magazine *magazine, int slab_index, int keep)
+{
+	unsigned int key = irq_lock();
 
-	/*
-	 * if all block mem_free , we need remove this node
-	 * ,and mem_free mem to Superior slab
-	 */
-	if (((uint32_t)slab->base_addr & ALL_SLAB_BUSY) == 0) {
-		free_to_parent = true;
-		ptr = slab->base_addr;
-		sys_slist_find_and_remove(dynamic_list,(sys_snode_t *)slab);
-
-		if (!free_to_stable_slab(slabs, slab)) {
-			SYS_LOG_ERR("mem_free to stable slab "
-							": ptr %p failed ",ptr);
-		}
-	#ifdef DEBUG
-		SYS_LOG_DBG("all block mem_free,we need remove this node"
-					" %d slab all : ptr %p ",slab_index,ptr);
-	#endif
-		goto found_begin;
-	} else {
-		return true;
+	while (magazine->count[slab_index] > keep) {
+		slab_push(slabs, slab_index,
+			magazine->blocks[slab_index][--magazine->count[slab_index]]);
 	}
+
+	irq_unlock(key);
 }
 
-static bool generate_dynamic_slab(struct slabs_info *slabs,
-					uint16_t parent_slab_index, uint16_t son_slab_index)
+static void magazine_flush_all(struct slabs_info *slabs, struct slab_magazine *magazine)
 {
-	struct dynamic_slab_info * new_slab = NULL;
-	void * base_addr = NULL;
-	uint16_t iteration_index = parent_slab_index;
-
-#ifdef DEBUG
-	SYS_LOG_DBG("slab %d is small , get memory form slab %d ",
-				son_slab_index, parent_slab_index);
-#endif
+	int i;
 
-	base_addr = malloc_from_stable_slab(slabs, parent_slab_index);
-	if (base_addr == NULL) {
-		SYS_LOG_ERR("generate dynamic slab failed  because mem_malloc"
-					" from parent slab %d failed",parent_slab_index);
-		return false;
+	for (i = 0; i < slabs->slab_num; i++) {
+		if (magazine->count[i])
+			magazine_flush(slabs, magazine, i, 0);
 	}
+}
 
-begin_new_daynamic_slab:
+int mem_slabs_magazine_attach(struct slabs_info *slabs)
+{
+	k_tid_t tid = k_current_get();
+	int ret = -ENOMEM;
+	unsigned int key;
+	int i;
 
-	iteration_index --;
+	key = irq_lock();
 
-	new_slab = (struct dynamic_slab_info *)malloc_from_stable_slab(slabs, 0);
+	for (i = 0; i < CONFIG_SLAB_MAGAZINE_THREADS; i++) {
+		if (slabs->magazines[i].owner == tid) {
+			ret = 0;
+			break;
+		}
+	}
 
-	if (new_slab != NULL) {
-		new_slab->base_addr = base_addr;
-	} else {
-		SYS_LOG_ERR("slab 0 is small, can't mem_malloc dynamic_slab_node");
-		goto err_end;
+	for (i = 0; ret && i < CONFIG_SLAB_MAGAZINE_THREADS; i++) {
+		if (!slabs->magazines[i].owner) {
+			memset(slabs->magazines[i].count, 0, sizeof(slabs->magazines[i].count));
+			slabs->magazines[i].owner = tid;
+			ret = 0;
+		}
 	}
 
-#ifdef DEBUG
-	SYS_LOG_DBG("new daynamic slab add to slab %d base_addr %p",
-					iteration_index, base_addr);
-#endif
+	irq_unlock(key);
+	return ret;
+}
 
-	sys_slist_append(slabs->slabs[iteration_index].dynamic_slab_list,
-					(sys_snode_t *)new_slab);
+void mem_slabs_magazine_detach(struct slabs_info *slabs)
+{
+	struct slab_magazine *magazine = NULL;
+	k_tid_t tid = k_current_get();
+	int i;
 
-	if (iteration_index > son_slab_index) {
-		base_addr = malloc_from_dynamic_slab(slabs, iteration_index);
-		if (base_addr != NULL) {
-			memset(base_addr, 0, slabs->slabs[iteration_index].block_size);
+	for (i = 0; i < CONFIG_SLAB_MAGAZINE_THREADS; i++) {
+		if (slabs->magazines[i].owner == tid) {
+			magazine = &slabs->magazines[i];
+			break;
 		}
-		goto begin_new_daynamic_slab;
 	}
-	return  true;
-
-err_end:
 
-	if ((iteration_index + 1) == parent_slab_index) {
-		free_to_stable_slab(slabs, base_addr);
-	} else {
-		free_to_dynamic_slab(slabs, base_addr);
+	if (magazine) {
+		magazine_flush_all(slabs, magazine);
+		magazine->owner = NULL;
 	}
-	return  false;
 }
-
-static int find_from_dynamic_slab(struct slabs_info *slabs, int slab_index)
+#else
+int mem_slabs_magazine_attach(struct slabs_info *slabs)
 {
-	sys_snode_t *node, *tmp;
-	struct dynamic_slab_info * slab = NULL;
-	sys_slist_t	* dynamic_list = NULL;
+	return -ENOSYS;
+}
 
-	if (slab_index >= 0 && slab_index < slabs->slab_num) {
+void mem_slabs_magazine_detach(struct slabs_info *slabs)
+{
+}
+#endif /* CONFIG_SLAB_MAGAZINE_THREADS > 0 */
 
-		dynamic_list = slabs->slabs[slab_index].dynamic_slab_list;
+static void *malloc_from_slab(struct slabs_info *slabs, int *slab_index)
+{
+	void *block_ptr = NULL;
+	unsigned int key = irq_lock();
+	u32_t avail;
 
-		SYS_SLIST_FOR_EACH_NODE_SAFE(dynamic_list, node, tmp) {
-			slab = DYNAMIC_SLAB_INFO(node);
-			if (((uint32_t)slab->base_addr & ALL_SLAB_BUSY) != ALL_SLAB_BUSY) {
-				return slab_index;
-			}
-		}
+	/* smallest class with a free block that fits, as the old first fit */
+	avail = slabs->avail_mask & ~(BIT(*slab_index) - 1);
+	if (avail) {
+		*slab_index = __builtin_ctz(avail);
+		block_ptr = slab_pop(slabs, *slab_index);
 	}
-	return slabs->slab_num;
+
+	irq_unlock(key);
+	return block_ptr;
 }
-#endif
 
-static int find_slab_index(struct slabs_info *slabs, unsigned int num_bytes)
+void * mem_slabs_malloc(struct slabs_info * slabs, unsigned int num_bytes)
 {
-	uint8_t i = 0;
-	uint8_t first_fit_slab = slabs->slab_num;
-	uint8_t target_slab_index = slabs->slab_num;
-
-	uint8_t flag=1;
-
-	for(i = 0; i < slabs->slab_num; i++) {
-		if (slabs->slabs[i].block_size >= num_bytes) {
-			target_slab_index = i;
-			if (first_fit_slab == slabs->slab_num) {
-				first_fit_slab = i;
-			}
-			if(k_mem_slab_num_free_get(
-					slabs->slabs[target_slab_index].slab) != 0) {
-				break;		
-			} else {
-				if (flag) {
-					SYS_LOG_DBG("%d ne",slabs->slabs[i].block_size);
-					flag = 0;
-				}
-			}
-		}
+	void * block_ptr = NULL;
+	int slab_index = size_to_slab_index(slabs, num_bytes);
+#if CONFIG_SLAB_MAGAZINE_THREADS > 0
+	struct slab_magazine *magazine;
+#endif
+
+	if (slab_index >= slabs->slab_num) {
+		SYS_LOG_ERR("Memory allocation failed ,block too big num_bytes %d ",
+						num_bytes);
+		return NULL;
 	}
 
-#ifdef CONFIG_USED_DYNAMIC_SLAB
-	if(first_fit_slab >= 0
-		&& target_slab_index < slabs->slab_num
-		&& first_fit_slab != target_slab_index)
-	{
-#ifdef DEBUG
-		SYS_LOG_DBG("first_fit_slab %d ,target_slab_index %d ",
-							first_fit_slab, target_slab_index);
-#endif
-		if(slabs->slabs[target_slab_index].block_size
-			<= slabs->slabs[first_fit_slab].block_size * 2)	{
-			return target_slab_index;
-		}
-		if (find_from_dynamic_slab(slabs, first_fit_slab) != first_fit_slab)	{
-			if(!generate_dynamic_slab(slabs,
-						target_slab_index,first_fit_slab)) {
-				target_slab_index = slabs->slab_num;
-			}
+#if CONFIG_SLAB_MAGAZINE_THREADS > 0
+	magazine = find_magazine(slabs, slab_index);
+	if (magazine) {
+		if (magazine->count[slab_index]) {
+			block_ptr = magazine->blocks[slab_index][--magazine->count[slab_index]];
+		} else {
+			block_ptr = magazine_refill(slabs, magazine, slab_index);
 		}
 
-		if(target_slab_index != slabs->slab_num) {
-			target_slab_index = first_fit_slab;
+		if (!block_ptr) {
+			/* give back what this thread holds before falling back */
+			magazine_flush_all(slabs, magazine);
 		}
 	}
 #endif
 
-	return target_slab_index;
-}
+	if (!block_ptr)
+		block_ptr = malloc_from_slab(slabs, &slab_index);
 
-static void dump_mem_hex(struct slabs_info *slabs, int slab_index)
-{
-	int length= slabs->slabs[slab_index].block_size *
-					slabs->slabs[slab_index].block_num;
-	unsigned char * addr = slabs->slabs[slab_index].slab_base;
-	int num = 0;
+	if (block_ptr == NULL) {
+		SYS_LOG_ERR("Memory allocation failed , num_bytes %d ", num_bytes);
+		return NULL;
+	}
 
-	printk("slab id : %d base addr: %p , lenght %d \n",
-			slab_index,	addr,	length);
+	/* stats are not worth an irq lock, a lost update is harmless */
+	if (slabs->slabs[slab_index].max_size < num_bytes)
+		slabs->slabs[slab_index].max_size = num_bytes;
 
-	printk ("free_list %p next freelist %p \n",
-			slabs->slabs[slab_index].slab->free_list,
-			*(char **)(slabs->slabs[slab_index].slab->free_list));
+	/* clear outside of the irq lock */
+#ifdef CONFIG_SLAB_LAZY_ZERO
+	memset(block_ptr, 0, num_bytes);
+#else
+	memset(block_ptr, 0, slabs->slabs[slab_index].block_size);
+#endif
 
-	for(int i = 0 ; i < length; i++)
-	{
-		if((i % 16) == 0)
-		{
-			printk("\n");
-		}
-		printk(" %2x ",addr[i]);
+	return block_ptr;
+}
+
+void mem_slabs_free(struct slabs_info * slabs, void *ptr)
+{
+	unsigned int key;
+	int slab_index;
+#if CONFIG_SLAB_MAGAZINE_THREADS > 0
+	struct slab_magazine *magazine;
+#endif
+
+	if (ptr == NULL) {
+		SYS_LOG_ERR("Memory Free ERR NULL ");
+		return;
 	}
-	printk("\n");
-	void * free_node = slabs->slabs[slab_index].slab->free_list;
 
-	while(free_node != NULL)
-	{
-		printk("node[%d] %p \n",num++,free_node);
-		free_node = *(char **)free_node;
+	slab_index = find_slab_by_addr(slabs, ptr);
+	if (slab_index >= slabs->slab_num) {
+		SYS_LOG_ERR("Memory Free ERR ptr %p ", ptr);
+		return;
 	}
 
-	if(k_mem_slab_num_free_get(slabs->slabs[slab_index].slab) != num)
-	{
-		printk("mem lost num %d , mem_free %d \n",
-				num,
-				k_mem_slab_num_free_get(slabs->slabs[slab_index].slab));
+#if CONFIG_SLAB_MAGAZINE_THREADS > 0
+	magazine = find_magazine(slabs, slab_index);
+	if (magazine) {
+		if (magazine->count[slab_index] == CONFIG_SLAB_MAGAZINE_DEPTH)
+			magazine_flush(slabs, magazine, slab_index, CONFIG_SLAB_MAGAZINE_DEPTH / 2);
+
+		magazine->blocks[slab_index][magazine->count[slab_index]++] = ptr;
+		return;
 	}
+#endif
 
+	key = irq_lock();
+	slab_push(slabs, slab_index, ptr);
+	irq_unlock(key);
 }
 
-void * mem_slabs_malloc(struct slabs_info * slabs, unsigned int num_bytes)
+void mem_slabs_init(struct slabs_info * slabs)
 {
-	void * block_ptr = NULL;
-	unsigned int key = irq_lock();
-	int slab_index = find_slab_index(slabs, num_bytes);
+	struct slab_info *slab;
+	int i, j, size;
+	char *block;
 
-#ifdef DEBUG
-	SYS_LOG_DBG("Memory mem_malloc  num_bytes %d bytes begin",num_bytes);
-#endif
-	if(slab_index >= slabs->slab_num)
-	{
-		SYS_LOG_ERR("Memory allocation failed ,block too big num_bytes %d ",
-						num_bytes);
-	#ifdef DEBUG
-		dump_stack();
-	#endif
-		goto END;
-	}
+	slabs->avail_mask = 0;
 
-#ifdef CONFIG_USED_DYNAMIC_SLAB
-	block_ptr = malloc_from_dynamic_slab(slabs, slab_index);
-	if(block_ptr != NULL)
-	{
-		memset(block_ptr, 0, num_bytes);
-		goto END;
+	for (i = 0 ; i < slabs->slab_num; i++) {
+		slab = &slabs->slabs[i];
+		slab->slab_end = slab->slab_base + slab->block_size * slab->block_num;
+		slab->free_list = NULL;
+		slab->num_used = slab->block_num;
+
+		/* link blocks so that the lowest address is handed out first */
+		for (j = slab->block_num - 1; j >= 0; j--) {
+			block = slab->slab_base + j * slab->block_size;
+			slab_push(slabs, i, block);
+		}
 	}
-#endif
 
-	block_ptr = malloc_from_stable_slab(slabs, slab_index);
-	if(block_ptr != NULL)
-	{
-		if (slabs->max_size[slab_index] < num_bytes)
-			slabs->max_size[slab_index] = num_bytes;
-		goto END;
+	for (i = 0, j = 0; i < SLAB_SIZE_LOOKUP_NUM; i++) {
+		size = i << SLAB_SIZE_GRANULE_SHIFT;
+		while (j < slabs->slab_num && slabs->slabs[j].block_size < size)
+			j++;
+		slabs->size_to_class[i] = j;
 	}
-END:
-#ifdef DEBUG
-	SYS_LOG_INF("Memory allocation num_bytes %d : block_ptr %p slab_index %d",
-				num_bytes, block_ptr, slab_index);
+
+#if CONFIG_SLAB_MAGAZINE_THREADS > 0
+	memset(slabs->magazines, 0, sizeof(slabs->magazines));
 #endif
-	if(block_ptr == NULL)
-	{
-//		dump_stack();
-		SYS_LOG_ERR("Memory allocation failed , num_bytes %d ", num_bytes);
-	}
-	irq_unlock(key);
-	return block_ptr;
 }
 
-void mem_slabs_free(struct slabs_info * slabs, void *ptr)
+static void dump_mem_hex(struct slabs_info *slabs, int slab_index)
 {
-	unsigned int key = irq_lock();
+	struct slab_info *slab = &slabs->slabs[slab_index];
+	int length = slab->block_size * slab->block_num;
+	unsigned char * addr = (unsigned char *)slab->slab_base;
+	void * free_node = slab->free_list;
+	int num = 0;
 
-#ifdef DEBUG
-	SYS_LOG_DBG("Memory Free  ptr %p begin",ptr);
-#endif
+	printk("slab id : %d base addr: %p , lenght %d \n",
+			slab_index,	addr,	length);
 
-	if (ptr != NULL)
+	for(int i = 0 ; i < length; i++)
 	{
-#ifdef CONFIG_USED_DYNAMIC_SLAB
-		if(free_to_dynamic_slab(slabs, ptr))
-		{
-		#ifdef DEBUG
-			SYS_LOG_INF("Memory Free to dynamic slab ptr %p ",ptr);
-		#endif
-			goto exit;
-		}
-#endif
-		if(!free_to_stable_slab(slabs, ptr))
+		if((i % 16) == 0)
 		{
-		#ifdef DEBUG
-			dump_stack();
-		#endif
-			SYS_LOG_ERR("Memory Free ERR ptr %p ", ptr);
-			goto exit;
+			printk("\n");
 		}
+		printk(" %2x ",addr[i]);
+	}
+	printk("\n");
 
-#ifdef DEBUG
-		SYS_LOG_INF("Memory Free ptr %p ",ptr);
-#endif
-	}else
+	while(free_node != NULL)
 	{
-		SYS_LOG_ERR("Memory Free ERR NULL ");
+		printk("node[%d] %p \n",num++,free_node);
+		free_node = *(char **)free_node;
 	}
-exit:
-	irq_unlock(key);
-}
 
-void slabs_mem_init(struct slabs_info * slabs)
-{
-	for(int i = 0 ; i < slabs->slab_num; i++)
+	if(slab->block_num - slab->num_used != num)
 	{
-		k_mem_slab_init(slabs->slabs[i].slab,
-							slabs->slabs[i].slab_base,
-							slabs->slabs[i].block_size,
-							slabs->slabs[i].block_num);
-#ifdef CONFIG_USED_DYNAMIC_SLAB
-		sys_slist_init(slabs->slabs[i].dynamic_slab_list);
-#endif
+		printk("mem lost num %d , mem_free %d \n",
+				num, slab->block_num - slab->num_used);
 	}
 }
 
@@ -664,51 +463,36 @@ void mem_slabs_dump(struct slabs_info * slabs, int index)
 
 	for(int i = 0 ; i < slabs->slab_num; i++)
 	{
-		total_used += 
-			slabs->slabs[i].block_size *
-			k_mem_slab_num_used_get(slabs->slabs[i].slab);
-		total_size += slabs->slabs[i].block_size *
-			slabs->slabs[i].block_num;
-	}
-	if(slabs->slab_flag == SYSTEM_MEM_SLAB)
-	{
-		printk("system total mem : %d bytes ,used mem %d bytes\n",
-				total_size,
-				total_used);
-	}
-	else
-	{
-		printk("app total mem : %d bytes ,used mem %d bytes \n",
-					total_size,
-					total_used );
+		total_used += slabs->slabs[i].block_size * slabs->slabs[i].num_used;
+		total_size += slabs->slabs[i].block_size * slabs->slabs[i].block_num;
 	}
+
+	printk("%s total mem : %d bytes ,used mem %d bytes\n",
+			(slabs->slab_flag == SYSTEM_MEM_SLAB) ? "system" : "app",
+			total_size, total_used);
+
 	for(int i = 0 ; i < slabs->slab_num; i++)
 	{
 		printk(
 			" mem slab %d :block size %4d : used %4d , mem_free %4d,"
 			" max used %4d, max size %4d\n",
-		 	i ,
+			i ,
 			slabs->slabs[i].block_size,
-			k_mem_slab_num_used_get(slabs->slabs[i].slab),
-			k_mem_slab_num_free_get(slabs->slabs[i].slab),
-			slabs->max_used[i], slabs->max_size[i]);
+			slabs->slabs[i].num_used,
+			slabs->slabs[i].block_num - slabs->slabs[i].num_used,
+			slabs->slabs[i].max_used, slabs->slabs[i].max_size);
 	}
-#ifdef CONFIG_USED_DYNAMIC_SLAB
-	for(int i = 0 ; i < slabs->slab_num; i++)
+
+#if CONFIG_SLAB_MAGAZINE_THREADS > 0
+	for(int i = 0 ; i < CONFIG_SLAB_MAGAZINE_THREADS; i++)
 	{
-		sys_snode_t *node, *tmp;
-		sys_slist_t	* dynamic_list = 
-				 slabs->slabs[i].dynamic_slab_list;
-
-		printk("slab %d dynamic slab list: \n", i);
-
-		SYS_SLIST_FOR_EACH_NODE_SAFE(dynamic_list, node, tmp) {
-			struct dynamic_slab_info * slab = DYNAMIC_SLAB_INFO(node);
-			printk("%8x : %8x %8x \n",
-					((uint32_t)slab->base_addr & (~ALL_SLAB_BUSY)),
-					((uint32_t)slab->base_addr & (SLAB0_BUSY)),
-					((uint32_t)slab->base_addr & (SLAB1_BUSY)));
-		}
+		if (!slabs->magazines[i].owner)
+			continue;
+
+		printk(" magazine %p :", slabs->magazines[i].owner);
+		for (int j = 0; j < slabs->slab_num; j++)
+			printk(" %d", slabs->magazines[i].count[j]);
+		printk("\n");
 	}
 #endif
 
@@ -717,13 +501,3 @@ void mem_slabs_dump(struct slabs_info * slabs, int index)
 		dump_mem_hex(slabs, index);
 	}
 }
-
-
-int mem_slab_init(void)
-{
-	slabs_mem_init((struct slabs_info *)&sys_slab);
-#ifndef APP_USED_SYSTEM_SLAB
-	slabs_mem_init((struct slabs_info *)&app_slab);
-#endif
-	return 0;
-}
@@ -51,6 +51,25 @@ extern "C" {
 	type __max2 = (y);			\
 	__max1 > __max2 ? __max1 : __max2; })
 
+/*
+ * Full memory barrier used by the single-producer/single-consumer (spsc)
+ * routines to order buffer data accesses against the head/tail publish.
+ *
+ * A compiler barrier is not enough here: the ring buffer may be shared with
+ * the DSP (dsp_ptr valid), which observes the memory bus directly, so the
+ * pending cpu writes must be drained by a hardware "sync" before the index
+ * update becomes visible.
+ */
+#if defined(__mips__)
+#define acts_ringbuf_barrier()	__asm__ __volatile__ ("sync" : : : "memory")
+#else
+#define acts_ringbuf_barrier()	__sync_synchronize()
+#endif
+
+/* load/store an index exactly once, never cached in register by compiler */
+#define ACTS_RINGBUF_LOAD(x)		(*(volatile uint32_t *)&(x))
+#define ACTS_RINGBUF_STORE(x, v)	(*(volatile uint32_t *)&(x) = (v))
+
 typedef int (*acts_ringbuf_read_fn)(void *, void *, unsigned int);
 typedef int (*acts_ringbuf_write_fn)(void *, const void *, unsigned int);
 
@@ -68,6 +87,14 @@ struct acts_ringbuf {
 	uint32_t dsp_ptr;	/* in 16-bit words */
 };
 
+/* one contiguous segment of a ring buffer, see acts_ringbuf_get_claim_seg */
+struct acts_ringbuf_seg {
+	/* cpu address of the segment */
+	void *data;
+	/* length of the segment in elements */
+	uint32_t len;
+};
+
 /**
  * @brief Statically define and initialize a high performance ring buffer.
  *
@@ -299,6 +326,42 @@ uint32_t acts_ringbuf_put_claim(struct acts_ringbuf *buf, void **data, uint32_t
  */
 int acts_ringbuf_put_finish(struct acts_ringbuf *buf, uint32_t size);
 
+/**
+ * @brief Get addresses of valid data in a ring buffer, wrap included.
+ *
+ * Unlike @ref acts_ringbuf_get_claim, the claim is not truncated at the
+ * wrap point: the data is described by up to 2 segments, the second one
+ * starting at the beginning of the data area. seg[1].len is 0 if the
+ * claimed data is contiguous. Once data is processed it can be freed
+ * using @ref acts_ringbuf_drop (or @ref acts_ringbuf_spsc_drop).
+ *
+ * @param[in]  buf Address of ring buffer.
+ * @param[out] seg Array of 2 segments filled with the claimed data.
+ * @param[in]  size Requested size in elements.
+ *
+ * @return Number of claimed elements, which can be smaller than requested
+ *	   if there is not enough data.
+ */
+uint32_t acts_ringbuf_get_claim_seg(struct acts_ringbuf *buf,
+		struct acts_ringbuf_seg seg[2], uint32_t size);
+
+/**
+ * @brief Allocate free space of a ring buffer, wrap included.
+ *
+ * Writing counterpart of @ref acts_ringbuf_get_claim_seg. Once data is
+ * written, it can be committed using @ref acts_ringbuf_fill_none (or
+ * @ref acts_ringbuf_spsc_fill_none).
+ *
+ * @param[in]  buf Address of ring buffer.
+ * @param[out] seg Array of 2 segments filled with the allocated space.
+ * @param[in]  size Requested allocation size in elements.
+ *
+ * @return Number of allocated elements, which can be smaller than requested
+ *	   if there is not enough free space.
+ */
+uint32_t acts_ringbuf_put_claim_seg(struct acts_ringbuf *buf,
+		struct acts_ringbuf_seg seg[2], uint32_t size);
+
 /**
  * @brief Copy a ring buffer.
  *
@@ -510,6 +573,125 @@ void *acts_ringbuf_tail_ptr(struct acts_ringbuf *buf, uint32_t *len);
  */
 void acts_ringbuf_defrag(struct acts_ringbuf *buf);
 
+/**
+ * @defgroup acts_ringbuf_spsc Single producer/single consumer routines
+ *
+ * Lock free variants that can be used when exactly one context writes and
+ * exactly one (other) context reads the ring buffer, for instance a thread
+ * and an irq handler, or the cpu and the dsp.
+ *
+ * Ordering guarantees:
+ * - only the producer stores @a tail, only the consumer stores @a head,
+ *   both are naturally aligned 32-bit words, so each store is atomic;
+ * - the producer loads @a head, then issues a barrier before writing data,
+ *   so it never overwrites elements the consumer is still reading;
+ * - the producer issues a barrier after writing data and before publishing
+ *   the new @a tail, so the consumer never sees an index ahead of the data;
+ * - the consumer mirrors this: barrier after loading @a tail and before
+ *   reading data, barrier after reading data and before publishing @a head.
+ *
+ * The same protocol must be followed by the dsp side when @a dsp_ptr is
+ * valid. Mixing these routines with the non-spsc ones on the same side is
+ * allowed, as long as that side is serialized by the caller.
+ * @{
+ */
+
+/**
+ * @brief Determine data length in a ring buffer (spsc).
+ *
+ * @param buf Address of ring buffer.
+ *
+ * @return Ring buffer data length in elements.
+ */
+static inline uint32_t acts_ringbuf_spsc_length(struct acts_ringbuf *buf)
+{
+	return ACTS_RINGBUF_LOAD(buf->tail) - ACTS_RINGBUF_LOAD(buf->head);
+}
+
+/**
+ * @brief Determine free space in a ring buffer (spsc).
+ *
+ * @param buf Address of ring buffer.
+ *
+ * @return Ring buffer free space in elements.
+ */
+static inline uint32_t acts_ringbuf_spsc_space(struct acts_ringbuf *buf)
+{
+	return buf->size - acts_ringbuf_spsc_length(buf);
+}
+
+/**
+ * @brief Read a ring buffer from the consumer side (spsc).
+ *
+ * @param buf Address of ring buffer.
+ * @param data Address of data.
+ * @param size Size of data in elements.
+ *
+ * @return number of elements successfully read, 0 if not enough data.
+ */
+uint32_t acts_ringbuf_spsc_get(struct acts_ringbuf *buf, void *data, uint32_t size);
+
+/**
+ * @brief Write a ring buffer from the producer side (spsc).
+ *
+ * @param buf Address of ring buffer.
+ * @param data Address of data.
+ * @param size Size of data in elements.
+ *
+ * @return number of elements successfully written, 0 if not enough space.
+ */
+uint32_t acts_ringbuf_spsc_put(struct acts_ringbuf *buf, const void *data, uint32_t size);
+
+/**
+ * @brief Publish elements consumed from a claimed buffer (spsc).
+ *
+ * Counterpart of @ref acts_ringbuf_get_finish for the consumer side.
+ *
+ * @param  buf Address of ring buffer.
+ * @param  size Number of elements that can be freed.
+ *
+ * @retval 0 Successful operation.
+ * @retval -EINVAL Provided @a size exceeds valid elements in the ring buffer.
+ */
+int acts_ringbuf_spsc_get_finish(struct acts_ringbuf *buf, uint32_t size);
+
+/**
+ * @brief Publish elements written to a claimed buffer (spsc).
+ *
+ * Counterpart of @ref acts_ringbuf_put_finish for the producer side.
+ *
+ * @param  buf Address of ring buffer.
+ * @param  size Number of valid elements in the allocated buffers.
+ *
+ * @retval 0 Successful operation.
+ * @retval -EINVAL Provided @a size exceeds free space in the ring buffer.
+ */
+int acts_ringbuf_spsc_put_finish(struct acts_ringbuf *buf, uint32_t size);
+
+/**
+ * @brief Drop data of a ring buffer from the consumer side (spsc).
+ *
+ * @param buf Address of ring buffer.
+ * @param size Size of data in elements.
+ *
+ * @return number of elements dropped in elements.
+ */
+uint32_t acts_ringbuf_spsc_drop(struct acts_ringbuf *buf, uint32_t size);
+
+/**
+ * @brief Fill no data of a ring buffer from the producer side (spsc).
+ *
+ * @param buf Address of ring buffer.
+ * @param size Size of data in elements.
+ *
+ * @return number of elements filled.
+ */
+uint32_t acts_ringbuf_spsc_fill_none(struct acts_ringbuf *buf, uint32_t size);
+
+/**
+ * @} end defgroup acts_ringbuf_spsc
+ */
+
 /**
  * @brief Dump information of a ring buffer
  *
@@ -16,6 +16,18 @@ typedef struct file_iterator_param {
 
 	/* match callback to filter path, return 1 if matched */
 	int (*match_fn)(const char *path, int is_dir);
+
+	/*
+	 * key of the play list index kept in topdir, change it when match_fn
+	 * changes what it matches. 0 to always scan the disk.
+	 */
+	u32_t index_key;
+
+	/*
+	 * 1 to scan the disk through iterator_scan() after create, tracks
+	 * can be played while the rest of the disk is scanned.
+	 */
+	u8_t scan_later;
 } file_iterator_param_t;
 
 /**
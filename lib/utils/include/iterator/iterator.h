@@ -44,6 +44,9 @@ typedef struct iterator_ops {
 
 	/* (optional) get plist info in the iteration */
 	int (*get_plist_info)(struct iterator *iter, void *param);
+
+	/* (optional) go on building the iteration, for iterators created without it */
+	int (*scan)(struct iterator *iter, int max_entries);
 } iterator_ops_t;
 
 /** iterator structure */
@@ -209,4 +212,18 @@ const void *iterator_set_track_no(struct iterator *iter, u16_t track_no);
  * @return 0 if succeed, others failed
  */
 int iterator_get_plist_info(struct iterator *iter, void *param);
+
+/**
+ * @brief go on building the iteration.
+ *
+ * This routine provides building the iteration a step at a time, the
+ * elements found so far can be iterated between the steps.
+ *
+ * @param iter address of the iterator
+ *
+ * @param max_entries entries to go through in this step, 0 for all
+ *
+ * @return 1 if more to build, 0 if built, others failed
+ */
+int iterator_scan(struct iterator *iter, int max_entries);
 #endif /* __ITERATOR_H__ */
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief 16 bit pcm dsp kernels
+ *
+ * All kernels saturate to the s16 range. Gains are Q15, a Q15 product is
+ * rounded as (x * gain + 0x4000) >> 15 and saturated, which is what the
+ * MIPS DSP ASE mulq_rs.ph instruction does, so the ASE and the C kernels
+ * give bit exact results. PCM_GAIN_UNITY leaves samples untouched.
+ *
+ * Buffers of 16 bit samples only need 2 byte alignment, kernels fall
+ * back to per sample processing when they cannot use 32 bit accesses.
+ */
+
+#ifndef __PCM_DSP_H__
+#define __PCM_DSP_H__
+
+#include <zephyr/types.h>
+
+/** Q15 gain of 1.0 (passes samples through unchanged) */
+#define PCM_GAIN_UNITY		(0x7FFF)
+/** Q15 gain of 0.5 */
+#define PCM_GAIN_HALF		(0x4000)
+
+/**
+ * @brief saturating add, dst[i] = sat(dst[i] + src[i])
+ */
+void pcm_add_sat(s16_t *dst, const s16_t *src, int samples);
+
+/**
+ * @brief apply Q15 gain in place
+ */
+void pcm_gain_q15(s16_t *buf, s16_t gain, int samples);
+
+/**
+ * @brief mix two buffers of the same layout with per source gains
+ *
+ * dst[i] = sat(q15(a[i], a_gain) + q15(b[i], b_gain)), dst may be a.
+ */
+void pcm_mix_q15(s16_t *dst, const s16_t *a, s16_t a_gain,
+		 const s16_t *b, s16_t b_gain, int samples);
+
+/**
+ * @brief mix planar stereo into interleaved stereo with per source gains
+ *
+ * dst[2i] = sat(q15(a[2i], a_gain) + q15(left[i], b_gain)) and the same
+ * for right on odd samples, dst may be a. left and right may be the same
+ * buffer to mix a mono source into both channels.
+ */
+void pcm_mix_planar_q15(s16_t *dst, const s16_t *a, s16_t a_gain,
+			const s16_t *left, const s16_t *right, s16_t b_gain,
+			int frames);
+
+/**
+ * @brief interleave planar left and right into stereo frames
+ */
+void pcm_interleave(s16_t *dst, const s16_t *left, const s16_t *right, int frames);
+
+/**
+ * @brief split stereo frames into planar left and right
+ */
+void pcm_deinterleave(s16_t *left, s16_t *right, const s16_t *src, int frames);
+
+#endif /* __PCM_DSP_H__ */
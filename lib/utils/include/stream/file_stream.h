@@ -35,6 +35,23 @@
  */
  io_stream_t file_stream_create(const char *param);
 
+/**
+ * @brief create file stream for recording, return stream handle
+ *
+ * Same as file_stream_create, for write only streams that append to a
+ * file for a long time. The file is allocated ahead of the data in steps
+ * of CONFIG_FILE_STREAM_PREALLOC_STEP bytes, contiguous when the volume
+ * allows, and written in aligned units, so appending does not update
+ * the FAT. Closing the stream truncates the file to the data written;
+ * a file left open by a power loss is longer than its data.
+ *
+ * @param param create stream param, file stream is file url
+ *
+ * @return stream handle if create stream success
+ * @return NULL  if create stream failed
+ */
+io_stream_t file_stream_create_prealloc(const char *param);
+
 /**
  * @} end defgroup file_stream_apis
  */
@@ -47,6 +47,57 @@ io_stream_t ringbuff_stream_create(struct acts_ringbuf *param);
  */
 io_stream_t ringbuff_stream_create_ext(void *ring_buff, u32_t ring_buff_size);
 
+/**
+ * @brief claim readable data of ring buffer stream in place
+ *
+ * This routine provides the readable data of the stream as up to 2
+ * segments (the second one is used when data wraps), so that it can be
+ * consumed without copying. The data is released by
+ * ringbuff_stream_get_finish. Attached streams and observers are not
+ * notified.
+ *
+ * @param handle handle of ring buffer stream
+ * @param seg segments filled with the claimed data
+ * @param len bytes user want to read
+ *
+ * @return bytes claimed, which can be smaller than len
+ */
+int ringbuff_stream_get_claim_seg(io_stream_t handle, struct acts_ringbuf_seg seg[2], int len);
+
+/**
+ * @brief release data claimed by ringbuff_stream_get_claim_seg
+ *
+ * @param handle handle of ring buffer stream
+ * @param len bytes consumed
+ *
+ * @return bytes released
+ */
+int ringbuff_stream_get_finish(io_stream_t handle, int len);
+
+/**
+ * @brief claim free space of ring buffer stream in place
+ *
+ * Writing counterpart of ringbuff_stream_get_claim_seg, the data is
+ * committed by ringbuff_stream_put_finish.
+ *
+ * @param handle handle of ring buffer stream
+ * @param seg segments filled with the claimed space
+ * @param len bytes user want to write
+ *
+ * @return bytes claimed, which can be smaller than len
+ */
+int ringbuff_stream_put_claim_seg(io_stream_t handle, struct acts_ringbuf_seg seg[2], int len);
+
+/**
+ * @brief commit data written to space claimed by ringbuff_stream_put_claim_seg
+ *
+ * @param handle handle of ring buffer stream
+ * @param len bytes written
+ *
+ * @return bytes committed
+ */
+int ringbuff_stream_put_finish(io_stream_t handle, int len);
+
 /**
  * @} end defgroup buffer_stream_apis
  */
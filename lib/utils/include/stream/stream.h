@@ -118,6 +118,24 @@ typedef struct {
 	void *(*get_ringbuffer)(io_stream_t handle);
 } stream_ops_t;
 
+/**
+ * structure of optional in place access operations, see stream_read_claim.
+ *
+ * Kept out of stream_ops_t since prebuilt libraries define stream_ops_t
+ * tables of their own; a stream supporting it sets handle->claim_ops in
+ * its init operation.
+ */
+typedef struct {
+	/** get address of contiguous readable data in place */
+	int (*read_claim)(io_stream_t handle, void **buf, int num);
+	/** release num bytes of data got by read_claim */
+	int (*read_commit)(io_stream_t handle, int num);
+	/** get address of contiguous free space in place */
+	int (*write_claim)(io_stream_t handle, void **buf, int num);
+	/** publish num bytes written to space got by write_claim */
+	int (*write_commit)(io_stream_t handle, int num);
+} stream_claim_ops_t;
+
 /**
  * @brief create stream , return stream handle
  *
@@ -178,6 +196,73 @@ int stream_read(io_stream_t handle, unsigned char *buf, int num);
  */
 int stream_write(io_stream_t handle, unsigned char *buf, int num);
 
+/**
+ * @brief claim readable data of stream in place
+ *
+ * This routine provides the address of up to num bytes of contiguous
+ * readable data inside the stream storage, so that user can consume it
+ * without copying. It never blocks, and returns less than num when less
+ * data is available or when the storage wraps. The data must be released
+ * by stream_read_commit before the next claim.
+ *
+ * Streams without in place access return -ENOSYS, user should then fall
+ * back to stream_read.
+ *
+ * @param handle handle of stream
+ * @param buf store the address of claimed data
+ * @param num bytes user want to read
+ *
+ * @return >=0 the claimed data length
+ * @return -ENOSYS stream not support in place access
+ * @return <0 other errors
+ */
+int stream_read_claim(io_stream_t handle, void **buf, int num);
+
+/**
+ * @brief release data claimed by stream_read_claim
+ *
+ * This routine advances the read offset, wakes up blocked writer, and
+ * feeds attached streams and observers as stream_read does.
+ *
+ * @param handle handle of stream
+ * @param num bytes consumed, not more than claimed
+ *
+ * @return >=0 the released data length
+ * @return <0 release failed
+ */
+int stream_read_commit(io_stream_t handle, int num);
+
+/**
+ * @brief claim free space of stream in place
+ *
+ * Writing counterpart of stream_read_claim, the written data must be
+ * published by stream_write_commit.
+ *
+ * @param handle handle of stream
+ * @param buf store the address of claimed space
+ * @param num bytes user want to write
+ *
+ * @return >=0 the claimed space length
+ * @return -ENOSYS stream not support in place access
+ * @return <0 other errors
+ */
+int stream_write_claim(io_stream_t handle, void **buf, int num);
+
+/**
+ * @brief publish data written to space claimed by stream_write_claim
+ *
+ * This routine notifies pre write observers (which may process the data
+ * in place), advances the write offset, wakes up blocked reader, and
+ * feeds attached streams and observers as stream_write does.
+ *
+ * @param handle handle of stream
+ * @param num bytes written, not more than claimed
+ *
+ * @return >=0 the published data length
+ * @return <0 publish failed
+ */
+int stream_write_commit(io_stream_t handle, int num);
+
 /**
  * @brief seek stream
  *
@@ -334,6 +419,61 @@ int stream_detach(io_stream_t origin, io_stream_t attach_stream);
  */
 void stream_dump(io_stream_t stream, const char *name, const char *line_prefix);
 
+/** stream statistics, collected when CONFIG_STREAM_STATISTICS is enabled */
+struct stream_stats {
+	/** bytes read from stream */
+	u32_t read_bytes;
+	/** bytes written to stream */
+	u32_t write_bytes;
+	/** number of read calls */
+	u32_t read_count;
+	/** number of write calls */
+	u32_t write_count;
+	/** reads that returned less than requested */
+	u32_t underrun_count;
+	/** writes that stored less than requested */
+	u32_t overrun_count;
+	/** number of waits for data or space in block mode */
+	u32_t block_count;
+	/** time spent waiting in block mode, in us */
+	u32_t block_time_us;
+	/** max data length seen after a write */
+	u32_t max_fill;
+	/** time spent in observer notify functions, in us */
+	u32_t observer_time_us;
+};
+
+/**
+ * @brief get stream statistics
+ *
+ * This routine provides a snapshot of the stream counters
+ *
+ * @param handle handle of stream
+ * @param stats counters of stream returned
+ *
+ * @return 0 get success
+ * @return -ENOSYS statistics not enabled
+ */
+int stream_get_stats(io_stream_t handle, struct stream_stats *stats);
+
+/**
+ * @brief reset stream statistics
+ *
+ * @param handle handle of stream
+ *
+ * @return N/A
+ */
+void stream_reset_stats(io_stream_t handle);
+
+/**
+ * @brief dump statistics of all live streams
+ *
+ * @param reset reset the counters after dump
+ *
+ * @return N/A
+ */
+void stream_dump_stats(bool reset);
+
 /**
  * @cond INTERNAL_HIDDEN
  */
@@ -383,8 +523,49 @@ struct __stream {
 
 	const stream_ops_t  *ops;
 	void *data;
+
+	/* optional in place access operations */
+	const stream_claim_ops_t *claim_ops;
+	/* data claimed by stream_read_claim / stream_write_claim */
+	void *read_claim_buf;
+	void *write_claim_buf;
+
+	/* bytes a blocked reader waits for, 0 if no reader is waiting */
+	u32_t read_watermark;
+	/* bytes of space a blocked writer waits for, 0 if none */
+	u32_t write_watermark;
+	/* write offset a blocked seek waits for, 0 if none */
+	u32_t seek_watermark;
+	/* block mode timeout in ms, OS_FOREVER to wait forever */
+	s32_t read_timeout;
+	s32_t write_timeout;
+	/* writer waits here for free space, readers wait on sync_sem */
+	os_sem *space_sem;
+
+#ifdef CONFIG_STREAM_STATISTICS
+	/* node in the list of live streams */
+	sys_snode_t node;
+	struct stream_stats stats;
+#endif
 };
 
+/**
+ * @brief set stream block mode timeout
+ *
+ * This routine provides set how long stream_read and stream_write wait
+ * for data or free space in block mode. stream_open sets 1s when
+ * MODE_BLOCK_TIMEOUT is set and OS_FOREVER otherwise, so this must be
+ * called after stream_open.
+ *
+ * @param handle handle of stream
+ * @param read_timeout read timeout in ms, OS_FOREVER to wait forever
+ * @param write_timeout write timeout in ms, OS_FOREVER to wait forever
+ *
+ * @return 0 set success
+ * @return !=0  set failed
+ */
+int stream_set_timeout(io_stream_t handle, s32_t read_timeout, s32_t write_timeout);
+
 /**
  * @brief set stream cache size
  *
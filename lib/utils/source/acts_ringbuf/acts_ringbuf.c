@@ -12,6 +12,40 @@
 #include <misc/util.h>
 #include <acts_ringbuf.h>
 
+/* describe size elements starting at index idx, wrap included */
+static uint32_t _acts_ringbuf_claim_seg(struct acts_ringbuf *buf, uint32_t idx,
+		uint32_t max_size, struct acts_ringbuf_seg seg[2], uint32_t size)
+{
+	uint32_t offset = buf->mask ? (idx & buf->mask) : (idx % buf->size);
+	uint32_t len;
+
+	if (size > max_size)
+		size = max_size;
+
+	len = min_t(uint32_t, buf->size - offset, size);
+
+	seg[0].data = (void *)(buf->cpu_ptr + ACTS_RINGBUF_SIZE8(offset));
+	seg[0].len = len;
+	seg[1].data = (void *)(buf->cpu_ptr);
+	seg[1].len = size - len;
+
+	return size;
+}
+
+static void _acts_ringbuf_seg_to_data(struct acts_ringbuf_seg seg[2], void *data)
+{
+	memcpy(data, seg[0].data, ACTS_RINGBUF_SIZE8(seg[0].len));
+	if (seg[1].len)
+		memcpy(data + ACTS_RINGBUF_SIZE8(seg[0].len), seg[1].data, ACTS_RINGBUF_SIZE8(seg[1].len));
+}
+
+static void _acts_ringbuf_data_to_seg(struct acts_ringbuf_seg seg[2], const void *data)
+{
+	memcpy(seg[0].data, data, ACTS_RINGBUF_SIZE8(seg[0].len));
+	if (seg[1].len)
+		memcpy(seg[1].data, data + ACTS_RINGBUF_SIZE8(seg[0].len), ACTS_RINGBUF_SIZE8(seg[1].len));
+}
+
 int acts_ringbuf_init(struct acts_ringbuf *buf, void *data, uint32_t size)
 {
 	buf->head = 0;
@@ -75,21 +109,13 @@ void acts_ringbuf_free(struct acts_ringbuf *buf)
 
 uint32_t acts_ringbuf_peek(struct acts_ringbuf *buf, void *data, uint32_t size)
 {
-	uint32_t offset, len;
+	struct acts_ringbuf_seg seg[2];
 
-	len = acts_ringbuf_length(buf);
-	if (size > len)
+	if (size > acts_ringbuf_length(buf))
 		return 0;
 
-	offset = buf->mask ? (buf->head & buf->mask) : (buf->head % buf->size);
-
-	len = buf->size - offset;
-	if (len >= size) {
-		memcpy(data, (void *)(buf->cpu_ptr + ACTS_RINGBUF_SIZE8(offset)), ACTS_RINGBUF_SIZE8(size));
-	} else {
-		memcpy(data, (void *)(buf->cpu_ptr + ACTS_RINGBUF_SIZE8(offset)), ACTS_RINGBUF_SIZE8(len));
-		memcpy(data + ACTS_RINGBUF_SIZE8(len), (void *)(buf->cpu_ptr), ACTS_RINGBUF_SIZE8(size - len));
-	}
+	acts_ringbuf_get_claim_seg(buf, seg, size);
+	_acts_ringbuf_seg_to_data(seg, data);
 
 	return size;
 }
@@ -124,21 +150,13 @@ int acts_ringbuf_get_finish(struct acts_ringbuf *buf, uint32_t size)
 
 uint32_t acts_ringbuf_put(struct acts_ringbuf *buf, const void *data, uint32_t size)
 {
-	uint32_t offset, len;
+	struct acts_ringbuf_seg seg[2];
 
-	len = acts_ringbuf_space(buf);
-	if (size > len)
+	if (size > acts_ringbuf_space(buf))
 		return 0;
 
-	offset = buf->mask ? (buf->tail & buf->mask) : (buf->tail % buf->size);
-
-	len = buf->size - offset;
-	if (len >= size) {
-		memcpy((void *)(buf->cpu_ptr + ACTS_RINGBUF_SIZE8(offset)), data, ACTS_RINGBUF_SIZE8(size));
-	} else {
-		memcpy((void *)(buf->cpu_ptr + ACTS_RINGBUF_SIZE8(offset)), data, ACTS_RINGBUF_SIZE8(len));
-		memcpy((void *)(buf->cpu_ptr), data + ACTS_RINGBUF_SIZE8(len), ACTS_RINGBUF_SIZE8(size - len));
-	}
+	acts_ringbuf_put_claim_seg(buf, seg, size);
+	_acts_ringbuf_data_to_seg(seg, data);
 
 	buf->tail += size;
 	return size;
@@ -165,6 +183,18 @@ int acts_ringbuf_put_finish(struct acts_ringbuf *buf, uint32_t size)
 	return 0;
 }
 
+uint32_t acts_ringbuf_get_claim_seg(struct acts_ringbuf *buf,
+		struct acts_ringbuf_seg seg[2], uint32_t size)
+{
+	return _acts_ringbuf_claim_seg(buf, buf->head, acts_ringbuf_length(buf), seg, size);
+}
+
+uint32_t acts_ringbuf_put_claim_seg(struct acts_ringbuf *buf,
+		struct acts_ringbuf_seg seg[2], uint32_t size)
+{
+	return _acts_ringbuf_claim_seg(buf, buf->tail, acts_ringbuf_space(buf), seg, size);
+}
+
 uint32_t acts_ringbuf_copy(struct acts_ringbuf *dst_buf, struct acts_ringbuf *src_buf, uint32_t size)
 {
 	uint32_t src_length = acts_ringbuf_length(src_buf);
@@ -215,30 +245,21 @@ uint32_t acts_ringbuf_copy(struct acts_ringbuf *dst_buf, struct acts_ringbuf *sr
 uint32_t acts_ringbuf_read(struct acts_ringbuf *buf,
 		void *stream, uint32_t size, acts_ringbuf_write_fn stream_write)
 {
-	uint32_t offset, len;
+	struct acts_ringbuf_seg seg[2];
 	int stream_len = 0;
+	int i, ret;
 
-	len = acts_ringbuf_length(buf);
-	if (size > len)
+	if (size > acts_ringbuf_length(buf))
 		return 0;
 
-	offset = buf->mask ? (buf->head & buf->mask) : (buf->head % buf->size);
+	acts_ringbuf_get_claim_seg(buf, seg, size);
 
-	len = buf->size - offset;
-	if (len >= size) {
-		stream_len = stream_write(stream,
-				(void *)(buf->cpu_ptr + ACTS_RINGBUF_SIZE8(offset)),
-				ACTS_RINGBUF_SIZE8(size));
-	} else {
-		stream_len = stream_write(stream,
-				(void *)(buf->cpu_ptr + ACTS_RINGBUF_SIZE8(offset)),
-				ACTS_RINGBUF_SIZE8(len));
-		if (stream_len == ACTS_RINGBUF_SIZE8(len)) {
-			ssize_t tmp = stream_write(stream, (void *)(buf->cpu_ptr),
-									ACTS_RINGBUF_SIZE8(size - len));
-			if (tmp > 0)
-				stream_len += tmp;
-		}
+	for (i = 0; i < ARRAY_SIZE(seg) && seg[i].len > 0; i++) {
+		ret = stream_write(stream, seg[i].data, ACTS_RINGBUF_SIZE8(seg[i].len));
+		if (ret > 0)
+			stream_len += ret;
+		if (ret != ACTS_RINGBUF_SIZE8(seg[i].len))
+			break;
 	}
 
 	if (stream_len > 0) {
@@ -253,30 +274,21 @@ uint32_t acts_ringbuf_read(struct acts_ringbuf *buf,
 uint32_t acts_ringbuf_write(struct acts_ringbuf *buf,
 		void *stream, uint32_t size, acts_ringbuf_read_fn stream_read)
 {
-	uint32_t offset, len;
+	struct acts_ringbuf_seg seg[2];
 	int stream_len = 0;
+	int i, ret;
 
-	len = acts_ringbuf_space(buf);
-	if (size > len)
+	if (size > acts_ringbuf_space(buf))
 		return 0;
 
-	offset = buf->mask ? (buf->tail & buf->mask) : (buf->tail % buf->size);
+	acts_ringbuf_put_claim_seg(buf, seg, size);
 
-	len = buf->size - offset;
-	if (len >= size) {
-		stream_len = stream_read(stream,
-				(void *)(buf->cpu_ptr + ACTS_RINGBUF_SIZE8(offset)),
-				ACTS_RINGBUF_SIZE8(size));
-	} else {
-		stream_len = stream_read(stream,
-				(void *)(buf->cpu_ptr + ACTS_RINGBUF_SIZE8(offset)),
-				ACTS_RINGBUF_SIZE8(len));
-		if (stream_len == ACTS_RINGBUF_SIZE8(len)) {
-			ssize_t tmp = stream_read(stream, (void *)(buf->cpu_ptr),
-									ACTS_RINGBUF_SIZE8(size - len));
-			if (tmp > 0)
-				stream_len += tmp;
-		}
+	for (i = 0; i < ARRAY_SIZE(seg) && seg[i].len > 0; i++) {
+		ret = stream_read(stream, seg[i].data, ACTS_RINGBUF_SIZE8(seg[i].len));
+		if (ret > 0)
+			stream_len += ret;
+		if (ret != ACTS_RINGBUF_SIZE8(seg[i].len))
+			break;
 	}
 
 	if (stream_len > 0) {
@@ -386,6 +398,99 @@ out_exit:
 	buf->head = 0;
 }
 
+uint32_t acts_ringbuf_spsc_get(struct acts_ringbuf *buf, void *data, uint32_t size)
+{
+	uint32_t head = buf->head;	/* only written by us */
+	struct acts_ringbuf_seg seg[2];
+
+	if (size > ACTS_RINGBUF_LOAD(buf->tail) - head)
+		return 0;
+
+	/* do not read data before the tail which covers it */
+	acts_ringbuf_barrier();
+
+	_acts_ringbuf_claim_seg(buf, head, size, seg, size);
+	_acts_ringbuf_seg_to_data(seg, data);
+
+	/* data must be consumed before producer can reuse the space */
+	acts_ringbuf_barrier();
+	ACTS_RINGBUF_STORE(buf->head, head + size);
+	return size;
+}
+
+uint32_t acts_ringbuf_spsc_put(struct acts_ringbuf *buf, const void *data, uint32_t size)
+{
+	uint32_t tail = buf->tail;	/* only written by us */
+	struct acts_ringbuf_seg seg[2];
+
+	if (size > buf->size - (tail - ACTS_RINGBUF_LOAD(buf->head)))
+		return 0;
+
+	/* do not overwrite data before the head which frees it */
+	acts_ringbuf_barrier();
+
+	_acts_ringbuf_claim_seg(buf, tail, size, seg, size);
+	_acts_ringbuf_data_to_seg(seg, data);
+
+	/* data must be visible before the tail which covers it */
+	acts_ringbuf_barrier();
+	ACTS_RINGBUF_STORE(buf->tail, tail + size);
+	return size;
+}
+
+int acts_ringbuf_spsc_get_finish(struct acts_ringbuf *buf, uint32_t size)
+{
+	uint32_t head = buf->head;
+	uint32_t offset = buf->mask ? (head & buf->mask) : (head % buf->size);
+	uint32_t max_size = min_t(uint32_t, buf->size - offset, ACTS_RINGBUF_LOAD(buf->tail) - head);
+
+	if (size > max_size)
+		return -EINVAL;
+
+	acts_ringbuf_barrier();
+	ACTS_RINGBUF_STORE(buf->head, head + size);
+	return 0;
+}
+
+int acts_ringbuf_spsc_put_finish(struct acts_ringbuf *buf, uint32_t size)
+{
+	uint32_t tail = buf->tail;
+	uint32_t offset = buf->mask ? (tail & buf->mask) : (tail % buf->size);
+	uint32_t max_size = min_t(uint32_t, buf->size - offset,
+				  buf->size - (tail - ACTS_RINGBUF_LOAD(buf->head)));
+
+	if (size > max_size)
+		return -EINVAL;
+
+	acts_ringbuf_barrier();
+	ACTS_RINGBUF_STORE(buf->tail, tail + size);
+	return 0;
+}
+
+uint32_t acts_ringbuf_spsc_drop(struct acts_ringbuf *buf, uint32_t size)
+{
+	uint32_t head = buf->head;
+
+	if (size > ACTS_RINGBUF_LOAD(buf->tail) - head)
+		return 0;
+
+	acts_ringbuf_barrier();
+	ACTS_RINGBUF_STORE(buf->head, head + size);
+	return size;
+}
+
+uint32_t acts_ringbuf_spsc_fill_none(struct acts_ringbuf *buf, uint32_t size)
+{
+	uint32_t tail = buf->tail;
+
+	if (size > buf->size - (tail - ACTS_RINGBUF_LOAD(buf->head)))
+		return 0;
+
+	acts_ringbuf_barrier();
+	ACTS_RINGBUF_STORE(buf->tail, tail + size);
+	return size;
+}
+
 void acts_ringbuf_dump(struct acts_ringbuf *buf, const char *name, const char *line_prefix)
 {
 	printk("%s%s: %p\n", line_prefix, name, buf);
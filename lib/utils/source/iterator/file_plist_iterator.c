@@ -10,6 +10,7 @@
 #include <fs_manager.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <crc.h>
 
 #define MAX_DIR_LEVEL 9
 #define FULL_PATH_LEN (MAX_URL_LEN + 2)
@@ -26,6 +27,10 @@ struct  folder_info_t {
 	u32_t cur_cluster;		/*Current cluster*/
 	u16_t dir_file_count;	/*valid file count*/
 	u8_t dir_layer;	/*curent dir in disk layer */
+#if CONFIG_PLIST_INDEX
+	u32_t file_crc;			/*crc of the file entries*/
+	u32_t dir_crc;			/*crc of the sub folder entries*/
+#endif
 };
 struct play_list_t {
 	struct  folder_info_t *folder_info[CONFIG_PLIST_SUPPORT_FOLDER_CNT];
@@ -36,9 +41,13 @@ struct play_list_t {
 	u16_t dir_file_seq_num;	/*curent file in folder sequence number*/
 	u8_t fs_type;	/*fs type:1--fat12/fat16,0--fat32/exfat */
 	u8_t mode;				/*play mode 0--Full cycle;1--single cycle;2--full,no cycle;3--folder cycle*/
+	u8_t scanning;			/*disk not scanned to the end yet*/
 	u16_t csize;			/* Cluster size [sectors] */
 	const char *topdir;
 	int (*match_fn)(const char *path, int is_dir);
+#if CONFIG_PLIST_INDEX
+	u32_t vsn;				/*volume serial number*/
+#endif
 };
 
 static struct play_list_t *play_list = NULL;
@@ -47,6 +56,17 @@ struct file_iterator_data {
 	u8_t has_query_next : 1; /* indicate whether has_next has been called */
 	u8_t has_query_prev : 1; /* indicate whether has_prev has been called */
 
+	/* scan state, kept between scan steps */
+	u8_t is_file_type : 1;   /* reading the files of a folder, dirs next */
+	u8_t has_sub_folder : 1;
+	u8_t cursor_pending : 1; /* cursor not reached by the scan yet */
+	u32_t dir_cluster;       /* cluster of the folder being read */
+	u32_t cursor_cluster;
+	u32_t cursor_blk_ofs;
+	u32_t cursor_file_size;
+	char *cursor_path;
+	struct file_iterator_param param;
+
 	/* cached dir structures */
 	s16_t level;
 	u16_t max_level;
@@ -57,6 +77,7 @@ struct file_iterator_data {
 	u16_t fname_len;  /* name len of current file */
 	u16_t full_len;   /* name len of full path */
 	char *full_path;  /* store the full path */
+	char *url;        /* path returned, full_path unless scanning later */
 
 	struct file_iterator_cursor cursor;
 
@@ -76,21 +97,49 @@ static int file_iterator_get_plist_info(struct iterator *iter, void *param)
 	return 0;
 }
 
-static int file_iterator_destroy(struct iterator *iter)
+/* release what only the scan needs */
+static void file_iterator_scan_free(struct file_iterator_data *data)
 {
-	struct file_iterator_data *data = iter->data;
 	int i;
 
-	if (data->dirent)
+	for (i = data->level; i >= 0; i--) {
+		if (data->dirs[i])
+			fs_closedir(data->dirs[i]);
+	}
+	data->level = -1;
+
+	if (data->dirent) {
 		mem_free(data->dirent);
+		data->dirent = NULL;
+	}
 
 	for (i = 0; i < data->max_level; i++) {
 		if (data->dirs[i]) {
 			mem_free(data->dirs[i]);
+			data->dirs[i] = NULL;
 		}
 	}
-	if (data->dname_len)
+
+	if (data->dname_len) {
 		mem_free(data->dname_len);
+		data->dname_len = NULL;
+	}
+
+	if (data->cursor_path) {
+		mem_free(data->cursor_path);
+		data->cursor_path = NULL;
+	}
+}
+
+static int file_iterator_destroy(struct iterator *iter)
+{
+	struct file_iterator_data *data = iter->data;
+	int i;
+
+	file_iterator_scan_free(data);
+
+	if (data->url && data->url != data->full_path)
+		mem_free(data->url);
 
 	if (data->full_path)
 		mem_free(data->full_path);
@@ -329,17 +378,17 @@ static int file_dirname_get(struct play_list_t *plist, struct iterator *iter)
 		(plist->fs_type && plist->folder_info[temp_folder_seq]->far_cluster != FAT16_FAR_CLUST));
 
 	/*get file path*/
-	memset(data->full_path, 0, FULL_PATH_LEN);
-	strcpy(data->full_path, plist->topdir);
+	memset(data->url, 0, FULL_PATH_LEN);
+	strcpy(data->url, plist->topdir);
 
-	if (data->full_path[strlen(data->full_path) - 1] != ':')
-		data->full_path[strlen(data->full_path)] = '/';
+	if (data->url[strlen(data->url) - 1] != ':')
+		data->url[strlen(data->url)] = '/';
 
-	get_pos_seq_file_path(path_buff, data->full_path);
-	data->cursor.path = data->full_path;
+	get_pos_seq_file_path(path_buff, data->url);
+	data->cursor.path = data->url;
 	iter->cursor = &data->cursor;
 
-	SYS_LOG_DBG("full_path:%s\n", data->full_path);
+	SYS_LOG_DBG("full_path:%s\n", data->url);
 
 exit:
 	if(path_buff)
@@ -388,14 +437,14 @@ static int file_dirname_get(struct play_list_t *plist, struct iterator *iter)
 	}
 
 	/*get file path*/
-	memset(data->full_path, 0, FULL_PATH_LEN);
-	snprintf(data->full_path, FULL_PATH_LEN, "%s%s/%s%u/%zu/%zu", OPEN_MODE, plist->topdir, CLUSTER,
+	memset(data->url, 0, FULL_PATH_LEN);
+	snprintf(data->url, FULL_PATH_LEN, "%s%s/%s%u/%zu/%zu", OPEN_MODE, plist->topdir, CLUSTER,
 		plist->folder_info[plist->folder_seq_num]->cur_cluster, dp->blk_ofs, entry->size);
 
-	data->cursor.path = data->full_path;
+	data->cursor.path = data->url;
 	iter->cursor = &data->cursor;
 
-	SYS_LOG_DBG("full_path:%s\n", data->full_path);
+	SYS_LOG_DBG("full_path:%s\n", data->url);
 
 exit:
 	if(zdp)
@@ -424,7 +473,7 @@ static const void *file_iterator_set_track_no(struct iterator *iter, u16_t track
 
 	data->has_query_next = 0;
 	data->has_query_prev = 0;
-	return data->full_path;
+	return data->url;
 }
 
 static int file_iterator_set_mode(struct iterator *iter, u8_t mode)
@@ -446,12 +495,17 @@ static const void *file_iterator_prev_folder(struct iterator *iter, u16_t *track
 	if (!plist || !plist->sum_file_count)
 		return NULL;
 
+	/* the first folder goes back to the last one */
+	if (plist->scanning &&
+		(data->cursor_pending || plist->file_seq_num <= plist->dir_file_seq_num))
+		return NULL;
+
 	calc_next_folder_playlist_info(plist, 0);
 
 	if (file_dirname_get(plist, iter))
 		return NULL;
 	*(u16_t *)track_no = plist->file_seq_num;
-	return data->full_path;
+	return data->url;
 }
 
 static const void *file_iterator_next_folder(struct iterator *iter, u16_t *track_no)
@@ -462,12 +516,18 @@ static const void *file_iterator_next_folder(struct iterator *iter, u16_t *track
 	if (!plist || !plist->sum_file_count)
 		return NULL;
 
+	/* the first file of the next folder must have been scanned */
+	if (plist->scanning && (data->cursor_pending ||
+		plist->file_seq_num - plist->dir_file_seq_num
+		+ plist->folder_info[plist->folder_seq_num]->dir_file_count >= plist->sum_file_count))
+		return NULL;
+
 	calc_next_folder_playlist_info(plist, 1);
 
 	if (file_dirname_get(plist, iter))
 		return NULL;
 	*(u16_t *)track_no = plist->file_seq_num;
-	return data->full_path;
+	return data->url;
 }
 
 static const void *next(struct iterator *iter, bool force_switch, u16_t *track_no)
@@ -477,6 +537,10 @@ static const void *next(struct iterator *iter, bool force_switch, u16_t *track_n
 
 	if (!plist || !plist->sum_file_count)
 		return NULL;
+	/*the last scanned file may not be the last one*/
+	if (plist->scanning &&
+		(data->cursor_pending || plist->file_seq_num >= plist->sum_file_count))
+		return NULL;
 	/*no cycle in mode 2*/
 	if (plist->mode == 2 && plist->file_seq_num == plist->sum_file_count && !force_switch)
 		return NULL;
@@ -491,7 +555,7 @@ static const void *next(struct iterator *iter, bool force_switch, u16_t *track_n
 		return NULL;
 	if (track_no)
 		*(u16_t *)track_no = plist->file_seq_num;
-	return data->full_path;
+	return data->url;
 }
 
 static int file_iterator_has_next(struct iterator *iter)
@@ -534,6 +598,11 @@ static const void *prev(struct iterator *iter, u16_t *track_no)
 
 	if (!plist || !plist->sum_file_count)
 		return NULL;
+	/*the first file goes back to the last one*/
+	if (plist->scanning && (data->cursor_pending || plist->file_seq_num <= 1 ||
+		(plist->mode == 3 && plist->dir_file_seq_num == 1 &&
+		plist->folder_seq_num == plist->sum_folder_count)))
+		return NULL;
 	/*folder cycle in mode 3*/
 	if (plist->mode == 3 && plist->dir_file_seq_num == 1)
 		plist->file_seq_num += plist->folder_info[plist->folder_seq_num]->dir_file_count;
@@ -544,7 +613,7 @@ static const void *prev(struct iterator *iter, u16_t *track_no)
 		return NULL;
 	if (track_no)
 		*(u16_t *)track_no = plist->file_seq_num;
-	return data->full_path;
+	return data->url;
 
 }
 
@@ -648,6 +717,11 @@ static int file_iterator_playlist_init(struct play_list_t *plist, struct file_it
 
 	plist->folder_info[0]->dir_file_count = 0;
 	plist->folder_info[0]->dir_layer = 0;
+#if CONFIG_PLIST_INDEX
+	plist->folder_info[0]->file_crc = 0;
+	plist->folder_info[0]->dir_crc = 0;
+	plist->vsn = dp->obj.fs->vsn;
+#endif
 	SYS_LOG_INF("fs info %s cur_cluster=%d,csize=%d\n",
 		data->full_path, plist->folder_info[0]->cur_cluster, plist->csize);
 	fs_closedir(zdp);
@@ -710,6 +784,10 @@ static int file_iterator_playlist_set(struct play_list_t *plist, fs_dir_t *zdp,
 	plist->folder_info[folder_index]->cur_cluster = dp->clust;
 	plist->folder_info[folder_index]->dir_file_count = 0;
 	plist->folder_info[folder_index]->dir_layer = layer;
+#if CONFIG_PLIST_INDEX
+	plist->folder_info[folder_index]->file_crc = 0;
+	plist->folder_info[folder_index]->dir_crc = 0;
+#endif
 	SYS_LOG_DBG("folder_index=%d,cur_cluster= %zu,layer=%d\n", folder_index, dp->clust, layer);
 	return 0;
 }
@@ -760,32 +838,392 @@ exit:
 
 }
 
-static const char *file_iterator_scan_disk(struct play_list_t *plist, struct iterator *iter, const void *param)
+#if CONFIG_PLIST_INDEX
+#define PLIST_INDEX_NAME	"PLIST.IDX"
+#define PLIST_INDEX_MAGIC	0x58494C50	/* "PLIX" */
+#define PLIST_INDEX_VERSION	2
+
+/* index file: head, then folder_cnt folder_info_t records */
+struct plist_index_head {
+	u32_t magic;
+	u16_t version;
+	u16_t folder_size;		/*sizeof(struct folder_info_t)*/
+	u32_t key;				/*index_key of the iterator param*/
+	u32_t vsn;				/*volume serial number*/
+	u32_t topdir_crc;		/*crc of topdir and max_level*/
+	u16_t folder_cnt;
+	u16_t file_cnt;
+	u32_t tree_crc;			/*crc of the folder records*/
+};
+
+/*
+ * The file and sub folder entries of a folder are summed in two crcs
+ * while it is scanned, the index can then be checked one folder at a
+ * time without walking paths. Hidden entries are skipped as in scan.
+ */
+static void plist_index_crc_entry(struct folder_info_t *folder, struct fs_dirent *entry)
+{
+	int len = strlen(entry->name) + 1;
+
+	/* the index file itself is not part of the play list */
+	if (!strcmp(entry->name, PLIST_INDEX_NAME))
+		return;
+
+	if (entry->type == FS_DIR_ENTRY_DIR) {
+		folder->dir_crc = utils_crc32(folder->dir_crc, (const u8_t *)entry->name, len);
+	} else {
+		folder->file_crc = utils_crc32(folder->file_crc, (const u8_t *)entry->name, len);
+		folder->file_crc = utils_crc32(folder->file_crc, (const u8_t *)&entry->size, sizeof(entry->size));
+	}
+}
+
+/*
+ * Scan stops in the middle of a folder when the file count is full, the
+ * rest of the folder still goes into its crcs so the index stays valid.
+ */
+static void plist_index_crc_rest(struct play_list_t *plist, struct file_iterator_data *data)
+{
+	struct folder_info_t *folder = plist->folder_info[plist->sum_folder_count];
+
+	while (!fs_readdir(data->dirs[data->level], data->dirent)) {
+		if (data->dirent->name[0] == 0)
+			break;
+		if (data->dirent->name[0] != '.')
+			plist_index_crc_entry(folder, data->dirent);
+	}
+}
+
+static void plist_index_path(char *path, const char *topdir)
+{
+	int len = strlen(topdir);
+
+	snprintf(path, FULL_PATH_LEN, "%s%s%s", topdir,
+		(topdir[len - 1] == ':' || topdir[len - 1] == '/') ? "" : "/", PLIST_INDEX_NAME);
+}
+
+static u32_t plist_index_topdir_crc(const struct file_iterator_param *iter_param)
+{
+	u32_t crc = utils_crc32(0, (const u8_t *)iter_param->topdir, strlen(iter_param->topdir));
+
+	return utils_crc32(crc, (const u8_t *)&iter_param->max_level, sizeof(iter_param->max_level));
+}
+
+static u32_t plist_index_tree_crc(struct play_list_t *plist)
+{
+	u32_t crc = 0;
+	int i;
+
+	for (i = 0; i <= plist->sum_folder_count; i++)
+		crc = utils_crc32(crc, (const u8_t *)plist->folder_info[i], sizeof(struct folder_info_t));
+
+	return crc;
+}
+
+static void plist_index_save(struct play_list_t *plist, const struct file_iterator_param *iter_param)
+{
+	struct plist_index_head head;
+	fs_file_t *fp = mem_malloc(sizeof(fs_file_t));
+	char *path = mem_malloc(FULL_PATH_LEN);
+	int len = sizeof(head);
+	int res, i;
+
+	if (!fp || !path)
+		goto exit;
+
+	memset(&head, 0, sizeof(head));
+	head.magic = PLIST_INDEX_MAGIC;
+	head.version = PLIST_INDEX_VERSION;
+	head.folder_size = sizeof(struct folder_info_t);
+	head.key = iter_param->index_key;
+	head.vsn = plist->vsn;
+	head.topdir_crc = plist_index_topdir_crc(iter_param);
+	head.folder_cnt = plist->sum_folder_count + 1;
+	head.file_cnt = plist->sum_file_count;
+	head.tree_crc = plist_index_tree_crc(plist);
+
+	plist_index_path(path, plist->topdir);
+	res = fs_open(fp, path);
+	if (res) {
+		SYS_LOG_WRN("open %s failed (res=%d)\n", path, res);
+		goto exit;
+	}
+
+	res = (fs_write(fp, &head, sizeof(head)) != sizeof(head));
+	for (i = 0; !res && i <= plist->sum_folder_count; i++) {
+		res = (fs_write(fp, plist->folder_info[i], sizeof(struct folder_info_t))
+				!= sizeof(struct folder_info_t));
+		len += sizeof(struct folder_info_t);
+	}
+
+	if (!res)
+		res = fs_truncate(fp, len);
+
+	fs_close(fp);
+
+	if (res) {
+		SYS_LOG_WRN("write %s failed\n", path);
+		fs_unlink(path);
+	}
+
+exit:
+	if (fp)
+		mem_free(fp);
+	if (path)
+		mem_free(path);
+}
+
+/*
+ * Read the folders of the index again and check them against their crcs.
+ * Renamed, added, removed or resized files only change the file counts of
+ * their folder, a changed sub folder list needs a full scan (-EAGAIN).
+ * Files over MAX_SUPPORT_FILE_CNT are dropped from the last folders.
+ * Return the number of folders updated.
+ */
+static int plist_index_update(struct play_list_t *plist)
+{
+	struct folder_info_t *folder;
+	struct folder_info_t check;
+	fs_dir_t *zdp = mem_malloc(sizeof(fs_dir_t));
+	struct fs_dirent *entry = mem_malloc(sizeof(struct fs_dirent));
+	u32_t sum_file = 0;
+	u16_t count;
+	int res = -ENOMEM;
+	int i, updated = 0;
+
+	if (!zdp || !entry)
+		goto exit;
+
+	for (i = 0; i <= plist->sum_folder_count; i++) {
+		folder = plist->folder_info[i];
+
+		res = fs_opendir_cluster(zdp, plist->topdir, folder->cur_cluster, 0);
+		if (res) {
+			SYS_LOG_WRN("fs_opendir folder %d failed (res=%d)\n", i, res);
+			goto exit;
+		}
+
+		check.file_crc = 0;
+		check.dir_crc = 0;
+		count = 0;
+
+		do {
+			res = fs_readdir(zdp, entry);
+			if (res || entry->name[0] == 0)
+				break;
+			if (entry->name[0] == '.')
+				continue;
+
+			plist_index_crc_entry(&check, entry);
+			if (entry->type == FS_DIR_ENTRY_FILE && plist->match_fn && plist->match_fn(entry->name, 0))
+				count++;
+		} while (1);
+
+		fs_closedir(zdp);
+		if (res)
+			goto exit;
+
+		/* folders were added or removed, scan all again */
+		if (check.dir_crc != folder->dir_crc) {
+			SYS_LOG_INF("folder %d sub folders changed\n", i);
+			res = -EAGAIN;
+			goto exit;
+		}
+
+		if (check.file_crc != folder->file_crc) {
+			folder->file_crc = check.file_crc;
+			folder->dir_file_count = count;
+			updated++;
+		}
+
+		/* keep the file count capped as scan does */
+		if (sum_file + folder->dir_file_count > MAX_SUPPORT_FILE_CNT) {
+			folder->dir_file_count = MAX_SUPPORT_FILE_CNT - sum_file;
+			updated++;
+		}
+
+		sum_file += folder->dir_file_count;
+	}
+
+	plist->sum_file_count = sum_file;
+	SYS_LOG_INF("%d folders updated\n", updated);
+	res = updated;
+
+exit:
+	if (zdp)
+		mem_free(zdp);
+	if (entry)
+		mem_free(entry);
+	return res;
+}
+
+/* locate the cursor file in its folder, as scan does */
+static void plist_index_set_cursor(struct play_list_t *plist, const struct file_iterator_cursor *cursor)
+{
+	fs_dir_t *zdp = NULL;
+	struct fs_dirent *entry = NULL;
+	u32_t cursor_cluster, cursor_blk_ofs, cursor_file_size;
+	u32_t sum_file = 0;
+	u16_t count = 0;
+	int i, res;
+
+	if (!cursor || !cursor->path ||
+		get_cursor_info(cursor->path, &cursor_cluster, &cursor_blk_ofs, &cursor_file_size))
+		return;
+
+	for (i = 0; i <= plist->sum_folder_count; i++) {
+		if (plist->folder_info[i]->cur_cluster == cursor_cluster)
+			break;
+		sum_file += plist->folder_info[i]->dir_file_count;
+	}
+
+	if (i > plist->sum_folder_count)
+		return;
+
+	zdp = mem_malloc(sizeof(fs_dir_t));
+	entry = mem_malloc(sizeof(struct fs_dirent));
+	if (!zdp || !entry)
+		goto exit;
+
+	if (fs_opendir_cluster(zdp, plist->topdir, cursor_cluster, 0))
+		goto exit;
+
+	do {
+		res = fs_readdir(zdp, entry);
+		if (res || entry->name[0] == 0)
+			break;
+		if (entry->name[0] == '.' || entry->type != FS_DIR_ENTRY_FILE)
+			continue;
+		if (!plist->match_fn || !plist->match_fn(entry->name, 0))
+			continue;
+
+		count++;
+		if (zdp->dp.blk_ofs == cursor_blk_ofs && (u32_t)entry->size == cursor_file_size) {
+			plist->dir_file_seq_num = count;
+			plist->file_seq_num = sum_file + count;
+			plist->folder_seq_num = i;
+			SYS_LOG_INF("cur file_seq_num=%d,dir_file_seq_num=%d,folder_seq_num=%d\n",
+				plist->file_seq_num, plist->dir_file_seq_num, plist->folder_seq_num);
+			break;
+		}
+	} while (count < plist->folder_info[i]->dir_file_count);
+
+	fs_closedir(zdp);
+
+exit:
+	if (zdp)
+		mem_free(zdp);
+	if (entry)
+		mem_free(entry);
+}
+
+/* load the play list from the index, the disk is scanned if this fails */
+static int plist_index_load(struct play_list_t *plist, const struct file_iterator_param *iter_param)
+{
+	struct plist_index_head head;
+	fs_file_t *fp = mem_malloc(sizeof(fs_file_t));
+	char *path = mem_malloc(FULL_PATH_LEN);
+	int res = -ENOMEM;
+	int i;
+
+	if (!fp || !path)
+		goto exit;
+
+	plist_index_path(path, plist->topdir);
+	res = fs_open(fp, path);
+	if (res)
+		goto exit;
+
+	res = -EINVAL;
+	if (fs_read(fp, &head, sizeof(head)) != sizeof(head)
+		|| head.magic != PLIST_INDEX_MAGIC
+		|| head.version != PLIST_INDEX_VERSION
+		|| head.folder_size != sizeof(struct folder_info_t)
+		|| head.key != iter_param->index_key
+		|| head.vsn != plist->vsn
+		|| head.topdir_crc != plist_index_topdir_crc(iter_param)
+		|| head.folder_cnt == 0
+		|| head.folder_cnt > CONFIG_PLIST_SUPPORT_FOLDER_CNT) {
+		fs_close(fp);
+		goto exit;
+	}
+
+	for (i = 0; i < head.folder_cnt; i++) {
+		if (fs_read(fp, plist->folder_info[i], sizeof(struct folder_info_t))
+				!= sizeof(struct folder_info_t))
+			break;
+	}
+
+	fs_close(fp);
+
+	plist->sum_folder_count = head.folder_cnt - 1;
+	plist->sum_file_count = head.file_cnt;
+	plist->file_seq_num = 0;
+	plist->folder_seq_num = 0;
+	plist->dir_file_seq_num = 0;
+
+	if (i < head.folder_cnt || head.tree_crc != plist_index_tree_crc(plist))
+		goto exit;
+
+	/* the disk may have been changed elsewhere, check every folder */
+	res = plist_index_update(plist);
+	if (res < 0)
+		goto exit;
+
+	if (res > 0)
+		plist_index_save(plist, iter_param);
+
+	plist_index_set_cursor(plist, iter_param->cursor);
+	res = 0;
+
+exit:
+	if (fp)
+		mem_free(fp);
+	if (path)
+		mem_free(path);
+	return res;
+}
+#endif
+
+static void file_iterator_scan_begin(struct play_list_t *plist, struct iterator *iter, const void *param)
 {
 	struct file_iterator_data *data = iter->data;
 	const struct file_iterator_param *iter_param = (struct file_iterator_param *)param;
 	const struct file_iterator_cursor *cursor = iter_param->cursor;
+
+	iter->cursor = NULL;
+	plist->scanning = 1;
+
+	data->is_file_type = 1;
+	data->has_sub_folder = 0;
+	data->dir_cluster = data->dirs[0]->dp.clust;
+
+	/* the caller's cursor may not live as long as a later scan */
+	if (cursor && cursor->path) {
+		get_cursor_info(cursor->path, &data->cursor_cluster, &data->cursor_blk_ofs, &data->cursor_file_size);
+		data->cursor_path = mem_malloc(strlen(cursor->path) + 1);
+		if (data->cursor_path) {
+			strcpy(data->cursor_path, cursor->path);
+			data->cursor_pending = 1;
+		}
+	}
+}
+
+/* return 1 if max_entries were read before the end of the disk */
+static int file_iterator_scan_disk(struct play_list_t *plist, struct iterator *iter, int max_entries)
+{
+	struct file_iterator_data *data = iter->data;
 	int res = -ENOENT;
+	int entries = 0;
 	u16_t len;
-	u8_t is_file_type = 1;
-	u8_t has_sub_folder = 0;
-	u32_t cursor_cluster = 0;
-	u32_t cursor_blk_ofs = 0;
-	u32_t cursor_file_size = 0;
-	u32_t temp_cluster = 0;
 	DIR* dp = NULL;
 
-	iter->cursor = NULL;
 	if (data->level < 0)
-		return NULL;
-
-	if (cursor->path)
-		get_cursor_info(cursor->path, &cursor_cluster, &cursor_blk_ofs, &cursor_file_size);
-
-	dp = &(data->dirs[data->level]->dp);
-	temp_cluster = dp->clust;
+		return 0;
 
 	do {
+		if (max_entries > 0 && ++entries > max_entries)
+			return 1;
+
 		res = fs_readdir(data->dirs[data->level], data->dirent);
 		if (res)
 			SYS_LOG_ERR("fs_readdir failed (res=%d), skip this\n", res);
@@ -800,14 +1238,14 @@ static const char *file_iterator_scan_disk(struct play_list_t *plist, struct ite
 		if (res || data->dirent->name[0] == 0) {
 			fs_closedir(data->dirs[data->level]);
 
-			if (data->level == 0 && (is_file_type == 0 || has_sub_folder == 0)) {
+			if (data->level == 0 && (data->is_file_type == 0 || data->has_sub_folder == 0)) {
 				data->level = -1;
-				return NULL;
+				return 0;
 			}
 
-			if (is_file_type && has_sub_folder) {
-				is_file_type = 0;
-				has_sub_folder = 0;
+			if (data->is_file_type && data->has_sub_folder) {
+				data->is_file_type = 0;
+				data->has_sub_folder = 0;
 				/*remove file name*/
 				data->full_len -= data->fname_len;
 				data->full_path[data->full_len] = 0;
@@ -829,7 +1267,7 @@ static const char *file_iterator_scan_disk(struct play_list_t *plist, struct ite
 			data->fname_len = 0;
 			data->level--;
 			SYS_LOG_DBG("up to dir %s\n", data->full_path);
-			is_file_type = 0;
+			data->is_file_type = 0;
 			continue;
 		}
 
@@ -837,6 +1275,11 @@ static const char *file_iterator_scan_disk(struct play_list_t *plist, struct ite
 		if (data->dirent->name[0] == '.')
 			continue;
 
+	#if CONFIG_PLIST_INDEX
+		if (data->is_file_type)
+			plist_index_crc_entry(plist->folder_info[plist->sum_folder_count], data->dirent);
+	#endif
+
 		/* manage the full path */
 		len = (u16_t)strlen(data->dirent->name);
 		data->full_len -= data->fname_len;
@@ -860,14 +1303,17 @@ static const char *file_iterator_scan_disk(struct play_list_t *plist, struct ite
 		}
 
 		/* This is a file, file count ++ in file type mode */
-		if (data->dirent->type == FS_DIR_ENTRY_FILE && is_file_type) {
+		if (data->dirent->type == FS_DIR_ENTRY_FILE && data->is_file_type) {
 			plist->folder_info[plist->sum_folder_count]->dir_file_count++;
 			plist->sum_file_count++;
 
 			/*set cursor*/
-			if (cursor && cursor->path && 
-				((temp_cluster == cursor_cluster && dp->blk_ofs == cursor_blk_ofs && (u32_t)(data->dirent->size) == cursor_file_size)
-				|| !strcmp(cursor->path, data->full_path))) {
+			dp = &(data->dirs[data->level]->dp);
+			if (data->cursor_path &&
+				((data->dir_cluster == data->cursor_cluster && dp->blk_ofs == data->cursor_blk_ofs
+				&& (u32_t)(data->dirent->size) == data->cursor_file_size)
+				|| !strcmp(data->cursor_path, data->full_path))) {
+				data->cursor_pending = 0;
 				plist->dir_file_seq_num = plist->folder_info[plist->sum_folder_count]->dir_file_count;
 				plist->file_seq_num = plist->sum_file_count;
 				plist->folder_seq_num = plist->sum_folder_count;
@@ -877,19 +1323,22 @@ static const char *file_iterator_scan_disk(struct play_list_t *plist, struct ite
 
 			if (plist->sum_file_count == MAX_SUPPORT_FILE_CNT) {
 				SYS_LOG_WRN("exceed max count\n");
+			#if CONFIG_PLIST_INDEX
+				plist_index_crc_rest(plist, data);
+			#endif
 				break;
 			}
 			continue;
 		}
 
 		/* This is a file, file count no change in dir type mode */
-		if (data->dirent->type == FS_DIR_ENTRY_FILE && is_file_type == 0) {
+		if (data->dirent->type == FS_DIR_ENTRY_FILE && data->is_file_type == 0) {
 			continue;
 		}
 
 		/* This is a dir, set had sub folder flag in file type mode */
-		if (data->dirent->type == FS_DIR_ENTRY_DIR && is_file_type) {
-			has_sub_folder = 1;
+		if (data->dirent->type == FS_DIR_ENTRY_DIR && data->is_file_type) {
+			data->has_sub_folder = 1;
 			continue;
 		}
 
@@ -917,7 +1366,7 @@ static const char *file_iterator_scan_disk(struct play_list_t *plist, struct ite
 
 		file_iterator_playlist_set(plist, data->dirs[data->level + 1], plist->sum_folder_count, data->level + 1);
 		/*read file first in a new dir*/
-		is_file_type = 1;
+		data->is_file_type = 1;
 		/* append a seperator */
 		data->full_path[data->full_len] = '/';
 		data->full_path[++data->full_len] = 0;
@@ -926,15 +1375,28 @@ static const char *file_iterator_scan_disk(struct play_list_t *plist, struct ite
 
 		/*open dir need to get cluster*/
 		dp = &(data->dirs[data->level]->dp);
-		temp_cluster = dp->clust;
+		data->dir_cluster = dp->clust;
 
 		SYS_LOG_DBG("down to dir %s\n", data->full_path);
 	} while (1);
 
+	return 0;
+}
+
+static void file_iterator_scan_end(struct play_list_t *plist, struct iterator *iter)
+{
+	struct file_iterator_data *data = iter->data;
+
+	plist->scanning = 0;
+	data->cursor_pending = 0;
+
 	/* clear prev query flag */
 	data->has_query_prev = 0;
 
-	return data->full_path;
+#if CONFIG_PLIST_INDEX
+	if (data->param.index_key)
+		plist_index_save(plist, &data->param);
+#endif
 }
 
 static int file_iterator_update_playlist(struct play_list_t *plist, struct iterator *iter, const void *param)
@@ -943,19 +1405,42 @@ static int file_iterator_update_playlist(struct play_list_t *plist, struct itera
 
 	int res = -ENOENT;
 
+	plist->scanning = 0;
 	file_iterator_playlist_init(plist, data, param);
 
+#if CONFIG_PLIST_INDEX
+	const struct file_iterator_param *iter_param = param;
+
+	if (iter_param->index_key && !plist_index_load(plist, iter_param)) {
+		SYS_LOG_INF("play list from index\n");
+		return 0;
+	}
+
+	/* index unusable, scan from the first folder */
+	plist->sum_folder_count = 0;
+	plist->sum_file_count = 0;
+	plist->folder_info[0]->dir_file_count = 0;
+	plist->folder_info[0]->file_crc = 0;
+	plist->folder_info[0]->dir_crc = 0;
+#endif
+
 	res = _back_to_topdir(data);
 	if (res)
 		return res;
+
+	file_iterator_scan_begin(plist, iter, param);
+	if (data->param.scan_later)
+		return 0;
+
 	/* scan disk to update playlist */
 #if CONFIG_SYS_LOG_DEFAULT_LEVEL >= 3
 	u32_t begin = k_cycle_get_32();
 #endif
-	file_iterator_scan_disk(plist, iter, param);
+	file_iterator_scan_disk(plist, iter, 0);
 #if CONFIG_SYS_LOG_DEFAULT_LEVEL >= 3
 	SYS_LOG_INF("scan disk case %d us \n", (k_cycle_get_32() - begin)/24);
 #endif
+	file_iterator_scan_end(plist, iter);
 
 	return res;
 }
@@ -998,6 +1483,27 @@ static int file_iterator_set_cursor(struct iterator *iter, const void *iter_curs
 	return res;
 }
 
+static int file_iterator_scan(struct iterator *iter, int max_entries)
+{
+	struct file_iterator_data *data = iter->data;
+	struct play_list_t *plist = get_play_list();
+
+	if (!plist)
+		return -ENXIO;
+
+	if (!plist->scanning)
+		return 0;
+
+	if (file_iterator_scan_disk(plist, iter, max_entries))
+		return 1;
+
+	file_iterator_scan_end(plist, iter);
+	file_iterator_scan_free(data);
+
+	SYS_LOG_INF("sum_file_count=%d,sum_folder_count=%d\n", plist->sum_file_count, plist->sum_folder_count + 1);
+	return 0;
+}
+
 static int file_iterator_init(struct iterator *iter, const void *param)
 {
 	const struct file_iterator_param *iter_param = (struct file_iterator_param *)param;
@@ -1021,6 +1527,8 @@ static int file_iterator_init(struct iterator *iter, const void *param)
 		return -ENOMEM;
 
 	memset(data, 0, sizeof(*data));
+	data->param = *iter_param;
+	data->param.cursor = NULL;
 	data->match_fn = iter_param->match_fn;
 	data->max_level = (u16_t)iter_param->max_level;
 	data->level = -1;
@@ -1043,6 +1551,15 @@ static int file_iterator_init(struct iterator *iter, const void *param)
 	if (!data->full_path)
 		goto err_out;
 
+	/* full_path is busy with the scan while tracks are played */
+	if (iter_param->scan_later) {
+		data->url = mem_malloc(FULL_PATH_LEN);
+		if (!data->url)
+			goto err_out;
+	} else {
+		data->url = data->full_path;
+	}
+
 	if (!play_list) {
 		play_list = mem_malloc(sizeof(*play_list));
 		if (!play_list)
@@ -1064,7 +1581,7 @@ static int file_iterator_init(struct iterator *iter, const void *param)
 		data->dname_len[0]++;
 	}
 
-	data->cursor.path = data->full_path;
+	data->cursor.path = data->url;
 
 	/* set_cursor may access data */
 	iter->data = data;
@@ -1083,47 +1600,18 @@ static int file_iterator_init(struct iterator *iter, const void *param)
 	}
 #endif
 
-	for (i = data->level; i >= 0; i--)
-		fs_closedir(data->dirs[i]);
-
-	if (data->dirent) {
-		mem_free(data->dirent);
-		data->dirent = NULL;
-	}
-
-	for (i = 0; i < data->max_level; i++) {
-		if (data->dirs[i]) {
-			mem_free(data->dirs[i]);
-			data->dirs[i] = NULL;
-		}
-	}
-
-	if (data->dname_len) {
-		mem_free(data->dname_len);
-		data->dname_len = NULL;
-	}
+	/* a later scan goes on from here */
+	if (!play_list->scanning)
+		file_iterator_scan_free(data);
 
 	return 0;
 
 err_out:
-	for (i = data->level; i >= 0; i--)
-		fs_closedir(data->dirs[i]);
-
-	if (data->dirent) {
-		mem_free(data->dirent);
-		data->dirent = NULL;
-	}
-
-	for (i = 0; i < data->max_level; i++) {
-		if (data->dirs[i]) {
-			mem_free(data->dirs[i]);
-			data->dirs[i] = NULL;
-		}
-	}
+	file_iterator_scan_free(data);
 
-	if (data->dname_len) {
-		mem_free(data->dname_len);
-		data->dname_len = NULL;
+	if (data->url && data->url != data->full_path) {
+		mem_free(data->url);
+		data->url = NULL;
 	}
 
 	if (data->full_path) {
@@ -1160,6 +1648,7 @@ static const struct iterator_ops file_iterator_ops = {
 	.set_track_no = file_iterator_set_track_no,
 	.set_mode = file_iterator_set_mode,
 	.get_plist_info = file_iterator_get_plist_info,
+	.scan = file_iterator_scan,
 };
 
 struct iterator *file_iterator_create(file_iterator_param_t *param)
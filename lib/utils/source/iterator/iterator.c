@@ -133,3 +133,11 @@ int iterator_get_plist_info(struct iterator *iter, void *param)
 
 	return -ENOSYS;
 }
+
+int iterator_scan(struct iterator *iter, int max_entries)
+{
+	if (iter && iter->ops->scan)
+		return iter->ops->scan(iter, max_entries);
+
+	return 0;
+}
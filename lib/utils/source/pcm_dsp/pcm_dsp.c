@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief 16 bit pcm dsp kernels
+ *
+ * Kernels work on pairs of samples packed in a 32 bit word. With the MIPS
+ * DSP ASE (-mdsp) each pair is one addq_s.ph/mulq_rs.ph instruction,
+ * otherwise the portable C below does the same per half word.
+ */
+
+#include <zephyr/types.h>
+#include <pcm_dsp.h>
+
+#if defined(__mips_dsp)
+typedef short pcm_v2q15 __attribute__((vector_size(4)));
+/* dsp instructions have no mips16 encoding */
+#define PCM_DSP_FUNC	__attribute__((nomips16))
+#else
+#define PCM_DSP_FUNC
+#endif
+
+/* pack two samples the way they are laid out in memory */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define PCM_PH(first, second)	(((u32_t)(u16_t)(first) << 16) | (u16_t)(second))
+#define PCM_PH_FIRST(w)		((s16_t)((w) >> 16))
+#define PCM_PH_SECOND(w)	((s16_t)(w))
+#else
+#define PCM_PH(first, second)	(((u32_t)(u16_t)(second) << 16) | (u16_t)(first))
+#define PCM_PH_FIRST(w)		((s16_t)(w))
+#define PCM_PH_SECOND(w)	((s16_t)((w) >> 16))
+#endif
+
+/* 32 bit view of a sample buffer, may alias the s16 samples */
+typedef u32_t __attribute__((__may_alias__)) pcm_word_t;
+
+#define PCM_IS_WORD_ALIGNED(p)	(((uintptr_t)(p) & 3) == 0)
+
+static inline s16_t pcm_sat16(s32_t val)
+{
+	if (val > 32767)
+		return 32767;
+	if (val < -32768)
+		return -32768;
+	return (s16_t)val;
+}
+
+static inline s16_t pcm_mulq15(s16_t val, s16_t gain)
+{
+	if (gain == PCM_GAIN_UNITY)
+		return val;
+
+	return pcm_sat16(((s32_t)val * gain + 0x4000) >> 15);
+}
+
+static inline s16_t pcm_mix1(s16_t a, s16_t a_gain, s16_t b, s16_t b_gain)
+{
+	return pcm_sat16((s32_t)pcm_mulq15(a, a_gain) + pcm_mulq15(b, b_gain));
+}
+
+static inline PCM_DSP_FUNC u32_t pcm_ph_add(u32_t a, u32_t b)
+{
+#if defined(__mips_dsp)
+	return (u32_t)__builtin_mips_addq_s_ph((pcm_v2q15)a, (pcm_v2q15)b);
+#else
+	return PCM_PH(pcm_sat16((s32_t)PCM_PH_FIRST(a) + PCM_PH_FIRST(b)),
+		      pcm_sat16((s32_t)PCM_PH_SECOND(a) + PCM_PH_SECOND(b)));
+#endif
+}
+
+/* gain2 holds the same gain in both halves */
+static inline PCM_DSP_FUNC u32_t pcm_ph_gain(u32_t a, u32_t gain2)
+{
+	if ((s16_t)gain2 == PCM_GAIN_UNITY)
+		return a;
+
+#if defined(__mips_dsp)
+	return (u32_t)__builtin_mips_mulq_rs_ph((pcm_v2q15)a, (pcm_v2q15)gain2);
+#else
+	return PCM_PH(pcm_mulq15(PCM_PH_FIRST(a), (s16_t)gain2),
+		      pcm_mulq15(PCM_PH_SECOND(a), (s16_t)gain2));
+#endif
+}
+
+PCM_DSP_FUNC void pcm_add_sat(s16_t *dst, const s16_t *src, int samples)
+{
+	pcm_word_t *dst_w;
+	const pcm_word_t *src_w;
+	int i;
+
+	if (samples > 0 && !PCM_IS_WORD_ALIGNED(dst)) {
+		*dst = pcm_sat16((s32_t)*dst + *src);
+		dst++;
+		src++;
+		samples--;
+	}
+
+	if (PCM_IS_WORD_ALIGNED(src)) {
+		dst_w = (pcm_word_t *)dst;
+		src_w = (const pcm_word_t *)src;
+		for (i = 0; i < samples / 2; i++)
+			dst_w[i] = pcm_ph_add(dst_w[i], src_w[i]);
+
+		i *= 2;
+	} else {
+		i = 0;
+	}
+
+	for (; i < samples; i++)
+		dst[i] = pcm_sat16((s32_t)dst[i] + src[i]);
+}
+
+PCM_DSP_FUNC void pcm_gain_q15(s16_t *buf, s16_t gain, int samples)
+{
+	u32_t gain2 = PCM_PH(gain, gain);
+	pcm_word_t *buf_w;
+	int i;
+
+	if (gain == PCM_GAIN_UNITY)
+		return;
+
+	if (samples > 0 && !PCM_IS_WORD_ALIGNED(buf)) {
+		*buf = pcm_mulq15(*buf, gain);
+		buf++;
+		samples--;
+	}
+
+	buf_w = (pcm_word_t *)buf;
+	for (i = 0; i < samples / 2; i++)
+		buf_w[i] = pcm_ph_gain(buf_w[i], gain2);
+
+	if (samples & 1)
+		buf[samples - 1] = pcm_mulq15(buf[samples - 1], gain);
+}
+
+PCM_DSP_FUNC void pcm_mix_q15(s16_t *dst, const s16_t *a, s16_t a_gain,
+		 const s16_t *b, s16_t b_gain, int samples)
+{
+	u32_t a_gain2 = PCM_PH(a_gain, a_gain);
+	u32_t b_gain2 = PCM_PH(b_gain, b_gain);
+	const pcm_word_t *a_w, *b_w;
+	pcm_word_t *dst_w;
+	int i;
+
+	if (samples > 0 && !PCM_IS_WORD_ALIGNED(dst)) {
+		*dst++ = pcm_mix1(*a++, a_gain, *b++, b_gain);
+		samples--;
+	}
+
+	if (PCM_IS_WORD_ALIGNED(a) && PCM_IS_WORD_ALIGNED(b)) {
+		dst_w = (pcm_word_t *)dst;
+		a_w = (const pcm_word_t *)a;
+		b_w = (const pcm_word_t *)b;
+		for (i = 0; i < samples / 2; i++) {
+			dst_w[i] = pcm_ph_add(pcm_ph_gain(a_w[i], a_gain2),
+					      pcm_ph_gain(b_w[i], b_gain2));
+		}
+
+		i *= 2;
+	} else {
+		i = 0;
+	}
+
+	for (; i < samples; i++)
+		dst[i] = pcm_mix1(a[i], a_gain, b[i], b_gain);
+}
+
+PCM_DSP_FUNC void pcm_mix_planar_q15(s16_t *dst, const s16_t *a, s16_t a_gain,
+			const s16_t *left, const s16_t *right, s16_t b_gain,
+			int frames)
+{
+	u32_t a_gain2 = PCM_PH(a_gain, a_gain);
+	u32_t b_gain2 = PCM_PH(b_gain, b_gain);
+	const pcm_word_t *a_w;
+	pcm_word_t *dst_w;
+	int i;
+
+	if (PCM_IS_WORD_ALIGNED(dst) && PCM_IS_WORD_ALIGNED(a)) {
+		dst_w = (pcm_word_t *)dst;
+		a_w = (const pcm_word_t *)a;
+		for (i = 0; i < frames; i++) {
+			dst_w[i] = pcm_ph_add(pcm_ph_gain(a_w[i], a_gain2),
+					      pcm_ph_gain(PCM_PH(left[i], right[i]), b_gain2));
+		}
+		return;
+	}
+
+	for (i = 0; i < frames; i++) {
+		dst[2 * i] = pcm_mix1(a[2 * i], a_gain, left[i], b_gain);
+		dst[2 * i + 1] = pcm_mix1(a[2 * i + 1], a_gain, right[i], b_gain);
+	}
+}
+
+void pcm_interleave(s16_t *dst, const s16_t *left, const s16_t *right, int frames)
+{
+	pcm_word_t *dst_w = (pcm_word_t *)dst;
+	int i;
+
+	if (PCM_IS_WORD_ALIGNED(dst)) {
+		for (i = 0; i < frames; i++)
+			dst_w[i] = PCM_PH(left[i], right[i]);
+		return;
+	}
+
+	for (i = 0; i < frames; i++) {
+		dst[2 * i] = left[i];
+		dst[2 * i + 1] = right[i];
+	}
+}
+
+void pcm_deinterleave(s16_t *left, s16_t *right, const s16_t *src, int frames)
+{
+	const pcm_word_t *src_w = (const pcm_word_t *)src;
+	u32_t frame;
+	int i;
+
+	if (PCM_IS_WORD_ALIGNED(src)) {
+		for (i = 0; i < frames; i++) {
+			frame = src_w[i];
+			left[i] = PCM_PH_FIRST(frame);
+			right[i] = PCM_PH_SECOND(frame);
+		}
+		return;
+	}
+
+	for (i = 0; i < frames; i++) {
+		left[i] = src[2 * i];
+		right[i] = src[2 * i + 1];
+	}
+}
@@ -176,6 +176,111 @@ int buffer_stream_destory(io_stream_t handle)
 	return 0;
 }
 
+/* bytes written and not read yet, a read only buffer is all data */
+static int buffer_stream_data_len(io_stream_t handle, buffer_info_t *info)
+{
+	if ((handle->mode & MODE_IN_OUT) == MODE_IN_OUT) {
+		return handle->wofs - handle->rofs;
+	}
+
+	return info->length - handle->rofs;
+}
+
+static int buffer_stream_read_claim(io_stream_t handle, void **buf, int num)
+{
+	int file_off = 0;
+	int data_len;
+	buffer_info_t *info = (buffer_info_t *)handle->data;
+
+	assert(info);
+
+	os_mutex_lock(&info->lock, K_FOREVER);
+
+	data_len = buffer_stream_data_len(handle, info);
+	if (data_len <= 0) {
+		*buf = NULL;
+		os_mutex_unlock(&info->lock);
+		return 0;
+	}
+
+	if (num > data_len) {
+		num = data_len;
+	}
+
+	if ((handle->mode & MODE_IN_OUT) == MODE_IN_OUT) {
+		file_off = handle->rofs % info->length;
+	} else {
+		file_off = handle->rofs;
+	}
+
+	/* claim stops at the end of buffer, caller claims again for the rest */
+	if (file_off + num > info->length) {
+		num = info->length - file_off;
+	}
+
+	*buf = info->buffer_base + file_off;
+
+	os_mutex_unlock(&info->lock);
+	return num;
+}
+
+static int buffer_stream_read_commit(io_stream_t handle, int num)
+{
+	buffer_info_t *info = (buffer_info_t *)handle->data;
+
+	assert(info);
+
+	os_mutex_lock(&info->lock, K_FOREVER);
+	if (num > buffer_stream_data_len(handle, info)) {
+		os_mutex_unlock(&info->lock);
+		return -EINVAL;
+	}
+	handle->rofs += num;
+	os_mutex_unlock(&info->lock);
+
+	return num;
+}
+
+static int buffer_stream_write_claim(io_stream_t handle, void **buf, int num)
+{
+	int file_off = 0;
+	buffer_info_t *info = (buffer_info_t *)handle->data;
+
+	assert(info);
+
+	os_mutex_lock(&info->lock, K_FOREVER);
+
+	file_off = handle->wofs % info->length;
+	if (file_off + num > info->length) {
+		num = info->length - file_off;
+	}
+
+	*buf = info->buffer_base + file_off;
+
+	os_mutex_unlock(&info->lock);
+	return num;
+}
+
+static int buffer_stream_write_commit(io_stream_t handle, int num)
+{
+	buffer_info_t *info = (buffer_info_t *)handle->data;
+
+	assert(info);
+
+	os_mutex_lock(&info->lock, K_FOREVER);
+	handle->wofs += num;
+	os_mutex_unlock(&info->lock);
+
+	return num;
+}
+
+static const stream_claim_ops_t buffer_stream_claim_ops = {
+	.read_claim = buffer_stream_read_claim,
+	.read_commit = buffer_stream_read_commit,
+	.write_claim = buffer_stream_write_claim,
+	.write_commit = buffer_stream_write_commit,
+};
+
 int buffer_stream_init(io_stream_t handle, void *param)
 {
 	buffer_info_t *info = NULL;
@@ -193,6 +298,7 @@ int buffer_stream_init(io_stream_t handle, void *param)
 	os_mutex_init(&info->lock);
 
 	handle->data = info;
+	handle->claim_ops = &buffer_stream_claim_ops;
 	handle->cache_size = buffer->cache_size;
 	handle->total_size = buffer->length;
 	return 0;
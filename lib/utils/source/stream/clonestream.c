@@ -13,6 +13,7 @@
 #include <mem_manager.h>
 #include <stream.h>
 #include <assert.h>
+#include "stream_internal.h"
 
 static bool validate_stream_state(io_stream_t handle, u8_t state)
 {
@@ -85,6 +86,7 @@ static int clone_stream_read(io_stream_t handle, unsigned char *buf,int num)
 				break;
 
 			info->clones[i]->ops->write(info->clones[i], buf, len);
+			_stream_wake_reader(info->clones[i]);
 		}
 	}
 
@@ -107,6 +109,7 @@ static int clone_stream_write(io_stream_t handle, unsigned char *buf,int num)
 				break;
 
 			info->clones[i]->ops->write(info->clones[i], buf, len);
+			_stream_wake_reader(info->clones[i]);
 		}
 	}
 
@@ -165,6 +168,8 @@ static int clone_stream_close(io_stream_t handle)
 			break;
 
 		info->clones[i]->ops->write(info->clones[i], NULL, 0);
+		info->clones[i]->write_finished = 1;
+		_stream_wake_reader(info->clones[i]);
 	}
 
 	return stream_close(info->origin);
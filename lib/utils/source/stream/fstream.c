@@ -23,7 +23,11 @@ typedef struct {
 	fs_file_t fp;
 	/** mutex used for sync*/
 	os_mutex lock;
-
+	/** allocated size of a preallocated file, 0 if not preallocated */
+	int extent;
+	/** data not written yet, up to the next write unit boundary */
+	u8_t *wbuf;
+	int wbuf_len;
 } file_stream_info_t;
 
 
@@ -51,6 +55,13 @@ int fstream_open(io_stream_t handle, stream_mode mode)
 		handle->wofs = handle->total_size;
 	}
 
+	/* media files are read with random seeks, map their clusters once */
+	if (CONFIG_FILE_STREAM_FASTSEEK_FRAGMENTS > 0
+		&& (handle->mode & MODE_IN_OUT) == MODE_IN && handle->total_size > 0) {
+		if (fs_fastseek_enable(&info->fp, CONFIG_FILE_STREAM_FASTSEEK_FRAGMENTS))
+			SYS_LOG_INF("handle %p without fast seek\n", handle);
+	}
+
 	SYS_LOG_INF("handle %p total_size %d mode %x \n",handle, handle->total_size, mode);
 	return 0;
 }
@@ -68,7 +79,8 @@ int fstream_read(io_stream_t handle, unsigned char *buf,int num)
 		return brw;
 	}
 
-	if ((handle->mode & MODE_IN_OUT) == MODE_IN_OUT) {
+	/* reads and writes share the file pointer, move it only when needed */
+	if ((handle->mode & MODE_IN_OUT) == MODE_IN_OUT && fs_tell(&info->fp) != handle->rofs) {
 		brw = fs_seek(&info->fp, handle->rofs, FS_SEEK_SET);
 		if (brw) {
 			SYS_LOG_ERR("seek failed %d\n", brw);
@@ -115,7 +127,7 @@ int fstream_write(io_stream_t handle, unsigned char *buf,int num)
 		return brw;
 	}
 
-	if ((handle->mode & MODE_IN_OUT) == MODE_IN_OUT) {
+	if ((handle->mode & MODE_IN_OUT) == MODE_IN_OUT && fs_tell(&info->fp) != handle->wofs) {
 		brw = fs_seek(&info->fp, handle->wofs, FS_SEEK_SET);
 		if (brw) {
 			SYS_LOG_ERR("seek failed %d\n", brw);
@@ -266,20 +278,14 @@ int fstream_get_space(io_stream_t handle)
 	return INT_MAX;
 }
 
-static int file_name_has_cluster(char *file_name, char **dir, u32_t *clust, u32_t *blk_ofs)
+/* parse temp_url in place, *dir points into it */
+static int file_name_has_cluster(char *temp_url, char **dir, u32_t *clust, u32_t *blk_ofs)
 {
 	char *str = NULL;
 	char *cluster = NULL;
 	char *blk = NULL;
 	int res = 0;
 
-	char *temp_url = mem_malloc(strlen(file_name) + 1);
-
-	if (!temp_url)
-		goto exit;
-
-	strcpy(temp_url, file_name);
-
 	str = strstr(temp_url,"bycluster:");
 	if (!str)
 		goto exit;
@@ -314,8 +320,6 @@ static int file_name_has_cluster(char *file_name, char **dir, u32_t *clust, u32_
 	SYS_LOG_DBG("dir=%s,clust=%d,blk_ofs=%d\n", *dir, *clust, *blk_ofs);
 	res = 1;
 exit:
-	if (temp_url)
-		mem_free(temp_url);
 	return res;
 }
 
@@ -324,17 +328,22 @@ int fstream_init(io_stream_t handle, void *param)
 	int res = 0;
 	file_stream_info_t *info = NULL;
 	char *file_name = (char *)param;
+	char *temp_url = NULL;
 	char *dir = NULL;
 	u32_t cluster = 0;
 	u32_t blk_ofs = 0;
 
 	info = mem_malloc(sizeof(file_stream_info_t));
-	if (!info) {
+	temp_url = mem_malloc(strlen(file_name) + 1);
+	if (!info || !temp_url) {
 		SYS_LOG_ERR("no memory\n");
-		return -ENOMEM;
+		res = -ENOMEM;
+		goto failed;
 	}
 
-	if (file_name_has_cluster(file_name, &dir, &cluster, &blk_ofs)) {
+	strcpy(temp_url, file_name);
+
+	if (file_name_has_cluster(temp_url, &dir, &cluster, &blk_ofs)) {
 		res = fs_open_cluster(&info->fp, dir, cluster, blk_ofs);
 		if (res) {
 			SYS_LOG_ERR("open Failed %d\n", res);
@@ -349,14 +358,253 @@ int fstream_init(io_stream_t handle, void *param)
 	}
 	os_mutex_init(&info->lock);
 
+	mem_free(temp_url);
 	handle->data = info;
 	return res;
 
 failed:
-	mem_free(info);
+	if (temp_url)
+		mem_free(temp_url);
+	if (info)
+		mem_free(info);
+	return res;
+}
+
+#if CONFIG_FILE_STREAM_PREALLOC_STEP > 0
+/* write out the staged bytes, the file position is at their start */
+static int _fstream_prealloc_sync(io_stream_t handle, file_stream_info_t *info)
+{
+	int brw;
+
+	if (!info->wbuf_len)
+		return 0;
+
+	brw = fs_write(&info->fp, info->wbuf, info->wbuf_len);
+	if (brw != info->wbuf_len) {
+		SYS_LOG_ERR("write %d \n", brw);
+		return (brw < 0) ? brw : -ENOSPC;
+	}
+
+	info->wbuf_len = 0;
+	return 0;
+}
+
+static void _fstream_prealloc_grow(io_stream_t handle, file_stream_info_t *info, int size)
+{
+	int extent = ROUND_UP(size, CONFIG_FILE_STREAM_PREALLOC_STEP);
+	int res;
+
+	res = fs_expand(&info->fp, extent);
+	if (res) {
+		/* nearly full volume, let writes allocate */
+		SYS_LOG_WRN("expand to %d failed %d\n", extent, res);
+		info->extent = 0;
+		return;
+	}
+
+	info->extent = extent;
+
+	/* writes in the extent find their clusters without the FAT */
+	if (CONFIG_FILE_STREAM_FASTSEEK_FRAGMENTS > 0)
+		fs_fastseek_enable(&info->fp, CONFIG_FILE_STREAM_FASTSEEK_FRAGMENTS);
+}
+
+static int fstream_prealloc_init(io_stream_t handle, void *param)
+{
+	file_stream_info_t *info;
+	int res;
+
+	res = fstream_init(handle, param);
+	if (res)
+		return res;
+
+	info = (file_stream_info_t *)handle->data;
+	info->wbuf = mem_malloc(CONFIG_FILE_STREAM_PREALLOC_WRITE_SIZE);
+	if (!info->wbuf) {
+		SYS_LOG_ERR("no memory\n");
+		fs_close(&info->fp);
+		mem_free(info);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int fstream_prealloc_open(io_stream_t handle, stream_mode mode)
+{
+	file_stream_info_t *info = (file_stream_info_t *)handle->data;
+
+	assert(info);
+
+	info->wbuf_len = 0;
+	info->extent = 0;
+
+	if ((mode & MODE_IN_OUT) != MODE_OUT) {
+		SYS_LOG_ERR("mode %x not supported\n", mode);
+		return -EINVAL;
+	}
+
+	fstream_open(handle, mode);
+
+	/* written data ends at total_size, the rest is preallocated */
+	_fstream_prealloc_grow(handle, info, handle->total_size + 1);
+	return 0;
+}
+
+/*
+ * Bytes up to the next write unit boundary are staged, whole units are
+ * written straight from buf, so the card only sees aligned writes in
+ * clusters allocated in advance.
+ */
+static int fstream_prealloc_write(io_stream_t handle, unsigned char *buf, int num)
+{
+	file_stream_info_t *info = (file_stream_info_t *)handle->data;
+	int unit = CONFIG_FILE_STREAM_PREALLOC_WRITE_SIZE;
+	int len = 0;
+	int brw, n;
+
+	assert(info);
+
+	brw = os_mutex_lock(&info->lock, K_FOREVER);
+	if (brw < 0) {
+		SYS_LOG_ERR("lock failed %d \n",brw);
+		return brw;
+	}
+
+	if (info->extent && handle->wofs + num > info->extent)
+		_fstream_prealloc_grow(handle, info, handle->wofs + num);
+
+	while (len < num) {
+		n = unit - handle->wofs % unit;
+		if (!info->wbuf_len && n == unit && num - len >= unit) {
+			n = (num - len) - (num - len) % unit;
+			brw = fs_write(&info->fp, buf + len, n);
+			if (brw != n) {
+				SYS_LOG_ERR("write %d \n", brw);
+				if (brw > 0) {
+					len += brw;
+					handle->wofs += brw;
+				}
+				break;
+			}
+		} else {
+			n = min(n, num - len);
+			memcpy(info->wbuf + info->wbuf_len, buf + len, n);
+			info->wbuf_len += n;
+			if ((handle->wofs + n) % unit == 0 && _fstream_prealloc_sync(handle, info)) {
+				info->wbuf_len -= n;
+				break;
+			}
+		}
+
+		len += n;
+		handle->wofs += n;
+	}
+
+	if (handle->wofs > handle->total_size)
+		handle->total_size = handle->wofs;
+
+	os_mutex_unlock(&info->lock);
+	return (len || !num) ? len : -EIO;
+}
+
+static int fstream_prealloc_seek(io_stream_t handle, int offset, seek_dir origin)
+{
+	file_stream_info_t *info = (file_stream_info_t *)handle->data;
+	int res;
+
+	assert(info);
+
+	os_mutex_lock(&info->lock, K_FOREVER);
+	res = _fstream_prealloc_sync(handle, info);
+	os_mutex_unlock(&info->lock);
+	if (res)
+		return res;
+
+	/* the end of the file is the end of the written data */
+	if (origin == SEEK_DIR_END) {
+		offset += handle->total_size;
+		origin = SEEK_DIR_BEG;
+	}
+
+	return fstream_seek(handle, offset, origin);
+}
+
+static int fstream_prealloc_tell(io_stream_t handle)
+{
+	return handle->wofs;
+}
+
+static int fstream_prealloc_flush(io_stream_t handle)
+{
+	file_stream_info_t *info = (file_stream_info_t *)handle->data;
+	int res;
+
+	assert(info);
+
+	os_mutex_lock(&info->lock, K_FOREVER);
+	res = _fstream_prealloc_sync(handle, info);
+	os_mutex_unlock(&info->lock);
+
+	return res ? res : fstream_flush(handle);
+}
+
+static int fstream_prealloc_close(io_stream_t handle)
+{
+	file_stream_info_t *info = (file_stream_info_t *)handle->data;
+	int res;
+
+	assert(info);
+
+	os_mutex_lock(&info->lock, K_FOREVER);
+	res = _fstream_prealloc_sync(handle, info);
+
+	/* give back what was preallocated but not written */
+	if (fs_truncate(&info->fp, handle->total_size))
+		SYS_LOG_ERR("truncate to %d failed\n", handle->total_size);
+
+	info->extent = 0;
+	os_mutex_unlock(&info->lock);
+
+	if (fstream_close(handle))
+		return -EIO;
+
 	return res;
 }
 
+static int fstream_prealloc_destroy(io_stream_t handle)
+{
+	file_stream_info_t *info = (file_stream_info_t *)handle->data;
+
+	assert(info);
+
+	mem_free(info->wbuf);
+	return fstream_destroy(handle);
+}
+
+const stream_ops_t file_stream_prealloc_ops = {
+	.init = fstream_prealloc_init,
+	.open = fstream_prealloc_open,
+	.seek = fstream_prealloc_seek,
+	.tell = fstream_prealloc_tell,
+	.write = fstream_prealloc_write,
+	.flush = fstream_prealloc_flush,
+	.get_space = fstream_get_space,
+	.close = fstream_prealloc_close,
+	.destroy = fstream_prealloc_destroy,
+};
+
+io_stream_t file_stream_create_prealloc(const char *param)
+{
+	return stream_create(&file_stream_prealloc_ops, (void *)param);
+}
+#else
+io_stream_t file_stream_create_prealloc(const char *param)
+{
+	return file_stream_create(param);
+}
+#endif /* CONFIG_FILE_STREAM_PREALLOC_STEP > 0 */
+
 const stream_ops_t file_stream_ops = {
 	.init = fstream_init,
 	.open = fstream_open,
@@ -41,7 +41,8 @@ static int ringbuff_stream_read(io_stream_t handle, unsigned char *buf, int len)
 	if (!info)
 		return -EACCES;
 
-	ret = acts_ringbuf_get(info->buf, buf, len);
+	/* reader is usually the dma irq, writer a media thread: no lock needed */
+	ret = acts_ringbuf_spsc_get(info->buf, buf, len);
 
 	if (ret != len) {
 		//SYS_LOG_WRN("want read %d bytes ,but only read  %d bytes \n",len,ret);
@@ -63,9 +64,9 @@ static int ringbuff_stream_write(io_stream_t handle, unsigned char *buf, int len
 
 	/**fill none when buf is NULL, allow user modify write offset only*/
 	if (!buf) {
-		ret = acts_ringbuf_fill_none(info->buf, len);
+		ret = acts_ringbuf_spsc_fill_none(info->buf, len);
 	} else {
-		ret = acts_ringbuf_put(info->buf, buf, len);
+		ret = acts_ringbuf_spsc_put(info->buf, buf, len);
 	}
 
 	if (ret != len) {
@@ -84,7 +85,7 @@ static int ringbuff_stream_get_length(io_stream_t handle)
 	if (!info)
 		return -EACCES;
 
-	return acts_ringbuf_length(info->buf);
+	return acts_ringbuf_spsc_length(info->buf);
 }
 
 static int ringbuff_stream_get_space(io_stream_t handle)
@@ -94,7 +95,7 @@ static int ringbuff_stream_get_space(io_stream_t handle)
 	if (!info)
 		return -EACCES;
 
-	return acts_ringbuf_space(info->buf);
+	return acts_ringbuf_spsc_space(info->buf);
 }
 
 static int ringbuff_stream_tell(io_stream_t handle)
@@ -141,6 +142,74 @@ static int ringbuff_stream_destroy(io_stream_t handle)
 	return ret;
 }
 
+static int ringbuff_stream_read_claim(io_stream_t handle, void **buf, int len)
+{
+	ringbuff_info_t *info = (ringbuff_info_t *)handle->data;
+	struct acts_ringbuf_seg seg[2];
+
+	if (!info)
+		return -EACCES;
+
+	/* only the part before the wrap point is handed out in place */
+	acts_ringbuf_get_claim_seg(info->buf, seg, len);
+	*buf = seg[0].data;
+
+	return seg[0].len;
+}
+
+static int ringbuff_stream_read_commit(io_stream_t handle, int len)
+{
+	ringbuff_info_t *info = (ringbuff_info_t *)handle->data;
+	int ret;
+
+	if (!info)
+		return -EACCES;
+
+	ret = acts_ringbuf_spsc_drop(info->buf, len);
+
+	handle->rofs = info->buf->head;
+	handle->wofs = info->buf->tail;
+
+	return ret;
+}
+
+static int ringbuff_stream_write_claim(io_stream_t handle, void **buf, int len)
+{
+	ringbuff_info_t *info = (ringbuff_info_t *)handle->data;
+	struct acts_ringbuf_seg seg[2];
+
+	if (!info)
+		return -EACCES;
+
+	acts_ringbuf_put_claim_seg(info->buf, seg, len);
+	*buf = seg[0].data;
+
+	return seg[0].len;
+}
+
+static int ringbuff_stream_write_commit(io_stream_t handle, int len)
+{
+	ringbuff_info_t *info = (ringbuff_info_t *)handle->data;
+	int ret;
+
+	if (!info)
+		return -EACCES;
+
+	ret = acts_ringbuf_spsc_fill_none(info->buf, len);
+
+	handle->rofs = info->buf->head;
+	handle->wofs = info->buf->tail;
+
+	return ret;
+}
+
+static const stream_claim_ops_t ringbuff_stream_claim_ops = {
+	.read_claim = ringbuff_stream_read_claim,
+	.read_commit = ringbuff_stream_read_commit,
+	.write_claim = ringbuff_stream_write_claim,
+	.write_commit = ringbuff_stream_write_commit,
+};
+
 static int ringbuff_stream_init(io_stream_t handle, void *param)
 {
 	ringbuff_info_t *info = NULL;
@@ -154,6 +223,7 @@ static int ringbuff_stream_init(io_stream_t handle, void *param)
 	info->buf = (struct acts_ringbuf *)param;
 
 	handle->data = info;
+	handle->claim_ops = &ringbuff_stream_claim_ops;
 
 	handle->total_size = acts_ringbuf_size(info->buf);
 
@@ -170,6 +240,63 @@ void *ringbuff_stream_get_ringbuf(io_stream_t handle)
 	return (void *)(info->buf);
 }
 
+int ringbuff_stream_get_claim_seg(io_stream_t handle, struct acts_ringbuf_seg seg[2], int len)
+{
+	ringbuff_info_t *info = (ringbuff_info_t *)handle->data;
+
+	if (!info || handle->state != STATE_OPEN)
+		return 0;
+
+	return acts_ringbuf_get_claim_seg(info->buf, seg, len);
+}
+
+int ringbuff_stream_get_finish(io_stream_t handle, int len)
+{
+	ringbuff_info_t *info = (ringbuff_info_t *)handle->data;
+	int ret;
+
+	if (!info)
+		return -EACCES;
+
+	ret = acts_ringbuf_spsc_drop(info->buf, len);
+
+	handle->rofs = info->buf->head;
+	handle->wofs = info->buf->tail;
+
+	/* wake up writer blocked on free space, same as stream_read */
+	_stream_wake_writer(handle);
+
+	return ret;
+}
+
+int ringbuff_stream_put_claim_seg(io_stream_t handle, struct acts_ringbuf_seg seg[2], int len)
+{
+	ringbuff_info_t *info = (ringbuff_info_t *)handle->data;
+
+	if (!info || handle->state != STATE_OPEN)
+		return 0;
+
+	return acts_ringbuf_put_claim_seg(info->buf, seg, len);
+}
+
+int ringbuff_stream_put_finish(io_stream_t handle, int len)
+{
+	ringbuff_info_t *info = (ringbuff_info_t *)handle->data;
+	int ret;
+
+	if (!info)
+		return -EACCES;
+
+	ret = acts_ringbuf_spsc_fill_none(info->buf, len);
+
+	handle->rofs = info->buf->head;
+	handle->wofs = info->buf->tail;
+
+	_stream_wake_reader(handle);
+
+	return ret;
+}
+
 const stream_ops_t ringbuff_stream_ops = {
 	.init = ringbuff_stream_init,
 	.open = ringbuff_stream_open,
@@ -34,6 +34,247 @@ static bool _stream_check_handle_state(io_stream_t handle, uint8_t need_state)
 	return true;
 }
 
+#ifdef CONFIG_STREAM_STATISTICS
+static sys_slist_t stream_list;
+static OS_MUTEX_DEFINE(stream_list_mutex);
+#endif
+
+static inline u32_t _stream_stats_time(void)
+{
+#ifdef CONFIG_STREAM_STATISTICS
+	return k_cycle_get_32();
+#else
+	return 0;
+#endif
+}
+
+#ifdef CONFIG_STREAM_STATISTICS
+static inline u32_t _stream_stats_elapsed_us(u32_t start)
+{
+	return (k_cycle_get_32() - start) / (sys_clock_hw_cycles_per_sec / USEC_PER_SEC);
+}
+#endif
+
+static inline void _stream_stats_read(io_stream_t handle, int num, int brw)
+{
+#ifdef CONFIG_STREAM_STATISTICS
+	handle->stats.read_count++;
+	if (brw > 0)
+		handle->stats.read_bytes += brw;
+	if (brw < num)
+		handle->stats.underrun_count++;
+#endif
+}
+
+static inline void _stream_stats_write(io_stream_t handle, int num, int brw)
+{
+#ifdef CONFIG_STREAM_STATISTICS
+	int len;
+
+	handle->stats.write_count++;
+	if (brw > 0)
+		handle->stats.write_bytes += brw;
+	if (brw < num)
+		handle->stats.overrun_count++;
+
+	len = stream_get_length(handle);
+	if (len > 0 && len > handle->stats.max_fill)
+		handle->stats.max_fill = len;
+#endif
+}
+
+static inline void _stream_stats_block(io_stream_t handle, u32_t start)
+{
+#ifdef CONFIG_STREAM_STATISTICS
+	handle->stats.block_count++;
+	handle->stats.block_time_us += _stream_stats_elapsed_us(start);
+#endif
+}
+
+static inline void _stream_stats_observer(io_stream_t handle, u32_t start)
+{
+#ifdef CONFIG_STREAM_STATISTICS
+	handle->stats.observer_time_us += _stream_stats_elapsed_us(start);
+#endif
+}
+
+#define STREAM_BLOCK_TIMEOUT_MS	(1000)
+
+void _stream_wake_reader(io_stream_t handle)
+{
+	u32_t watermark = handle->read_watermark;
+
+	if (!handle->sync_sem)
+		return;
+
+	/* a blocked seek waits for wofs to reach its target */
+	if (handle->seek_watermark && handle->wofs >= handle->seek_watermark) {
+		os_sem_give(handle->sync_sem);
+		return;
+	}
+
+	if (!watermark)
+		return;
+
+	if (handle->write_finished || stream_get_length(handle) >= watermark)
+		os_sem_give(handle->sync_sem);
+}
+
+void _stream_wake_writer(io_stream_t handle)
+{
+	u32_t watermark = handle->write_watermark;
+
+	if (!handle->space_sem || !watermark)
+		return;
+
+	if (stream_get_space(handle) >= watermark)
+		os_sem_give(handle->space_sem);
+}
+
+/*
+ * Wait on sem until woken up or the timeout counted from begin expires.
+ * Every producer wakes the waiters through _stream_wake_reader() or
+ * _stream_wake_writer(). Return 0 when woken up, -EAGAIN on timeout.
+ */
+static int _stream_wait(io_stream_t handle, os_sem *sem, s32_t timeout, u32_t begin)
+{
+	s32_t remain = timeout;
+	u32_t start;
+	int ret;
+
+	if (timeout != OS_FOREVER) {
+		remain = timeout - (s32_t)(os_uptime_get_32() - begin);
+		if (remain <= 0)
+			return -EAGAIN;
+	}
+
+	start = _stream_stats_time();
+	ret = os_sem_take(sem, remain);
+	_stream_stats_block(handle, start);
+
+	return ret ? -EAGAIN : 0;
+}
+
+/* wake up writer, feed attached streams and observers with data read */
+static int _stream_read_notify(io_stream_t handle, unsigned char *buf, int num)
+{
+	int i;
+	int brw;
+	u32_t start;
+
+	_stream_wake_writer(handle);
+
+	if (!_is_in_isr()) {
+		os_mutex_lock(&handle->attach_lock, OS_FOREVER);
+	}
+
+	/**data read to attached stream */
+	for (i = 0; i < ARRAY_SIZE(handle->attach_stream); i++) {
+		if (handle->attach_mode[i] != MODE_IN)
+			continue;
+
+		if (!handle->attach_stream[i])
+			continue;
+
+		brw = handle->attach_stream[i]->ops->write(handle->attach_stream[i], buf, num);
+		if (brw != num) {
+			if (!_is_in_isr()) {
+				os_mutex_unlock(&handle->attach_lock);
+			}
+			return brw;
+		}
+
+		/* written past its notify, wake up the attached stream reader */
+		_stream_wake_reader(handle->attach_stream[i]);
+	}
+
+	if (!_is_in_isr()) {
+		os_mutex_unlock(&handle->attach_lock);
+	}
+
+	start = _stream_stats_time();
+	for (i = 0; i < ARRAY_SIZE(handle->observer_notify); i++) {
+		if (handle->observer_notify[i] && (handle->observer_type[i] & STREAM_NOTIFY_READ)) {
+			handle->observer_notify[i](handle->observer[i], handle->rofs,
+				handle->wofs, handle->total_size, buf, num, STREAM_NOTIFY_READ);
+		}
+	}
+	_stream_stats_observer(handle, start);
+
+	return num;
+}
+
+/* let pre write observers process data before it becomes visible */
+static void _stream_pre_write_notify(io_stream_t handle, unsigned char *buf, int num)
+{
+	int i;
+	u32_t start;
+
+	start = _stream_stats_time();
+	for (i = 0; i < ARRAY_SIZE(handle->observer_notify); i++) {
+		if (handle->observer_notify[i] && (handle->observer_type[i] & STREAM_NOTIFY_PRE_WRITE)) {
+			handle->observer_notify[i](handle->observer[i], handle->rofs,
+				handle->wofs, handle->total_size, buf, num, STREAM_NOTIFY_PRE_WRITE);
+		}
+	}
+	_stream_stats_observer(handle, start);
+}
+
+/* wake up reader, feed attached streams and observers with data written */
+static int _stream_write_notify(io_stream_t handle, unsigned char *buf, int num)
+{
+	int i;
+	int brw = num;
+	u32_t start;
+
+	if (!num) {
+		handle->write_finished = 1;
+	}
+
+	_stream_wake_reader(handle);
+
+	if (!_is_in_isr()) {
+		os_mutex_lock(&handle->attach_lock, OS_FOREVER);
+	}
+
+	/**data write to attached stream */
+	for (i = 0; i < ARRAY_SIZE(handle->attach_stream); i++) {
+		if (handle->attach_mode[i] != MODE_OUT)
+			continue;
+
+		if (!handle->attach_stream[i])
+			continue;
+
+		brw = handle->attach_stream[i]->ops->write(handle->attach_stream[i], buf, num);
+		if (brw != num) {
+			//SYS_LOG_ERR("Failed writing to stream [%d]\n", brw);
+			if (!_is_in_isr()) {
+				os_mutex_unlock(&handle->attach_lock);
+			}
+			return brw;
+		}
+
+		/* written past its notify, wake up the attached stream reader */
+		if (!num) {
+			handle->attach_stream[i]->write_finished = 1;
+		}
+		_stream_wake_reader(handle->attach_stream[i]);
+	}
+
+	if (!_is_in_isr()) {
+		os_mutex_unlock(&handle->attach_lock);
+	}
+	start = _stream_stats_time();
+	for (i = 0; i < ARRAY_SIZE(handle->observer_notify); i++) {
+		if (handle->observer_notify[i] && (handle->observer_type[i] & STREAM_NOTIFY_WRITE)) {
+			handle->observer_notify[i](handle->observer[i], handle->rofs,
+				handle->wofs, handle->total_size, buf, num, STREAM_NOTIFY_WRITE);
+		}
+	}
+	_stream_stats_observer(handle, start);
+	return brw;
+}
+
 io_stream_t stream_create(const stream_ops_t  *ops, void *init_param)
 {
 	int ret = 0;
@@ -49,7 +290,15 @@ io_stream_t stream_create(const stream_ops_t  *ops, void *init_param)
 	stream->rofs = 0;
 	stream->wofs = 0;
 	stream->ops = ops;
+	stream->claim_ops = NULL;
+	stream->read_claim_buf = NULL;
+	stream->write_claim_buf = NULL;
+	stream->sync_sem = NULL;
+	stream->space_sem = NULL;
 	os_mutex_init(&stream->attach_lock);
+#ifdef CONFIG_STREAM_STATISTICS
+	memset(&stream->stats, 0, sizeof(stream->stats));
+#endif
 
 	if (stream->ops->init) {
 		ret = stream->ops->init(stream, init_param);
@@ -59,8 +308,15 @@ io_stream_t stream_create(const stream_ops_t  *ops, void *init_param)
 		SYS_LOG_ERR("create failed 0x%p \n", stream);
 		mem_free(stream);
 		stream = NULL;
+		goto exit;
 	}
 
+#ifdef CONFIG_STREAM_STATISTICS
+	os_mutex_lock(&stream_list_mutex, OS_FOREVER);
+	sys_slist_append(&stream_list, &stream->node);
+	os_mutex_unlock(&stream_list_mutex);
+#endif
+
 exit:
 	SYS_LOG_DBG(" 0x%p \n",stream);
 	return stream;
@@ -89,14 +345,30 @@ int stream_open(io_stream_t handle, stream_mode mode)
 	}
 
 	if((mode & (MODE_READ_BLOCK | MODE_WRITE_BLOCK))){
-		handle->sync_sem = mem_malloc(sizeof(os_sem));
+		/* sync_sem for readers and space_sem for writers in one block */
 		if (!handle->sync_sem) {
-			return -ENOMEM;
+			handle->sync_sem = mem_malloc(2 * sizeof(os_sem));
+			if (!handle->sync_sem) {
+				return -ENOMEM;
+			}
+			handle->space_sem = handle->sync_sem + 1;
 		}
 		os_sem_init(handle->sync_sem, 0, 1);
+		os_sem_init(handle->space_sem, 0, 1);
 		handle->write_finished = 0;
 	}
 
+	handle->read_watermark = 0;
+	handle->write_watermark = 0;
+	handle->seek_watermark = 0;
+	if (mode & MODE_BLOCK_TIMEOUT) {
+		handle->read_timeout = STREAM_BLOCK_TIMEOUT_MS;
+		handle->write_timeout = STREAM_BLOCK_TIMEOUT_MS;
+	} else {
+		handle->read_timeout = OS_FOREVER;
+		handle->write_timeout = OS_FOREVER;
+	}
+
 	handle->mode = mode;
 	handle->state = STATE_OPEN;
 
@@ -105,9 +377,8 @@ int stream_open(io_stream_t handle, stream_mode mode)
 
 int stream_read(io_stream_t handle, unsigned char *buf,int num)
 {
-	int i;
 	int brw;
-	int try_cnt = 0;
+	u32_t begin;
 
 	if (!_stream_check_handle_state(handle,STATE_OPEN)) {
 		return -ENOSYS;
@@ -118,68 +389,33 @@ int stream_read(io_stream_t handle, unsigned char *buf,int num)
 	}
 
 	if ((handle->mode & MODE_READ_BLOCK)) {
-		while (stream_get_length(handle) < num) {
-			if((handle->mode & MODE_BLOCK_TIMEOUT)){
-				if (try_cnt ++ > 20) {
-					SYS_LOG_INF("time out 1s");
-					handle->write_finished = 1;
-					return 0;
-				}
+		begin = os_uptime_get_32();
+		/* publish the watermark before checking, writer wakes us once reached */
+		handle->read_watermark = num;
+		while (stream_get_length(handle) < num && !handle->write_finished) {
+			if (_stream_wait(handle, handle->sync_sem, handle->read_timeout, begin)) {
+				SYS_LOG_INF("time out %d ms", handle->read_timeout);
+				handle->read_watermark = 0;
+				handle->write_finished = 1;
+				return 0;
 			}
-			os_sem_take(handle->sync_sem, OS_MSEC(50));
 			if(!_stream_check_handle_state(handle,STATE_OPEN)) {
+				handle->read_watermark = 0;
 				return -ENOSYS;
 			}
-			if (handle->write_finished) {
-				break;
-			}
 		}
+		handle->read_watermark = 0;
 	}
 
 	brw = handle->ops->read(handle, buf, num);
+	_stream_stats_read(handle, num, brw);
 	if (brw < 0) {
 		SYS_LOG_DBG("read failed [%d]\n", brw);
 		brw = 0;
 		return brw;
 	}
 
-	if (handle->sync_sem) {
-		os_sem_give(handle->sync_sem);
-	}
-
-	if (!_is_in_isr()) {
-		os_mutex_lock(&handle->attach_lock, OS_FOREVER);
-	}
-
-	/**data read to attached stream */
-	for (i = 0; i < ARRAY_SIZE(handle->attach_stream); i++) {
-		if (handle->attach_mode[i] != MODE_IN)
-			continue;
-
-		if (!handle->attach_stream[i])
-			continue;
-
-		brw = handle->attach_stream[i]->ops->write(handle->attach_stream[i], buf, num);
-		if (brw != num) {
-			if (!_is_in_isr()) {
-				os_mutex_unlock(&handle->attach_lock);
-			}
-			return brw;
-		}
-	}
-
-	if (!_is_in_isr()) {
-		os_mutex_unlock(&handle->attach_lock);
-	}
-
-	for (i = 0; i < ARRAY_SIZE(handle->observer_notify); i++) {
-		if (handle->observer_notify[i] && (handle->observer_type[i] & STREAM_NOTIFY_READ)) {
-			handle->observer_notify[i](handle->observer[i], handle->rofs,
-				handle->wofs, handle->total_size, buf, brw, STREAM_NOTIFY_READ);
-		}
-	}
-
-	return brw;
+	return _stream_read_notify(handle, buf, brw);
 }
 
 int stream_seek(io_stream_t handle, int offset,seek_dir origin)
@@ -187,6 +423,7 @@ int stream_seek(io_stream_t handle, int offset,seek_dir origin)
 	int i;
 	int brw = 0;
 	int target_off = offset;
+	u32_t start, begin;
 
 	if (!_stream_check_handle_state(handle,STATE_OPEN)) {
 		return -ENOSYS;
@@ -215,13 +452,21 @@ int stream_seek(io_stream_t handle, int offset,seek_dir origin)
 		return -1;
 	}
 
-	if ((handle->mode & MODE_IN_OUT) == MODE_IN_OUT) {
+	if ((handle->mode & MODE_IN_OUT) == MODE_IN_OUT && target_off > handle->wofs) {
+		if (!handle->sync_sem)
+			return -EPERM;
+
+		begin = os_uptime_get_32();
+		/* the writer wakes us once wofs reaches target */
+		handle->seek_watermark = target_off;
 		while (target_off > handle->wofs) {
-			os_sem_take(handle->sync_sem, OS_MSEC(50));
+			_stream_wait(handle, handle->sync_sem, OS_FOREVER, begin);
 			if(!_stream_check_handle_state(handle,STATE_OPEN)) {
+				handle->seek_watermark = 0;
 				return -ENOSYS;
 			}
 		}
+		handle->seek_watermark = 0;
 	}
 
 	brw = handle->ops->seek(handle, target_off, SEEK_DIR_BEG);
@@ -230,12 +475,14 @@ int stream_seek(io_stream_t handle, int offset,seek_dir origin)
 		return brw;
 	}
 
+	start = _stream_stats_time();
 	for (i = 0; i < ARRAY_SIZE(handle->observer_notify); i++) {
 		if (handle->observer_notify[i] && (handle->observer_type[i] & STREAM_NOTIFY_SEEK)) {
 			handle->observer_notify[i](handle->observer[i], handle->rofs,
 				handle->wofs, handle->total_size, NULL, 0, STREAM_NOTIFY_SEEK);
 		}
 	}
+	_stream_stats_observer(handle, start);
 
 	return brw;
 }
@@ -264,8 +511,7 @@ int stream_tell(io_stream_t handle)
 int stream_write(io_stream_t handle, unsigned char *buf, int num)
 {
 	int brw;
-	int i;
-	int try_cnt = 0;
+	u32_t begin;
 
 	if (!_stream_check_handle_state(handle,STATE_OPEN)) {
 		return -ENOSYS;
@@ -276,73 +522,129 @@ int stream_write(io_stream_t handle, unsigned char *buf, int num)
 	}
 
 	if ((handle->mode & MODE_WRITE_BLOCK)) {
+		begin = os_uptime_get_32();
+		handle->write_watermark = num;
 		while (stream_get_space(handle) < num) {
-			if ((handle->mode & MODE_BLOCK_TIMEOUT)) {
-				if (try_cnt ++ > 20) {
-					SYS_LOG_INF("time out 1s");
-					handle->write_finished = 1;
-					return 0;
-				}
+			if (_stream_wait(handle, handle->space_sem, handle->write_timeout, begin)) {
+				SYS_LOG_INF("time out %d ms", handle->write_timeout);
+				handle->write_watermark = 0;
+				handle->write_finished = 1;
+				return 0;
 			}
-			os_sem_take(handle->sync_sem, OS_MSEC(50));
 			if(!_stream_check_handle_state(handle,STATE_OPEN)) {
+				handle->write_watermark = 0;
 				return -ENOSYS;
 			}
 		}
+		handle->write_watermark = 0;
 	}
 
-	for (i = 0; i < ARRAY_SIZE(handle->observer_notify); i++) {
-		if (handle->observer_notify[i] && (handle->observer_type[i] & STREAM_NOTIFY_PRE_WRITE)) {
-			handle->observer_notify[i](handle->observer[i], handle->rofs,
-				handle->wofs, handle->total_size, buf, num, STREAM_NOTIFY_PRE_WRITE);
-		}
-	}
+	_stream_pre_write_notify(handle, buf, num);
 
 	brw = handle->ops->write(handle, buf, num);
+	_stream_stats_write(handle, num, brw);
 	if (brw != num) {
 		//SYS_LOG_ERR("Failed writing to stream [%d]\n", brw);
 		return brw;
 	}
 
-	if (!num) {
-		handle->write_finished = 1;
+	return _stream_write_notify(handle, buf, num);
+}
+
+int stream_read_claim(io_stream_t handle, void **buf, int num)
+{
+	int brw;
+
+	if (!_stream_check_handle_state(handle,STATE_OPEN)) {
+		return -ENOSYS;
 	}
 
-	if (handle->sync_sem)
-		os_sem_give(handle->sync_sem);
+	if (!(handle->mode & MODE_IN)) {
+		return -EPERM;
+	}
 
+	if (!handle->claim_ops || !handle->claim_ops->read_claim) {
+		return -ENOSYS;
+	}
 
-	if (!_is_in_isr()) {
-		os_mutex_lock(&handle->attach_lock, OS_FOREVER);
+	brw = handle->claim_ops->read_claim(handle, buf, num);
+	if (brw >= 0) {
+		handle->read_claim_buf = *buf;
 	}
 
-	/**data write to attached stream */
-	for (i = 0; i < ARRAY_SIZE(handle->attach_stream); i++) {
-		if (handle->attach_mode[i] != MODE_OUT)
-			continue;
+	return brw;
+}
 
-		if (!handle->attach_stream[i])
-			continue;
+int stream_read_commit(io_stream_t handle, int num)
+{
+	int brw;
 
-		brw = handle->attach_stream[i]->ops->write(handle->attach_stream[i], buf, num);
-		if (brw != num) {
-			//SYS_LOG_ERR("Failed writing to stream [%d]\n", brw);
-			if (!_is_in_isr()) {
-				os_mutex_unlock(&handle->attach_lock);
-			}
-			return brw;
-		}
+	if (!_stream_check_handle_state(handle,STATE_OPEN)) {
+		return -ENOSYS;
 	}
 
-	if (!_is_in_isr()) {
-		os_mutex_unlock(&handle->attach_lock);
+	if (!handle->claim_ops || !handle->read_claim_buf) {
+		return -EPERM;
 	}
-	for (i = 0; i < ARRAY_SIZE(handle->observer_notify); i++) {
-		if (handle->observer_notify[i] && (handle->observer_type[i] & STREAM_NOTIFY_WRITE)) {
-			handle->observer_notify[i](handle->observer[i], handle->rofs,
-				handle->wofs, handle->total_size, buf, num, STREAM_NOTIFY_WRITE);
-		}
+
+	brw = handle->claim_ops->read_commit(handle, num);
+	_stream_stats_read(handle, num, brw);
+	if (brw <= 0) {
+		handle->read_claim_buf = NULL;
+		return brw;
+	}
+
+	brw = _stream_read_notify(handle, handle->read_claim_buf, brw);
+	handle->read_claim_buf = NULL;
+	return brw;
+}
+
+int stream_write_claim(io_stream_t handle, void **buf, int num)
+{
+	int brw;
+
+	if (!_stream_check_handle_state(handle,STATE_OPEN)) {
+		return -ENOSYS;
+	}
+
+	if (!(handle->mode & MODE_OUT)) {
+		return -EPERM;
+	}
+
+	if (!handle->claim_ops || !handle->claim_ops->write_claim) {
+		return -ENOSYS;
+	}
+
+	brw = handle->claim_ops->write_claim(handle, buf, num);
+	if (brw >= 0) {
+		handle->write_claim_buf = *buf;
+	}
+
+	return brw;
+}
+
+int stream_write_commit(io_stream_t handle, int num)
+{
+	int brw;
+
+	if (!_stream_check_handle_state(handle,STATE_OPEN)) {
+		return -ENOSYS;
+	}
+
+	if (!handle->claim_ops || !handle->write_claim_buf) {
+		return -EPERM;
+	}
+
+	_stream_pre_write_notify(handle, handle->write_claim_buf, num);
+
+	brw = handle->claim_ops->write_commit(handle, num);
+	_stream_stats_write(handle, num, brw);
+	if (brw != num) {
+		return brw;
 	}
+
+	brw = _stream_write_notify(handle, handle->write_claim_buf, num);
+	handle->write_claim_buf = NULL;
 	return brw;
 }
 
@@ -365,6 +667,9 @@ int stream_flush(io_stream_t handle)
 		return brw;
 	}
 
+	_stream_wake_reader(handle);
+	_stream_wake_writer(handle);
+
 	return 0;
 }
 
@@ -386,11 +691,13 @@ int stream_close(io_stream_t handle)
 		SYS_LOG_ERR("close failed [%d]\n", res);
 	}
 
+	/* change state first, so woken up waiters see the stream closed */
+	handle->state = STATE_CLOSE;
 	if (handle->sync_sem) {
 		handle->write_finished = 1;
 		os_sem_give(handle->sync_sem);
+		os_sem_give(handle->space_sem);
 	}
-	handle->state = STATE_CLOSE;
 	return res;
 }
 
@@ -413,6 +720,12 @@ int stream_destroy(io_stream_t handle)
 	if (handle->sync_sem)
 		mem_free(handle->sync_sem);
 
+#ifdef CONFIG_STREAM_STATISTICS
+	os_mutex_lock(&stream_list_mutex, OS_FOREVER);
+	sys_slist_find_and_remove(&stream_list, &handle->node);
+	os_mutex_unlock(&stream_list_mutex);
+#endif
+
 	mem_free(handle);
 	return res;
 }
@@ -602,9 +915,68 @@ void *stream_get_ringbuffer(io_stream_t handle)
 	return buf;
 }
 
+int stream_set_timeout(io_stream_t handle, s32_t read_timeout, s32_t write_timeout)
+{
+	if (!_stream_check_handle_state(handle,STATE_OPEN)) {
+		return -ENOSYS;
+	}
+
+	handle->read_timeout = read_timeout;
+	handle->write_timeout = write_timeout;
+	return 0;
+}
+
 void stream_dump(io_stream_t stream, const char *name, const char *line_prefix)
 {
 	printk("%s%s (t:%d,s:%d): rofs=0x%x, wofs=0x%x, size=0x%x, length=0x%x, space=0x%x\n",
 		line_prefix, name, stream->type, stream->state, stream->rofs, stream->wofs,
 		stream->total_size, stream_get_length(stream), stream_get_space(stream));
 }
+
+int stream_get_stats(io_stream_t handle, struct stream_stats *stats)
+{
+#ifdef CONFIG_STREAM_STATISTICS
+	memcpy(stats, &handle->stats, sizeof(*stats));
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+void stream_reset_stats(io_stream_t handle)
+{
+#ifdef CONFIG_STREAM_STATISTICS
+	memset(&handle->stats, 0, sizeof(handle->stats));
+#endif
+}
+
+void stream_dump_stats(bool reset)
+{
+#ifdef CONFIG_STREAM_STATISTICS
+	struct stream_stats *stats;
+	io_stream_t stream;
+
+	os_mutex_lock(&stream_list_mutex, OS_FOREVER);
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&stream_list, stream, node) {
+		stats = &stream->stats;
+
+		printk("stream %p (t:%d,s:%d) size %u\n", stream, stream->type,
+			stream->state, stream->total_size);
+		printk("\tread %u bytes/%u calls, underrun %u\n",
+			stats->read_bytes, stats->read_count, stats->underrun_count);
+		printk("\twrite %u bytes/%u calls, overrun %u, max fill %u\n",
+			stats->write_bytes, stats->write_count, stats->overrun_count,
+			stats->max_fill);
+		printk("\tblock %u waits/%u us, observer %u us\n",
+			stats->block_count, stats->block_time_us, stats->observer_time_us);
+
+		if (reset)
+			stream_reset_stats(stream);
+	}
+
+	os_mutex_unlock(&stream_list_mutex);
+#else
+	printk("stream statistics not enabled\n");
+#endif
+}
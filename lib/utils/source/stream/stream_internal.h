@@ -24,4 +24,10 @@
 
 #include <stream.h>
 
+/* wake up a blocked reader or seek once its watermark is reached */
+void _stream_wake_reader(io_stream_t handle);
+
+/* wake up a blocked writer once its write watermark is reached */
+void _stream_wake_writer(io_stream_t handle);
+
 #endif /* __IOSTREAM_INTERNAL_H__ */
@@ -79,6 +79,8 @@ typedef enum
 {
     MEM_TRACE_MALLOC        = 0x601,
     MEM_TRACE_FREE          = 0x602,
+    MEM_TRACE_SNAPSHOT      = 0x603,
+    MEM_TRACE_SITE          = 0x604,
 }trace_malloc_type_e;
 
 typedef struct
@@ -159,6 +161,8 @@ static uint32_t _trace_is_active(struct k_thread  *thread, uint32_t event)
     if (((event_mask & TRACE_TYPE) != 0) && (event_mask & TRACE_TYPE) != (event & TRACE_TYPE)) {
         return 0;
     }  
+
+    return 1;
 }
 
 
@@ -624,8 +628,45 @@ void _trace_free(uint32_t address, uint32_t caller)
     _trace_binary_write(current, buf, 8 + str_len, MEM_TRACE_FREE);        
 }
 
-#endif
+/*
+ * Heap profile records are written on request, so they bypass the event
+ * filter. The payload is plain words without task name: the snapshot
+ * record is followed by one site record per tracked caller.
+ */
+int _trace_mem_snapshot(uint32_t sites, uint32_t live_bytes, uint32_t peak_bytes, uint32_t dropped)
+{
+    uint32_t  buf[TRACE_PACKET_LENGTH / 4];
+    trace_ctx_t *trace_ctx = get_trace_ctx();
 
+    if (!cbuf_is_init(&trace_ctx->cbuf_binary)) {
+        return -ENODEV;
+    }
 
+    buf[TRACE_PAYLOAD_START] = sites;
+    buf[TRACE_PAYLOAD_START + 1] = live_bytes;
+    buf[TRACE_PAYLOAD_START + 2] = peak_bytes;
+    buf[TRACE_PAYLOAD_START + 3] = dropped;
 
+    _trace_binary_write(k_current_get(), buf, 16, MEM_TRACE_SNAPSHOT);
+    return 0;
+}
 
+int _trace_mem_site(uint32_t caller, uint32_t live_bytes, uint32_t peak_bytes, uint32_t count)
+{
+    uint32_t  buf[TRACE_PACKET_LENGTH / 4];
+    trace_ctx_t *trace_ctx = get_trace_ctx();
+
+    if (!cbuf_is_init(&trace_ctx->cbuf_binary)) {
+        return -ENODEV;
+    }
+
+    buf[TRACE_PAYLOAD_START] = caller;
+    buf[TRACE_PAYLOAD_START + 1] = live_bytes;
+    buf[TRACE_PAYLOAD_START + 2] = peak_bytes;
+    buf[TRACE_PAYLOAD_START + 3] = count;
+
+    _trace_binary_write(k_current_get(), buf, 16, MEM_TRACE_SITE);
+    return 0;
+}
+
+#endif
@@ -352,7 +352,10 @@ void audio_test_loop(void)
 void system_app_init(void)
 {
 	//init message manager
-	msg_manager_init();
+	if (!msg_manager_init()) {
+		SYS_LOG_ERR("msg manager init failed");
+		return;
+	}
 
 	//init service manager
 	srv_manager_init();
@@ -454,7 +454,7 @@ void lcmusic_input_event_proc(struct app_msg *msg)
 	case MSG_LCMPLAYER_PLAY_NEXT:
 		_lcmusic_cancel_num_input_check(lcmusic);
 
-		if (lcmusic->disk_scanning || lcmusic->seek_direction)
+		if (lcmusic->seek_direction)
 			break;
 
 		lcmusic->prev_music_state = 0;
@@ -473,7 +473,7 @@ void lcmusic_input_event_proc(struct app_msg *msg)
 	case MSG_LCMPLAYER_PLAY_PREV:
 		_lcmusic_cancel_num_input_check(lcmusic);
 
-		if (lcmusic->disk_scanning || lcmusic->seek_direction)
+		if (lcmusic->seek_direction)
 			break;
 
 		lcmusic->prev_music_state = 1;
@@ -630,7 +630,7 @@ void lcmusic_input_event_proc(struct app_msg *msg)
 	case MSG_LCMPLAYER_PLAY_NEXT_DIR:
 		_lcmusic_cancel_num_input_check(lcmusic);
 
-		if (lcmusic->disk_scanning || lcmusic->seek_direction)
+		if (lcmusic->seek_direction)
 			break;
 		lcmusic->prev_music_state = 0;
 		lcmusic->filt_track_no = 0;
@@ -647,7 +647,7 @@ void lcmusic_input_event_proc(struct app_msg *msg)
 	case MSG_LCMPLAYER_PLAY_PREV_DIR:
 		_lcmusic_cancel_num_input_check(lcmusic);
 
-		if (lcmusic->disk_scanning || lcmusic->seek_direction)
+		if (lcmusic->seek_direction)
 			break;
 
 		lcmusic->filt_track_no = 0;
@@ -779,8 +779,9 @@ void lcmusic_event_proc(struct app_msg *msg)
 #ifdef	CONFIG_INPUT_DEV_ACTS_IRKEY
 	case MSG_LCMPLAYER_PLAY_TRACK_NO:
 		lcmusic->filt_track_no = 0;
-		if (lcmusic->disk_scanning || lcmusic->track_no == 0
-			|| lcmusic->track_no > lcmusic->sum_track_no) {
+		/* a track past the scanned ones waits for the scan */
+		if (lcmusic->track_no == 0
+			|| (!lcmusic->disk_scanning && lcmusic->track_no > lcmusic->sum_track_no)) {
 			lcmusic->track_no = 0;
 		#ifdef CONFIG_SEG_LED_MANAGER
 			seg_led_manager_set_timeout_event(0, NULL);
@@ -19,14 +19,54 @@
 #define LOOP_DIR  "LOOP"
 #define SYSTEM_DIR "SYSTEM"
 
+/* play list index key, change it when the filters below change */
+#define LCMUSIC_PLIST_INDEX_KEY	0x4C434D53	/* "LCMS" */
+
 #if CONFIG_BKG_SCAN_DISK
 #define SCAN_DISK_STACKSIZE	1536
+/* dir entries read with iter_mutex held, play requests get in between */
+#define SCAN_DISK_STEP_ENTRIES	32
 static u8_t scan_disk_stack[SCAN_DISK_STACKSIZE];
+static volatile u8_t scan_disk_running;
+/* given by the scan thread after each step and when it exits */
+static OS_SEM_DEFINE(scan_disk_step_sem, 0, 1);
 #endif
 
 OS_MUTEX_DEFINE(iter_mutex);
 
 iterator_t *iter = NULL;
+
+#if CONFIG_BKG_SCAN_DISK
+/*
+ * Called with iter_mutex held when the track asked for is not scanned
+ * yet, wait for the next scan step and return true to ask again.
+ */
+static bool _lcmusic_wait_scan(struct lcmusic_app_t *lcmusic)
+{
+	if (!lcmusic->disk_scanning)
+		return false;
+
+	/* steps done before are already seen, the scan needs iter_mutex */
+	os_sem_reset(&scan_disk_step_sem);
+	os_mutex_unlock(&iter_mutex);
+	os_sem_take(&scan_disk_step_sem, OS_FOREVER);
+	os_mutex_lock(&iter_mutex, OS_FOREVER);
+	return true;
+}
+#else
+static inline bool _lcmusic_wait_scan(struct lcmusic_app_t *lcmusic)
+{
+	return false;
+}
+#endif
+
+/* the scan thread may not have created the iterator yet */
+static void _lcmusic_lock_iter(struct lcmusic_app_t *lcmusic)
+{
+	os_mutex_lock(&iter_mutex, OS_FOREVER);
+	while (!iter && _lcmusic_wait_scan(lcmusic))
+		;
+}
 static int _iterator_filter_dir(const char *path)
 {
 	/*lcmusic app filter record file, alarm file and loop music file **/
@@ -73,6 +113,12 @@ int lcmusic_init_iterator(struct lcmusic_app_t *lcmusic)
 	param.max_level = MAX_DIR_LEVEL;
 
 	param.match_fn = _iterator_match_fn;
+	/* record dirs are only filtered in the mplayer apps */
+	param.index_key = LCMUSIC_PLIST_INDEX_KEY + _iterator_filter_dir(RECORD_DIR);
+#if CONFIG_BKG_SCAN_DISK
+	/* _lcmusic_scan_disk_thread scans, tracks are played as they are found */
+	param.scan_later = 1;
+#endif
 
 	iter = file_iterator_create(&param);
 	if (iter)
@@ -83,17 +129,22 @@ int lcmusic_init_iterator(struct lcmusic_app_t *lcmusic)
 }
 void lcmusic_exit_iterator(void)
 {
+	struct lcmusic_app_t *lcmusic = lcmusic_get_app();
+
 	os_mutex_lock(&iter_mutex, OS_FOREVER);
 
 	if (iter)
 		iterator_destroy(iter);
 	iter = NULL;
+	/* the scan thread stops at its next step */
+	if (lcmusic)
+		lcmusic->disk_scanning = 0;
 	os_mutex_unlock(&iter_mutex);
 }
 
 const char *lcmusic_play_next_url(struct lcmusic_app_t *lcmusic, bool force_switch)
 {
-	os_mutex_lock(&iter_mutex, OS_FOREVER);
+	_lcmusic_lock_iter(lcmusic);
 
 	if (!iter) {
 		SYS_LOG_WRN("iter null\n");
@@ -105,9 +156,14 @@ const char *lcmusic_play_next_url(struct lcmusic_app_t *lcmusic, bool force_swit
 	if ((lcmusic->music_state != LCMUSIC_STATUS_NULL) && (lcmusic->music_state != LCMUSIC_STATUS_ERROR))
 		lcmusic->full_cycle_times = 0;
 
-	const char *path = iterator_next(iter, force_switch, &lcmusic->music_bp_info.track_no);
+	const char *path;
 
-	if (lcmusic->music_bp_info.track_no == lcmusic->sum_track_no)
+	do {
+		path = iterator_next(iter, force_switch, &lcmusic->music_bp_info.track_no);
+	} while (!path && _lcmusic_wait_scan(lcmusic));
+
+	/* the sum grows while scanning */
+	if (!lcmusic->disk_scanning && lcmusic->music_bp_info.track_no == lcmusic->sum_track_no)
 		lcmusic->full_cycle_times++;
 
 	if (!path || lcmusic->full_cycle_times > 2) {
@@ -125,7 +181,7 @@ const char *lcmusic_play_next_url(struct lcmusic_app_t *lcmusic, bool force_swit
 }
 const char *lcmusic_play_prev_url(struct lcmusic_app_t *lcmusic)
 {
-	os_mutex_lock(&iter_mutex, OS_FOREVER);
+	_lcmusic_lock_iter(lcmusic);
 	if (!iter) {
 		SYS_LOG_WRN("iter null\n");
 		lcmusic->mplayer_state = MPLAYER_STATE_ERROR;
@@ -137,9 +193,13 @@ const char *lcmusic_play_prev_url(struct lcmusic_app_t *lcmusic)
 	if ((lcmusic->music_state != LCMUSIC_STATUS_NULL) && (lcmusic->music_state != LCMUSIC_STATUS_ERROR))
 		lcmusic->full_cycle_times = 0;
 
-	const char *path = iterator_prev(iter, &lcmusic->music_bp_info.track_no);
+	const char *path;
+
+	do {
+		path = iterator_prev(iter, &lcmusic->music_bp_info.track_no);
+	} while (!path && _lcmusic_wait_scan(lcmusic));
 
-	if (lcmusic->music_bp_info.track_no == lcmusic->sum_track_no)
+	if (!lcmusic->disk_scanning && lcmusic->music_bp_info.track_no == lcmusic->sum_track_no)
 		lcmusic->full_cycle_times++;
 
 	if (!path || lcmusic->full_cycle_times > 2) {
@@ -157,14 +217,18 @@ const char *lcmusic_play_prev_url(struct lcmusic_app_t *lcmusic)
 
 const char *lcmusic_play_next_folder_url(struct lcmusic_app_t *lcmusic)
 {
-	os_mutex_lock(&iter_mutex, OS_FOREVER);
+	_lcmusic_lock_iter(lcmusic);
 	if (!iter) {
 		SYS_LOG_WRN("iter null\n");
 		lcmusic->mplayer_state = MPLAYER_STATE_ERROR;
 		os_mutex_unlock(&iter_mutex);
 		return NULL;
 	}
-	const char *path = iterator_next_folder(iter, &lcmusic->music_bp_info.track_no);
+	const char *path;
+
+	do {
+		path = iterator_next_folder(iter, &lcmusic->music_bp_info.track_no);
+	} while (!path && _lcmusic_wait_scan(lcmusic));
 
 	if (!path) {
 		SYS_LOG_WRN("path null\n");
@@ -180,14 +244,18 @@ const char *lcmusic_play_next_folder_url(struct lcmusic_app_t *lcmusic)
 
 const char *lcmusic_play_prev_folder_url(struct lcmusic_app_t *lcmusic)
 {
-	os_mutex_lock(&iter_mutex, OS_FOREVER);
+	_lcmusic_lock_iter(lcmusic);
 	if (!iter) {
 		SYS_LOG_WRN("iter null\n");
 		lcmusic->mplayer_state = MPLAYER_STATE_ERROR;
 		os_mutex_unlock(&iter_mutex);
 		return NULL;
 	}
-	const char *path = iterator_prev_folder(iter, &lcmusic->music_bp_info.track_no);
+	const char *path;
+
+	do {
+		path = iterator_prev_folder(iter, &lcmusic->music_bp_info.track_no);
+	} while (!path && _lcmusic_wait_scan(lcmusic));
 
 	if (!path) {
 		SYS_LOG_WRN("path null\n");
@@ -204,14 +272,18 @@ const char *lcmusic_play_prev_folder_url(struct lcmusic_app_t *lcmusic)
 
 const char *lcmusic_play_set_track_no(struct lcmusic_app_t *lcmusic, u16_t track_no)
 {
-	os_mutex_lock(&iter_mutex, OS_FOREVER);
+	_lcmusic_lock_iter(lcmusic);
 	if (!iter) {
 		SYS_LOG_WRN("iter null\n");
 		lcmusic->mplayer_state = MPLAYER_STATE_ERROR;
 		os_mutex_unlock(&iter_mutex);
 		return NULL;
 	}
-	const char *path = iterator_set_track_no(iter, track_no);
+	const char *path;
+
+	do {
+		path = iterator_set_track_no(iter, track_no);
+	} while (!path && _lcmusic_wait_scan(lcmusic));
 
 	if (!path) {
 		lcmusic->mplayer_state = MPLAYER_STATE_ERROR;
@@ -561,28 +633,70 @@ static void _lcmusic_scan_disk_start(void)
 static void _lcmusic_scan_disk_thread(void *parama1, void *parama2, void *parama3)
 {
 	struct lcmusic_app_t *lcmusic = lcmusic_get_app();
+	int res = -ENODEV;
 
 	if (!lcmusic)
-		return;
+		goto exit;
 	os_mutex_lock(&iter_mutex, OS_FOREVER);
 	if (lcmusic->cur_url[0] != 0) {
 		os_sleep(500);
 	}
-	lcmusic->disk_scanning = 1;
-	_lcmusic_scan_disk_start();
-	lcmusic->disk_scanning = 0;
+	if (lcmusic->disk_scanning)
+		_lcmusic_scan_disk_start();
+	if (!iter)
+		lcmusic->disk_scanning = 0;
 	os_mutex_unlock(&iter_mutex);
+
+#ifdef CONFIG_DVFS_DYNAMIC_LEVEL
+	dvfs_set_level(DVFS_LEVEL_HIGH_PERFORMANCE, "scan_disk");
+#endif
+	/* publish the tracks found a step at a time */
+	do {
+		os_mutex_lock(&iter_mutex, OS_FOREVER);
+		if (!iter) {
+			/* iterator exited, lcmusic may be gone */
+			os_mutex_unlock(&iter_mutex);
+			break;
+		}
+		res = iterator_scan(iter, SCAN_DISK_STEP_ENTRIES);
+		iterator_get_plist_info(iter, &lcmusic->sum_track_no);
+		if (res <= 0)
+			lcmusic->disk_scanning = 0;
+		os_mutex_unlock(&iter_mutex);
+		os_sem_give(&scan_disk_step_sem);
+		os_yield();
+	} while (res > 0);
+#ifdef CONFIG_DVFS_DYNAMIC_LEVEL
+	dvfs_unset_level(DVFS_LEVEL_HIGH_PERFORMANCE, "scan_disk");
+#endif
+
+exit:
+	scan_disk_running = 0;
+	os_sem_give(&scan_disk_step_sem);
 }
 #endif
 
 void lcmusic_scan_disk(void)
 {
 #if CONFIG_BKG_SCAN_DISK
-/* create a thread to scan disk*/
+	struct lcmusic_app_t *lcmusic = lcmusic_get_app();
+
+	if (!lcmusic)
+		return;
+
+	/* the scan of a previous disk is still stopping */
+	while (scan_disk_running)
+		os_sem_take(&scan_disk_step_sem, OS_FOREVER);
+
+	/* play requests wait from now on, not from when the scan thread runs */
+	lcmusic->disk_scanning = 1;
+	scan_disk_running = 1;
+
+/* create a thread to scan disk, below the app so that playback goes first*/
 	os_thread_create(scan_disk_stack, SCAN_DISK_STACKSIZE,
 		_lcmusic_scan_disk_thread,
 		NULL, NULL, NULL,
-		CONFIG_APP_PRIORITY - 1, 0, 0);
+		CONFIG_APP_PRIORITY + 1, 0, 0);
 #else
 	_lcmusic_scan_disk_start();
 #endif
@@ -58,6 +58,9 @@
 #define MONITOR_TIME_PERIOD OS_MSEC(1000)
 #define RECORD_DIR_LEN	(10)
 #define RECORD_FILE_PATH_LEN	(24)
+#define RECORD_CACHE_READ_SIZE	(0x800)
+/* wav header length of the file is updated every this many bytes */
+#define RECORD_CHECKPOINT_SIZE	(0x20000)
 #define MAX_RECORD_FILES (999)
 #define FILE_FORMAT	".WAV"
 
@@ -160,6 +163,7 @@ struct recorder_app_t {
 
 	io_stream_t recorder_stream;
 	io_stream_t cache_stream;
+	int checkpoint_ofs;
 
 	u8_t restart_iterator_times;
 	u8_t music_state;
@@ -181,6 +185,7 @@ void recorder_start(struct recorder_app_t *record);
 void recorder_stop(struct recorder_app_t *record);
 void recorder_pause(struct recorder_app_t *record);
 void recorder_resume(struct recorder_app_t *record);
+int recorder_write_cache_to_disk(struct recorder_app_t *record, int len);
 void recorder_input_event_proc(struct app_msg *msg);
 void recorder_event_proc(struct app_msg *msg);
 void recorder_tts_event_proc(struct app_msg *msg);
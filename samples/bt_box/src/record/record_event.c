@@ -19,7 +19,6 @@
 #define SEEK_SPEED_LEVEL	(10)
 #define SYNC_RECORD_DATA_PERIOD (30)
 static u32_t start_seek_time;
-extern char record_cache_read_temp[0x800];
 
 static bool _check_disk_plugout(struct recorder_app_t *record)
 {
@@ -237,18 +236,13 @@ static void _recorder_read_cache_timer(struct thread_timer *ttimer, void *expiry
 		return;
 	u32_t begin = k_cycle_get_32();
 
-	while (stream_get_length(record->cache_stream) >= sizeof(record_cache_read_temp)) {
-		len = stream_read(record->cache_stream, record_cache_read_temp, sizeof(record_cache_read_temp));
-		if (len < 0) {
-			SYS_LOG_ERR("error\n");
-			return;
-		}
-
-		if (len != sizeof(record_cache_read_temp)) {
+	while (stream_get_length(record->cache_stream) >= RECORD_CACHE_READ_SIZE) {
+		len = recorder_write_cache_to_disk(record, RECORD_CACHE_READ_SIZE);
+		sum_len += len;
+		if (len != RECORD_CACHE_READ_SIZE) {
 			SYS_LOG_WRN("len:%d\n", len);
+			break;
 		}
-		stream_write(record->recorder_stream, record_cache_read_temp, len);
-		sum_len += len;
 	}
 	u32_t cost = k_cycle_get_32();
 
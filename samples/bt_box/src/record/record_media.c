@@ -12,6 +12,7 @@
 #include "record.h"
 #include "media_mem.h"
 #include "tts_manager.h"
+#include <misc/byteorder.h>
 #ifdef CONFIG_PROPERTY
 #include <property_manager.h>
 #endif
@@ -25,13 +26,14 @@
 #define RECORD_FILE_SIZE_MAX	(512)	/* 512MB */
 #define READ_CACHE_TIME_PERIOD OS_MSEC(50)
 #define RECORD_BPINFO_LEN	(64)
+/* wav header written by the encoder, see media_player_repair_filhdr */
+#define RECORD_HEADER_SIZE	(512)
 
 const char RECORD_BPINFO_FILE[] = "_record.log";
 const char COUNT_TAG[] = "file_count:";
 const char COUNT_END_TAG[] = ",";
 
 static char record_adpcm_cache[0x2800] _NODATA_SECTION(.btmusic_pcm_bss);
-char record_cache_read_temp[0x800] _NODATA_SECTION(.btmusic_pcm_bss);
 
 extern io_stream_t record_stream_create_ext(void *ring_buff, u32_t ring_buff_size);
 
@@ -209,6 +211,51 @@ static char *_record_create_file_path(struct recorder_app_t *record)
 	return NULL;
 }
 
+#if CONFIG_FILE_STREAM_PREALLOC_STEP > 0
+/*
+ * A recording cut by a power loss keeps its preallocated tail, the data
+ * length in the header is the one of the last checkpoint, drop the rest.
+ * Files without a wav header or never checkpointed (data length 0) are
+ * left alone, their header says nothing about the data.
+ */
+static void _recorder_trim_file(const char *path)
+{
+	u8_t riff[12];
+	u32_t data_size = 0;
+	fs_file_t fp;
+	off_t size;
+
+	if (fs_open(&fp, path))
+		return;
+
+	if (fs_seek(&fp, 0, FS_SEEK_END))
+		goto exit;
+
+	size = fs_tell(&fp);
+	if (size < RECORD_HEADER_SIZE || fs_seek(&fp, 0, FS_SEEK_SET))
+		goto exit;
+
+	if (fs_read(&fp, riff, sizeof(riff)) != sizeof(riff)
+		|| memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4))
+		goto exit;
+
+	if (fs_seek(&fp, RECORD_HEADER_SIZE - 4, FS_SEEK_SET))
+		goto exit;
+
+	if (fs_read(&fp, &data_size, sizeof(data_size)) != sizeof(data_size))
+		goto exit;
+
+	data_size = sys_le32_to_cpu(data_size);
+	if (data_size > 0 && data_size < size - RECORD_HEADER_SIZE) {
+		SYS_LOG_INF("trim %d to %d\n", (int)size, RECORD_HEADER_SIZE + data_size);
+		fs_truncate(&fp, RECORD_HEADER_SIZE + data_size);
+	}
+
+exit:
+	fs_close(&fp);
+}
+#endif
+
 void recorder_repair_file(struct recorder_app_t *record)
 {
 	char *file_path = NULL;
@@ -226,6 +273,9 @@ void recorder_repair_file(struct recorder_app_t *record)
 		return;
 	}
 	SYS_LOG_INF("path:%s\n", record->recplayer_bp_info.file_path);
+#if CONFIG_FILE_STREAM_PREALLOC_STEP > 0
+	_recorder_trim_file(record->recplayer_bp_info.file_path);
+#endif
 	stream_wav = file_stream_create((void *)record->recplayer_bp_info.file_path);
 	if (stream_wav) {
 		res = stream_open(stream_wav, MODE_OUT);
@@ -440,7 +490,8 @@ void recorder_start(struct recorder_app_t *record)
 		goto exit_app;
 	}
 	SYS_LOG_INF("file:%s\n", file_path);
-	file_stream = file_stream_create((void *)file_path);
+	/* allocated ahead, appending does not stall on FAT updates */
+	file_stream = file_stream_create_prealloc((void *)file_path);
 	if (file_stream) {
 		res = stream_open(file_stream, MODE_OUT);
 		if (res) {
@@ -477,6 +528,7 @@ void recorder_start(struct recorder_app_t *record)
 
 	record->cache_stream = init_param.capture_output_stream;
 	record->recorder_stream = file_stream;
+	record->checkpoint_ofs = RECORD_CHECKPOINT_SIZE;
 
 	stream_set_observer(record->cache_stream, NULL, record_stream_observer_notify, STREAM_NOTIFY_WRITE);
 
@@ -517,29 +569,58 @@ exit_app:
 	msg.cmd = MSG_SWITCH_APP;
 	send_async_msg(APP_ID_MAIN, &msg);/* change to next app */
 }
+/* write cached pcm to file straight from the capture ring, no bounce buffer */
+int recorder_write_cache_to_disk(struct recorder_app_t *record, int len)
+{
+	void *data = NULL;
+	int claim_len;
+	int sum_len = 0;
+
+	while (sum_len < len) {
+		claim_len = stream_read_claim(record->cache_stream, &data, len - sum_len);
+		if (claim_len <= 0)
+			break;
+
+		claim_len = stream_write(record->recorder_stream, data, claim_len);
+		if (claim_len <= 0) {
+			SYS_LOG_ERR("write failed %d\n", claim_len);
+			break;
+		}
+
+		stream_read_commit(record->cache_stream, claim_len);
+		sum_len += claim_len;
+	}
+
+#if CONFIG_FILE_STREAM_PREALLOC_STEP > 0
+	/*
+	 * the file is longer than its data until it is closed, keep the data
+	 * length in the header for recorder_repair_file after a power loss
+	 */
+	if (stream_tell(record->recorder_stream) >= record->checkpoint_ofs) {
+		media_player_repair_filhdr(NULL, WAV_TYPE, record->recorder_stream);
+		/* the header sector may still sit in the file buffer */
+		stream_flush(record->recorder_stream);
+		stream_seek(record->recorder_stream, 0, SEEK_DIR_END);
+		record->checkpoint_ofs = stream_tell(record->recorder_stream) + RECORD_CHECKPOINT_SIZE;
+	}
+#endif
+
+	return sum_len;
+}
+
 static void _recorder_sync_cache_to_disk(struct recorder_app_t *record)
 {
 	int len = 0;
 
 	if (!record->recorder_stream || !record->cache_stream)
 		return;
-	while ((len = stream_get_length(record->cache_stream)) > 0) {
-		SYS_LOG_INF("len:%d\n", len);
-		if (len > sizeof(record_cache_read_temp))
-			len = sizeof(record_cache_read_temp);
-		len = stream_read(record->cache_stream, record_cache_read_temp, len);
-		if (len < 0) {
-			SYS_LOG_ERR("error\n");
-			break;
-		}
 
-		stream_write(record->recorder_stream, record_cache_read_temp, len);
-
-		if (len != sizeof(record_cache_read_temp)) {
-			SYS_LOG_INF("len:%d\n", len);
-			break;
-		}
+	len = stream_get_length(record->cache_stream);
+	if (len > 0) {
+		SYS_LOG_INF("len:%d\n", len);
+		recorder_write_cache_to_disk(record, len);
 	}
+
 	media_player_repair_filhdr(NULL, WAV_TYPE, record->recorder_stream);
 }
 void recorder_stop(struct recorder_app_t *record)
@@ -164,6 +164,40 @@ static int record_stream_destroy(io_stream_t handle)
 	return ret;
 }
 
+static int record_stream_read_claim(io_stream_t handle, void **buf, int len)
+{
+	struct recordbuff_info_t *info = (struct recordbuff_info_t *)handle->data;
+
+	if (!info)
+		return -EACCES;
+
+	return acts_ringbuf_get_claim(info->buf, buf, len);
+}
+
+static int record_stream_read_commit(io_stream_t handle, int len)
+{
+	struct recordbuff_info_t *info = (struct recordbuff_info_t *)handle->data;
+	int ret;
+
+	if (!info)
+		return -EACCES;
+
+	ret = acts_ringbuf_get_finish(info->buf, len);
+	if (ret) {
+		return ret;
+	}
+
+	handle->rofs = info->buf->head;
+	handle->wofs = info->buf->tail;
+
+	return len;
+}
+
+static const stream_claim_ops_t record_stream_claim_ops = {
+	.read_claim = record_stream_read_claim,
+	.read_commit = record_stream_read_commit,
+};
+
 static int record_stream_init(io_stream_t handle, void *param)
 {
 	struct recordbuff_info_t *info = NULL;
@@ -177,6 +211,7 @@ static int record_stream_init(io_stream_t handle, void *param)
 	info->buf = (struct acts_ringbuf *)param;
 
 	handle->data = info;
+	handle->claim_ops = &record_stream_claim_ops;
 
 	handle->total_size = acts_ringbuf_size(info->buf);
 	handle->write_finished = 0;
@@ -33,6 +33,43 @@ def is_windows():
     else:
         return 0
 
+SDFS_DIR_SIZE = 32
+SDFS_DIR_SORTED = 0x54524F53    # "SORT"
+
+def sdfs_name_key(entry):
+    # strncasecmp(name, fname, 12) order, as sd_sorted_find() searches
+    return entry[:12].split(b'\0')[0].lower()
+
+def sort_sdfs_dir(image_file):
+    """
+    Sort the directory entries by lower case name, in place, and mark the
+    "sdfs.bin" entry, sd_fopen() then binary searches them. File data,
+    offsets and checksums do not move, nothing is added to the image.
+    """
+    with open(image_file, 'rb') as f:
+        data = bytearray(f.read())
+
+    (fname, total, size, reserved) = struct.unpack_from('<12siiI', data, 0)
+    if fname[:8] != b'sdfs.bin' or size != len(data) or reserved != 0:
+        print('SDFS: unknown image format, entries not sorted')
+        return
+
+    dir_end = SDFS_DIR_SIZE * (total + 1)
+    entries = [bytes(data[i:i + SDFS_DIR_SIZE]) \
+               for i in range(SDFS_DIR_SIZE, dir_end, SDFS_DIR_SIZE)]
+    entries.sort(key = sdfs_name_key)
+
+    for i in range(1, total):
+        if sdfs_name_key(entries[i - 1]) == sdfs_name_key(entries[i]):
+            print('SDFS: duplicate name %s, entries not sorted' %entries[i][:12])
+            return
+
+    data[SDFS_DIR_SIZE:dir_end] = b''.join(entries)
+    struct.pack_into('<I', data, 20, SDFS_DIR_SORTED)
+
+    with open(image_file, 'wb') as f:
+        f.write(data)
+
 def main(argv):
     parser = argparse.ArgumentParser(
         description='Build sdfs image (sdfs)',
@@ -62,6 +99,8 @@ def main(argv):
         print(outmsg)
         sys.exit(1)
 
+    sort_sdfs_dir(args.output_file)
+
     print('SDFS: Generate sdfs file: %s.' %args.output_file)
 
 if __name__ == "__main__":
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019 Actions Semiconductor Co., Ltd
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+
+"""
+Decode heap profile records from a raw trace event capture.
+
+The capture is the binary stream of the trace event buffer (packets
+starting with sync byte 0x7E). "system memprof emit" writes one snapshot
+record followed by one record per caller; mem_malloc/mem_free events, if
+enabled by the trace event mask, are folded into the same per caller view.
+
+Caller addresses are resolved with the symbol list kallsyms is built from:
+
+    mips-mti-elf-nm -n zephyr.elf > zephyr.nm
+    mem_profile.py trace.bin zephyr.nm
+"""
+
+import argparse
+import bisect
+import struct
+import sys
+
+TRACE_SYNC_CODE = 0x7E
+TRACE_HEADER = struct.Struct('<BBBBII')
+
+MEM_TRACE_MALLOC = 0x601
+MEM_TRACE_FREE = 0x602
+MEM_TRACE_SNAPSHOT = 0x603
+MEM_TRACE_SITE = 0x604
+
+
+class Symbols:
+    def __init__(self, nm_file):
+        self.addrs = []
+        self.names = []
+        if not nm_file:
+            return
+
+        with open(nm_file, 'r') as f:
+            for line in f:
+                fields = line.split()
+                if len(fields) != 3 or fields[1] not in 'tTwW':
+                    continue
+                self.addrs.append(int(fields[0], 16))
+                self.names.append(fields[2])
+
+    def lookup(self, addr):
+        if addr == 0:
+            return '<other>'
+
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return '?'
+        return '%s+0x%x' % (self.names[i], addr - self.addrs[i])
+
+
+def packets(data):
+    pos = 0
+    bad = 0
+    while pos + TRACE_HEADER.size <= len(data):
+        if data[pos] != TRACE_SYNC_CODE:
+            pos += 1
+            bad += 1
+            continue
+
+        length = data[pos + 1]
+        if length < TRACE_HEADER.size or pos + length > len(data):
+            pos += 1
+            bad += 1
+            continue
+
+        pkt = data[pos:pos + length]
+        checksum = (sum(pkt) - pkt[3]) & 0xff
+        if checksum != pkt[3]:
+            pos += 1
+            bad += 1
+            continue
+
+        sync, length, seq, checksum, timestamp, event = \
+            TRACE_HEADER.unpack_from(pkt)
+        yield seq, timestamp, event, pkt[TRACE_HEADER.size:]
+        pos += length
+
+    if bad:
+        print('skipped %d bytes out of sync' % bad, file=sys.stderr)
+
+
+class Site:
+    def __init__(self):
+        self.live = 0
+        self.peak = 0
+        self.count = 0
+
+
+def decode(data):
+    snapshots = []
+    events = {}
+    live = {}
+
+    for seq, timestamp, event, payload in packets(data):
+        if event == MEM_TRACE_SNAPSHOT:
+            sites, live_bytes, peak_bytes, dropped = \
+                struct.unpack_from('<4I', payload)
+            snapshots.append({'time': timestamp, 'live': live_bytes,
+                              'peak': peak_bytes, 'dropped': dropped,
+                              'sites': {}})
+        elif event == MEM_TRACE_SITE and snapshots:
+            caller, live_bytes, peak_bytes, count = \
+                struct.unpack_from('<4I', payload)
+            site = Site()
+            site.live, site.peak, site.count = live_bytes, peak_bytes, count
+            snapshots[-1]['sites'][caller] = site
+        elif event == MEM_TRACE_MALLOC:
+            addr, size, caller = struct.unpack_from('<3I', payload)
+            site = events.setdefault(caller, Site())
+            site.live += size
+            site.count += 1
+            site.peak = max(site.peak, site.live)
+            live[addr] = (caller, size)
+        elif event == MEM_TRACE_FREE:
+            addr, caller = struct.unpack_from('<2I', payload)
+            if addr in live:
+                caller, size = live.pop(addr)
+                events[caller].live -= size
+
+    return snapshots, events
+
+
+def print_sites(sites, symbols):
+    print('  %-10s %10s %10s %8s  %s' % ('caller', 'live', 'peak', 'allocs',
+                                         'symbol'))
+    for caller, site in sorted(sites.items(), key=lambda s: -s[1].peak):
+        print('  0x%08x %10d %10d %8d  %s' % (caller, site.live, site.peak,
+                                            site.count, symbols.lookup(caller)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode heap profile trace')
+    parser.add_argument('trace', help='raw trace event capture')
+    parser.add_argument('nm', nargs='?', help='output of "nm -n zephyr.elf"')
+    parser.add_argument('--all', action='store_true',
+                        help='print every snapshot, not only the last one')
+    args = parser.parse_args()
+
+    with open(args.trace, 'rb') as f:
+        data = f.read()
+
+    symbols = Symbols(args.nm)
+    snapshots, events = decode(data)
+
+    if not args.all:
+        snapshots = snapshots[-1:]
+
+    for snap in snapshots:
+        print('snapshot @%u: live %u bytes, peak %u bytes, dropped %u' %
+              (snap['time'], snap['live'], snap['peak'], snap['dropped']))
+        print_sites(snap['sites'], symbols)
+
+    if events:
+        print('malloc/free events:')
+        print_sites(events, symbols)
+
+    if not snapshots and not events:
+        print('no heap profile records found')
+        return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -85,6 +85,9 @@ int fs_close(fs_file_t *zfp)
 {
 	FRESULT res;
 
+	if (zfp->fp.obj.fs)
+		fs_fastseek_disable(zfp);
+
 	res = f_close(&zfp->fp);
 
 	return translate_error(res);
@@ -117,6 +120,10 @@ ssize_t fs_write(fs_file_t *zfp, const void *ptr, size_t size)
 	FRESULT res;
 	unsigned int bw;
 
+	/* the cluster map can not grow with the file */
+	if (f_tell(&zfp->fp) + size > f_size(&zfp->fp))
+		fs_fastseek_disable(zfp);
+
 	res = f_write(&zfp->fp, ptr, size, &bw);
 	if (res != FR_OK) {
 		return translate_error(res);
@@ -185,6 +192,8 @@ int fs_truncate(fs_file_t *zfp, off_t length)
 	FRESULT res = FR_OK;
 	off_t cur_length = f_size(&zfp->fp);
 
+	fs_fastseek_disable(zfp);
+
 	/* f_lseek expands file if new position is larger than file size */
 	res = f_lseek(&zfp->fp, length);
 	if (res != FR_OK) {
@@ -231,6 +240,8 @@ int fs_trunc_quick(fs_file_t *zfp, off_t length)
 	FRESULT res = FR_OK;
 	off_t cur_length = f_size(&zfp->fp);
 
+	fs_fastseek_disable(zfp);
+
 	/* Optimize: No need to do any operation */
 	if (cur_length == length)
 		return translate_error(res);
@@ -254,6 +265,113 @@ int fs_trunc_quick(fs_file_t *zfp, off_t length)
 	return translate_error(res);
 }
 
+int fs_expand(fs_file_t *zfp, off_t length)
+{
+	FSIZE_t ofs = f_tell(&zfp->fp);
+	FRESULT res;
+	bool full;
+
+	if (length <= f_size(&zfp->fp))
+		return 0;
+
+	fs_fastseek_disable(zfp);
+
+#if _USE_EXPAND
+	if (f_size(&zfp->fp) == 0) {
+		res = f_expand(&zfp->fp, length, 1);
+		if (res == FR_OK)
+			return translate_error(f_sync(&zfp->fp));
+
+		/* no contiguous run that long, allocate cluster by cluster */
+		if (res != FR_DENIED)
+			return translate_error(res);
+	}
+#endif
+
+	/* f_lseek expands file if new position is larger than file size */
+	res = f_lseek(&zfp->fp, length);
+	if (res != FR_OK)
+		return translate_error(res);
+
+	/* stops short when the volume is full */
+	full = (f_tell(&zfp->fp) != length);
+
+	res = f_sync(&zfp->fp);
+	if (res == FR_OK)
+		res = f_lseek(&zfp->fp, ofs);
+	if (res != FR_OK)
+		return translate_error(res);
+
+	return full ? -ENOSPC : 0;
+}
+
+int fs_fastseek_enable(fs_file_t *zfp, int max_fragments)
+{
+#if _USE_FASTSEEK
+	/*
+	 * map size in words, then length and first cluster of each fragment,
+	 * 0 terminated. Most files have a few fragments, map them on the stack
+	 * first to learn the size to allocate.
+	 */
+	DWORD tbl_init[2 + 2 * 4];
+	DWORD *tbl;
+	FSIZE_t ofs;
+	FRESULT res;
+
+	if (zfp->fp.cltbl)
+		return 0;
+
+	ofs = f_tell(&zfp->fp);
+
+	tbl_init[0] = ARRAY_SIZE(tbl_init);
+	zfp->fp.cltbl = tbl_init;
+	res = f_lseek(&zfp->fp, CREATE_LINKMAP);
+	zfp->fp.cltbl = NULL;
+
+	if (res != FR_OK && res != FR_NOT_ENOUGH_CORE)
+		return translate_error(res);
+
+	/* tbl_init[0] now holds the number of words the map needs */
+	if ((tbl_init[0] - 2) / 2 > max_fragments)
+		return -ENOMEM;
+
+	tbl = mem_malloc(tbl_init[0] * sizeof(DWORD));
+	if (!tbl)
+		return -ENOMEM;
+
+	if (res == FR_OK) {
+		memcpy(tbl, tbl_init, tbl_init[0] * sizeof(DWORD));
+	} else {
+		tbl[0] = tbl_init[0];
+		zfp->fp.cltbl = tbl;
+		res = f_lseek(&zfp->fp, CREATE_LINKMAP);
+		if (res != FR_OK) {
+			fs_fastseek_disable(zfp);
+			return translate_error(res);
+		}
+	}
+
+	zfp->fp.cltbl = tbl;
+
+	/* reload the current cluster through the map */
+	res = f_lseek(&zfp->fp, ofs);
+
+	return translate_error(res);
+#else
+	return -ENOTSUP;
+#endif
+}
+
+void fs_fastseek_disable(fs_file_t *zfp)
+{
+#if _USE_FASTSEEK
+	if (zfp->fp.cltbl) {
+		mem_free(zfp->fp.cltbl);
+		zfp->fp.cltbl = NULL;
+	}
+#endif
+}
+
 int fs_sync(fs_file_t *zfp)
 {
 	FRESULT res = FR_OK;
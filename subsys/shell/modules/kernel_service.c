@@ -529,6 +529,32 @@ static int shell_cmd_nvram(int argc, char *argv[])
 }
 #endif /* CONFIG_NVRAM_CONFIG */
 
+#if defined(CONFIG_THREAD_TIMER_STATS)
+#include <thread_timer.h>
+
+static int shell_cmd_thread_timer(int argc, char *argv[])
+{
+	struct thread_timer_stats stats;
+
+	thread_timer_get_stats(&stats);
+
+	printk("thread timers: armed %u (max %u), cascaded %u\n",
+	       stats.armed, stats.max_armed, stats.cascaded);
+	printk("wheels %u (max %u) of %u\n",
+	       stats.wheels, stats.max_wheels, CONFIG_THREAD_TIMER_WHEELS);
+	printk("expired %u in %u batches, jitter avg %u ms max %u ms\n",
+	       stats.expired, stats.batches,
+	       stats.expired ? stats.jitter_total_ms / stats.expired : 0,
+	       stats.jitter_max_ms);
+
+	if (argc >= 2 && !strncmp(argv[1], "reset", sizeof("reset"))) {
+		thread_timer_reset_stats();
+	}
+
+	return 0;
+}
+#endif /* CONFIG_THREAD_TIMER_STATS */
+
 #if defined(CONFIG_STACK_BACKTRACE)
 #include <stack_backtrace.h>
 
@@ -988,6 +1014,10 @@ const struct shell_cmd kernel_commands[] = {
 	{ "nvram", shell_cmd_nvram, "show nvram data" },
 #endif
 
+#if defined(CONFIG_THREAD_TIMER_STATS)
+	{ "thread_timer", shell_cmd_thread_timer, "show thread timer statistics: thread_timer [reset]" },
+#endif
+
 #if defined(CONFIG_STACK_BACKTRACE)
 	{ "dumpstack", shell_dumpstack, "dump all thread stack" },
 #endif /* CONFIG_STACK_BACKTRACE */
@@ -199,8 +199,27 @@ static volatile u32_t defered_wr_sz;
 static volatile u32_t defered_rd_off;
 
 #define PAGE_SIZE	CONFIG_MASS_STORAGE_BUF_SIZE
-static u8_t page[PAGE_SIZE] __aligned(4) USB_MASS_STORAGE_DATA;
-static u8_t page2[PAGE_SIZE] __aligned(4) USB_MASS_STORAGE_DATA;
+#define PAGE_NUM	CONFIG_MASS_STORAGE_BUF_NUM
+#define READ_AHEAD_NUM	min(CONFIG_MASS_STORAGE_READ_AHEAD, PAGE_NUM)
+
+static u8_t pages[PAGE_NUM][PAGE_SIZE] __aligned(4) USB_MASS_STORAGE_DATA;
+
+/*
+ * Buffer ring shared by the disk thread and the endpoint callbacks.
+ * The producer (disk for READ, USB for WRITE) fills buffers in order,
+ * the consumer drains them in the same order, ring_ready counts the
+ * buffers filled and not yet drained. The USB side is chained from
+ * the endpoint callbacks, so it never waits for the disk thread.
+ */
+static u32_t ring_len[PAGE_NUM];
+static u8_t ring_disk;
+static u8_t ring_usb;
+static volatile u8_t ring_ready;
+
+/* sequential read ahead, kept in the first buffers of the ring */
+static u64_t prefetch_addr;
+static u8_t prefetch_num;
+static u8_t prefetch_pdrv;
 
 #define USB_RW_TIMEOUT	K_MSEC(5000)
 
@@ -318,6 +337,109 @@ static inline int usb_mass_read(u8_t *data, u32_t len)
 #endif
 }
 
+/* start the USB transfer of buffer ring_usb */
+static void msc_ring_usb_start(void)
+{
+	int ret;
+
+#ifdef CONFIG_USB_AOTG_DC_MULTI_FIFO
+	ret = usb_mass_transfer(pages[ring_usb], ring_len[ring_usb]);
+#else
+	if (thread_op == THREAD_OP_READ_QUEUED) {
+		ret = usb_write(mass_ep_data[MSD_IN_EP_IDX].ep_addr,
+				pages[ring_usb], ring_len[ring_usb], NULL);
+	} else {
+		ret = usb_read_async(mass_ep_data[MSD_OUT_EP_IDX].ep_addr,
+				pages[ring_usb], ring_len[ring_usb], NULL);
+	}
+#endif
+	if (ret != 0) {
+		SYS_LOG_ERR("Failed to transfer EP %d", ret);
+	}
+}
+
+/*
+ * Whether USB may take buffer ring_usb: filled by disk for READ,
+ * free for WRITE, in which case the length to receive is claimed.
+ */
+static bool msc_ring_usb_next(void)
+{
+	if (thread_op == THREAD_OP_READ_QUEUED) {
+		return ring_ready > 0;
+	}
+
+	if (!length || (ring_ready == PAGE_NUM)) {
+		return false;
+	}
+
+	ring_len[ring_usb] = min(length, PAGE_SIZE);
+	length -= ring_len[ring_usb];
+
+	return true;
+}
+
+/* start USB on the next buffer if it is idle, called by the thread */
+static void msc_ring_usb_kick(void)
+{
+	unsigned int key;
+	bool start = false;
+
+	key = irq_lock();
+	if (!usb_rw_working) {
+		start = msc_ring_usb_next();
+		usb_rw_working = start;
+	}
+	irq_unlock(key);
+
+	if (start) {
+		msc_ring_usb_start();
+	}
+}
+
+/* USB is done with buffer ring_usb, called by the endpoint callbacks */
+static void msc_ring_usb_done(void)
+{
+	if (thread_op == THREAD_OP_READ_QUEUED) {
+		ring_ready--;
+	} else {
+		ring_ready++;
+	}
+	ring_usb = (ring_usb + 1) % PAGE_NUM;
+
+	usb_rw_working = msc_ring_usb_next();
+	if (usb_rw_working) {
+		msc_ring_usb_start();
+	}
+
+	k_sem_give(&usb_wait_sem);
+}
+
+/* disk is done with buffer ring_disk */
+static void msc_ring_disk_done(void)
+{
+	unsigned int key;
+
+	ring_disk = (ring_disk + 1) % PAGE_NUM;
+
+	key = irq_lock();
+	if (thread_op == THREAD_OP_READ_QUEUED) {
+		ring_ready++;
+	} else {
+		ring_ready--;
+	}
+	irq_unlock(key);
+
+	msc_ring_usb_kick();
+}
+
+static void msc_ring_reset(void)
+{
+	usb_rw_working = 0;
+	ring_disk = 0;
+	ring_usb = 0;
+	ring_ready = 0;
+}
+
 static void msd_state_machine_reset(void)
 {
 	stage = READ_CBW;
@@ -327,12 +449,12 @@ static void msd_init(void)
 {
 	memset((void *)&cbw, 0, sizeof(struct CBW));
 	memset((void *)&csw, 0, sizeof(struct CSW));
-	memset(page, 0, sizeof(page));
-	memset(page2, 0, sizeof(page2));
+	memset(pages, 0, sizeof(pages));
 	addr = 0;
 	length = 0;
 	defered_wr_sz = 0;
 	defered_rd_off = 0;
+	prefetch_num = 0;
 }
 
 static bool sendCSW(void)
@@ -664,7 +786,7 @@ static __unused void thread_memory_read_done(void)
 
 	thread_op = THREAD_OP_READ_DONE;
 
-	if (usb_mass_write(page, n) != 0) {
+	if (usb_mass_write(pages[0], n) != 0) {
 		SYS_LOG_ERR("Failed to write EP 0x%x",
 			    mass_ep_data[MSD_IN_EP_IDX].ep_addr);
 	}
@@ -700,7 +822,7 @@ static __unused void memoryRead(void)
 
 	defered_rd_off += n;
 
-	usb_mass_write(&page[offset], n);
+	usb_mass_write(&pages[0][offset], n);
 }
 
 static bool infoTransfer(void)
@@ -996,14 +1118,14 @@ static __unused void memoryVerify(u8_t *buf, u16_t size)
 	/* beginning of a new block -> load a whole block in RAM */
 	if (!(addr % BLOCK_SIZE)) {
 		SYS_LOG_DBG("Disk READ sector %d", (u32_t)(addr/BLOCK_SIZE));
-		if (disk_read(disk_pdrv, page, addr/BLOCK_SIZE, 1)) {
+		if (disk_read(disk_pdrv, pages[0], addr/BLOCK_SIZE, 1)) {
 			SYS_LOG_ERR("---- Disk Read Error %d", (u32_t)(addr/BLOCK_SIZE));
 		}
 	}
 
 	/* info are in RAM -> no need to re-read memory */
 	for (n = 0; n < size; n++) {
-		if (page[addr%BLOCK_SIZE + n] != buf[n]) {
+		if (pages[0][addr%BLOCK_SIZE + n] != buf[n]) {
 			SYS_LOG_DBG("Mismatch sector %d offset %d",
 				    (u32_t)(addr/BLOCK_SIZE), (u32_t)n);
 			memOK = false;
@@ -1031,7 +1153,7 @@ static __unused void memoryWrite(u8_t *buf, u16_t size)
 		SYS_LOG_WRN("Stall OUT endpoint");
 	}
 
-	memcpy(page + defered_wr_sz, buf, size);
+	memcpy(pages[0] + defered_wr_sz, buf, size);
 
 	length -= size;
 	defered_wr_sz += size;
@@ -1072,8 +1194,7 @@ static void mass_storage_bulk_out(u8_t ep,
 		case WRITE10:
 		case WRITE12:
 			SYS_LOG_DBG("> BO - PROC_CBW WR");
-			usb_rw_working = 0;
-			k_sem_give(&usb_wait_sem);
+			msc_ring_usb_done();
 			break;
 #if 0
 		case VERIFY10:
@@ -1149,8 +1270,7 @@ static void mass_storage_bulk_in(u8_t ep,
 		case READ10:
 		case READ12:
 			/* SYS_LOG_DBG("< BI - PROC_CBW  READ"); */
-			usb_rw_working = 0;
-			k_sem_give(&usb_wait_sem);
+			msc_ring_usb_done();
 			break;
 		default:
 			SYS_LOG_ERR("< BI-PROC_CBW default <<ERROR!!>> 0x%x",
@@ -1272,249 +1392,272 @@ done:
 	return 0;
 }
 
-void usb_mass_storage_thread(void *p1, void *p2, void *p3)
+/* wait for the USB side to finish a buffer */
+static int msc_wait_usb(void)
 {
-	u32_t sectors, len, len_ping, len_pong, disk_left;
-	u8_t *page_disk, *page_usb;
-	u8_t skip_disk_write;
-	u8_t disk_state;
 	int ret;
 
-	ARG_UNUSED(p1);
-	ARG_UNUSED(p2);
-	ARG_UNUSED(p3);
+	ret = k_sem_take(&usb_wait_sem, USB_RW_TIMEOUT);
+	if (ret != 0) {
+		SYS_LOG_ERR("usb %s %d",
+			    (thread_op == THREAD_OP_READ_QUEUED) ? "write" : "read", ret);
+		return ret;
+	}
 
-	while (msc_state_running()) {
-restart:
-		k_sem_take(&disk_wait_sem, K_FOREVER);
+	if (!msc_state_running()) {
+		return -ESHUTDOWN;
+	}
 
-		if (!msc_state_running()) {
+	return 0;
+}
+
+/* hand buffers read ahead at the start of this READ to USB */
+static void msc_read_ahead_take(void)
+{
+	u32_t len;
+	u8_t i;
+
+	if (!prefetch_num || (prefetch_addr != addr) ||
+	    (prefetch_pdrv != disk_pdrv)) {
+		prefetch_num = 0;
+		return;
+	}
+
+	for (i = 0; (i < prefetch_num) && length; i++) {
+		len = min(length, PAGE_SIZE);
+		addr += len;
+		length -= len;
+		csw.DataResidue -= len;
+
+		ring_len[ring_disk] = len;
+		msc_ring_disk_done();
+	}
+
+	SYS_LOG_DBG("read ahead hit %d", i);
+	prefetch_num = 0;
+}
+
+/*
+ * Read the buffers following a READ while the host handles the CSW,
+ * stop as soon as the next command is queued.
+ */
+static void msc_read_ahead(u64_t next_addr)
+{
+	prefetch_num = 0;
+	prefetch_addr = next_addr;
+	prefetch_pdrv = disk_pdrv;
+
+	while (prefetch_num < READ_AHEAD_NUM) {
+		if (k_sem_count_get(&disk_wait_sem) || !msc_state_running()) {
 			break;
 		}
 
-		SYS_LOG_DBG("sem %d", thread_op);
+		if ((next_addr + PAGE_SIZE) > memory_size) {
+			break;
+		}
 
-		switch (thread_op) {
-		case THREAD_OP_READ_QUEUED:
-			usb_rw_working = 0;
-			page_disk = page;
+		if (disk_read(disk_pdrv, pages[prefetch_num],
+			      (next_addr/BLOCK_SIZE), PAGE_SIZE / BLOCK_SIZE)) {
+			break;
+		}
 
-			while (length) {
-				if (length > PAGE_SIZE) {
-					len = PAGE_SIZE;
-				} else {
-					len = length;
-				}
+		next_addr += PAGE_SIZE;
+		prefetch_num++;
+	}
+}
 
-				if ((addr + len) > memory_size) {
-					len = memory_size - addr;
-					stage = ERROR;
-				}
-				sectors = len / BLOCK_SIZE;
+static int msc_thread_read(void)
+{
+	u32_t sectors, len;
+	u64_t next_addr;
+	u8_t disk_state;
+	bool passed;
+	int ret;
 
-				SYS_LOG_DBG("read %d sectors", sectors);
+	msc_ring_reset();
+	msc_read_ahead_take();
 
-				if (disk_read(disk_pdrv, page_disk, (addr/BLOCK_SIZE), sectors)) {
-					if (disk_ioctl(disk_pdrv, DISK_HW_DETECT, &disk_state) ||
-					    (disk_state != STA_DISK_OK)) {
-						disk_pdrv = MSC_DISK_NO_MEDIA;
-					}
+	while (length) {
+		/* wait for a buffer USB is done with */
+		while (ring_ready == PAGE_NUM) {
+			ret = msc_wait_usb();
+			if (ret) {
+				return ret;
+			}
+		}
 
-					msc_sense_data = SS_UNRECOVERED_READ_ERROR;
-					SYS_LOG_ERR("Disk Read Error 0x%x %d",
-						    (u32_t)(addr/BLOCK_SIZE), sectors);
-					break;
-				}
+		if (length > PAGE_SIZE) {
+			len = PAGE_SIZE;
+		} else {
+			len = length;
+		}
 
-				addr += len;
-				length -= len;
-				csw.DataResidue -= len;
-
-				while (usb_rw_working) {
-					ret = k_sem_take(&usb_wait_sem, USB_RW_TIMEOUT);
-					if (ret != 0) {
-						SYS_LOG_ERR("usb write %d", ret);
-						goto restart;
-					}
-					if (!msc_state_running()) {
-						goto exit;
-					}
-				}
+		if ((addr + len) > memory_size) {
+			len = memory_size - addr;
+			stage = ERROR;
+		}
+		sectors = len / BLOCK_SIZE;
 
-				usb_rw_working = 1;
-#ifdef CONFIG_USB_AOTG_DC_MULTI_FIFO
-				if (usb_mass_transfer(page_disk, len) != 0) {
-					SYS_LOG_ERR("Failed to write EP 0x%x",
-							mass_ep_data[MSD_IN_EP_IDX].ep_addr);
-				}
-#else
-				if (usb_write(mass_ep_data[MSD_IN_EP_IDX].ep_addr,
-				    page_disk, len, NULL) != 0) {
-					SYS_LOG_ERR("Failed to write EP 0x%x",
-							mass_ep_data[MSD_IN_EP_IDX].ep_addr);
-				}
-#endif
-				if (page_disk == page) {
-					page_disk = page2;
-				} else {
-					page_disk = page;
-				}
+		SYS_LOG_DBG("read %d sectors", sectors);
 
-				if (stage == ERROR) {
-					break;
-				}
+		if (disk_read(disk_pdrv, pages[ring_disk], (addr/BLOCK_SIZE), sectors)) {
+			if (disk_ioctl(disk_pdrv, DISK_HW_DETECT, &disk_state) ||
+			    (disk_state != STA_DISK_OK)) {
+				disk_pdrv = MSC_DISK_NO_MEDIA;
 			}
 
-			while (usb_rw_working) {
-				ret = k_sem_take(&usb_wait_sem, USB_RW_TIMEOUT);
-				if (ret != 0) {
-					SYS_LOG_ERR("usb write last %d", ret);
-					goto restart;
-				}
-				if (!msc_state_running()) {
-					goto exit;
-				}
-			}
+			msc_sense_data = SS_UNRECOVERED_READ_ERROR;
+			SYS_LOG_ERR("Disk Read Error 0x%x %d",
+				    (u32_t)(addr/BLOCK_SIZE), sectors);
+			break;
+		}
 
-			/* stall unitl USB write done */
-			if (msc_sense_data) {
-				stage = ERROR;
-				usb_ep_set_stall(mass_ep_data[MSD_IN_EP_IDX].ep_addr);
-			}
+		addr += len;
+		length -= len;
+		csw.DataResidue -= len;
 
-			thread_op = THREAD_OP_READ_DONE;
+		/* USB sends it as soon as the buffers before are sent */
+		ring_len[ring_disk] = len;
+		msc_ring_disk_done();
 
-			csw.Status = (stage == ERROR) ? CSW_FAILED : CSW_PASSED;
-			handle_csw();
+		if (stage == ERROR) {
 			break;
+		}
+	}
 
-		case THREAD_OP_WRITE_QUEUED:
-			page_usb = page;
-			page_disk = page2;
-			disk_left = length;
-			skip_disk_write = 0;
+	while (usb_rw_working) {
+		ret = msc_wait_usb();
+		if (ret) {
+			return ret;
+		}
+	}
 
-			SYS_LOG_DBG("length: %d, disk_left: %d",
-				length, disk_left);
+	/* stall unitl USB write done */
+	if (msc_sense_data) {
+		stage = ERROR;
+		usb_ep_set_stall(mass_ep_data[MSD_IN_EP_IDX].ep_addr);
+	}
 
-			if (length > PAGE_SIZE) {
-				len_ping = PAGE_SIZE;
-			} else {
-				len_ping = length;
-			}
-			length -= len_ping;
-			len_pong = 0;	/* for compiler */
+	thread_op = THREAD_OP_READ_DONE;
 
-#ifdef CONFIG_USB_AOTG_DC_MULTI_FIFO
-			usb_mass_transfer(page_usb, len_ping);
-#else
-			usb_read_async(mass_ep_data[MSD_OUT_EP_IDX].ep_addr,
-					page_usb, len_ping, NULL);
-#endif
-			ret = k_sem_take(&usb_wait_sem, USB_RW_TIMEOUT);
-			if (ret != 0) {
-				SYS_LOG_ERR("usb read first %d", ret);
-				goto restart;
-			}
-			if (!msc_state_running()) {
-				goto exit;
-			}
-			SYS_LOG_DBG("usb read ping");
-
-			while (1) {
-				while (usb_rw_working) {
-					ret = k_sem_take(&usb_wait_sem, USB_RW_TIMEOUT);
-					if (ret != 0) {
-						SYS_LOG_ERR("usb read %d", ret);
-						goto restart;
-					}
-					if (!msc_state_running()) {
-						goto exit;
-					}
-				}
+	/* the next CBW may change addr as soon as the CSW is sent */
+	next_addr = addr;
+	passed = (stage != ERROR);
 
-				if (length) {
-					usb_rw_working = 1;
-
-					if (length > PAGE_SIZE) {
-						len = PAGE_SIZE;
-					} else {
-						len = length;
-					}
-					length -= len;
-
-					if (page_usb == page) {
-						page_usb = page2;
-						len_pong = len;
-						SYS_LOG_DBG("usb read pong");
-					} else {
-						page_usb = page;
-						len_ping = len;
-						SYS_LOG_DBG("usb read ping");
-					}
+	csw.Status = passed ? CSW_PASSED : CSW_FAILED;
+	handle_csw();
 
-#ifdef CONFIG_USB_AOTG_DC_MULTI_FIFO
-					usb_mass_transfer(page_usb, len);
-#else
-					usb_read_async(mass_ep_data[MSD_OUT_EP_IDX].ep_addr,
-						page_usb, len, NULL);
-#endif
-				}
+	if (passed) {
+		msc_read_ahead(next_addr);
+	}
 
-				if (page_disk == page) {
-					page_disk = page2;
-					len = len_pong;
-					SYS_LOG_DBG("disk write pong");
-				} else {
-					page_disk = page;
-					len = len_ping;
-					SYS_LOG_DBG("disk write ping");
-				}
+	return 0;
+}
 
-				if ((addr + len) > memory_size) {
-					len = memory_size - addr;
-					stage = ERROR;
-					usb_ep_set_stall(mass_ep_data[MSD_OUT_EP_IDX].ep_addr);
-					SYS_LOG_WRN("Stall OUT endpoint");
-				}
-				sectors = len / BLOCK_SIZE;
+static int msc_thread_write(void)
+{
+	u32_t sectors, len, disk_left;
+	u8_t skip_disk_write = 0;
+	u8_t disk_state;
+	int ret;
+
+	/* data read ahead may be overwritten */
+	prefetch_num = 0;
 
-				SYS_LOG_DBG("write %d sectors", sectors);
+	msc_ring_reset();
+	disk_left = length;
 
-				if ((skip_disk_write == 0) &&
-				    disk_write(disk_pdrv, page_disk, (addr/BLOCK_SIZE), sectors)) {
-					if (disk_ioctl(disk_pdrv, DISK_HW_DETECT, &disk_state) ||
-					    (disk_state != STA_DISK_OK)) {
-						disk_pdrv = MSC_DISK_NO_MEDIA;
-					}
+	SYS_LOG_DBG("length: %d, disk_left: %d", length, disk_left);
 
-					msc_sense_data = SS_WRITE_ERROR;
+	/* USB receives ahead into free buffers while disk writes */
+	msc_ring_usb_kick();
+
+	while (disk_left) {
+		while (!ring_ready) {
+			ret = msc_wait_usb();
+			if (ret) {
+				return ret;
+			}
+		}
+
+		len = ring_len[ring_disk];
+		if ((addr + len) > memory_size) {
+			len = memory_size - addr;
+			stage = ERROR;
+			usb_ep_set_stall(mass_ep_data[MSD_OUT_EP_IDX].ep_addr);
+			SYS_LOG_WRN("Stall OUT endpoint");
+		}
+		sectors = len / BLOCK_SIZE;
+
+		SYS_LOG_DBG("write %d sectors", sectors);
+
+		if ((skip_disk_write == 0) &&
+		    disk_write(disk_pdrv, pages[ring_disk], (addr/BLOCK_SIZE), sectors)) {
+			if (disk_ioctl(disk_pdrv, DISK_HW_DETECT, &disk_state) ||
+			    (disk_state != STA_DISK_OK)) {
+				disk_pdrv = MSC_DISK_NO_MEDIA;
+			}
+
+			msc_sense_data = SS_WRITE_ERROR;
 #if DISK_WRITE_ERROR_CONTINUE
-					skip_disk_write = 1;
+			skip_disk_write = 1;
 #else
-					stage = ERROR;
-					usb_ep_set_stall(mass_ep_data[MSD_OUT_EP_IDX].ep_addr);
+			stage = ERROR;
+			usb_ep_set_stall(mass_ep_data[MSD_OUT_EP_IDX].ep_addr);
 #endif
-					SYS_LOG_ERR("Disk Write Error 0x%x %d",
-							(u32_t)(addr/BLOCK_SIZE), sectors);
-				}
-				disk_left -= len;
-				addr += len;
-				csw.DataResidue -= len;
-				SYS_LOG_DBG("wrote %d, left %d", len, disk_left);
+			SYS_LOG_ERR("Disk Write Error 0x%x %d",
+					(u32_t)(addr/BLOCK_SIZE), sectors);
+		}
+		msc_ring_disk_done();
+
+		disk_left -= len;
+		addr += len;
+		csw.DataResidue -= len;
+		SYS_LOG_DBG("wrote %d, left %d", len, disk_left);
+
+		if (stage != PROCESS_CBW) {
+			break;
+		}
+	}
 
-				if ((!disk_left) || (stage != PROCESS_CBW)) {
 #if DISK_WRITE_ERROR_CONTINUE
-					if (skip_disk_write) {
-						stage = ERROR;
-					}
+	if (skip_disk_write) {
+		stage = ERROR;
+	}
 #endif
-					thread_op = THREAD_OP_WRITE_DONE;
-					SYS_LOG_DBG("write done");
-					csw.Status = (stage == ERROR) ? CSW_FAILED : CSW_PASSED;
-					sendCSW();
-					break;
-				}
+	thread_op = THREAD_OP_WRITE_DONE;
+	SYS_LOG_DBG("write done");
+	csw.Status = (stage == ERROR) ? CSW_FAILED : CSW_PASSED;
+	sendCSW();
+
+	return 0;
+}
+
+void usb_mass_storage_thread(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (msc_state_running()) {
+		k_sem_take(&disk_wait_sem, K_FOREVER);
+
+		if (!msc_state_running()) {
+			break;
+		}
+
+		SYS_LOG_DBG("sem %d", thread_op);
+
+		switch (thread_op) {
+		case THREAD_OP_READ_QUEUED:
+			if (msc_thread_read() == -ESHUTDOWN) {
+				goto exit;
+			}
+			break;
+
+		case THREAD_OP_WRITE_QUEUED:
+			if (msc_thread_write() == -ESHUTDOWN) {
+				goto exit;
 			}
 			break;
 
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Counts the system timer interrupts while the system only runs the timers
+ * of an idle BT connection: the link polls of the bt engine looper, the
+ * ui/battery poll of the app looper and a delayed work of the workqueue.
+ */
+
+#include <ztest.h>
+#include <thread_timer.h>
+#include <sw_isr_table.h>
+#include <soc.h>
+
+#define MEASURE_MS		5000
+
+/* sniff interval of an idle connection */
+#define LINK_POLL_MS		500
+#define APP_POLL_MS		1000
+#define WORK_POLL_MS		300
+
+/* distinct expiry times per second, the app poll falls on a link poll */
+#define EVENTS_PER_SEC		(MSEC_PER_SEC / LINK_POLL_MS + \
+				 MSEC_PER_SEC / WORK_POLL_MS + 1)
+
+extern s32_t _sys_idle_threshold_ticks;
+
+static struct thread_timer link_timer;
+static struct thread_timer app_timer;
+static struct k_delayed_work poll_work;
+static K_SEM_DEFINE(looper_sem, 0, 1);
+static bool poll_running;
+static int events;
+
+static void poll_timer_fn(struct thread_timer *ttimer, void *arg)
+{
+	events++;
+}
+
+static void poll_work_fn(struct k_work *work)
+{
+	events++;
+	if (poll_running)
+		k_delayed_work_submit(&poll_work, WORK_POLL_MS);
+}
+
+/* runs the timers for MEASURE_MS, returns the timer interrupts per second */
+static u32_t measure_wakeups(void)
+{
+	u32_t start, irq_cnt;
+
+	events = 0;
+	poll_running = true;
+	thread_timer_init(&link_timer, poll_timer_fn, NULL);
+	thread_timer_init(&app_timer, poll_timer_fn, NULL);
+	thread_timer_start(&link_timer, LINK_POLL_MS, LINK_POLL_MS);
+	thread_timer_start(&app_timer, APP_POLL_MS, APP_POLL_MS);
+	k_delayed_work_submit(&poll_work, WORK_POLL_MS);
+
+	start = k_uptime_get_32();
+	irq_cnt = _sw_isr_table[IRQ_ID_TIMER0].irq_cnt;
+
+	/* a message looper sleeps until its next thread timer */
+	while (k_uptime_get_32() - start < MEASURE_MS) {
+		k_sem_take(&looper_sem, thread_timer_next_timeout());
+		thread_timer_handle_expired();
+	}
+
+	irq_cnt = _sw_isr_table[IRQ_ID_TIMER0].irq_cnt - irq_cnt;
+
+	poll_running = false;
+	k_delayed_work_cancel(&poll_work);
+	thread_timer_stop(&link_timer);
+	thread_timer_stop(&app_timer);
+
+	TC_PRINT("%d events, %d timer interrupts in %d ms\n",
+		 events, irq_cnt, MEASURE_MS);
+
+	return irq_cnt * MSEC_PER_SEC / MEASURE_MS;
+}
+
+void test_wakeups_tickless(void)
+{
+	u32_t wakeups = measure_wakeups();
+
+	TC_PRINT("tickless idle: %d wakeups per second\n", wakeups);
+	/**TESTPOINT: the CPU only wakes up for the timer expiries */
+	zassert_true(wakeups <= EVENTS_PER_SEC + 1, NULL);
+	zassert_true(events >= (MEASURE_MS / LINK_POLL_MS), "timers not expired");
+}
+
+void test_wakeups_ticking(void)
+{
+	s32_t threshold = _sys_idle_threshold_ticks;
+	u32_t wakeups;
+
+	/* never enter tickless idle */
+	_sys_idle_threshold_ticks = 0x7fffffff;
+	wakeups = measure_wakeups();
+	_sys_idle_threshold_ticks = threshold;
+
+	TC_PRINT("periodic tick: %d wakeups per second\n", wakeups);
+	zassert_true(wakeups >= CONFIG_SYS_CLOCK_TICKS_PER_SEC * 9 / 10, NULL);
+}
+
+void test_uptime_accounting(void)
+{
+	u32_t t0, t1, c0, c1;
+	s32_t diff;
+
+	/* sleep long in tickless idle, the lazily accounted ticks keep time */
+	k_sleep(1);
+	t0 = k_uptime_get_32();
+	c0 = k_cycle_get_32();
+	k_sleep(3000);
+	t1 = k_uptime_get_32();
+	c1 = k_cycle_get_32();
+
+	diff = (t1 - t0) - (c1 - c0) / (CONFIG_SYS_CLOCK_HW_CYCLES_PER_SEC / MSEC_PER_SEC);
+	TC_PRINT("uptime %d ms, %d ms off the cycle count\n", t1 - t0, diff);
+	/**TESTPOINT: uptime follows the clock source within one tick */
+	zassert_true(diff >= -(sys_clock_us_per_tick / USEC_PER_MSEC) &&
+		     diff <= sys_clock_us_per_tick / USEC_PER_MSEC, NULL);
+}
+
+void test_main(void)
+{
+	k_delayed_work_init(&poll_work, poll_work_fn);
+
+	ztest_test_suite(test_tickless_wakeups,
+		ztest_unit_test(test_wakeups_tickless),
+		ztest_unit_test(test_wakeups_ticking),
+		ztest_unit_test(test_uptime_accounting));
+	ztest_run_test_suite(test_tickless_wakeups);
+}
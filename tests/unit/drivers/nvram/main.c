@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+
+/* arch.h is not included on the host */
+unsigned int find_lsb_set(u32_t op);
+void panic(const char *err_msg);
+
+#include <drivers/nvram/nvram_config.c>
+
+#define FACTORY_ADDR	(0x0)
+#define FACTORY_SIZE	(0x1000)
+#define USER_ADDR	(0x1000)
+#define USER_SIZE	(0x4000)
+#define FLASH_SIZE	(USER_ADDR + USER_SIZE)
+
+#define NUM_CONFIGS	(40)
+#define MAX_LEN		(40)
+
+static u8_t flash[FLASH_SIZE];
+static int read_ops, write_ops, erase_ops;
+
+static struct {
+	char name[16];
+	u8_t data[MAX_LEN];
+	int len;
+} model[NUM_CONFIGS + 20];
+
+static const struct partition_entry parts[] = {
+	{ .file_id = PARTITION_FILE_ID_NVRAM_FACTORY, .offset = FACTORY_ADDR, .size = FACTORY_SIZE },
+	{ .file_id = PARTITION_FILE_ID_NVRAM_USER, .offset = USER_ADDR, .size = USER_SIZE },
+};
+
+/* storage and os glue, NOR flash only clears bits */
+struct device *nvram_storage_init(void)
+{
+	return (struct device *)flash;
+}
+
+int nvram_storage_read(struct device *dev, uint32_t addr, void *buf, int32_t size)
+{
+	zassert_true(addr + size <= FLASH_SIZE, "read past end");
+	memcpy(buf, flash + addr, size);
+	read_ops++;
+	return 0;
+}
+
+int nvram_storage_write(struct device *dev, uint32_t addr, const void *buf, int32_t size)
+{
+	const u8_t *p = buf;
+	int i;
+
+	zassert_true(addr + size <= FLASH_SIZE, "write past end");
+	for (i = 0; i < size; i++)
+		flash[addr + i] &= p[i];
+	write_ops++;
+	return 0;
+}
+
+int nvram_storage_erase(struct device *dev, uint32_t addr, int32_t size)
+{
+	zassert_true(addr + size <= FLASH_SIZE, "erase past end");
+	memset(flash + addr, 0xff, size);
+	erase_ops++;
+	return 0;
+}
+
+const struct partition_entry *partition_get_part(u8_t file_id)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(parts); i++) {
+		if (parts[i].file_id == file_id)
+			return &parts[i];
+	}
+
+	return NULL;
+}
+
+int k_sem_take(struct k_sem *sem, s32_t timeout)
+{
+	return 0;
+}
+
+void k_sem_give(struct k_sem *sem)
+{
+}
+
+void k_busy_wait(u32_t usec_to_wait)
+{
+}
+
+unsigned int find_lsb_set(u32_t op)
+{
+	return __builtin_ffs(op);
+}
+
+void panic(const char *err_msg)
+{
+	zassert_unreachable(err_msg);
+}
+
+static void model_set(int i, int len, u32_t seed)
+{
+	int j;
+
+	snprintf(model[i].name, sizeof(model[i].name), "CFG_ITEM_%d", i);
+	for (j = 0; j < len; j++)
+		model[i].data[j] = (seed >> (j % 24)) + j;
+	model[i].len = len;
+}
+
+static void check_model(int num)
+{
+	u8_t buf[MAX_LEN];
+	int i;
+
+	for (i = 0; i < num; i++) {
+		if (!model[i].len) {
+			zassert_equal(nvram_config_get(model[i].name, buf, sizeof(buf)), -ENOENT,
+				      "deleted config found");
+			continue;
+		}
+
+		zassert_equal(nvram_config_get(model[i].name, buf, sizeof(buf)), model[i].len,
+			      model[i].name);
+		zassert_true(!memcmp(buf, model[i].data, model[i].len), "wrong data");
+	}
+}
+
+static void test_init(void)
+{
+	memset(flash, 0xff, sizeof(flash));
+
+	zassert_equal(nvram_config_init(NULL), 0, NULL);
+	zassert_true(user_nvram_region.item_index_valid, NULL);
+	zassert_equal(user_nvram_region.item_index_used, 0, NULL);
+}
+
+static void test_set_get(void)
+{
+	u32_t seed = 5;
+	int i, step, reads;
+
+	for (i = 0; i < NUM_CONFIGS; i++) {
+		model_set(i, 1 + i % MAX_LEN, i);
+		zassert_equal(nvram_config_set(model[i].name, model[i].data, model[i].len), 0, NULL);
+	}
+	check_model(NUM_CONFIGS);
+
+	/* updates and deletes, enough to purge the segment many times */
+	for (step = 0; step < 2000; step++) {
+		seed = seed * 1103515245 + 12345;
+		i = (seed >> 8) % NUM_CONFIGS;
+		model_set(i, ((seed >> 20) % 8) ? 1 + (seed >> 4) % MAX_LEN : 0, seed);
+		zassert_equal(nvram_config_set(model[i].name, model[i].data, model[i].len), 0, NULL);
+	}
+	check_model(NUM_CONFIGS);
+
+	/* a lookup reads the item header, the name and the data */
+	reads = read_ops;
+	check_model(NUM_CONFIGS);
+	zassert_true(read_ops - reads <= NUM_CONFIGS * 4, "items walked in flash");
+
+	/* index is rebuilt the same at boot */
+	zassert_equal(nvram_config_init(NULL), 0, NULL);
+	zassert_true(user_nvram_region.item_index_valid, NULL);
+	check_model(NUM_CONFIGS);
+}
+
+static void test_set_many(void)
+{
+	struct nvram_config_entry entries[NUM_CONFIGS];
+	int i, writes, erases;
+
+	/* unchanged configs are not written */
+	for (i = 0; i < NUM_CONFIGS; i++) {
+		entries[i].name = model[i].name;
+		entries[i].data = model[i].data;
+		entries[i].len = model[i].len;
+	}
+	writes = write_ops;
+	zassert_equal(nvram_config_set_many(entries, NUM_CONFIGS), 0, NULL);
+	zassert_equal(write_ops, writes, "unchanged config written");
+
+	/* fill the segment so the batch needs a purge */
+	while (user_nvram_region.seg_write_offset - user_nvram_region.seg_offset <
+	       user_nvram_region.seg_size - 0x100) {
+		model_set(0, MAX_LEN, write_ops);
+		zassert_equal(nvram_config_set(model[0].name, model[0].data, model[0].len), 0, NULL);
+	}
+
+	for (i = 0; i < NUM_CONFIGS; i += 3) {
+		model_set(i, (i % 2) ? MAX_LEN : 0, i * 77);
+		entries[i].len = model[i].len;
+	}
+	erases = erase_ops;
+	zassert_equal(nvram_config_set_many(entries, NUM_CONFIGS), 0, NULL);
+	zassert_true(erase_ops - erases <= 1, "purged more than once");
+	check_model(NUM_CONFIGS);
+
+	/* one bad entry, nothing is written */
+	entries[5].name = NULL;
+	writes = write_ops;
+	zassert_equal(nvram_config_set_many(entries, NUM_CONFIGS), -EINVAL, NULL);
+	zassert_equal(write_ops, writes, NULL);
+}
+
+static void test_index_full(void)
+{
+	int i;
+
+	/* more configs than the index holds, lookups go to flash */
+	for (i = NUM_CONFIGS; i < ARRAY_SIZE(model); i++) {
+		model_set(i, 4, i);
+		zassert_equal(nvram_config_set(model[i].name, model[i].data, model[i].len), 0, NULL);
+	}
+	zassert_false(user_nvram_region.item_index_valid, NULL);
+	check_model(ARRAY_SIZE(model));
+
+	for (i = ARRAY_SIZE(model) - 1; i >= NUM_CONFIGS; i--) {
+		model[i].len = 0;
+		zassert_equal(nvram_config_set(model[i].name, NULL, 0), 0, NULL);
+	}
+	check_model(ARRAY_SIZE(model));
+
+	/* the next purge builds it again */
+	zassert_equal(nvram_config_init(NULL), 0, NULL);
+	zassert_true(user_nvram_region.item_index_valid, NULL);
+	check_model(ARRAY_SIZE(model));
+}
+
+static void test_benchmark(void)
+{
+	u8_t buf[MAX_LEN];
+	int i, reads;
+
+	reads = read_ops;
+	for (i = 0; i < NUM_CONFIGS; i++)
+		nvram_config_get(model[i].name, buf, sizeof(buf));
+	printf("%d configs, flash reads per get: %.1f indexed", NUM_CONFIGS,
+	       (double)(read_ops - reads) / NUM_CONFIGS);
+
+	user_nvram_region.item_index_valid = false;
+	reads = read_ops;
+	for (i = 0; i < NUM_CONFIGS; i++)
+		nvram_config_get(model[i].name, buf, sizeof(buf));
+	printf(", %.1f walking the segment\n", (double)(read_ops - reads) / NUM_CONFIGS);
+	user_nvram_region.item_index_valid = true;
+}
+
+void test_main(void)
+{
+	ztest_test_suite(nvram_test,
+		ztest_unit_test(test_init),
+		ztest_unit_test(test_set_get),
+		ztest_unit_test(test_set_many),
+		ztest_unit_test(test_index_full),
+		ztest_unit_test(test_benchmark)
+	);
+
+	ztest_run_test_suite(nvram_test);
+}
@@ -0,0 +1,473 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <ext/fs/fat/ff.c>
+#include <subsys/fs/fat_fs.c>
+#include <ext/actions/porting/hal/cache/cache.c>
+#include <ext/actions/porting/hal/cache/file_cache.c>
+
+#define SECTOR_SIZE	(512)
+/* enough 4K clusters for FAT16 */
+#define DISK_SECTORS	(64 * 1024)
+#define DISK_PDRV	(4)
+#define VOLUME		"SD:"
+#define STAGE_SIZE	CONFIG_FILE_CACHE_STAGE_SIZE
+
+#define CACHE_SIZE	(64 * 1024)
+#define BENCH_SIZE	(8 * 1024 * 1024)
+#define BENCH_CHUNK	(1000)
+
+/* rough SD card cost: command overhead plus transfer */
+#define SD_CMD_US	(500)
+#define SD_SECTOR_US	(25)
+
+static u8_t *disk_data;
+static int disk_ops, disk_sectors;
+static FATFS fat_fs;
+static struct k_work *queued_work;
+
+/* disk and os glue */
+DSTATUS disk_initialize(BYTE pdrv)
+{
+	return 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+	return 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != DISK_PDRV || sector + count > DISK_SECTORS)
+		return RES_PARERR;
+
+	memcpy(buff, disk_data + sector * SECTOR_SIZE, count * SECTOR_SIZE);
+	disk_ops++;
+	disk_sectors += count;
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != DISK_PDRV || sector + count > DISK_SECTORS)
+		return RES_PARERR;
+
+	memcpy(disk_data + sector * SECTOR_SIZE, buff, count * SECTOR_SIZE);
+	disk_ops++;
+	disk_sectors += count;
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+	switch (cmd) {
+	case GET_SECTOR_COUNT:
+		*(DWORD *)buff = DISK_SECTORS;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD *)buff = SECTOR_SIZE;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD *)buff = 1;
+		return RES_OK;
+	case CTRL_SYNC:
+		return RES_OK;
+	default:
+		return RES_PARERR;
+	}
+}
+
+static int rtc_get(struct device *dev, struct rtc_time *tm)
+{
+	memset(tm, 0, sizeof(*tm));
+	tm->tm_year = 119;
+	return 0;
+}
+
+static const struct rtc_driver_api rtc_api = {
+	.get_time = rtc_get,
+};
+
+static struct device rtc_dev = {
+	.driver_api = &rtc_api,
+};
+
+struct device *device_get_binding(const char *name)
+{
+	return &rtc_dev;
+}
+
+FRESULT f_map(FIL *fp, void **addr)
+{
+	return FR_INT_ERR;
+}
+
+int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+{
+	return 1;
+}
+
+int ff_req_grant(_SYNC_t sobj)
+{
+	return 1;
+}
+
+void ff_rel_grant(_SYNC_t sobj)
+{
+}
+
+int ff_del_syncobj(_SYNC_t sobj)
+{
+	return 1;
+}
+
+void *ff_memalloc(UINT msize)
+{
+	return malloc(msize);
+}
+
+void ff_memfree(void *mblock)
+{
+	free(mblock);
+}
+
+void *mem_malloc(unsigned int size)
+{
+	return calloc(1, size);
+}
+
+void mem_free(void *ptr)
+{
+	free(ptr);
+}
+
+WCHAR ff_wtoupper(WCHAR chr)
+{
+	return (chr >= 'a' && chr <= 'z') ? chr - 'a' + 'A' : chr;
+}
+
+int nls_utf8_uni2char(int uni, u8_t *out, int boundlen)
+{
+	*out = (u8_t)uni;
+	return 1;
+}
+
+int nls_utf8_char2uni(const u8_t *rawstring, int boundlen, u16_t *uni)
+{
+	*uni = *rawstring;
+	return 1;
+}
+
+void k_mutex_init(struct k_mutex *mutex)
+{
+}
+
+int k_mutex_lock(struct k_mutex *mutex, s32_t timeout)
+{
+	return 0;
+}
+
+void k_mutex_unlock(struct k_mutex *mutex)
+{
+}
+
+void k_sem_init(struct k_sem *sem, unsigned int initial_count, unsigned int limit)
+{
+}
+
+void k_sem_give(struct k_sem *sem)
+{
+}
+
+int k_sem_take(struct k_sem *sem, s32_t timeout)
+{
+	return -EAGAIN;
+}
+
+void k_sleep(s32_t duration)
+{
+}
+
+void k_work_q_start(struct k_work_q *work_q, k_thread_stack_t stack,
+		    size_t stack_size, int prio)
+{
+}
+
+/* the io work runs when the test says so */
+void k_queue_append(struct k_queue *queue, void *data)
+{
+	queued_work = data;
+}
+
+static void run_io_work(void)
+{
+	struct k_work *work = queued_work;
+
+	if (work) {
+		queued_work = NULL;
+		atomic_clear_bit(work->flags, K_WORK_STATE_PENDING);
+		work->handler(work);
+	}
+}
+
+/* cache content is a function of the stream offset */
+static u8_t pattern(u32_t ofs)
+{
+	return (u8_t)((ofs >> 12) * 13 + ofs);
+}
+
+static void fill_pattern(u8_t *buf, u32_t ofs, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = pattern(ofs + i);
+}
+
+static bool check_pattern(const u8_t *buf, u32_t ofs, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (buf[i] != pattern(ofs + i))
+			return false;
+	}
+	return true;
+}
+
+static void test_setup(void)
+{
+	static u8_t work[4096];
+
+	disk_data = calloc(DISK_SECTORS, SECTOR_SIZE);
+	zassert_not_null(disk_data, NULL);
+
+	zassert_equal(f_mkfs(VOLUME, FM_FAT, 4096, work, sizeof(work)), FR_OK, NULL);
+	zassert_equal(f_mount(&fat_fs, VOLUME, 1), FR_OK, NULL);
+	zassert_equal(fat_fs.csize * SECTOR_SIZE, STAGE_SIZE, NULL);
+}
+
+static void test_stream(void)
+{
+	static u8_t buf[3 * STAGE_SIZE];
+	u32_t seed = 5, wpos = 0, rpos = 0;
+	io_cache_t cache;
+	int step, len, ret;
+
+	/* rounded down to whole stages */
+	cache = cache_create(VOLUME "CACHE.BIN", CACHE_SIZE + 100, TYPE_FILE_CACHE);
+	zassert_not_null(cache, NULL);
+	zassert_equal(cache_size(cache), CACHE_SIZE, NULL);
+
+	for (step = 0; step < 20000; step++) {
+		seed = seed * 1103515245 + 12345;
+		len = 1 + (seed >> 8) % ((seed & 0x100) ? 64 : sizeof(buf));
+
+		switch ((seed >> 4) % 4) {
+		case 0:
+			fill_pattern(buf, wpos, len);
+			ret = cache_write_nonblock(cache, buf, len);
+			zassert_true(ret >= 0 && ret <= len, NULL);
+			wpos += ret;
+			break;
+		case 1:
+			run_io_work();
+			break;
+		default:
+			ret = cache_read_nonblock(cache, buf, len);
+			zassert_true(ret >= 0 && ret <= len, NULL);
+			zassert_true(check_pattern(buf, rpos, ret), "wrong data");
+			rpos += ret;
+			break;
+		}
+
+		zassert_equal(cache_length(cache), wpos - rpos, NULL);
+	}
+
+	zassert_true(wpos > 8 * CACHE_SIZE, "ring not wrapped");
+
+	/* the tail is read back from the stages and from the file */
+	zassert_equal(cache_write_finished(cache), 0, NULL);
+	while (cache_length(cache)) {
+		run_io_work();
+		ret = cache_read_nonblock(cache, buf, 700);
+		zassert_true(check_pattern(buf, rpos, ret), "wrong tail");
+		rpos += ret;
+	}
+	zassert_equal(rpos, wpos, NULL);
+
+	zassert_equal(cache_destroy(cache), 0, NULL);
+}
+
+static void test_nonblock_write(void)
+{
+	static u8_t buf[CACHE_SIZE];
+	io_cache_t cache;
+	int ops;
+
+	cache = cache_create(VOLUME "CACHE.BIN", CACHE_SIZE, TYPE_FILE_CACHE);
+	zassert_not_null(cache, NULL);
+
+	/* two stages are taken without any disk io */
+	fill_pattern(buf, 0, sizeof(buf));
+	ops = disk_ops;
+	zassert_equal(cache_write_nonblock(cache, buf, sizeof(buf)), 2 * STAGE_SIZE, NULL);
+	zassert_equal(disk_ops, ops, "writer waited for the disk");
+	zassert_equal(cache_io_pending(cache), 2 * STAGE_SIZE, NULL);
+	zassert_equal(cache_write_nonblock(cache, buf, 1), 0, NULL);
+
+	/* each stage is one aligned multi sector write */
+	run_io_work();
+	zassert_equal(cache_io_pending(cache), 0, NULL);
+	zassert_equal(cache_write_nonblock(cache, buf + 2 * STAGE_SIZE, 100), 100, NULL);
+	zassert_equal(cache_io_pending(cache), 100, NULL);
+
+	/* the partial last stage goes out when the writer finishes */
+	cache_write_finished(cache);
+	run_io_work();
+	zassert_equal(cache_io_pending(cache), 0, NULL);
+
+	zassert_equal(cache_read_nonblock(cache, buf, sizeof(buf)), 2 * STAGE_SIZE + 100, NULL);
+	zassert_true(check_pattern(buf, 0, 2 * STAGE_SIZE + 100), NULL);
+
+	zassert_equal(cache_destroy(cache), 0, NULL);
+}
+
+static void test_reset(void)
+{
+	u8_t buf[1000];
+	io_cache_t cache;
+
+	cache = cache_create(VOLUME "CACHE.BIN", CACHE_SIZE, TYPE_FILE_CACHE);
+	zassert_not_null(cache, NULL);
+
+	fill_pattern(buf, 0, sizeof(buf));
+	zassert_equal(cache_write_nonblock(cache, buf, sizeof(buf)), sizeof(buf), NULL);
+	cache_reset(cache);
+	run_io_work();
+	zassert_equal(cache_length(cache), 0, NULL);
+	zassert_equal(cache_io_pending(cache), 0, NULL);
+
+	zassert_equal(cache_write_nonblock(cache, buf, sizeof(buf)), sizeof(buf), NULL);
+	zassert_equal(cache_read_nonblock(cache, buf, sizeof(buf)), sizeof(buf), NULL);
+	zassert_true(check_pattern(buf, 0, sizeof(buf)), NULL);
+
+	zassert_equal(cache_destroy(cache), 0, NULL);
+}
+
+/* what file_cache did before: seek and unaligned io for every chunk */
+static int old_ring_io(fs_file_t *fp, int *ofs, void *buf, int num, bool write)
+{
+	int file_off = *ofs % CACHE_SIZE;
+	int len = min(num, CACHE_SIZE - file_off);
+	int done;
+
+	fs_seek(fp, file_off, FS_SEEK_SET);
+	done = write ? fs_write(fp, buf, len) : fs_read(fp, buf, len);
+	if (len < num) {
+		fs_seek(fp, 0, FS_SEEK_SET);
+		done += write ? fs_write(fp, (u8_t *)buf + len, num - len) :
+				fs_read(fp, (u8_t *)buf + len, num - len);
+	}
+
+	*ofs += done;
+	return done;
+}
+
+static u64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_report(const char *name, u64_t ns, u64_t writer_ns, int ops, int sectors)
+{
+	double mb = (double)BENCH_SIZE / (1024 * 1024);
+	double sd_ms = ((double)ops * SD_CMD_US + (double)sectors * SD_SECTOR_US) / 1000;
+
+	printf("%-22s %7.1f MB/s %7d disk ops %7.0f ms sd est. %6.1f ms writer\n",
+	       name, mb * 1e9 / ns, ops, sd_ms, (double)writer_ns / 1e6);
+}
+
+static void bench_old(void)
+{
+	static u8_t buf[BENCH_CHUNK];
+	int wofs = 0, rofs = 0, ops, sectors;
+	u64_t ns, writer_ns = 0, t;
+	fs_file_t fp;
+
+	zassert_equal(fs_open(&fp, VOLUME "OLD.BIN"), 0, NULL);
+
+	ops = disk_ops;
+	sectors = disk_sectors;
+	ns = now_ns();
+	while (rofs < BENCH_SIZE) {
+		/* the writer does the disk io itself */
+		t = now_ns();
+		old_ring_io(&fp, &wofs, buf, BENCH_CHUNK, true);
+		writer_ns += now_ns() - t;
+		old_ring_io(&fp, &rofs, buf, BENCH_CHUNK, false);
+	}
+	ns = now_ns() - ns;
+
+	bench_report("seek + unaligned io", ns, writer_ns, disk_ops - ops, disk_sectors - sectors);
+	zassert_equal(fs_close(&fp), 0, NULL);
+}
+
+static void bench_staged(void)
+{
+	static u8_t buf[BENCH_CHUNK];
+	int written = 0, read = 0, ops, sectors;
+	u64_t ns, writer_ns = 0, t;
+	io_cache_t cache;
+
+	cache = cache_create(VOLUME "CACHE.BIN", CACHE_SIZE, TYPE_FILE_CACHE);
+	zassert_not_null(cache, NULL);
+
+	ops = disk_ops;
+	sectors = disk_sectors;
+	ns = now_ns();
+	while (read < BENCH_SIZE) {
+		t = now_ns();
+		written += cache_write_nonblock(cache, buf, BENCH_CHUNK);
+		writer_ns += now_ns() - t;
+		run_io_work();
+		read += cache_read_nonblock(cache, buf, BENCH_CHUNK);
+	}
+	ns = now_ns() - ns;
+
+	bench_report("staged aligned io", ns, writer_ns, disk_ops - ops, disk_sectors - sectors);
+	zassert_equal(cache_destroy(cache), 0, NULL);
+}
+
+static void test_benchmark(void)
+{
+	printf("%d MB through a %d KB file cache in %d byte chunks, 4K clusters\n",
+	       BENCH_SIZE / (1024 * 1024), CACHE_SIZE / 1024, BENCH_CHUNK);
+	bench_old();
+	bench_staged();
+}
+
+void test_main(void)
+{
+	ztest_test_suite(file_cache_test,
+		ztest_unit_test(test_setup),
+		ztest_unit_test(test_stream),
+		ztest_unit_test(test_nonblock_write),
+		ztest_unit_test(test_reset),
+		ztest_unit_test(test_benchmark)
+	);
+
+	ztest_run_test_suite(file_cache_test);
+}
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <kernel.h>
+
+static unsigned int host_irq_lock(void)
+{
+	return 0;
+}
+
+static void host_irq_unlock(unsigned int key)
+{
+}
+
+#undef irq_lock
+#undef irq_unlock
+#define irq_lock()		host_irq_lock()
+#define irq_unlock(key)		host_irq_unlock(key)
+
+/* the linker gives the bounds of sections with C names */
+#define __app_entry_table	__start_app_entry
+#define __app_entry_end		__stop_app_entry
+#define __service_entry_table	__start_service_entry
+#define __service_entry_end	__stop_service_entry
+
+#include <ext/actions/component/system/msg_manager.c>
+
+/* packed like the firmware linker script packs them */
+#define APP(app_name) \
+	const struct app_entry_t __used __aligned(sizeof(void *)) __app_entry_##app_name \
+	__attribute__((__section__("app_entry"))) = { .name = #app_name }
+
+#define SERVICE(srv_name) \
+	const struct service_entry_t __used __aligned(sizeof(void *)) __service_entry_##srv_name \
+	__attribute__((__section__("service_entry"))) = { .name = #srv_name }
+
+APP(main);
+APP(btmusic);
+APP(btcall);
+APP(linein);
+APP(usound);
+APP(music);
+APP(record);
+APP(alarm);
+APP(fm);
+APP(ota);
+APP(tool);
+APP(charge);
+APP(spdif_in);
+APP(mic_in);
+APP(card_reader);
+APP(attest);
+APP(sd_music);
+APP(usb_music);
+APP(nor_music);
+APP(i2srx_in);
+SERVICE(media);
+SERVICE(bluetooth);
+SERVICE(tts);
+SERVICE(ui);
+SERVICE(record);
+SERVICE(bt_engine);
+SERVICE(fs);
+SERVICE(power);
+SERVICE(mqtt);
+SERVICE(lcmusic);
+
+#define APP_NUM		(__stop_app_entry - __start_app_entry)
+#define SRV_NUM		(__stop_service_entry - __start_service_entry)
+
+static struct k_thread threads[64];
+static os_tid_t sent_to;
+static int sent_prio;
+
+/* os glue */
+void *mem_malloc(unsigned int size)
+{
+	return calloc(1, size);
+}
+
+void mem_free(void *ptr)
+{
+	free(ptr);
+}
+
+k_tid_t k_current_get(void)
+{
+	return &threads[1];
+}
+
+int k_thread_priority_get(k_tid_t thread)
+{
+	return 0;
+}
+
+void k_thread_priority_set(k_tid_t thread, int prio)
+{
+}
+
+void os_msg_init(void)
+{
+}
+
+int os_send_async_msg_ex(void *receiver, void *msg, int msg_size, int prio, u32_t flags)
+{
+	sent_to = receiver;
+	sent_prio = prio;
+	return 0;
+}
+
+int os_send_sync_msg(void *receiver, void *msg, int msg_size)
+{
+	sent_to = receiver;
+	return 0;
+}
+
+int os_receive_msg(void *msg, int msg_size, int timeout)
+{
+	return -ETIMEDOUT;
+}
+
+int msg_pool_get_free_msg_num(void)
+{
+	return 0;
+}
+
+void os_msg_clean(void)
+{
+}
+
+int os_get_pending_msg_cnt(void)
+{
+	return 0;
+}
+
+/* msg_manager_get_name_by_tid takes an int, too small for host pointers */
+static char *name_by_tid(os_tid_t tid)
+{
+	struct msg_listener *listener = msg_manager_find_by_tid(tid);
+
+	return listener ? listener->name : NULL;
+}
+
+static u64_t host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void test_init(void)
+{
+	zassert_equal(APP_NUM, 20, NULL);
+	zassert_equal(SRV_NUM, 10, NULL);
+	zassert_true(msg_manager_init(), NULL);
+
+	/* ids come from the entry sections, apps first */
+	zassert_equal(msg_manager_get_listener_id(__start_app_entry[3].name), 3, NULL);
+	zassert_equal(msg_manager_get_listener_id(__start_service_entry[2].name),
+		      APP_NUM + 2, NULL);
+	zassert_equal(msg_manager_get_listener_id("nobody"), -ENOENT, NULL);
+	zassert_is_null(msg_manager_listener_tid("main"), "not added yet");
+}
+
+static void test_listeners(void)
+{
+	char name[4][8];
+	int i, id;
+
+	/* "record" is an app and a service, each has its own id */
+	zassert_true(msg_manager_get_listener_id("record") < APP_NUM, NULL);
+	zassert_true(msg_manager_get_service_listener_id("record") >= APP_NUM, NULL);
+	zassert_equal(msg_manager_get_service_listener_id("main"), -ENOENT, NULL);
+
+	for (i = 0; i < APP_NUM; i++)
+		zassert_true(msg_manager_add_listener(__start_app_entry[i].name, &threads[i]), NULL);
+	for (i = 0; i < SRV_NUM; i++)
+		zassert_true(msg_manager_add_listener(__start_service_entry[i].name,
+						      &threads[APP_NUM + i]), NULL);
+
+	for (i = 0; i < APP_NUM + SRV_NUM; i++) {
+		zassert_equal(msg_manager_get_listener_tid(i), &threads[i], NULL);
+		zassert_equal(name_by_tid(&threads[i]),
+			      listeners[i].name, NULL);
+	}
+	zassert_equal(msg_manager_listener_tid("bluetooth"),
+		      &threads[msg_manager_get_listener_id("bluetooth")], NULL);
+	zassert_true(!strcmp(msg_manager_get_current(), __start_app_entry[1].name), NULL);
+	zassert_equal(msg_manager_listener_tid("record"),
+		      &threads[msg_manager_get_listener_id("record")], NULL);
+
+	/* the app leaves, messages to the name go to the service */
+	zassert_true(msg_manager_remove_listener("record"), NULL);
+	zassert_equal(msg_manager_listener_tid("record"),
+		      &threads[msg_manager_get_service_listener_id("record")], NULL);
+	zassert_true(msg_manager_add_listener("record", &threads[msg_manager_get_listener_id("record")]), NULL);
+
+	/* an app restarts on another thread, the id stays */
+	id = msg_manager_get_listener_id("btcall");
+	zassert_true(msg_manager_remove_listener("btcall"), NULL);
+	zassert_false(msg_manager_remove_listener("btcall"), NULL);
+	zassert_is_null(msg_manager_listener_tid("btcall"), NULL);
+	zassert_is_null(name_by_tid(&threads[id]), NULL);
+	zassert_true(msg_manager_add_listener("btcall", &threads[60]), NULL);
+	zassert_equal(msg_manager_get_listener_id("btcall"), id, NULL);
+	zassert_equal(msg_manager_get_listener_tid(id), &threads[60], NULL);
+	zassert_true(!strcmp(name_by_tid(&threads[60]), "btcall"), NULL);
+
+	/* other names get the spare ids */
+	for (i = 0; i < CONFIG_MSG_MANAGER_MAX_LISTENERS; i++) {
+		snprintf(name[i], sizeof(name[i]), "usr%d", i);
+		zassert_true(msg_manager_add_listener(name[i], &threads[APP_NUM + SRV_NUM + i]), NULL);
+		zassert_equal(msg_manager_get_listener_id(name[i]), APP_NUM + SRV_NUM + i, NULL);
+	}
+	zassert_false(msg_manager_add_listener("one_more", &threads[63]), NULL);
+}
+
+static void test_send(void)
+{
+	struct app_msg msg = { .type = MSG_KEY_INPUT };
+
+	zassert_true(send_async_msg("main", &msg), NULL);
+	zassert_equal(sent_to, &threads[msg_manager_get_listener_id("main")], NULL);
+	zassert_equal(sent_prio, MSG_PRIO_HIGH, NULL);
+
+	zassert_true(msg_manager_send_async_msg_id(msg_manager_get_listener_id("media"), &msg,
+						   MSG_PRIO_LOW, 0), NULL);
+	zassert_equal(sent_to, msg_manager_listener_tid("media"), NULL);
+	zassert_equal(sent_prio, MSG_PRIO_LOW, NULL);
+
+	zassert_true(send_async_msg(ALL_RECEIVER_NAME, &msg), NULL);
+	zassert_equal(sent_to, OS_ANY, NULL);
+
+	zassert_true(msg_manager_remove_listener("ota"), NULL);
+	zassert_false(send_async_msg("ota", &msg), "sent to a stopped app");
+	zassert_false(send_async_msg("nobody", &msg), NULL);
+	zassert_false(msg_manager_send_async_msg_id(1000, &msg, MSG_PRIO_NORMAL, 0), NULL);
+}
+
+/* the list walk the lookups replaced */
+struct list_listener {
+	sys_snode_t node;
+	char *name;
+	os_tid_t tid;
+};
+
+static void test_benchmark(void)
+{
+	static struct list_listener list_listeners[ARRAY_SIZE(threads)];
+	sys_slist_t list;
+	sys_snode_t *node;
+	struct list_listener *item;
+	volatile os_tid_t tid;
+	u64_t start, list_ns, hash_ns;
+	int i, n;
+
+	sys_slist_init(&list);
+	for (i = 0; i < listener_num; i++) {
+		list_listeners[i].name = listeners[i].name;
+		list_listeners[i].tid = listeners[i].tid;
+		sys_slist_append(&list, &list_listeners[i].node);
+	}
+
+	start = host_ns();
+	for (n = 0; n < 100000; n++) {
+		const char *name = listeners[n % listener_num].name;
+
+		SYS_SLIST_FOR_EACH_NODE(&list, node) {
+			item = CONTAINER_OF(node, struct list_listener, node);
+			if (!strcmp(item->name, name)) {
+				tid = item->tid;
+				break;
+			}
+		}
+	}
+	list_ns = host_ns() - start;
+
+	start = host_ns();
+	for (n = 0; n < 100000; n++)
+		tid = msg_manager_listener_tid(listeners[n % listener_num].name);
+	hash_ns = host_ns() - start;
+
+	printf("%d listeners, name lookup: list walk %d ns, hashed %d ns\n", listener_num,
+	       (int)(list_ns / 100000), (int)(hash_ns / 100000));
+	zassert_true(hash_ns < list_ns, NULL);
+	(void)tid;
+}
+
+void test_main(void)
+{
+	ztest_test_suite(msg_manager_test,
+		ztest_unit_test(test_init),
+		ztest_unit_test(test_listeners),
+		ztest_unit_test(test_send),
+		ztest_unit_test(test_benchmark)
+	);
+
+	ztest_run_test_suite(msg_manager_test);
+}
@@ -0,0 +1,571 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <threads.h>
+#include <time.h>
+
+/* the scheduler is modeled below */
+#define _ksched__h_
+#define _kernel_include_wait_q__h_
+
+#include <kernel.h>
+
+struct host_thread {
+	struct k_thread thread;
+	cnd_t cond;
+	int pending;
+	int woken;
+	int ret;
+	s32_t timeout;
+};
+
+#define HOST_THREAD(t)	CONTAINER_OF(t, struct host_thread, thread)
+
+static mtx_t irq_mutex;
+static int irq_nested;
+static u64_t irq_start, irq_off_ns, irq_off_max_ns, irq_off_num;
+static _Thread_local struct k_thread *host_current;
+
+static u64_t host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* interrupts are off from the outermost lock to its unlock */
+static void host_irq_off_end(void)
+{
+	u64_t ns = host_ns() - irq_start;
+
+	irq_off_ns += ns;
+	irq_off_num++;
+	if (ns > irq_off_max_ns)
+		irq_off_max_ns = ns;
+}
+
+static unsigned int host_irq_lock(void)
+{
+	mtx_lock(&irq_mutex);
+	if (!irq_nested++)
+		irq_start = host_ns();
+	return 0;
+}
+
+static void host_irq_unlock(unsigned int key)
+{
+	if (!--irq_nested)
+		host_irq_off_end();
+	mtx_unlock(&irq_mutex);
+}
+
+static void host_pend_current_thread(_wait_q_t *wait_q, s32_t timeout)
+{
+	struct host_thread *cur = HOST_THREAD(host_current);
+
+	sys_dlist_append(wait_q, &cur->thread.base.k_q_node);
+	cur->pending = 1;
+	cur->timeout = timeout;
+}
+
+static unsigned int host_swap(unsigned int key)
+{
+	struct host_thread *cur = HOST_THREAD(host_current);
+	struct timespec ts;
+	int ret = thrd_success;
+
+	irq_nested--;
+	host_irq_off_end();
+
+	if (!cur->pending) {
+		mtx_unlock(&irq_mutex);
+		return 0;
+	}
+
+	timespec_get(&ts, TIME_UTC);
+	ts.tv_sec += cur->timeout / 1000;
+	ts.tv_nsec += (cur->timeout % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	while (!cur->woken && ret == thrd_success) {
+		if (cur->timeout == K_FOREVER)
+			ret = cnd_wait(&cur->cond, &irq_mutex);
+		else
+			ret = cnd_timedwait(&cur->cond, &irq_mutex, &ts);
+	}
+
+	if (cur->woken) {
+		ret = cur->ret;
+	} else {
+		sys_dlist_remove(&cur->thread.base.k_q_node);
+		ret = -EAGAIN;
+	}
+	cur->pending = 0;
+	cur->woken = 0;
+
+	mtx_unlock(&irq_mutex);
+	return ret;
+}
+
+static struct k_thread *host_unpend_first_thread(_wait_q_t *wait_q)
+{
+	sys_dnode_t *node = sys_dlist_get(wait_q);
+
+	return node ? CONTAINER_OF(node, struct k_thread, base.k_q_node) : NULL;
+}
+
+static void host_ready_thread(struct k_thread *thread)
+{
+	HOST_THREAD(thread)->woken = 1;
+	cnd_signal(&HOST_THREAD(thread)->cond);
+}
+
+#undef irq_lock
+#undef irq_unlock
+#define irq_lock()				host_irq_lock()
+#define irq_unlock(key)				host_irq_unlock(key)
+#define _current				host_current
+#define _is_in_isr()				0
+#define _pend_current_thread(wait_q, timeout)	host_pend_current_thread(wait_q, timeout)
+#define _Swap(key)				host_swap(key)
+#define _unpend_first_thread(wait_q)		host_unpend_first_thread(wait_q)
+#define _abort_thread_timeout(thread)		(void)(thread)
+#define _ready_thread(thread)			host_ready_thread(thread)
+#define _set_thread_return_value(thread, value)	(HOST_THREAD(thread)->ret = (value))
+#define _must_switch_threads()			0
+
+#include <ext/actions/porting/os_wrapper/os_wrapper.c>
+
+#define CMD_STOP	(0xff)
+
+static struct host_thread main_thread, rx[8];
+static mtx_t sem_mutex;
+static cnd_t sem_cond;
+
+static volatile int rx_count;
+static u64_t rx_latency_ns;
+
+/* os glue */
+k_tid_t k_thread_create(struct k_thread *new_thread, k_thread_stack_t stack,
+			size_t stack_size, void (*entry)(void *, void *, void *),
+			void *p1, void *p2, void *p3,
+			int prio, u32_t options, s32_t delay)
+{
+	return new_thread;
+}
+
+void k_sem_init(struct k_sem *sem, unsigned int initial_count, unsigned int limit)
+{
+	sem->count = initial_count;
+	sem->limit = limit;
+}
+
+void k_sem_give(struct k_sem *sem)
+{
+	mtx_lock(&sem_mutex);
+	sem->count++;
+	cnd_broadcast(&sem_cond);
+	mtx_unlock(&sem_mutex);
+}
+
+int k_sem_take(struct k_sem *sem, s32_t timeout)
+{
+	mtx_lock(&sem_mutex);
+	while (!sem->count)
+		cnd_wait(&sem_cond, &sem_mutex);
+	sem->count--;
+	mtx_unlock(&sem_mutex);
+	return 0;
+}
+
+k_tid_t k_current_get(void)
+{
+	return host_current;
+}
+
+static void host_thread_init(struct host_thread *thread)
+{
+	memset(thread, 0, sizeof(*thread));
+	cnd_init(&thread->cond);
+	for (int i = 0; i < CONFIG_THREAD_MSG_QUEUE_PRIO; i++)
+		sys_slist_init(&thread->thread.msg_q[i]);
+	sys_dlist_init(&thread->thread.msg_wait_q);
+}
+
+static int send_cmd(struct host_thread *receiver, int cmd)
+{
+	struct app_msg msg = { .cmd = cmd, .value = (int)host_ns() };
+
+	return os_send_async_msg(receiver ? &receiver->thread : OS_ANY, &msg, sizeof(msg));
+}
+
+static int send_ex(struct host_thread *receiver, int type, int cmd, int value,
+		   int prio, u32_t flags)
+{
+	struct app_msg msg = { .type = type, .cmd = cmd, .value = value };
+
+	return os_send_async_msg_ex(&receiver->thread, &msg, sizeof(msg), prio, flags);
+}
+
+/* receive as another thread, from the main test thread */
+static int receive_as(struct host_thread *receiver, struct app_msg *msg, int timeout)
+{
+	int ret;
+
+	host_current = &receiver->thread;
+	ret = os_receive_msg(msg, sizeof(*msg), timeout);
+	host_current = &main_thread.thread;
+
+	return ret;
+}
+
+static void clean_as(struct host_thread *receiver)
+{
+	host_current = &receiver->thread;
+	os_msg_clean();
+	host_current = &main_thread.thread;
+}
+
+static int receiver_entry(void *arg)
+{
+	struct app_msg msg;
+
+	host_current = &((struct host_thread *)arg)->thread;
+
+	for (;;) {
+		zassert_equal(os_receive_msg(&msg, sizeof(msg), OS_FOREVER), 0, NULL);
+		rx_latency_ns += (u32_t)host_ns() - (u32_t)msg.value;
+		rx_count++;
+
+		if (msg.callback)
+			msg.callback(&msg, 0, NULL);
+		if (msg.cmd == CMD_STOP)
+			break;
+	}
+
+	return 0;
+}
+
+static void test_init(void)
+{
+	int i;
+
+	mtx_init(&irq_mutex, mtx_plain | mtx_recursive);
+	mtx_init(&sem_mutex, mtx_plain);
+	cnd_init(&sem_cond);
+
+	host_thread_init(&main_thread);
+	for (i = 0; i < ARRAY_SIZE(rx); i++)
+		host_thread_init(&rx[i]);
+	host_current = &main_thread.thread;
+
+	os_msg_init();
+	zassert_equal(msg_pool_get_free_msg_num(), CONFIG_NUM_MBOX_ASYNC_MSGS, NULL);
+}
+
+static void test_order(void)
+{
+	struct app_msg msg;
+	int i;
+
+	for (i = 0; i < 5; i++)
+		zassert_equal(send_cmd(&rx[0], i), 0, NULL);
+	zassert_equal(send_cmd(NULL, 100), 0, NULL);
+	zassert_equal(send_cmd(&rx[0], 5), 0, NULL);
+	zassert_equal(msg_pool_get_free_msg_num(), CONFIG_NUM_MBOX_ASYNC_MSGS - 7, NULL);
+
+	host_current = &rx[0].thread;
+	zassert_equal(os_get_pending_msg_cnt(), 6, NULL);
+	host_current = &main_thread.thread;
+	zassert_equal(os_get_pending_msg_cnt(), 0, NULL);
+
+	/* own messages in order, then the ones sent to anyone */
+	for (i = 0; i < 6; i++) {
+		zassert_equal(receive_as(&rx[0], &msg, OS_NO_WAIT), 0, NULL);
+		zassert_equal(msg.cmd, i, "out of order");
+	}
+	zassert_equal(receive_as(&rx[0], &msg, OS_NO_WAIT), 0, NULL);
+	zassert_equal(msg.cmd, 100, NULL);
+
+	zassert_equal(receive_as(&rx[0], &msg, OS_NO_WAIT), -ETIMEDOUT, NULL);
+	zassert_equal(msg_pool_get_free_msg_num(), CONFIG_NUM_MBOX_ASYNC_MSGS, "message lost");
+}
+
+static void test_timeout(void)
+{
+	struct app_msg msg;
+	u64_t start = host_ns();
+
+	zassert_equal(receive_as(&rx[0], &msg, 20), -ETIMEDOUT, NULL);
+	zassert_true(host_ns() - start >= 20 * 1000000, "returned early");
+	zassert_true(sys_dlist_is_empty(&rx[0].thread.msg_wait_q), NULL);
+}
+
+static void test_full(void)
+{
+	int i, j;
+
+	/* one stalled receiver cannot take the whole pool */
+	for (i = 0; i < CONFIG_OS_MSG_MAX_PENDING; i++)
+		zassert_equal(send_cmd(&rx[0], i), 0, NULL);
+	zassert_equal(send_cmd(&rx[0], i), -ENOBUFS, NULL);
+	zassert_equal(msg_pool_get_free_msg_num(),
+		      CONFIG_NUM_MBOX_ASYNC_MSGS - CONFIG_OS_MSG_MAX_PENDING, NULL);
+
+	for (j = 1; msg_pool_get_free_msg_num(); j++) {
+		for (i = 0; i < CONFIG_OS_MSG_MAX_PENDING && msg_pool_get_free_msg_num(); i++)
+			zassert_equal(send_cmd(&rx[j], i), 0, NULL);
+	}
+	zassert_equal(send_cmd(&rx[j], 0), -ENOMEM, NULL);
+
+	for (i = 0; i < ARRAY_SIZE(rx); i++)
+		clean_as(&rx[i]);
+	zassert_equal(msg_pool_get_free_msg_num(), CONFIG_NUM_MBOX_ASYNC_MSGS, NULL);
+}
+
+static void test_thread(void)
+{
+	struct app_msg msg = { .cmd = CMD_STOP };
+	thrd_t thread;
+	int i;
+
+	rx_count = 0;
+	zassert_equal(thrd_create(&thread, receiver_entry, &rx[0]), thrd_success, NULL);
+
+	for (i = 0; i < 10; i++)
+		zassert_equal(send_cmd(&rx[0], i), 0, NULL);
+
+	/* returns once the receiver called back */
+	zassert_equal(os_send_sync_msg(&rx[0].thread, &msg, sizeof(msg)), 0, NULL);
+	zassert_equal(rx_count, 11, NULL);
+
+	zassert_equal(thrd_join(thread, NULL), thrd_success, NULL);
+	zassert_equal(msg_pool_get_free_msg_num(), CONFIG_NUM_MBOX_ASYNC_MSGS, NULL);
+}
+
+static bool host_is_pending(struct host_thread *thread)
+{
+	bool pending;
+
+	host_irq_lock();
+	pending = thread->pending && !thread->woken;
+	host_irq_unlock(0);
+
+	return pending;
+}
+
+static void test_any(void)
+{
+	struct app_msg msg = { .cmd = CMD_STOP };
+	thrd_t thread;
+
+	/* clean and count leave the messages sent to anyone */
+	zassert_equal(send_cmd(&rx[0], 1), 0, NULL);
+	zassert_equal(send_cmd(NULL, 2), 0, NULL);
+	host_current = &rx[0].thread;
+	zassert_equal(os_get_pending_msg_cnt(), 1, NULL);
+	host_current = &main_thread.thread;
+	clean_as(&rx[0]);
+	zassert_equal(receive_as(&rx[1], &msg, OS_NO_WAIT), 0, NULL);
+	zassert_equal(msg.cmd, 2, NULL);
+	zassert_equal(msg_pool_get_free_msg_num(), CONFIG_NUM_MBOX_ASYNC_MSGS, NULL);
+
+	/* a blocked receiver is woken, a sync send to anyone returns */
+	rx_count = 0;
+	msg.cmd = CMD_STOP;
+	zassert_equal(thrd_create(&thread, receiver_entry, &rx[1]), thrd_success, NULL);
+	while (!host_is_pending(&rx[1]))
+		thrd_yield();
+
+	zassert_equal(os_send_sync_msg(OS_ANY, &msg, sizeof(msg)), 0, NULL);
+	zassert_equal(rx_count, 1, NULL);
+	zassert_equal(thrd_join(thread, NULL), thrd_success, NULL);
+	zassert_true(sys_dlist_is_empty(&any_msg_receivers), NULL);
+	zassert_true(sys_dlist_is_empty(&rx[1].thread.msg_wait_q), NULL);
+
+	/* a receiver that timed out is not woken again */
+	zassert_equal(receive_as(&rx[1], &msg, 10), -ETIMEDOUT, NULL);
+	zassert_true(sys_dlist_is_empty(&any_msg_receivers), NULL);
+}
+
+static void test_prio(void)
+{
+	struct app_msg msg;
+
+	zassert_equal(send_ex(&rx[0], 1, 0, 0, OS_MSG_PRIO_LOW, 0), 0, NULL);
+	zassert_equal(send_ex(&rx[0], 2, 0, 0, OS_MSG_PRIO_NORMAL, 0), 0, NULL);
+	zassert_equal(send_ex(&rx[0], 3, 0, 0, OS_MSG_PRIO_HIGH, 0), 0, NULL);
+	zassert_equal(send_ex(&rx[0], 4, 0, 0, OS_MSG_PRIO_HIGH, 0), 0, NULL);
+	/* out of range is the lowest priority */
+	zassert_equal(send_ex(&rx[0], 5, 0, 0, 10, 0), 0, NULL);
+
+	receive_as(&rx[0], &msg, OS_NO_WAIT);
+	zassert_equal(msg.type, 3, NULL);
+	receive_as(&rx[0], &msg, OS_NO_WAIT);
+	zassert_equal(msg.type, 4, NULL);
+	receive_as(&rx[0], &msg, OS_NO_WAIT);
+	zassert_equal(msg.type, 2, NULL);
+	receive_as(&rx[0], &msg, OS_NO_WAIT);
+	zassert_equal(msg.type, 1, NULL);
+	receive_as(&rx[0], &msg, OS_NO_WAIT);
+	zassert_equal(msg.type, 5, NULL);
+	zassert_equal(msg_pool_get_free_msg_num(), CONFIG_NUM_MBOX_ASYNC_MSGS, NULL);
+}
+
+static void test_coalesce(void)
+{
+	struct app_msg msg = { .type = 7, .callback = os_sync_msg_callback };
+	int i;
+
+	/* volume steps keep the place of the first one */
+	for (i = 0; i < 10; i++)
+		zassert_equal(send_ex(&rx[0], 7, 0, i, OS_MSG_PRIO_NORMAL, OS_MSG_COALESCE), 0, NULL);
+	zassert_equal(send_ex(&rx[0], 8, 0, 0, OS_MSG_PRIO_NORMAL, 0), 0, NULL);
+	zassert_equal(send_ex(&rx[0], 7, 0, 10, OS_MSG_PRIO_NORMAL, OS_MSG_COALESCE), 0, NULL);
+	zassert_equal(msg_pool_get_free_msg_num(), CONFIG_NUM_MBOX_ASYNC_MSGS - 2, NULL);
+
+	/* another cmd of the same type in between, the last state is kept */
+	zassert_equal(send_ex(&rx[0], 9, 1, 0, OS_MSG_PRIO_NORMAL, OS_MSG_COALESCE), 0, NULL);
+	zassert_equal(send_ex(&rx[0], 9, 2, 0, OS_MSG_PRIO_NORMAL, OS_MSG_COALESCE), 0, NULL);
+	zassert_equal(send_ex(&rx[0], 9, 1, 0, OS_MSG_PRIO_NORMAL, OS_MSG_COALESCE), 0, NULL);
+
+	/* never over a message with a callback */
+	zassert_equal(os_send_async_msg(&rx[0].thread, &msg, sizeof(msg)), 0, NULL);
+	zassert_equal(send_ex(&rx[0], 7, 0, 11, OS_MSG_PRIO_NORMAL, OS_MSG_COALESCE), 0, NULL);
+
+	receive_as(&rx[0], &msg, OS_NO_WAIT);
+	zassert_true(msg.type == 7 && msg.value == 10, "not replaced in place");
+	receive_as(&rx[0], &msg, OS_NO_WAIT);
+	zassert_equal(msg.type, 8, NULL);
+	for (i = 0; i < 3; i++) {
+		receive_as(&rx[0], &msg, OS_NO_WAIT);
+		zassert_true(msg.type == 9 && msg.cmd == (i == 1 ? 2 : 1), "state reordered");
+	}
+	receive_as(&rx[0], &msg, OS_NO_WAIT);
+	zassert_not_null(msg.callback, NULL);
+	receive_as(&rx[0], &msg, OS_NO_WAIT);
+	zassert_true(msg.type == 7 && msg.value == 11, NULL);
+	zassert_equal(receive_as(&rx[0], &msg, OS_NO_WAIT), -ETIMEDOUT, NULL);
+	zassert_equal(msg_pool_get_free_msg_num(), CONFIG_NUM_MBOX_ASYNC_MSGS, NULL);
+}
+
+/* a busy main thread gets volume, battery and key events in bursts */
+static void bench_burst(u32_t flags)
+{
+	struct app_msg msg;
+	int i, n, failed = 0, used = 0, key_pos = -1;
+
+	for (i = 0; i < 200; i++) {
+		if (send_ex(&rx[0], 10, 0, i, OS_MSG_PRIO_NORMAL, flags))
+			failed++;
+		if (!(i % 20) && send_ex(&rx[0], 11, 1, i, OS_MSG_PRIO_LOW, flags))
+			failed++;
+		if (i == 150 && send_ex(&rx[0], 12, 0, i, OS_MSG_PRIO_HIGH, 0))
+			failed++;
+		used = max(used, CONFIG_NUM_MBOX_ASYNC_MSGS - msg_pool_get_free_msg_num());
+	}
+
+	for (n = 0; !receive_as(&rx[0], &msg, OS_NO_WAIT); n++) {
+		if (msg.type == 12)
+			key_pos = n;
+	}
+
+	printf("%-10s 211 sent: %2d buffers used, %3d dropped, key %s\n",
+	       flags ? "coalesce:" : "plain:", used, failed,
+	       key_pos < 0 ? "dropped" : (key_pos ? "late" : "received first"));
+
+	/* without coalescing the receiver is full long before the key */
+	if (flags) {
+		zassert_equal(failed, 0, NULL);
+		zassert_equal(used, 3, NULL);
+		zassert_equal(key_pos, 0, "key not received first");
+	}
+}
+
+static u64_t bench_backlog(int threads, int backlog)
+{
+	struct app_msg msg;
+	u64_t start, ns;
+	int i;
+
+	for (i = 0; i < threads * backlog; i++)
+		send_cmd(&rx[i % threads], 0);
+
+	irq_off_ns = irq_off_max_ns = irq_off_num = 0;
+	start = host_ns();
+	for (i = 0; i < 100000; i++) {
+		send_cmd(&rx[i % threads], 0);
+		receive_as(&rx[i % threads], &msg, OS_NO_WAIT);
+	}
+	ns = host_ns() - start;
+
+	printf("%d threads, %2d pending each: send + receive %3d ns, irq off %2d ns avg %5d ns max\n",
+	       threads, backlog, (int)(ns / 100000), (int)(irq_off_ns / irq_off_num),
+	       (int)irq_off_max_ns);
+
+	for (i = 0; i < threads; i++)
+		clean_as(&rx[i]);
+
+	return irq_off_ns / irq_off_num;
+}
+
+static void test_benchmark(void)
+{
+	struct app_msg msg = { .cmd = CMD_STOP };
+	u64_t least, most, start;
+	thrd_t thread;
+	int i;
+
+	bench_burst(0);
+	bench_burst(OS_MSG_COALESCE);
+
+	least = bench_backlog(1, 0);
+	bench_backlog(4, 8);
+	most = bench_backlog(8, 16);
+	zassert_true(most < 3 * least + 50, "irq off time grows with the backlog");
+
+	/* wakeup of a blocked receiver, then a sync round trip */
+	rx_count = 0;
+	rx_latency_ns = 0;
+	zassert_equal(thrd_create(&thread, receiver_entry, &rx[0]), thrd_success, NULL);
+	for (i = 0; i < 1000; i++) {
+		send_cmd(&rx[0], 0);
+		while (rx_count <= i)
+			thrd_yield();
+	}
+	printf("async wakeup latency %d us\n", (int)(rx_latency_ns / 1000 / 1000));
+
+	start = host_ns();
+	for (i = 0; i < 1000; i++) {
+		msg.cmd = (i == 999) ? CMD_STOP : 0;
+		os_send_sync_msg(&rx[0].thread, &msg, sizeof(msg));
+	}
+	printf("sync round trip %d us\n", (int)((host_ns() - start) / 1000 / 1000));
+	zassert_equal(thrd_join(thread, NULL), thrd_success, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(os_wrapper_test,
+		ztest_unit_test(test_init),
+		ztest_unit_test(test_order),
+		ztest_unit_test(test_timeout),
+		ztest_unit_test(test_full),
+		ztest_unit_test(test_thread),
+		ztest_unit_test(test_any),
+		ztest_unit_test(test_prio),
+		ztest_unit_test(test_coalesce),
+		ztest_unit_test(test_benchmark)
+	);
+
+	ztest_run_test_suite(os_wrapper_test);
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ext/actions/component/property/property_cache.c>
+
+#define NVRAM_ITEMS	(32)
+#define MAX_LEN		(CONFIG_PROPERTY_CACHE_MAX_BYTES + 16)
+
+static struct {
+	char name[16];
+	u8_t data[MAX_LEN];
+	int len;
+} nvram[NVRAM_ITEMS];
+
+static int nvram_gets, nvram_sets, nvram_batches;
+static u32_t uptime;
+
+/* nvram and os glue */
+static int nvram_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < NVRAM_ITEMS; i++) {
+		if (nvram[i].len && !strcmp(nvram[i].name, name))
+			return i;
+	}
+
+	return -1;
+}
+
+static int nvram_store(const char *name, const void *data, int len)
+{
+	int i = nvram_find(name);
+
+	if (i < 0) {
+		if (!len)
+			return 0;
+		for (i = 0; i < NVRAM_ITEMS && nvram[i].len; i++)
+			;
+		zassert_true(i < NVRAM_ITEMS, "nvram full");
+		strcpy(nvram[i].name, name);
+	}
+
+	zassert_true(len <= MAX_LEN, NULL);
+	memcpy(nvram[i].data, data, len);
+	nvram[i].len = len;
+	return 0;
+}
+
+int nvram_config_get(const char *name, void *data, int max_len)
+{
+	int i = nvram_find(name);
+
+	nvram_gets++;
+	if (i < 0)
+		return -ENOENT;
+
+	memcpy(data, nvram[i].data, min(max_len, nvram[i].len));
+	return min(max_len, nvram[i].len);
+}
+
+int nvram_config_set(const char *name, const void *data, int len)
+{
+	nvram_sets++;
+	return nvram_store(name, data, len);
+}
+
+int nvram_config_set_many(const struct nvram_config_entry *entries, int num)
+{
+	int i;
+
+	nvram_batches++;
+	for (i = 0; i < num; i++)
+		nvram_store(entries[i].name, entries[i].data, entries[i].len);
+	return 0;
+}
+
+void *mem_malloc(unsigned int size)
+{
+	return calloc(1, size);
+}
+
+void mem_free(void *ptr)
+{
+	free(ptr);
+}
+
+int k_mutex_lock(struct k_mutex *mutex, s32_t timeout)
+{
+	return 0;
+}
+
+void k_mutex_unlock(struct k_mutex *mutex)
+{
+}
+
+u32_t k_uptime_get_32(void)
+{
+	return uptime;
+}
+
+static void test_init(void)
+{
+	memset(nvram, 0, sizeof(nvram));
+	zassert_equal(property_cache_init(), 0, NULL);
+}
+
+static void test_write_back(void)
+{
+	char buf[MAX_LEN];
+	int vol;
+
+	/* volume changes stay in RAM */
+	for (vol = 0; vol < 100; vol++)
+		zassert_equal(property_cache_set("VOLUME", &vol, sizeof(vol)), 0, NULL);
+	zassert_equal(property_cache_set("BT_LINK_KEY", "0123456789abcdef", 16), 0, NULL);
+	zassert_equal(nvram_sets + nvram_batches, 0, "flash written on set");
+
+	zassert_equal(property_cache_get("VOLUME", &vol, sizeof(vol)), sizeof(vol), NULL);
+	zassert_equal(vol, 99, NULL);
+	zassert_equal(nvram_gets, 0, NULL);
+
+	/* exact match, a prefix of a cached name is another property */
+	zassert_equal(property_cache_get("VOL", buf, sizeof(buf)), -ENOENT, NULL);
+	zassert_equal(nvram_gets, 1, NULL);
+
+	/* busy system, nothing committed until the oldest change is too old */
+	zassert_equal(property_cache_flush_idle(0), 0, NULL);
+	zassert_equal(nvram_batches, 0, NULL);
+	uptime += CONFIG_PROPERTY_CACHE_MAX_DIRTY_SEC * 1000;
+	zassert_equal(property_cache_flush_idle(0), 0, NULL);
+	zassert_equal(nvram_batches, 1, "dirty items not committed in one batch");
+	zassert_equal(nvram_sets, 0, NULL);
+	zassert_equal(nvram_find("VOLUME") >= 0 && nvram_find("BT_LINK_KEY") >= 0, 1, NULL);
+
+	/* unchanged value is not dirty again */
+	vol = 99;
+	zassert_equal(property_cache_set("VOLUME", &vol, sizeof(vol)), 0, NULL);
+	zassert_equal(property_cache_flush_idle(CONFIG_PROPERTY_CACHE_IDLE_COMMIT_MS), 0, NULL);
+	zassert_equal(nvram_batches, 1, NULL);
+
+	vol = 5;
+	zassert_equal(property_cache_set("VOLUME", &vol, sizeof(vol)), 0, NULL);
+	zassert_equal(property_cache_flush_idle(CONFIG_PROPERTY_CACHE_IDLE_COMMIT_MS), 0, NULL);
+	zassert_equal(nvram_batches, 2, "not committed on idle");
+	zassert_equal(*(int *)nvram[nvram_find("VOLUME")].data, 5, NULL);
+}
+
+static void test_read_through(void)
+{
+	char buf[MAX_LEN];
+	int gets;
+
+	nvram_store("BT_NAME", "speaker", 8);
+
+	gets = nvram_gets;
+	zassert_equal(property_cache_get("BT_NAME", buf, sizeof(buf)), 8, NULL);
+	zassert_equal(property_cache_get("BT_NAME", buf, sizeof(buf)), 8, NULL);
+	zassert_equal(nvram_gets - gets, 1, "not cached on read");
+	zassert_true(!strcmp(buf, "speaker"), NULL);
+
+	/* a value that fills the buffer may be cut, read it again next time */
+	nvram_store("BT_ADDR", "112233", 6);
+	gets = nvram_gets;
+	zassert_equal(property_cache_get("BT_ADDR", buf, 6), 6, NULL);
+	zassert_equal(property_cache_get("BT_ADDR", buf, sizeof(buf)), 6, NULL);
+	zassert_equal(property_cache_get("BT_ADDR", buf, sizeof(buf)), 6, NULL);
+	zassert_equal(nvram_gets - gets, 2, NULL);
+
+	/* delete reads back as missing before and after commit */
+	zassert_equal(property_cache_set("BT_NAME", NULL, 0), 0, NULL);
+	zassert_equal(property_cache_get("BT_NAME", buf, sizeof(buf)), -ENOENT, NULL);
+	zassert_equal(property_cache_flush("BT_NAME"), 0, NULL);
+	zassert_equal(nvram_find("BT_NAME"), -1, NULL);
+}
+
+static void test_full(void)
+{
+	char name[16], big[CONFIG_PROPERTY_CACHE_MAX_BYTES];
+	char buf[MAX_LEN];
+	int i, batches, sets;
+
+	/* more dirty items than slots, commits the dirty ones to make room */
+	batches = nvram_batches;
+	for (i = 0; i < 3 * CONFIG_PROPERTY_CACHE_SIZE; i++) {
+		snprintf(name, sizeof(name), "ITEM_%d", i);
+		zassert_equal(property_cache_set(name, &i, sizeof(i)), 0, NULL);
+	}
+	zassert_true(nvram_batches - batches <= 3, NULL);
+	zassert_equal(property_cache_flush(NULL), 0, NULL);
+
+	for (i = 0; i < 3 * CONFIG_PROPERTY_CACHE_SIZE; i++) {
+		snprintf(name, sizeof(name), "ITEM_%d", i);
+		zassert_true(nvram_find(name) >= 0, "item lost");
+		zassert_equal(*(int *)nvram[nvram_find(name)].data, i, NULL);
+	}
+
+	/* too large for the cache, written directly */
+	sets = nvram_sets;
+	memset(big, 0x5a, sizeof(big));
+	zassert_equal(property_cache_set("BIG", big, sizeof(big)), 0, NULL);
+	zassert_equal(nvram_sets - sets, 1, "oversized value cached");
+	zassert_equal(property_cache_get("BIG", buf, sizeof(buf)), sizeof(big), NULL);
+}
+
+static void test_benchmark(void)
+{
+	int i, vol, batches = nvram_batches, sets = nvram_sets;
+
+	/* volume knob turned during playback, idle check every 100ms */
+	for (i = 0; i < 1000; i++) {
+		vol = i % 16;
+		property_cache_set("VOLUME", &vol, sizeof(vol));
+		uptime += 100;
+		property_cache_flush_idle((i % 200) == 199 ? CONFIG_PROPERTY_CACHE_IDLE_COMMIT_MS : 0);
+	}
+	property_cache_flush(NULL);
+
+	printf("1000 volume changes: %d flash commits\n",
+	       nvram_batches - batches + nvram_sets - sets);
+	zassert_true(nvram_batches - batches + nvram_sets - sets <= 10, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(property_test,
+		ztest_unit_test(test_init),
+		ztest_unit_test(test_write_back),
+		ztest_unit_test(test_read_through),
+		ztest_unit_test(test_full),
+		ztest_unit_test(test_benchmark)
+	);
+
+	ztest_run_test_suite(property_test);
+}
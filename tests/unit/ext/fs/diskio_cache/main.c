@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <ext/fs/fat/diskio_cache.c>
+
+#define SECTOR_SIZE	(512)
+#define DISK_SECTORS	(256)
+#define LINE_SECTORS	(CONFIG_DISKIO_CACHE_LINE_SIZE / SECTOR_SIZE)
+
+static int sem_count;
+
+void k_sem_init(struct k_sem *sem, unsigned int initial_count, unsigned int limit)
+{
+	sem_count = initial_count;
+}
+
+void k_sem_give(struct k_sem *sem)
+{
+	sem_count = 1;
+}
+
+int k_sem_take(struct k_sem *sem, s32_t timeout)
+{
+	/* the cache thread makes one pass per test call */
+	diskio_cache.terminal = 1;
+	sem_count = 0;
+	return 0;
+}
+
+int k_mutex_lock(struct k_mutex *mutex, s32_t timeout)
+{
+	return 0;
+}
+
+void k_mutex_unlock(struct k_mutex *mutex)
+{
+}
+
+int os_thread_create(char *stack, size_t stack_size,
+		     void (*entry)(void *, void *, void *),
+		     void *p1, void *p2, void *p3, int prio, u32_t options, int delay)
+{
+	return 1;
+}
+
+static u8_t disk_data[DISK_SECTORS * SECTOR_SIZE];
+static u8_t model[DISK_SECTORS * SECTOR_SIZE];
+static int read_ops, read_sectors;
+static int write_ops, write_sectors, last_write_count;
+
+static int ram_read(struct disk_info *disk, uint8_t *buf, uint32_t sector, uint32_t num)
+{
+	zassert_true(sector + num <= DISK_SECTORS, "read past end");
+	memcpy(buf, disk_data + sector * SECTOR_SIZE, num * SECTOR_SIZE);
+	read_ops++;
+	read_sectors += num;
+	return 0;
+}
+
+static int ram_write(struct disk_info *disk, const uint8_t *buf, uint32_t sector, uint32_t num)
+{
+	zassert_true(sector + num <= DISK_SECTORS, "write past end");
+	memcpy(disk_data + sector * SECTOR_SIZE, buf, num * SECTOR_SIZE);
+	write_ops++;
+	write_sectors += num;
+	last_write_count = num;
+	return 0;
+}
+
+static const struct disk_operation ram_disk_ops = {
+	.read = ram_read,
+	.write = ram_write,
+};
+
+static struct disk_info ram_disk = {
+	.name = "RAM",
+	.sector_size = SECTOR_SIZE,
+	.sector_cnt = DISK_SECTORS,
+	.op = &ram_disk_ops,
+};
+
+static void reset_counters(void)
+{
+	read_ops = read_sectors = 0;
+	write_ops = write_sectors = 0;
+}
+
+static void cache_setup(void)
+{
+	u32_t seed = 11;
+	int i;
+
+	diskio_cache_init(NULL);
+
+	for (i = 0; i < sizeof(disk_data); i++) {
+		seed = seed * 1103515245 + 12345;
+		disk_data[i] = seed >> 16;
+	}
+	memcpy(model, disk_data, sizeof(model));
+	reset_counters();
+}
+
+static void run_cache_thread(void)
+{
+	diskio_cache.terminal = 0;
+	_diskio_cache_thread_loop(&diskio_cache, NULL, NULL);
+}
+
+static void fill_pattern(u8_t *buf, int len, u32_t seed)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (seed + i * 7) >> 1;
+}
+
+static void test_random_access(void)
+{
+	static u8_t buf[16 * SECTOR_SIZE];
+	u32_t seed = 3, sector, count;
+	int step;
+
+	cache_setup();
+
+	for (step = 0; step < 20000; step++) {
+		seed = seed * 1103515245 + 12345;
+		sector = (seed >> 8) % DISK_SECTORS;
+		count = 1 + (seed >> 20) % ((seed & 0x100) ? 3 : 16);
+		if (sector + count > DISK_SECTORS)
+			count = DISK_SECTORS - sector;
+
+		switch ((seed >> 4) % 8) {
+		case 0:
+		case 1:
+		case 2:
+			fill_pattern(buf, count * SECTOR_SIZE, seed);
+			zassert_equal(diskio_cache_write(&ram_disk, 0, buf, sector, count), 0, NULL);
+			memcpy(model + sector * SECTOR_SIZE, buf, count * SECTOR_SIZE);
+			break;
+		case 3:
+			run_cache_thread();
+			break;
+		case 4:
+			if ((seed >> 12) % 16 == 0)
+				zassert_equal(diskio_cache_flush(&ram_disk), 0, NULL);
+			break;
+		default:
+			zassert_equal(diskio_cache_read(&ram_disk, 0, buf, sector, count), 0, NULL);
+			zassert_true(!memcmp(buf, model + sector * SECTOR_SIZE, count * SECTOR_SIZE),
+				     "read returned stale data");
+			break;
+		}
+	}
+
+	zassert_equal(diskio_cache_flush(&ram_disk), 0, NULL);
+	zassert_equal(diskio_cache.dirty_num, 0, NULL);
+	zassert_true(!memcmp(disk_data, model, sizeof(model)), "write back lost data");
+}
+
+static void test_write_back_coalesce(void)
+{
+	u8_t buf[SECTOR_SIZE];
+	int sector;
+
+	cache_setup();
+
+	/* one sector at a time over as many lines as there are sets */
+	for (sector = 0; sector < LINE_SECTORS * DISKIO_CACHE_SETS; sector++) {
+		fill_pattern(buf, SECTOR_SIZE, sector);
+		diskio_cache_write(&ram_disk, 0, buf, sector, 1);
+		memcpy(model + sector * SECTOR_SIZE, buf, SECTOR_SIZE);
+	}
+
+	zassert_equal(sem_count, DISKIO_CACHE_SETS >= DISKIO_CACHE_DIRTY_HIGH, NULL);
+	zassert_equal(write_ops, 0, "written before flush");
+
+	zassert_equal(diskio_cache_flush(&ram_disk), 0, NULL);
+	zassert_equal(write_ops, 1, "dirty lines not merged");
+	zassert_equal(last_write_count, LINE_SECTORS * DISKIO_CACHE_SETS, NULL);
+	zassert_true(!memcmp(disk_data, model, sizeof(model)), NULL);
+}
+
+static void test_dirty_high(void)
+{
+	u8_t buf[SECTOR_SIZE];
+	int line;
+
+	cache_setup();
+
+	/* the cache thread is woken only when the threshold is reached */
+	for (line = 0; line < DISKIO_CACHE_DIRTY_HIGH; line++) {
+		zassert_equal(sem_count, 0, "woken below the threshold");
+		fill_pattern(buf, SECTOR_SIZE, line);
+		diskio_cache_write(&ram_disk, 0, buf, line * LINE_SECTORS, 1);
+		memcpy(model + line * LINE_SECTORS * SECTOR_SIZE, buf, SECTOR_SIZE);
+	}
+
+	zassert_equal(sem_count, 1, NULL);
+	zassert_equal(diskio_cache.dirty_num, DISKIO_CACHE_DIRTY_HIGH, NULL);
+	zassert_equal(write_ops, 0, "written before flush");
+
+	run_cache_thread();
+	zassert_equal(diskio_cache.dirty_num, 0, NULL);
+	zassert_true(!memcmp(disk_data, model, sizeof(model)), NULL);
+}
+
+static void test_readahead(void)
+{
+	u8_t buf[SECTOR_SIZE];
+	int sector;
+
+	cache_setup();
+
+	diskio_cache_read(&ram_disk, 0, buf, 0, 1);
+	diskio_cache_read(&ram_disk, 0, buf, 1, 1);
+	zassert_equal(diskio_cache.prefetch_num, DISKIO_CACHE_READAHEAD, NULL);
+
+	run_cache_thread();
+	zassert_equal(diskio_cache.prefetch_num, 0, NULL);
+
+	reset_counters();
+	for (sector = 2; sector < LINE_SECTORS * (1 + DISKIO_CACHE_READAHEAD); sector++) {
+		diskio_cache_read(&ram_disk, 0, buf, sector, 1);
+		zassert_true(!memcmp(buf, model + sector * SECTOR_SIZE, SECTOR_SIZE), NULL);
+	}
+	zassert_equal(read_ops, 0, "prefetched lines missed");
+
+	/* reading on keeps the queue ahead without duplicates */
+	zassert_equal(diskio_cache.prefetch_num, DISKIO_CACHE_READAHEAD, NULL);
+
+	/* random access does not prefetch */
+	run_cache_thread();
+	diskio_cache_read(&ram_disk, 0, buf, 100, 1);
+	diskio_cache_read(&ram_disk, 0, buf, 50, 1);
+	zassert_equal(diskio_cache.prefetch_num, 0, NULL);
+}
+
+static void test_large_transfer(void)
+{
+	static u8_t buf[8 * LINE_SECTORS * SECTOR_SIZE];
+	u8_t sector_buf[SECTOR_SIZE];
+
+	cache_setup();
+
+	/* dirty line in the middle of a large read */
+	fill_pattern(sector_buf, SECTOR_SIZE, 99);
+	diskio_cache_write(&ram_disk, 0, sector_buf, 2 * LINE_SECTORS + 1, 1);
+	memcpy(model + (2 * LINE_SECTORS + 1) * SECTOR_SIZE, sector_buf, SECTOR_SIZE);
+	reset_counters();
+
+	zassert_equal(diskio_cache_read(&ram_disk, 0, buf, 1, 8 * LINE_SECTORS - 2), 0, NULL);
+	zassert_true(!memcmp(buf, model + SECTOR_SIZE, (8 * LINE_SECTORS - 2) * SECTOR_SIZE), NULL);
+	/* head, tail, and the runs before and after the cached line */
+	zassert_equal(read_ops, 4, NULL);
+	zassert_equal(write_ops, 0, "large read flushed the cache");
+	zassert_true(_diskio_find_way(&ram_disk, 2 * LINE_SECTORS) >= 0, "cached line dropped");
+
+	/* whole line writes go through and keep cached lines coherent */
+	fill_pattern(buf, 4 * LINE_SECTORS * SECTOR_SIZE, 5);
+	zassert_equal(diskio_cache_write(&ram_disk, 0, buf, 0, 4 * LINE_SECTORS), 0, NULL);
+	memcpy(model, buf, 4 * LINE_SECTORS * SECTOR_SIZE);
+	zassert_equal(diskio_cache_flush(&ram_disk), 0, NULL);
+	zassert_true(!memcmp(disk_data, model, sizeof(model)), NULL);
+}
+
+static void test_lru(void)
+{
+	u8_t buf[SECTOR_SIZE];
+	u32_t stride = LINE_SECTORS * DISKIO_CACHE_SETS;
+
+	cache_setup();
+
+	/* three lines of set 0 */
+	diskio_cache_read(&ram_disk, 0, buf, 0, 1);
+	diskio_cache_read(&ram_disk, 0, buf, stride, 1);
+	diskio_cache_read(&ram_disk, 0, buf, 0, 1);
+	diskio_cache_read(&ram_disk, 0, buf, 2 * stride, 1);
+
+	zassert_true(_diskio_find_way(&ram_disk, 0) >= 0, "recently used line evicted");
+	zassert_true(_diskio_find_way(&ram_disk, stride) < 0, "lru line kept");
+	zassert_true(_diskio_find_way(&ram_disk, 2 * stride) >= 0, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(diskio_cache_test,
+		ztest_unit_test(test_random_access),
+		ztest_unit_test(test_write_back_coalesce),
+		ztest_unit_test(test_dirty_high),
+		ztest_unit_test(test_readahead),
+		ztest_unit_test(test_large_transfer),
+		ztest_unit_test(test_lru)
+	);
+
+	ztest_run_test_suite(diskio_cache_test);
+}
@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <kernel.h>
+#include <kernel_structs.h>
+
+static struct k_thread host_thread;
+static struct k_thread *host_current = &host_thread;
+static u32_t uptime;
+
+static unsigned int host_irq_lock(void)
+{
+	return 0;
+}
+
+static void host_irq_unlock(unsigned int key)
+{
+}
+
+#undef irq_lock
+#undef irq_unlock
+#define irq_lock()		host_irq_lock()
+#define irq_unlock(key)		host_irq_unlock(key)
+#undef _current
+#define _current		host_current
+
+unsigned int find_lsb_set(u32_t op);
+
+#include <kernel/thread_timer.c>
+
+/* kernel glue */
+u32_t k_uptime_get_32(void)
+{
+	return uptime;
+}
+
+unsigned int find_lsb_set(u32_t op)
+{
+	return __builtin_ffs(op);
+}
+
+static u64_t host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void host_thread_init(u32_t time)
+{
+	memset(&host_thread, 0, sizeof(host_thread));
+	host_current = &host_thread;
+	thread_timer_wheels_used = 0;
+	uptime = time;
+}
+
+static int armed_num(struct k_thread *thread)
+{
+	return thread->thread_timer_q ? thread->thread_timer_q->num : 0;
+}
+
+#define TIMER_NUM	48
+
+struct test_timer {
+	struct thread_timer timer;
+	/* model of the timer */
+	bool armed;
+	u32_t expiry_time;
+	s32_t period;
+	/* calls of the expiry function */
+	int fired;
+	u32_t fired_time;
+	/* timer stopped by the expiry function */
+	struct thread_timer *stop;
+};
+
+static struct test_timer timers[TIMER_NUM];
+static int fired_num;
+
+static void test_expiry(struct thread_timer *ttimer, void *arg)
+{
+	struct test_timer *t = arg;
+
+	zassert_equal(ttimer, &t->timer, NULL);
+	t->fired++;
+	t->fired_time = uptime;
+	fired_num++;
+
+	if (t->stop)
+		thread_timer_stop(t->stop);
+}
+
+static void timers_init(void)
+{
+	int i;
+
+	memset(timers, 0, sizeof(timers));
+	for (i = 0; i < TIMER_NUM; i++)
+		thread_timer_init(&timers[i].timer, test_expiry, &timers[i]);
+}
+
+static void model_start(struct test_timer *t, s32_t duration, s32_t period)
+{
+	thread_timer_start(&t->timer, duration, period);
+	t->armed = true;
+	t->expiry_time = uptime + duration;
+	t->period = period;
+}
+
+/* handle expired timers at the current uptime and check them with the model */
+static void model_handle(void)
+{
+	struct test_timer *t;
+	int i;
+
+	for (i = 0; i < TIMER_NUM; i++)
+		timers[i].fired = 0;
+
+	thread_timer_handle_expired();
+
+	for (i = 0; i < TIMER_NUM; i++) {
+		t = &timers[i];
+		if (t->armed && compare_time(t->expiry_time, uptime) <= 0) {
+			zassert_equal(t->fired, 1, "timer not expired");
+			if (t->period) {
+				t->expiry_time = uptime + t->period;
+			} else {
+				t->armed = false;
+			}
+		} else {
+			zassert_equal(t->fired, 0, "timer expired early");
+		}
+		zassert_equal(thread_timer_is_running(&t->timer), t->armed, NULL);
+	}
+}
+
+static void model_check_timeout(void)
+{
+	int timeout = thread_timer_next_timeout();
+	int remain = K_FOREVER;
+	int i;
+
+	for (i = 0; i < TIMER_NUM; i++) {
+		if (timers[i].armed && (remain == K_FOREVER ||
+		    compare_time(timers[i].expiry_time, uptime) < remain))
+			remain = max(compare_time(timers[i].expiry_time, uptime), 0);
+	}
+
+	zassert_equal(timeout, remain, NULL);
+}
+
+static s32_t random_duration(void)
+{
+	switch (rand() % 5) {
+	case 0:
+		return rand() % 2;
+	case 1:
+		return rand() % 20;
+	case 2:
+		return rand() % 600;
+	case 3:
+		return rand() % 6000;
+	default:
+		return rand() % 70000;
+	}
+}
+
+static void test_start_stop(void)
+{
+	struct test_timer *t = &timers[0];
+
+	host_thread_init(1000);
+	timers_init();
+
+	zassert_equal(thread_timer_next_timeout(), K_FOREVER, NULL);
+
+	model_start(t, 100, 0);
+	zassert_true(thread_timer_is_running(&t->timer), NULL);
+	zassert_equal(thread_timer_next_timeout(), 100, NULL);
+
+	/* restart while running moves it */
+	uptime += 40;
+	model_start(t, 100, 0);
+	zassert_equal(thread_timer_next_timeout(), 100, NULL);
+	zassert_equal(armed_num(&host_thread), 1, NULL);
+
+	thread_timer_stop(&t->timer);
+	thread_timer_stop(&t->timer);
+	t->armed = false;
+	zassert_false(thread_timer_is_running(&t->timer), NULL);
+	zassert_equal(armed_num(&host_thread), 0, NULL);
+	zassert_equal(thread_timer_next_timeout(), K_FOREVER, NULL);
+
+	/* init of a started timer takes it out of the wheel */
+	model_start(t, 10, 10);
+	thread_timer_init(&t->timer, test_expiry, t);
+	t->armed = false;
+	zassert_equal(armed_num(&host_thread), 0, NULL);
+
+	/* due timers expire at once */
+	model_start(t, 0, 0);
+	zassert_equal(thread_timer_next_timeout(), K_NO_WAIT, NULL);
+	model_handle();
+	zassert_equal(t->fired, 1, NULL);
+}
+
+/* apps check and stop their timers before the first init */
+static void test_zeroed_timer(void)
+{
+	static struct thread_timer zeroed;
+
+	host_thread_init(1000);
+	timers_init();
+
+	memset(&zeroed, 0, sizeof(zeroed));
+	zassert_false(thread_timer_is_running(&zeroed), NULL);
+	thread_timer_stop(&zeroed);
+	zassert_is_null(host_thread.thread_timer_q, NULL);
+
+	/* and while the thread has a wheel */
+	model_start(&timers[0], 100, 0);
+	zassert_false(thread_timer_is_running(&zeroed), NULL);
+	thread_timer_stop(&zeroed);
+	zassert_equal(armed_num(&host_thread), 1, NULL);
+	zassert_equal(thread_timer_next_timeout(), 100, NULL);
+
+	thread_timer_init(&zeroed, test_expiry, &timers[1]);
+	zassert_false(thread_timer_is_running(&zeroed), NULL);
+}
+
+static void test_wheel_pool(void)
+{
+	static struct k_thread threads[CONFIG_THREAD_TIMER_WHEELS + 1];
+	struct thread_timer_stats stats;
+	int i;
+
+	host_thread_init(1000);
+	timers_init();
+	memset(threads, 0, sizeof(threads));
+	/* the counters of the wheels dropped by other tests */
+	memset(&thread_timer_stats, 0, sizeof(thread_timer_stats));
+
+	/* taken by the first timer, kept until the looper finds none left */
+	zassert_is_null(host_thread.thread_timer_q, NULL);
+	model_start(&timers[0], 10, 0);
+	zassert_not_null(host_thread.thread_timer_q, NULL);
+	thread_timer_stop(&timers[0].timer);
+	timers[0].armed = false;
+	zassert_not_null(host_thread.thread_timer_q, NULL);
+	thread_timer_handle_expired();
+	zassert_is_null(host_thread.thread_timer_q, NULL);
+	zassert_equal(thread_timer_wheels_used, 0, NULL);
+
+	/* one wheel per thread with timers */
+	for (i = 0; i < CONFIG_THREAD_TIMER_WHEELS; i++) {
+		host_current = &threads[i];
+		thread_timer_start(&timers[i].timer, 100 + i, 0);
+		zassert_true(thread_timer_is_running(&timers[i].timer), NULL);
+	}
+	zassert_equal(thread_timer_wheels_used, BIT(CONFIG_THREAD_TIMER_WHEELS) - 1, NULL);
+	thread_timer_get_stats(&stats);
+	zassert_equal(stats.wheels, CONFIG_THREAD_TIMER_WHEELS, NULL);
+
+	/* the pool is empty, the timer does not start */
+	host_current = &threads[CONFIG_THREAD_TIMER_WHEELS];
+	thread_timer_start(&timers[i].timer, 100, 0);
+	zassert_false(thread_timer_is_running(&timers[i].timer), NULL);
+	zassert_equal(thread_timer_next_timeout(), K_FOREVER, NULL);
+
+	/* an exited thread gives its wheel back with its timers */
+	_thread_timer_release(&threads[0]);
+	zassert_is_null(threads[0].thread_timer_q, NULL);
+	thread_timer_start(&timers[i].timer, 100, 0);
+	zassert_true(thread_timer_is_running(&timers[i].timer), NULL);
+	zassert_false(thread_timer_is_running(&timers[0].timer), "left in the wheel");
+	thread_timer_stop(&timers[0].timer);
+	zassert_equal(armed_num(host_current), 1, NULL);
+
+	for (i = 1; i <= CONFIG_THREAD_TIMER_WHEELS; i++)
+		_thread_timer_release(&threads[i]);
+	zassert_equal(thread_timer_wheels_used, 0, NULL);
+	thread_timer_get_stats(&stats);
+	zassert_equal(stats.wheels, 0, NULL);
+	zassert_equal(stats.max_wheels, CONFIG_THREAD_TIMER_WHEELS, NULL);
+	host_current = &host_thread;
+}
+
+static void test_batch(void)
+{
+	int i;
+
+	host_thread_init(5000);
+	timers_init();
+
+	/* all expire in one slot, the first stops the last */
+	for (i = 0; i < 8; i++)
+		model_start(&timers[i], 300, 0);
+	timers[0].stop = &timers[7].timer;
+	timers[7].armed = false;
+
+	uptime += 300;
+	thread_timer_handle_expired();
+
+	for (i = 0; i < 7; i++)
+		zassert_equal(timers[i].fired, 1, NULL);
+	zassert_equal(timers[7].fired, 0, "stopped timer expired");
+	zassert_equal(armed_num(&host_thread), 0, NULL);
+}
+
+static void test_model(void)
+{
+	struct test_timer *t;
+	int n, i;
+
+	/* starts close to the uptime wrap */
+	host_thread_init(0xffffffff - 100000);
+	timers_init();
+	srand(1);
+
+	for (n = 0; n < 200000; n++) {
+		t = &timers[rand() % TIMER_NUM];
+
+		switch (rand() % 8) {
+		case 0:
+		case 1:
+		case 2:
+			model_start(t, random_duration(), (rand() % 4) ? 0 : 1 + rand() % 3000);
+			break;
+		case 3:
+			thread_timer_stop(&t->timer);
+			t->armed = false;
+			break;
+		case 4:
+			/* long sleep of the thread */
+			uptime += rand() % 20000;
+			model_handle();
+			break;
+		default:
+			uptime += rand() % 4;
+			model_handle();
+			break;
+		}
+
+		model_check_timeout();
+	}
+
+	for (i = 0; i < TIMER_NUM; i++)
+		thread_timer_stop(&timers[i].timer);
+	zassert_equal(armed_num(&host_thread), 0, NULL);
+}
+
+/* a message looper sleeps until the next timeout */
+static void test_looper(void)
+{
+	static const s32_t periods[] = { 20, 100, 500, 500, 1000, 3000, 60000 };
+	u32_t start, last_fired = 0;
+	int i, wakeups = 0, fire_times = 0;
+
+	host_thread_init(123);
+	timers_init();
+
+	for (i = 0; i < ARRAY_SIZE(periods); i++)
+		model_start(&timers[i], periods[i], periods[i]);
+
+	start = uptime;
+	fired_num = 0;
+	while (uptime - start < 600000) {
+		uptime += thread_timer_next_timeout();
+		wakeups++;
+
+		i = fired_num;
+		model_handle();
+		if (fired_num != i && uptime != last_fired) {
+			fire_times++;
+			last_fired = uptime;
+		}
+	}
+
+	printf("%d periodic timers for 600 s: %d expiries, %d wakeups for %d expiry times\n",
+	       (int)ARRAY_SIZE(periods), fired_num, wakeups, fire_times);
+	zassert_equal(wakeups, fire_times, "wakeups without expiry");
+}
+
+/* the sorted list the wheel replaced */
+static sys_dlist_t list_q;
+
+static void list_remove(struct thread_timer *ttimer)
+{
+	struct thread_timer *in_q, *next;
+
+	SYS_DLIST_FOR_EACH_CONTAINER_SAFE(&list_q, in_q, next, node) {
+		if (ttimer == in_q) {
+			sys_dlist_remove(&in_q->node);
+			return;
+		}
+	}
+}
+
+static void list_start(struct thread_timer *ttimer, s32_t duration)
+{
+	struct thread_timer *in_q;
+
+	list_remove(ttimer);
+	ttimer->expiry_time = uptime + duration;
+
+	SYS_DLIST_FOR_EACH_CONTAINER(&list_q, in_q, node) {
+		if (compare_time(ttimer->expiry_time, in_q->expiry_time) < 0) {
+			sys_dlist_insert_before(&list_q, &in_q->node, &ttimer->node);
+			return;
+		}
+	}
+
+	sys_dlist_append(&list_q, &ttimer->node);
+}
+
+static void test_benchmark(void)
+{
+	static s32_t durations[4096];
+	u64_t start, list_ns, wheel_ns;
+	int i, n;
+
+	for (i = 0; i < ARRAY_SIZE(durations); i++)
+		durations[i] = 10 + rand() % 5000;
+
+	for (n = 8; n <= TIMER_NUM; n *= 2) {
+		host_thread_init(0);
+		timers_init();
+		sys_dlist_init(&list_q);
+
+		start = host_ns();
+		for (i = 0; i < 100000; i++) {
+			list_start(&timers[i % n].timer, durations[i % ARRAY_SIZE(durations)]);
+			if (i & 1)
+				list_remove(&timers[(i * 7) % n].timer);
+		}
+		list_ns = host_ns() - start;
+
+		for (i = 0; i < n; i++)
+			sys_dlist_init(&timers[i].timer.node);
+
+		start = host_ns();
+		for (i = 0; i < 100000; i++) {
+			thread_timer_start(&timers[i % n].timer, durations[i % ARRAY_SIZE(durations)], 0);
+			if (i & 1)
+				thread_timer_stop(&timers[(i * 7) % n].timer);
+		}
+		wheel_ns = host_ns() - start;
+
+		printf("%d timers, start/stop: sorted list %d ns, wheel %d ns\n", n,
+		       (int)(list_ns / 100000), (int)(wheel_ns / 100000));
+		if (n >= 32)
+			zassert_true(wheel_ns < list_ns, NULL);
+	}
+}
+
+static void test_stats(void)
+{
+	struct thread_timer_stats stats;
+	int i;
+
+	host_thread_init(0);
+	timers_init();
+	/* the counters of the wheels dropped by other tests */
+	memset(&thread_timer_stats, 0, sizeof(thread_timer_stats));
+
+	for (i = 0; i < 4; i++)
+		model_start(&timers[i], 10 * (i + 1), 0);
+	thread_timer_get_stats(&stats);
+	zassert_equal(stats.armed, 4, NULL);
+
+	/* handled 5 ms late */
+	uptime += 25;
+	model_handle();
+	thread_timer_get_stats(&stats);
+	zassert_equal(stats.armed, 2, NULL);
+	zassert_equal(stats.max_armed, 4, NULL);
+	zassert_equal(stats.expired, 2, NULL);
+	zassert_equal(stats.batches, 2, NULL);
+	zassert_equal(stats.jitter_total_ms, 15 + 5, NULL);
+	zassert_equal(stats.jitter_max_ms, 15, NULL);
+
+	thread_timer_stop(&timers[2].timer);
+	thread_timer_stop(&timers[3].timer);
+	thread_timer_get_stats(&stats);
+	zassert_equal(stats.armed, 0, NULL);
+
+	thread_timer_reset_stats();
+	thread_timer_get_stats(&stats);
+	zassert_equal(stats.expired + stats.max_armed + stats.jitter_max_ms, 0, NULL);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(thread_timer_test,
+		ztest_unit_test(test_start_stop),
+		ztest_unit_test(test_zeroed_timer),
+		ztest_unit_test(test_wheel_pool),
+		ztest_unit_test(test_batch),
+		ztest_unit_test(test_model),
+		ztest_unit_test(test_looper),
+		ztest_unit_test(test_benchmark),
+		ztest_unit_test(test_stats)
+	);
+
+	ztest_run_test_suite(thread_timer_test);
+}
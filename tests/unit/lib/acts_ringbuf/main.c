@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <threads.h>
+#include <sched.h>
+#include <time.h>
+
+#include <lib/utils/source/acts_ringbuf/acts_ringbuf.c>
+
+#define STRESS_TOTAL_BYTES	(64 * 1024 * 1024)
+#define STRESS_MAX_CHUNK	(700)
+
+struct stress_ctx {
+	struct acts_ringbuf *buf;
+	u32_t total;
+	u32_t wraps;
+	u32_t full_spins;
+	u32_t empty_spins;
+	u32_t errors;
+};
+
+static u8_t ring_data[4096];
+static u8_t pattern[2 * STRESS_MAX_CHUNK];
+
+void *mem_malloc(unsigned int num_bytes)
+{
+	return malloc(num_bytes);
+}
+
+void mem_free(void *ptr)
+{
+	free(ptr);
+}
+
+static u64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static u32_t chunk_size(u32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return 1 + (*seed >> 16) % STRESS_MAX_CHUNK;
+}
+
+static int crosses_wrap(struct acts_ringbuf *buf, u32_t idx, u32_t size)
+{
+	u32_t offset = buf->mask ? (idx & buf->mask) : (idx % buf->size);
+
+	return offset + size > buf->size;
+}
+
+static int producer_entry(void *arg)
+{
+	struct stress_ctx *ctx = arg;
+	u32_t seed = 1, done = 0;
+
+	while (done < ctx->total) {
+		u32_t size = min_t(u32_t, chunk_size(&seed), ctx->total - done);
+		u32_t tail = ctx->buf->tail;
+
+		if (!acts_ringbuf_spsc_put(ctx->buf, &pattern[done & 0xff], size)) {
+			ctx->full_spins++;
+			sched_yield();
+			continue;
+		}
+
+		if (crosses_wrap(ctx->buf, tail, size))
+			ctx->wraps++;
+
+		done += size;
+	}
+
+	return 0;
+}
+
+static int consumer_entry(void *arg)
+{
+	struct stress_ctx *ctx = arg;
+	u8_t data[STRESS_MAX_CHUNK];
+	u32_t seed = 7, done = 0;
+
+	while (done < ctx->total) {
+		u32_t size = min_t(u32_t, chunk_size(&seed), ctx->total - done);
+
+		if (!acts_ringbuf_spsc_get(ctx->buf, data, size)) {
+			ctx->empty_spins++;
+			sched_yield();
+			continue;
+		}
+
+		/* producer writes pattern[i & 0xff] for byte i of the stream */
+		if (memcmp(data, &pattern[done & 0xff], size))
+			ctx->errors++;
+
+		done += size;
+	}
+
+	return 0;
+}
+
+static void run_stress(u32_t ring_size)
+{
+	struct acts_ringbuf buf;
+	struct stress_ctx ctx = {
+		.buf = &buf,
+		.total = STRESS_TOTAL_BYTES,
+	};
+	thrd_t producer, consumer;
+	u64_t start, elapsed;
+
+	acts_ringbuf_init(&buf, ring_data, ring_size);
+
+	start = now_ns();
+	thrd_create(&consumer, consumer_entry, &ctx);
+	thrd_create(&producer, producer_entry, &ctx);
+	thrd_join(producer, NULL);
+	thrd_join(consumer, NULL);
+	elapsed = now_ns() - start;
+
+	printf("ring %4u (%s): %llu bytes/s, %u wraps (1 per %u bytes), "
+	       "full %u, empty %u\n", ring_size, buf.mask ? "pow2" : "mod",
+	       (unsigned long long)ctx.total * 1000000000ull / (elapsed ? elapsed : 1),
+	       ctx.wraps, ctx.wraps ? ctx.total / ctx.wraps : 0,
+	       ctx.full_spins, ctx.empty_spins);
+
+	zassert_equal(ctx.errors, 0, "data corrupted");
+	zassert_true(acts_ringbuf_is_empty(&buf), "ring not drained");
+}
+
+static void test_spsc_wrap(void)
+{
+	struct acts_ringbuf buf;
+	u8_t out[16];
+	void *claim;
+
+	zassert_true((uintptr_t)ring_data <= UINT32_MAX, "ring above 4 GiB");
+
+	acts_ringbuf_init(&buf, ring_data, 10);
+
+	zassert_equal(acts_ringbuf_spsc_put(&buf, "abcdefgh", 8), 8, NULL);
+	zassert_equal(acts_ringbuf_spsc_put(&buf, "ijk", 3), 0, "overflow");
+	zassert_equal(acts_ringbuf_spsc_get(&buf, out, 6), 6, NULL);
+	zassert_equal(acts_ringbuf_spsc_put(&buf, "ijklmn", 6), 6, NULL);
+	zassert_equal(acts_ringbuf_spsc_length(&buf), 8, NULL);
+	zassert_equal(acts_ringbuf_spsc_get(&buf, out, 8), 8, NULL);
+	zassert_true(!memcmp(out, "ghijklmn", 8), "wrapped data mismatch");
+
+	zassert_equal(acts_ringbuf_put_claim(&buf, &claim, 4), 4, NULL);
+	memcpy(claim, "wxyz", 4);
+	zassert_equal(acts_ringbuf_spsc_put_finish(&buf, 7), -EINVAL, NULL);
+	zassert_equal(acts_ringbuf_spsc_put_finish(&buf, 4), 0, NULL);
+	zassert_equal(acts_ringbuf_get_claim(&buf, &claim, 4), 4, NULL);
+	zassert_true(!memcmp(claim, "wxyz", 4), "claimed data mismatch");
+	zassert_equal(acts_ringbuf_spsc_get_finish(&buf, 4), 0, NULL);
+
+	zassert_equal(acts_ringbuf_spsc_fill_none(&buf, 10), 10, NULL);
+	zassert_equal(acts_ringbuf_spsc_drop(&buf, 11), 0, NULL);
+	zassert_equal(acts_ringbuf_spsc_drop(&buf, 10), 10, NULL);
+	zassert_true(acts_ringbuf_is_empty(&buf), NULL);
+}
+
+static void test_claim_seg(void)
+{
+	struct acts_ringbuf_seg seg[2];
+	struct acts_ringbuf buf;
+	u8_t out[16];
+
+	acts_ringbuf_init(&buf, ring_data, 10);
+	acts_ringbuf_fill_none(&buf, 7);
+	acts_ringbuf_drop(&buf, 7);
+
+	/* 3 contiguous elements before the wrap, 5 after */
+	zassert_equal(acts_ringbuf_put_claim_seg(&buf, seg, 12), 10, "space not bounded");
+	zassert_equal(acts_ringbuf_put_claim_seg(&buf, seg, 8), 8, NULL);
+	zassert_equal(seg[0].data, ring_data + 7, NULL);
+	zassert_equal(seg[0].len, 3, NULL);
+	zassert_equal(seg[1].data, ring_data, NULL);
+	zassert_equal(seg[1].len, 5, NULL);
+	memcpy(seg[0].data, "abc", 3);
+	memcpy(seg[1].data, "defgh", 5);
+	zassert_equal(acts_ringbuf_fill_none(&buf, 8), 8, NULL);
+
+	zassert_equal(acts_ringbuf_get_claim_seg(&buf, seg, 2), 2, NULL);
+	zassert_equal(seg[1].len, 0, "contiguous claim split");
+	zassert_equal(acts_ringbuf_get_claim_seg(&buf, seg, 16), 8, NULL);
+	zassert_equal(seg[0].len + seg[1].len, 8, NULL);
+
+	zassert_equal(acts_ringbuf_peek(&buf, out, 8), 8, NULL);
+	zassert_true(!memcmp(out, "abcdefgh", 8), "peek across wrap");
+	zassert_equal(acts_ringbuf_drop(&buf, 8), 8, NULL);
+}
+
+static void test_spsc_stress(void)
+{
+	int i;
+
+	for (i = 0; i < sizeof(pattern); i++)
+		pattern[i] = (u8_t)(i * 31 + 7);
+
+	run_stress(4096);
+	run_stress(3000);
+	run_stress(1024);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(acts_ringbuf_test,
+		ztest_unit_test(test_spsc_wrap),
+		ztest_unit_test(test_claim_seg),
+		ztest_unit_test(test_spsc_stress)
+	);
+
+	ztest_run_test_suite(acts_ringbuf_test);
+}
@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ext/fs/fat/ff.c>
+#include <subsys/fs/fat_fs.c>
+#include <lib/utils/source/stream/fstream.c>
+
+#define SECTOR_SIZE	(512)
+/* enough 4K clusters for FAT16 */
+#define DISK_SECTORS	(64 * 1024)
+#define DISK_PDRV	(4)
+#define VOLUME		"SD:"
+#define STEP		CONFIG_FILE_STREAM_PREALLOC_STEP
+#define UNIT		CONFIG_FILE_STREAM_PREALLOC_WRITE_SIZE
+
+#define RECORD_SIZE	(1024 * 1024 + 1234)
+
+static u8_t *disk_data;
+static int fat_writes, data_writes, unaligned_writes;
+static FATFS fat_fs;
+
+/* disk and os glue */
+DSTATUS disk_initialize(BYTE pdrv)
+{
+	return 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+	return 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != DISK_PDRV || sector + count > DISK_SECTORS)
+		return RES_PARERR;
+
+	memcpy(buff, disk_data + sector * SECTOR_SIZE, count * SECTOR_SIZE);
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != DISK_PDRV || sector + count > DISK_SECTORS)
+		return RES_PARERR;
+
+	memcpy(disk_data + sector * SECTOR_SIZE, buff, count * SECTOR_SIZE);
+
+	if (fat_fs.fs_type && sector >= fat_fs.fatbase && sector < fat_fs.dirbase) {
+		fat_writes++;
+	} else if (fat_fs.fs_type && sector >= fat_fs.database) {
+		data_writes++;
+		if ((sector - fat_fs.database) % (UNIT / SECTOR_SIZE) ||
+		    count % (UNIT / SECTOR_SIZE))
+			unaligned_writes++;
+	}
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+	switch (cmd) {
+	case GET_SECTOR_COUNT:
+		*(DWORD *)buff = DISK_SECTORS;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD *)buff = SECTOR_SIZE;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD *)buff = 1;
+		return RES_OK;
+	case CTRL_SYNC:
+		return RES_OK;
+	default:
+		return RES_PARERR;
+	}
+}
+
+static int rtc_get(struct device *dev, struct rtc_time *tm)
+{
+	memset(tm, 0, sizeof(*tm));
+	tm->tm_year = 119;
+	return 0;
+}
+
+static const struct rtc_driver_api rtc_api = {
+	.get_time = rtc_get,
+};
+
+static struct device rtc_dev = {
+	.driver_api = &rtc_api,
+};
+
+struct device *device_get_binding(const char *name)
+{
+	return &rtc_dev;
+}
+
+FRESULT f_map(FIL *fp, void **addr)
+{
+	return FR_INT_ERR;
+}
+
+int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+{
+	return 1;
+}
+
+int ff_req_grant(_SYNC_t sobj)
+{
+	return 1;
+}
+
+void ff_rel_grant(_SYNC_t sobj)
+{
+}
+
+int ff_del_syncobj(_SYNC_t sobj)
+{
+	return 1;
+}
+
+void *ff_memalloc(UINT msize)
+{
+	return malloc(msize);
+}
+
+void ff_memfree(void *mblock)
+{
+	free(mblock);
+}
+
+void *mem_malloc(unsigned int size)
+{
+	return calloc(1, size);
+}
+
+void mem_free(void *ptr)
+{
+	free(ptr);
+}
+
+WCHAR ff_wtoupper(WCHAR chr)
+{
+	return (chr >= 'a' && chr <= 'z') ? chr - 'a' + 'A' : chr;
+}
+
+int nls_utf8_uni2char(int uni, u8_t *out, int boundlen)
+{
+	*out = (u8_t)uni;
+	return 1;
+}
+
+int nls_utf8_char2uni(const u8_t *rawstring, int boundlen, u16_t *uni)
+{
+	*uni = *rawstring;
+	return 1;
+}
+
+void k_mutex_init(struct k_mutex *mutex)
+{
+}
+
+int k_mutex_lock(struct k_mutex *mutex, s32_t timeout)
+{
+	return 0;
+}
+
+void k_mutex_unlock(struct k_mutex *mutex)
+{
+}
+
+io_stream_t stream_create(const stream_ops_t *ops, void *init_param)
+{
+	io_stream_t handle = calloc(1, sizeof(struct __stream));
+
+	handle->ops = ops;
+	if (ops->init(handle, init_param)) {
+		free(handle);
+		return NULL;
+	}
+	return handle;
+}
+
+/* file content is a function of the offset */
+static u8_t pattern(u32_t ofs)
+{
+	return (u8_t)((ofs >> 9) * 31 + (ofs & 0x1ff));
+}
+
+static void fill_pattern(u8_t *buf, u32_t ofs, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = pattern(ofs + i);
+}
+
+static void check_file(const char *path, int size)
+{
+	static u8_t buf[4096], expect[4096];
+	fs_file_t fp;
+	int ofs, len;
+
+	zassert_equal(fs_open(&fp, path), 0, NULL);
+	zassert_equal(f_size(&fp.fp), size, NULL);
+	for (ofs = 0; ofs < size; ofs += len) {
+		len = min(size - ofs, (int)sizeof(buf));
+		zassert_equal(fs_read(&fp, buf, len), len, NULL);
+		fill_pattern(expect, ofs, len);
+		zassert_true(!memcmp(buf, expect, len), "wrong data");
+	}
+	zassert_equal(fs_close(&fp), 0, NULL);
+}
+
+static void test_setup(void)
+{
+	static u8_t work[4096];
+
+	disk_data = calloc(DISK_SECTORS, SECTOR_SIZE);
+	zassert_not_null(disk_data, NULL);
+
+	zassert_equal(f_mkfs(VOLUME, FM_FAT, UNIT, work, sizeof(work)), FR_OK, NULL);
+	zassert_equal(f_mount(&fat_fs, VOLUME, 1), FR_OK, NULL);
+}
+
+static void test_expand(void)
+{
+	u8_t buf[100];
+	fs_file_t fp, gap;
+
+	/* a hole of one free cluster in front of the free space */
+	zassert_equal(fs_open(&gap, VOLUME "GAP.BIN"), 0, NULL);
+	zassert_equal(fs_write(&gap, buf, 1), 1, NULL);
+	zassert_equal(fs_close(&gap), 0, NULL);
+	zassert_equal(fs_open(&fp, VOLUME "KEEP.BIN"), 0, NULL);
+	zassert_equal(fs_write(&fp, buf, 1), 1, NULL);
+	zassert_equal(fs_close(&fp), 0, NULL);
+	zassert_equal(fs_unlink(VOLUME "GAP.BIN"), 0, NULL);
+
+	zassert_equal(fs_open(&fp, VOLUME "EXP.BIN"), 0, NULL);
+	zassert_equal(fs_expand(&fp, 3 * UNIT), 0, NULL);
+	zassert_equal(f_size(&fp.fp), 3 * UNIT, NULL);
+	zassert_equal(fs_tell(&fp), 0, NULL);
+	zassert_equal(fs_fastseek_enable(&fp, 1), 0, "not contiguous");
+	fs_fastseek_disable(&fp);
+
+	/* grows in place, keeps the position */
+	fill_pattern(buf, 0, sizeof(buf));
+	zassert_equal(fs_write(&fp, buf, sizeof(buf)), sizeof(buf), NULL);
+	zassert_equal(fs_expand(&fp, 5 * UNIT), 0, NULL);
+	zassert_equal(fs_tell(&fp), sizeof(buf), NULL);
+	zassert_equal(fs_expand(&fp, UNIT), 0, "shrunk");
+	zassert_equal(f_size(&fp.fp), 5 * UNIT, NULL);
+	zassert_equal(fs_fastseek_enable(&fp, 1), 0, "not contiguous");
+
+	zassert_equal(fs_expand(&fp, DISK_SECTORS * SECTOR_SIZE), -ENOSPC, NULL);
+	zassert_equal(fs_tell(&fp), sizeof(buf), NULL);
+	zassert_equal(fs_truncate(&fp, sizeof(buf)), 0, NULL);
+	zassert_equal(fs_close(&fp), 0, NULL);
+
+	check_file(VOLUME "EXP.BIN", sizeof(buf));
+	zassert_equal(fs_unlink(VOLUME "EXP.BIN"), 0, NULL);
+}
+
+static void write_record(io_stream_t handle, int from, int to)
+{
+	static u8_t buf[3000];
+	u32_t seed = 9;
+	int len;
+
+	while (from < to) {
+		seed = seed * 1103515245 + 12345;
+		len = min(to - from, 1 + (int)((seed >> 8) % sizeof(buf)));
+		fill_pattern(buf, from, len);
+		zassert_equal(handle->ops->write(handle, buf, len), len, NULL);
+		from += len;
+	}
+}
+
+static void test_prealloc_stream(void)
+{
+	u8_t hdr[4];
+	io_stream_t handle;
+	int fat, data;
+
+	handle = file_stream_create_prealloc(VOLUME "REC001.WAV");
+	zassert_not_null(handle, NULL);
+	zassert_equal(handle->ops->open(handle, MODE_OUT), 0, NULL);
+	zassert_equal(f_size(&((file_stream_info_t *)handle->data)->fp.fp), STEP, NULL);
+
+	fat = fat_writes;
+	data = data_writes;
+	unaligned_writes = 0;
+	write_record(handle, 0, RECORD_SIZE / 2);
+
+	/* rewrite the header like media_player_repair_filhdr and go on */
+	fill_pattern(hdr, 508, sizeof(hdr));
+	zassert_equal(handle->ops->seek(handle, 508, SEEK_DIR_BEG), 0, NULL);
+	zassert_equal(handle->ops->write(handle, hdr, sizeof(hdr)), sizeof(hdr), NULL);
+	zassert_equal(handle->ops->seek(handle, 0, SEEK_DIR_END), 0, NULL);
+	zassert_equal(handle->ops->tell(handle), RECORD_SIZE / 2, NULL);
+
+	write_record(handle, RECORD_SIZE / 2, RECORD_SIZE);
+
+	/* the FAT is only written when the file grows by a step */
+	zassert_true(fat_writes - fat <= 2 * (RECORD_SIZE / STEP), "FAT written on append");
+	/*
+	 * whole units except around the header rewrite: the partial unit
+	 * in two sectors, the header sector, and the rest of that unit
+	 */
+	zassert_true(unaligned_writes <= 5, "unaligned writes");
+	printf("%d KB appended: %d data writes, %d unaligned, %d FAT writes\n",
+	       RECORD_SIZE / 1024, data_writes - data, unaligned_writes, fat_writes - fat);
+
+	/* a power loss leaves the preallocated size */
+	zassert_equal(handle->ops->flush(handle), 0, NULL);
+	zassert_equal(f_size(&((file_stream_info_t *)handle->data)->fp.fp),
+		      ROUND_UP(RECORD_SIZE, STEP), NULL);
+
+	zassert_equal(handle->ops->close(handle), 0, NULL);
+	zassert_equal(handle->ops->destroy(handle), 0, NULL);
+	free(handle);
+
+	check_file(VOLUME "REC001.WAV", RECORD_SIZE);
+}
+
+static void test_plain_append(void)
+{
+	static u8_t buf[2048];
+	fs_file_t fp;
+	int ofs, fat = fat_writes;
+
+	zassert_equal(fs_open(&fp, VOLUME "REC002.WAV"), 0, NULL);
+	for (ofs = 0; ofs < RECORD_SIZE; ofs += sizeof(buf)) {
+		fill_pattern(buf, ofs, sizeof(buf));
+		zassert_equal(fs_write(&fp, buf, sizeof(buf)), sizeof(buf), NULL);
+		fs_sync(&fp);
+	}
+	zassert_equal(fs_close(&fp), 0, NULL);
+
+	printf("plain fs_write + sync:  %d FAT writes\n", fat_writes - fat);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(fstream_prealloc_test,
+		ztest_unit_test(test_setup),
+		ztest_unit_test(test_expand),
+		ztest_unit_test(test_prealloc_stream),
+		ztest_unit_test(test_plain_append)
+	);
+
+	ztest_run_test_suite(fstream_prealloc_test);
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+
+static int irq_nest;
+
+unsigned int irq_lock(void)
+{
+	irq_nest++;
+	return 0;
+}
+
+void irq_unlock(unsigned int key)
+{
+	irq_nest--;
+}
+
+struct trace_record {
+	u32_t event;
+	u32_t word[4];
+};
+
+static struct trace_record records[16];
+static int record_num;
+
+static int trace_record(u32_t event, u32_t a, u32_t b, u32_t c, u32_t d)
+{
+	struct trace_record *rec = &records[record_num++];
+
+	rec->event = event;
+	rec->word[0] = a;
+	rec->word[1] = b;
+	rec->word[2] = c;
+	rec->word[3] = d;
+	return 0;
+}
+
+int _trace_mem_snapshot(uint32_t sites, uint32_t live_bytes, uint32_t peak_bytes, uint32_t dropped)
+{
+	return trace_record(0x603, sites, live_bytes, peak_bytes, dropped);
+}
+
+int _trace_mem_site(uint32_t caller, uint32_t live_bytes, uint32_t peak_bytes, uint32_t count)
+{
+	return trace_record(0x604, caller, live_bytes, peak_bytes, count);
+}
+
+#include <lib/memory/source/mem_profiler.c>
+
+#define CALLER(n)	((void *)(uintptr_t)(0x1000 + (n) * 0x40))
+#define BLOCK(n)	((void *)(uintptr_t)(0x20000 + (n) * 0x20))
+
+static void profiler_setup(void)
+{
+	memset(&mem_prof, 0, sizeof(mem_prof));
+	record_num = 0;
+}
+
+static struct mem_prof_site *site_of(void *caller)
+{
+	int i;
+
+	for (i = 0; i <= MEM_PROF_SITE_NUM; i++) {
+		if (mem_prof.sites[i].caller == caller)
+			return &mem_prof.sites[i];
+	}
+
+	return NULL;
+}
+
+static void test_site_accounting(void)
+{
+	struct mem_prof_site *site;
+
+	profiler_setup();
+
+	mem_profiler_malloc(BLOCK(0), 100, CALLER(0));
+	mem_profiler_malloc(BLOCK(1), 50, CALLER(0));
+	mem_profiler_malloc(BLOCK(2), 30, CALLER(1));
+	mem_profiler_malloc(NULL, 30, CALLER(1));
+	mem_profiler_free(BLOCK(0));
+	mem_profiler_malloc(BLOCK(0), 20, CALLER(0));
+
+	site = site_of(CALLER(0));
+	zassert_not_null(site, NULL);
+	zassert_equal(site->live_bytes, 70, NULL);
+	zassert_equal(site->peak_bytes, 150, NULL);
+	zassert_equal(site->live_count, 2, NULL);
+	zassert_equal(site->total_count, 3, NULL);
+	zassert_equal(site_of(CALLER(1))->live_bytes, 30, NULL);
+	zassert_equal(mem_prof.live_bytes, 100, NULL);
+	zassert_equal(mem_prof.peak_bytes, 180, NULL);
+
+	/* unknown address is counted, not charged to anybody */
+	mem_profiler_free(BLOCK(9));
+	zassert_equal(mem_prof.untracked_frees, 1, NULL);
+	zassert_equal(mem_prof.live_bytes, 100, NULL);
+
+	mem_profiler_reset();
+	zassert_equal(site->peak_bytes, 70, NULL);
+	zassert_equal(site->total_count, 2, NULL);
+	zassert_equal(mem_prof.peak_bytes, 100, NULL);
+	zassert_equal(irq_nest, 0, NULL);
+}
+
+static void test_table_limits(void)
+{
+	int i;
+
+	profiler_setup();
+
+	/* callers beyond the site table go to the shared entry */
+	for (i = 0; i < MEM_PROF_SITE_NUM + 3; i++)
+		mem_profiler_malloc(BLOCK(i), 8, CALLER(i));
+
+	zassert_equal(mem_prof.sites[MEM_PROF_SITE_OTHER].caller, NULL, NULL);
+	zassert_equal(mem_prof.sites[MEM_PROF_SITE_OTHER].live_count, 3, NULL);
+
+	for (i = MEM_PROF_SITE_NUM + 3; i < MEM_PROF_LIVE_NUM; i++)
+		mem_profiler_malloc(BLOCK(i), 8, CALLER(0));
+
+	zassert_equal(mem_prof.live_num, MEM_PROF_LIVE_LIMIT, NULL);
+	zassert_equal(mem_prof.dropped, MEM_PROF_LIVE_NUM - MEM_PROF_LIVE_LIMIT, NULL);
+
+	/* dropped blocks free as untracked, the rest balance to zero */
+	for (i = 0; i < MEM_PROF_LIVE_NUM; i++)
+		mem_profiler_free(BLOCK(i));
+
+	zassert_equal(mem_prof.live_num, 0, NULL);
+	zassert_equal(mem_prof.live_bytes, 0, NULL);
+	zassert_equal(mem_prof.untracked_frees, mem_prof.dropped, NULL);
+	for (i = 0; i <= MEM_PROF_SITE_NUM; i++)
+		zassert_equal(mem_prof.sites[i].live_bytes, 0, NULL);
+}
+
+/* random churn must keep every live block reachable after deletions */
+static void test_live_churn(void)
+{
+	u32_t size[MEM_PROF_LIVE_LIMIT] = { 0 };
+	u32_t seed = 7, expect = 0;
+	int step, n, i;
+
+	profiler_setup();
+
+	for (step = 0; step < 100000; step++) {
+		seed = seed * 1103515245 + 12345;
+		n = (seed >> 8) % MEM_PROF_LIVE_LIMIT;
+
+		if (size[n]) {
+			zassert_true(mem_prof_live_find(BLOCK(n)) >= 0, "live block lost");
+			mem_profiler_free(BLOCK(n));
+			expect -= size[n];
+			size[n] = 0;
+		} else {
+			size[n] = 1 + (seed >> 20) % 512;
+			mem_profiler_malloc(BLOCK(n), size[n], CALLER(n & 3));
+			expect += size[n];
+		}
+
+		zassert_equal(mem_prof.live_bytes, expect, NULL);
+	}
+
+	for (i = 0; i < MEM_PROF_LIVE_LIMIT; i++) {
+		zassert_equal(mem_prof_live_find(BLOCK(i)) >= 0, size[i] != 0,
+			      "live table out of sync");
+	}
+
+	zassert_equal(mem_prof.dropped, 0, NULL);
+	zassert_equal(mem_prof.untracked_frees, 0, NULL);
+}
+
+static void test_emit(void)
+{
+	profiler_setup();
+
+	mem_profiler_malloc(BLOCK(0), 64, CALLER(0));
+	mem_profiler_malloc(BLOCK(1), 32, CALLER(1));
+	mem_profiler_free(BLOCK(1));
+
+	zassert_equal(mem_profiler_emit(), 2, NULL);
+	zassert_equal(record_num, 3, NULL);
+	zassert_equal(records[0].event, 0x603, NULL);
+	zassert_equal(records[0].word[0], 2, NULL);
+	zassert_equal(records[0].word[1], 64, NULL);
+	zassert_equal(records[0].word[2], 96, NULL);
+
+	for (record_num = 1; record_num < 3; record_num++) {
+		struct trace_record *rec = &records[record_num];
+
+		zassert_equal(rec->event, 0x604, NULL);
+		if (rec->word[0] == (u32_t)(uintptr_t)CALLER(1)) {
+			zassert_equal(rec->word[1], 0, NULL);
+			zassert_equal(rec->word[2], 32, NULL);
+		} else {
+			zassert_equal(rec->word[0], (u32_t)(uintptr_t)CALLER(0), NULL);
+			zassert_equal(rec->word[1], 64, NULL);
+		}
+	}
+}
+
+void test_main(void)
+{
+	ztest_test_suite(mem_profiler_test,
+		ztest_unit_test(test_site_accounting),
+		ztest_unit_test(test_table_limits),
+		ztest_unit_test(test_live_churn),
+		ztest_unit_test(test_emit)
+	);
+
+	ztest_run_test_suite(mem_profiler_test);
+}
@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <time.h>
+
+static int irq_nest;
+static u64_t irq_off_start;
+static u64_t irq_off_total;
+static u64_t irq_off_max;
+static u32_t irq_lock_count;
+static int in_isr;
+static int fake_thread;
+
+static u64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+unsigned int irq_lock(void)
+{
+	if (!irq_nest++)
+		irq_off_start = now_ns();
+
+	irq_lock_count++;
+	return 0;
+}
+
+void irq_unlock(unsigned int key)
+{
+	u64_t off;
+
+	if (--irq_nest)
+		return;
+
+	off = now_ns() - irq_off_start;
+	irq_off_total += off;
+	if (off > irq_off_max)
+		irq_off_max = off;
+}
+
+int k_is_in_isr(void)
+{
+	return in_isr;
+}
+
+k_tid_t k_current_get(void)
+{
+	return (k_tid_t)&fake_thread;
+}
+
+#include <lib/memory/source/mem_slab.c>
+
+#define TRACE_STEPS	(200000)
+#define TRACE_MAX_LIVE	(256)
+
+struct live_block {
+	void *ptr;
+	u32_t size;
+	u32_t expire;
+};
+
+struct trace_result {
+	u32_t allocs;
+	u32_t failures;
+	u32_t frag_failures;
+	u32_t peak_requested;
+	u32_t peak_block_bytes;
+	u64_t elapsed_ns;
+};
+
+static struct live_block live[TRACE_MAX_LIVE];
+
+static u32_t trace_rand(u32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static u32_t block_size_of(void *ptr)
+{
+	return sys_slab.slabs[find_slab_by_addr(&sys_slab, ptr)].block_size;
+}
+
+static u32_t pool_free_bytes(void)
+{
+	u32_t free_bytes = 0;
+	int i;
+
+	for (i = 0; i < sys_slab.slab_num; i++) {
+		free_bytes += sys_slab.slabs[i].block_size *
+			(sys_slab.slabs[i].block_num - sys_slab.slabs[i].num_used);
+	}
+
+	return free_bytes;
+}
+
+/*
+ * Synthetic trace shaped like bt and media service traffic: many short
+ * lived message sized allocations, some packet buffers and a few long
+ * lived codec buffers. The same seed always replays the same trace.
+ */
+static void replay_trace(struct trace_result *result)
+{
+	u32_t requested = 0, block_bytes = 0;
+	u32_t seed = 2019, kind, size, life;
+	u64_t start;
+	int step, i, slot;
+
+	memset(result, 0, sizeof(*result));
+	memset(live, 0, sizeof(live));
+
+	start = now_ns();
+
+	for (step = 0; step < TRACE_STEPS; step++) {
+		for (i = 0; i < TRACE_MAX_LIVE; i++) {
+			if (live[i].ptr && live[i].expire <= step) {
+				requested -= live[i].size;
+				block_bytes -= block_size_of(live[i].ptr);
+				mem_slabs_free(&sys_slab, live[i].ptr);
+				live[i].ptr = NULL;
+			}
+		}
+
+		kind = trace_rand(&seed) % 100;
+		if (kind < 60) {
+			size = 4 + trace_rand(&seed) % 45;
+			life = 1 + trace_rand(&seed) % 8;
+		} else if (kind < 96) {
+			size = 60 + trace_rand(&seed) % 200;
+			life = 8 + trace_rand(&seed) % 32;
+		} else {
+			size = 400 + trace_rand(&seed) % 1100;
+			life = 64 + trace_rand(&seed) % 256;
+		}
+
+		for (slot = 0; slot < TRACE_MAX_LIVE && live[slot].ptr; slot++)
+			;
+		if (slot == TRACE_MAX_LIVE)
+			continue;
+
+		result->allocs++;
+		live[slot].ptr = mem_slabs_malloc(&sys_slab, size);
+		if (!live[slot].ptr) {
+			result->failures++;
+			if (pool_free_bytes() >= size)
+				result->frag_failures++;
+			continue;
+		}
+
+		live[slot].size = size;
+		live[slot].expire = step + life;
+		requested += size;
+		block_bytes += block_size_of(live[slot].ptr);
+		if (block_bytes > result->peak_block_bytes) {
+			result->peak_block_bytes = block_bytes;
+			result->peak_requested = requested;
+		}
+	}
+
+	for (i = 0; i < TRACE_MAX_LIVE; i++) {
+		if (live[i].ptr)
+			mem_slabs_free(&sys_slab, live[i].ptr);
+	}
+
+	result->elapsed_ns = now_ns() - start;
+}
+
+static void reset_irq_stats(void)
+{
+	irq_off_total = 0;
+	irq_off_max = 0;
+	irq_lock_count = 0;
+}
+
+static void slab_setup(void)
+{
+	mem_slabs_init(&sys_slab);
+	reset_irq_stats();
+}
+
+static void test_size_class_lookup(void)
+{
+	unsigned int size;
+	int i, expect;
+
+	slab_setup();
+
+	for (size = 0; size <= SLAB_MAX_BLOCK_SIZE; size++) {
+		for (expect = 0; sys_slab.slabs[expect].block_size < size; expect++)
+			;
+		zassert_equal(size_to_slab_index(&sys_slab, size), expect,
+			      "wrong class for size");
+	}
+
+	zassert_equal(size_to_slab_index(&sys_slab, SLAB_MAX_BLOCK_SIZE + 1),
+		      sys_slab.slab_num, "oversize request accepted");
+	zassert_is_null(mem_slabs_malloc(&sys_slab, SLAB_MAX_BLOCK_SIZE + 1), NULL);
+
+	for (i = 0; i < sys_slab.slab_num; i++) {
+		zassert_equal(find_slab_by_addr(&sys_slab, sys_slab.slabs[i].slab_base),
+			      i, "wrong class for address");
+		zassert_equal(find_slab_by_addr(&sys_slab, sys_slab.slabs[i].slab_end - 1),
+			      sys_slab.slab_num, "unaligned address accepted");
+	}
+}
+
+static void test_alloc_free(void)
+{
+	void *blocks[CONFIG_SLAB3_NUM_BLOCKS];
+	u8_t *ptr;
+	int i;
+
+	slab_setup();
+
+	ptr = mem_slabs_malloc(&sys_slab, 40);
+	zassert_not_null(ptr, NULL);
+	memset(ptr, 0xa5, 64);
+	mem_slabs_free(&sys_slab, ptr);
+
+	/* lifo free list hands the same block out again, cleared */
+	zassert_equal_ptr(mem_slabs_malloc(&sys_slab, 40), ptr, NULL);
+	for (i = 0; i < 64; i++)
+		zassert_equal(ptr[i], 0, "block not cleared");
+	mem_slabs_free(&sys_slab, ptr);
+
+	for (i = 0; i < CONFIG_SLAB3_NUM_BLOCKS; i++) {
+		blocks[i] = mem_slabs_malloc(&sys_slab, 64);
+		zassert_equal(find_slab_by_addr(&sys_slab, blocks[i]), 3, NULL);
+	}
+
+	/* class exhausted: next larger class is used */
+	ptr = mem_slabs_malloc(&sys_slab, 64);
+	zassert_equal(find_slab_by_addr(&sys_slab, ptr), 4, "no fallback");
+	zassert_equal(sys_slab.slabs[3].num_used, CONFIG_SLAB3_NUM_BLOCKS, NULL);
+	mem_slabs_free(&sys_slab, ptr);
+
+	for (i = 0; i < CONFIG_SLAB3_NUM_BLOCKS; i++)
+		mem_slabs_free(&sys_slab, blocks[i]);
+
+	for (i = 0; i < sys_slab.slab_num; i++)
+		zassert_equal(sys_slab.slabs[i].num_used, 0, "block leaked");
+	zassert_equal(sys_slab.avail_mask, BIT(sys_slab.slab_num) - 1, NULL);
+}
+
+static void test_magazine(void)
+{
+	void *blocks[CONFIG_SLAB_MAGAZINE_DEPTH * 2];
+	void *ptr;
+	int i;
+
+	slab_setup();
+	zassert_equal(mem_slabs_magazine_attach(&sys_slab), 0, NULL);
+	reset_irq_stats();
+
+	/* first allocation refills the magazine under one lock */
+	ptr = mem_slabs_malloc(&sys_slab, 16);
+	zassert_equal(irq_lock_count, 1, NULL);
+	zassert_equal(sys_slab.magazines[0].count[1], CONFIG_SLAB_MAGAZINE_DEPTH / 2, NULL);
+
+	reset_irq_stats();
+	mem_slabs_free(&sys_slab, ptr);
+	ptr = mem_slabs_malloc(&sys_slab, 16);
+	mem_slabs_free(&sys_slab, ptr);
+	zassert_equal(irq_lock_count, 0, "magazine hit locked irq");
+
+	/* isr must not touch the magazine of the interrupted thread */
+	in_isr = 1;
+	ptr = mem_slabs_malloc(&sys_slab, 16);
+	mem_slabs_free(&sys_slab, ptr);
+	in_isr = 0;
+	zassert_equal(irq_lock_count, 2, NULL);
+
+	/* big blocks bypass the magazine */
+	reset_irq_stats();
+	ptr = mem_slabs_malloc(&sys_slab, 512);
+	mem_slabs_free(&sys_slab, ptr);
+	zassert_equal(irq_lock_count, 2, NULL);
+
+	for (i = 0; i < ARRAY_SIZE(blocks); i++)
+		blocks[i] = mem_slabs_malloc(&sys_slab, 16);
+	for (i = 0; i < ARRAY_SIZE(blocks); i++)
+		mem_slabs_free(&sys_slab, blocks[i]);
+	zassert_true(sys_slab.magazines[0].count[1] <= CONFIG_SLAB_MAGAZINE_DEPTH, NULL);
+
+	mem_slabs_magazine_detach(&sys_slab);
+	for (i = 0; i < sys_slab.slab_num; i++)
+		zassert_equal(sys_slab.slabs[i].num_used, 0, "magazine not flushed");
+}
+
+static void report(const char *name, struct trace_result *result)
+{
+	printf("%-10s %u allocs, %llu ns/op, irq locks %u, irq off total %llu us"
+	       " max %llu ns, failures %u (%u with enough free bytes),"
+	       " internal frag at peak %u%%\n",
+	       name, result->allocs,
+	       (unsigned long long)(result->elapsed_ns / result->allocs),
+	       irq_lock_count, (unsigned long long)(irq_off_total / 1000),
+	       (unsigned long long)irq_off_max,
+	       result->failures, result->frag_failures,
+	       result->peak_block_bytes ?
+	       100 - result->peak_requested * 100 / result->peak_block_bytes : 0);
+}
+
+static void test_trace_replay(void)
+{
+	struct trace_result shared, cached;
+	int i;
+
+	slab_setup();
+	replay_trace(&shared);
+	report("shared", &shared);
+	zassert_true(irq_lock_count >= 2 * shared.allocs - 2 * shared.failures, NULL);
+
+	slab_setup();
+	zassert_equal(mem_slabs_magazine_attach(&sys_slab), 0, NULL);
+	replay_trace(&cached);
+	report("magazine", &cached);
+	mem_slabs_magazine_detach(&sys_slab);
+
+	zassert_true(irq_lock_count < 2 * cached.allocs, "magazine saved no lock");
+
+	for (i = 0; i < sys_slab.slab_num; i++)
+		zassert_equal(sys_slab.slabs[i].num_used, 0, "trace leaked blocks");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(mem_slab_test,
+		ztest_unit_test(test_size_class_lookup),
+		ztest_unit_test(test_alloc_free),
+		ztest_unit_test(test_magazine),
+		ztest_unit_test(test_trace_replay)
+	);
+
+	ztest_run_test_suite(mem_slab_test);
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <lib/utils/source/pcm_dsp/pcm_dsp.c>
+
+#define TEST_SAMPLES	(1027)
+#define BENCH_SAMPLES	(1024)
+#define BENCH_ROUNDS	(4000)
+
+static const s16_t test_gains[] = {
+	PCM_GAIN_UNITY, PCM_GAIN_HALF, 0, 1, -1, 0x7FFE, -32768, 12345, -20000,
+};
+
+static s16_t in_a[TEST_SAMPLES + 2];
+static s16_t in_b[TEST_SAMPLES + 2];
+static s16_t in_r[TEST_SAMPLES + 2];
+static s16_t out[2 * TEST_SAMPLES + 2];
+static s16_t expect[2 * TEST_SAMPLES + 2];
+
+/* reference semantics, one sample at a time */
+static s16_t ref_sat(s32_t val)
+{
+	return val > 32767 ? 32767 : (val < -32768 ? -32768 : val);
+}
+
+static s64_t floor_div(s64_t num, s64_t den)
+{
+	s64_t q = num / den;
+
+	return (num % den && num < 0) ? q - 1 : q;
+}
+
+static s16_t ref_gain(s16_t val, s16_t gain)
+{
+	if (gain == PCM_GAIN_UNITY)
+		return val;
+
+	return ref_sat((s32_t)floor_div((s64_t)val * gain + 0x4000, 32768));
+}
+
+static s16_t ref_mix(s16_t a, s16_t a_gain, s16_t b, s16_t b_gain)
+{
+	return ref_sat((s32_t)ref_gain(a, a_gain) + ref_gain(b, b_gain));
+}
+
+static void fill_random(s16_t *buf, int samples, u32_t seed)
+{
+	static const s16_t edges[] = { 32767, -32768, 0, -1, 1, 16384, -16384 };
+	int i;
+
+	for (i = 0; i < samples; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (seed >> 28) < 3 ? edges[(seed >> 8) % ARRAY_SIZE(edges)] :
+					    (s16_t)(seed >> 12);
+	}
+}
+
+static void fill_inputs(u32_t seed)
+{
+	fill_random(in_a, ARRAY_SIZE(in_a), seed);
+	fill_random(in_b, ARRAY_SIZE(in_b), seed + 1);
+	fill_random(in_r, ARRAY_SIZE(in_r), seed + 2);
+}
+
+static void test_add_sat(void)
+{
+	int off_d, off_s, i, n;
+
+	fill_inputs(1);
+
+	for (off_d = 0; off_d < 2; off_d++) {
+		for (off_s = 0; off_s < 2; off_s++) {
+			for (n = TEST_SAMPLES - 2; n <= TEST_SAMPLES; n++) {
+				memcpy(out + off_d, in_a, n * 2);
+				pcm_add_sat(out + off_d, in_b + off_s, n);
+				for (i = 0; i < n; i++) {
+					zassert_equal(out[off_d + i],
+						      ref_sat((s32_t)in_a[i] + in_b[off_s + i]),
+						      "add mismatch");
+				}
+			}
+		}
+	}
+}
+
+static void test_gain(void)
+{
+	int off, g, i, n;
+
+	fill_inputs(2);
+
+	for (g = 0; g < ARRAY_SIZE(test_gains); g++) {
+		for (off = 0; off < 2; off++) {
+			for (n = TEST_SAMPLES - 1; n <= TEST_SAMPLES; n++) {
+				memcpy(out + off, in_a, n * 2);
+				pcm_gain_q15(out + off, test_gains[g], n);
+				for (i = 0; i < n; i++) {
+					zassert_equal(out[off + i], ref_gain(in_a[i], test_gains[g]),
+						      "gain mismatch");
+				}
+			}
+		}
+	}
+}
+
+static void test_mix(void)
+{
+	int ga, gb, off_a, off_b, i;
+
+	fill_inputs(3);
+
+	for (ga = 0; ga < ARRAY_SIZE(test_gains); ga++) {
+		for (gb = 0; gb < ARRAY_SIZE(test_gains); gb++) {
+			for (off_a = 0; off_a < 2; off_a++) {
+				for (off_b = 0; off_b < 2; off_b++) {
+					s16_t a_gain = test_gains[ga], b_gain = test_gains[gb];
+
+					for (i = 0; i < TEST_SAMPLES; i++)
+						expect[i] = ref_mix(in_a[off_a + i], a_gain, in_b[off_b + i], b_gain);
+
+					/* in place, like audio track does */
+					memcpy(out + off_a, in_a + off_a, TEST_SAMPLES * 2);
+					pcm_mix_q15(out + off_a, out + off_a, a_gain, in_b + off_b, b_gain, TEST_SAMPLES);
+					zassert_true(!memcmp(out + off_a, expect, TEST_SAMPLES * 2), "mix mismatch");
+
+					pcm_mix_q15(out, in_a + off_a, a_gain, in_b + off_b, b_gain, TEST_SAMPLES);
+					zassert_true(!memcmp(out, expect, TEST_SAMPLES * 2), "mix mismatch");
+				}
+			}
+		}
+	}
+}
+
+static void test_mix_planar(void)
+{
+	int ga, gb, off, i, frames = TEST_SAMPLES / 2;
+
+	fill_inputs(4);
+
+	for (ga = 0; ga < ARRAY_SIZE(test_gains); ga++) {
+		for (gb = 0; gb < ARRAY_SIZE(test_gains); gb++) {
+			s16_t a_gain = test_gains[ga], b_gain = test_gains[gb];
+
+			for (off = 0; off < 2; off++) {
+				for (i = 0; i < frames; i++) {
+					expect[2 * i] = ref_mix(in_a[2 * i], a_gain, in_b[i], b_gain);
+					expect[2 * i + 1] = ref_mix(in_a[2 * i + 1], a_gain, in_r[i], b_gain);
+				}
+
+				memcpy(out + off, in_a, frames * 4);
+				pcm_mix_planar_q15(out + off, out + off, a_gain, in_b, in_r, b_gain, frames);
+				zassert_true(!memcmp(out + off, expect, frames * 4), "planar mix mismatch");
+			}
+
+			/* mono source into both channels */
+			for (i = 0; i < frames; i++) {
+				expect[2 * i] = ref_mix(in_a[2 * i], a_gain, in_b[i], b_gain);
+				expect[2 * i + 1] = ref_mix(in_a[2 * i + 1], a_gain, in_b[i], b_gain);
+			}
+			pcm_mix_planar_q15(out, in_a, a_gain, in_b, in_b, b_gain, frames);
+			zassert_true(!memcmp(out, expect, frames * 4), "mono mix mismatch");
+		}
+	}
+}
+
+static void test_interleave(void)
+{
+	s16_t left[TEST_SAMPLES / 2], right[TEST_SAMPLES / 2];
+	int off, i, frames = TEST_SAMPLES / 2;
+
+	fill_inputs(5);
+
+	for (off = 0; off < 2; off++) {
+		pcm_interleave(out + off, in_a, in_b, frames);
+		for (i = 0; i < frames; i++) {
+			zassert_equal(out[off + 2 * i], in_a[i], NULL);
+			zassert_equal(out[off + 2 * i + 1], in_b[i], NULL);
+		}
+
+		pcm_deinterleave(left, right, out + off, frames);
+		zassert_true(!memcmp(left, in_a, frames * 2), NULL);
+		zassert_true(!memcmp(right, in_b, frames * 2), NULL);
+	}
+}
+
+static u64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static u64_t now_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* the mix loop audio track used before: both sources halved */
+static void halving_mix(s16_t *dst, const s16_t *src, const s16_t *left,
+			const s16_t *right, int frames)
+{
+	int i;
+
+	for (i = 0; i < frames; i++) {
+		*dst++ = (*src++) / 2 + left[i] / 2;
+		*dst++ = (*src++) / 2 + right[i] / 2;
+	}
+}
+
+static void ref_mix_planar(s16_t *dst, const s16_t *src, s16_t a_gain,
+			   const s16_t *left, const s16_t *right, s16_t b_gain, int frames)
+{
+	int i;
+
+	for (i = 0; i < frames; i++) {
+		dst[2 * i] = ref_mix(src[2 * i], a_gain, left[i], b_gain);
+		dst[2 * i + 1] = ref_mix(src[2 * i + 1], a_gain, right[i], b_gain);
+	}
+}
+
+#define BENCH(name, call)						\
+	do {								\
+		u64_t ns = now_ns(), cycles = now_cycles();		\
+		int round;						\
+		for (round = 0; round < BENCH_ROUNDS; round++) {	\
+			call;						\
+			__asm__ volatile("" : : "r"(out) : "memory");	\
+		}							\
+		cycles = now_cycles() - cycles;				\
+		ns = now_ns() - ns;					\
+		printf("%-24s %6.2f ns/sample %6.2f cycles/sample\n", name,	\
+		       (double)ns / BENCH_ROUNDS / BENCH_SAMPLES,		\
+		       (double)cycles / BENCH_ROUNDS / BENCH_SAMPLES);	\
+	} while (0)
+
+static void test_benchmark(void)
+{
+	int frames = BENCH_SAMPLES / 2;
+
+	fill_inputs(6);
+
+	BENCH("halving mix (old)", halving_mix(out, in_a, in_b, in_r, frames));
+	BENCH("reference planar mix", ref_mix_planar(out, in_a, PCM_GAIN_HALF, in_b, in_r, 0x6000, frames));
+	BENCH("pcm_mix_planar_q15", pcm_mix_planar_q15(out, in_a, PCM_GAIN_HALF, in_b, in_r, 0x6000, frames));
+	BENCH("pcm_mix_planar unity", pcm_mix_planar_q15(out, in_a, PCM_GAIN_UNITY, in_b, in_r, PCM_GAIN_UNITY, frames));
+	BENCH("pcm_mix_q15", pcm_mix_q15(out, in_a, PCM_GAIN_HALF, in_b, 0x6000, BENCH_SAMPLES));
+	BENCH("pcm_add_sat", pcm_add_sat(out, in_b, BENCH_SAMPLES));
+	BENCH("pcm_gain_q15", pcm_gain_q15(out, 0x6000, BENCH_SAMPLES));
+	BENCH("pcm_interleave", pcm_interleave(out, in_a, in_b, frames));
+}
+
+void test_main(void)
+{
+	ztest_test_suite(pcm_dsp_test,
+		ztest_unit_test(test_add_sat),
+		ztest_unit_test(test_gain),
+		ztest_unit_test(test_mix),
+		ztest_unit_test(test_mix_planar),
+		ztest_unit_test(test_interleave),
+		ztest_unit_test(test_benchmark)
+	);
+
+	ztest_run_test_suite(pcm_dsp_test);
+}
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <ext/fs/fat/ff.c>
+#include <subsys/fs/fat_fs.c>
+
+#define SECTOR_SIZE	(512)
+/* enough 512 byte clusters for FAT32 */
+#define DISK_SECTORS	(80 * 1024)
+#define DISK_PDRV	(4)
+#define VOLUME		"SD:"
+
+#define FILE_SIZE	(4 * 1024 * 1024)
+#define CHUNK_SIZE	(256 * 1024)
+#define FRAGMENTS	(FILE_SIZE / CHUNK_SIZE)
+#define BENCH_SEEKS	(2000)
+
+static u8_t *disk_data;
+static int disk_reads;
+static FATFS fat_fs;
+
+/* disk and os glue */
+DSTATUS disk_initialize(BYTE pdrv)
+{
+	return 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+	return 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != DISK_PDRV || sector + count > DISK_SECTORS)
+		return RES_PARERR;
+
+	memcpy(buff, disk_data + sector * SECTOR_SIZE, count * SECTOR_SIZE);
+	disk_reads++;
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != DISK_PDRV || sector + count > DISK_SECTORS)
+		return RES_PARERR;
+
+	memcpy(disk_data + sector * SECTOR_SIZE, buff, count * SECTOR_SIZE);
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+	switch (cmd) {
+	case GET_SECTOR_COUNT:
+		*(DWORD *)buff = DISK_SECTORS;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD *)buff = SECTOR_SIZE;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD *)buff = 1;
+		return RES_OK;
+	case CTRL_SYNC:
+		return RES_OK;
+	default:
+		return RES_PARERR;
+	}
+}
+
+static int rtc_get(struct device *dev, struct rtc_time *tm)
+{
+	memset(tm, 0, sizeof(*tm));
+	tm->tm_year = 119;
+	return 0;
+}
+
+static const struct rtc_driver_api rtc_api = {
+	.get_time = rtc_get,
+};
+
+static struct device rtc_dev = {
+	.driver_api = &rtc_api,
+};
+
+struct device *device_get_binding(const char *name)
+{
+	return &rtc_dev;
+}
+
+FRESULT f_map(FIL *fp, void **addr)
+{
+	return FR_INT_ERR;
+}
+
+int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+{
+	return 1;
+}
+
+int ff_req_grant(_SYNC_t sobj)
+{
+	return 1;
+}
+
+void ff_rel_grant(_SYNC_t sobj)
+{
+}
+
+int ff_del_syncobj(_SYNC_t sobj)
+{
+	return 1;
+}
+
+void *ff_memalloc(UINT msize)
+{
+	return malloc(msize);
+}
+
+void ff_memfree(void *mblock)
+{
+	free(mblock);
+}
+
+void *mem_malloc(unsigned int size)
+{
+	return calloc(1, size);
+}
+
+void mem_free(void *ptr)
+{
+	free(ptr);
+}
+
+WCHAR ff_wtoupper(WCHAR chr)
+{
+	return (chr >= 'a' && chr <= 'z') ? chr - 'a' + 'A' : chr;
+}
+
+int nls_utf8_uni2char(int uni, u8_t *out, int boundlen)
+{
+	*out = (u8_t)uni;
+	return 1;
+}
+
+int nls_utf8_char2uni(const u8_t *rawstring, int boundlen, u16_t *uni)
+{
+	*uni = *rawstring;
+	return 1;
+}
+
+/* file content is a function of the offset */
+static u8_t pattern(u32_t ofs)
+{
+	return (u8_t)((ofs >> 9) * 31 + (ofs & 0x1ff));
+}
+
+static void fill_pattern(u8_t *buf, u32_t ofs, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = pattern(ofs + i);
+}
+
+static void test_setup(void)
+{
+	static u8_t work[4096];
+	static u8_t chunk[CHUNK_SIZE];
+	fs_file_t frag, cont, filler;
+	u32_t ofs;
+
+	disk_data = calloc(DISK_SECTORS, SECTOR_SIZE);
+	zassert_not_null(disk_data, NULL);
+
+	zassert_equal(f_mkfs(VOLUME, FM_FAT32, SECTOR_SIZE, work, sizeof(work)), FR_OK, NULL);
+	zassert_equal(f_mount(&fat_fs, VOLUME, 1), FR_OK, NULL);
+	zassert_equal(fat_fs.fs_type, FS_FAT32, NULL);
+
+	/* a filler chunk between every chunk of FRAG.BIN */
+	zassert_equal(fs_open(&frag, VOLUME "FRAG.BIN"), 0, NULL);
+	zassert_equal(fs_open(&filler, VOLUME "FILL.BIN"), 0, NULL);
+	for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE) {
+		fill_pattern(chunk, ofs, CHUNK_SIZE);
+		zassert_equal(fs_write(&frag, chunk, CHUNK_SIZE), CHUNK_SIZE, NULL);
+		zassert_equal(fs_write(&filler, chunk, 4096), 4096, NULL);
+	}
+	zassert_equal(fs_close(&filler), 0, NULL);
+	zassert_equal(fs_close(&frag), 0, NULL);
+
+	zassert_equal(fs_open(&cont, VOLUME "CONT.BIN"), 0, NULL);
+	for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE) {
+		fill_pattern(chunk, ofs, CHUNK_SIZE);
+		zassert_equal(fs_write(&cont, chunk, CHUNK_SIZE), CHUNK_SIZE, NULL);
+	}
+	zassert_equal(fs_close(&cont), 0, NULL);
+}
+
+static void check_read(fs_file_t *fp, u32_t ofs, int len)
+{
+	u8_t buf[700], expect[700];
+
+	zassert_equal(fs_seek(fp, ofs, FS_SEEK_SET), 0, NULL);
+	zassert_equal(fs_read(fp, buf, len), len, NULL);
+	fill_pattern(expect, ofs, len);
+	zassert_true(!memcmp(buf, expect, len), "wrong data");
+}
+
+static void test_fastseek_read(void)
+{
+	u32_t seed = 7, ofs;
+	fs_file_t fp;
+	int i, reads;
+
+	zassert_equal(fs_open(&fp, VOLUME "FRAG.BIN"), 0, NULL);
+	check_read(&fp, 1000, 100);
+
+	/* current position is kept */
+	zassert_equal(fs_fastseek_enable(&fp, FRAGMENTS), 0, NULL);
+	zassert_not_null(fp.fp.cltbl, NULL);
+	zassert_equal(fs_tell(&fp), 1100, NULL);
+	zassert_equal(fp.fp.cltbl[0], 2 + 2 * FRAGMENTS, "fragments not mapped");
+
+	reads = disk_reads;
+	for (i = 0; i < 500; i++) {
+		seed = seed * 1103515245 + 12345;
+		ofs = (seed >> 4) % (FILE_SIZE - 700);
+		check_read(&fp, ofs, 1 + (seed >> 24) % 700);
+	}
+	/* data sectors only, no FAT walk */
+	zassert_true(disk_reads - reads <= 500 * 3, "FAT read on seek");
+
+	check_read(&fp, FILE_SIZE - 1, 1);
+	check_read(&fp, 0, 1);
+
+	zassert_equal(fs_close(&fp), 0, NULL);
+}
+
+static void test_fastseek_budget(void)
+{
+	fs_file_t fp;
+
+	zassert_equal(fs_open(&fp, VOLUME "FRAG.BIN"), 0, NULL);
+	zassert_equal(fs_fastseek_enable(&fp, FRAGMENTS - 1), -ENOMEM, NULL);
+	zassert_is_null(fp.fp.cltbl, NULL);
+	check_read(&fp, FILE_SIZE / 2 + 3, 600);
+	zassert_equal(fs_close(&fp), 0, NULL);
+
+	/* a contiguous file is mapped in one fragment */
+	zassert_equal(fs_open(&fp, VOLUME "CONT.BIN"), 0, NULL);
+	zassert_equal(fs_fastseek_enable(&fp, 1), 0, NULL);
+	zassert_equal(fp.fp.cltbl[0], 4, NULL);
+	check_read(&fp, FILE_SIZE - 600, 600);
+	zassert_equal(fs_close(&fp), 0, NULL);
+}
+
+static void test_fastseek_write(void)
+{
+	u8_t buf[512];
+	fs_file_t fp;
+
+	zassert_equal(fs_open(&fp, VOLUME "CONT.BIN"), 0, NULL);
+	zassert_equal(fs_fastseek_enable(&fp, 1), 0, NULL);
+
+	/* writing inside the file keeps the map */
+	fill_pattern(buf, 5000, sizeof(buf));
+	zassert_equal(fs_seek(&fp, 5000, FS_SEEK_SET), 0, NULL);
+	zassert_equal(fs_write(&fp, buf, sizeof(buf)), sizeof(buf), NULL);
+	zassert_not_null(fp.fp.cltbl, NULL);
+
+	/* growing it drops the map */
+	fill_pattern(buf, FILE_SIZE, sizeof(buf));
+	zassert_equal(fs_seek(&fp, 0, FS_SEEK_END), 0, NULL);
+	zassert_equal(fs_write(&fp, buf, sizeof(buf)), sizeof(buf), NULL);
+	zassert_is_null(fp.fp.cltbl, NULL);
+	check_read(&fp, FILE_SIZE - 100, 300);
+	zassert_equal(fs_truncate(&fp, FILE_SIZE), 0, NULL);
+
+	zassert_equal(fs_close(&fp), 0, NULL);
+}
+
+static u64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_seek(const char *name, const char *path, bool fastseek)
+{
+	u32_t seed = 1, ofs;
+	u64_t ns;
+	fs_file_t fp;
+	u8_t buf[16];
+	int i, reads;
+
+	zassert_equal(fs_open(&fp, path), 0, NULL);
+	if (fastseek)
+		zassert_equal(fs_fastseek_enable(&fp, FRAGMENTS), 0, NULL);
+
+	reads = disk_reads;
+	ns = now_ns();
+	for (i = 0; i < BENCH_SEEKS; i++) {
+		seed = seed * 1103515245 + 12345;
+		ofs = (seed >> 4) % (FILE_SIZE - sizeof(buf));
+		fs_seek(&fp, ofs, FS_SEEK_SET);
+		fs_read(&fp, buf, sizeof(buf));
+	}
+	ns = now_ns() - ns;
+
+	printf("%-28s %8.2f us/seek %8.2f disk reads/seek\n", name,
+	       (double)ns / BENCH_SEEKS / 1000, (double)(disk_reads - reads) / BENCH_SEEKS);
+
+	zassert_equal(fs_close(&fp), 0, NULL);
+}
+
+static void test_benchmark(void)
+{
+	printf("random seek + 16 byte read, %d MB file, 512 byte clusters\n",
+	       FILE_SIZE / (1024 * 1024));
+	bench_seek("contiguous, chain walk", VOLUME "CONT.BIN", false);
+	bench_seek("contiguous, fast seek", VOLUME "CONT.BIN", true);
+	bench_seek("fragmented, chain walk", VOLUME "FRAG.BIN", false);
+	bench_seek("fragmented, fast seek", VOLUME "FRAG.BIN", true);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(fastseek_test,
+		ztest_unit_test(test_setup),
+		ztest_unit_test(test_fastseek_read),
+		ztest_unit_test(test_fastseek_budget),
+		ztest_unit_test(test_fastseek_write),
+		ztest_unit_test(test_benchmark)
+	);
+
+	ztest_run_test_suite(fastseek_test);
+}
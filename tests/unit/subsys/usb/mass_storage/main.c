@@ -0,0 +1,489 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+
+/* one host mutex stands for interrupt locking, callbacks run under it */
+static mtx_t irq_mutex;
+
+static unsigned int host_irq_lock(void)
+{
+	mtx_lock(&irq_mutex);
+	return 0;
+}
+
+static void host_irq_unlock(unsigned int key)
+{
+	mtx_unlock(&irq_mutex);
+}
+
+#undef irq_lock
+#undef irq_unlock
+#define irq_lock()	host_irq_lock()
+#define irq_unlock(key)	host_irq_unlock(key)
+
+#include <subsys/usb/class/mass_storage.c>
+
+#define DISK_SECTORS	(16 * 1024)
+/* rough SD card: command overhead plus transfer */
+#define DISK_CMD_US	(200)
+#define DISK_SECTOR_US	(60)
+/* rough high-speed bulk transfer */
+#define USB_XFER_US	(50)
+#define USB_KB_US	(120)
+/* host turnaround between a CSW and the next CBW */
+#define HOST_CMD_US	(400)
+
+#define BENCH_SIZE	(2 * 1024 * 1024)
+#define BENCH_CMD	(64 * 1024)
+
+static u8_t *disk_data;
+static u8_t *host_buf;
+static int disk_reads;
+static u64_t disk_busy_us, usb_busy_us;
+static u32_t tag;
+static thrd_t msc_thread;
+
+/* endpoint requests posted by the device, served by the host */
+static mtx_t bus_mutex;
+static cnd_t bus_cond;
+static struct {
+	u8_t *buf;
+	u32_t len;
+	bool pending;
+} ep_req[2];
+
+static mtx_t sem_mutex;
+static cnd_t sem_cond;
+
+static void busy_us(u32_t us)
+{
+	struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+
+	nanosleep(&ts, NULL);
+}
+
+static u64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void deadline(struct timespec *ts, s32_t ms)
+{
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_sec += ms / 1000;
+	ts->tv_nsec += (ms % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+/* disk, usb and os glue */
+DSTATUS disk_initialize(BYTE pdrv)
+{
+	return 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+	return 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != MSC_DISK_RAM || sector + count > DISK_SECTORS)
+		return RES_PARERR;
+
+	busy_us(DISK_CMD_US + count * DISK_SECTOR_US);
+	disk_busy_us += DISK_CMD_US + count * DISK_SECTOR_US;
+	disk_reads++;
+
+	memcpy(buff, disk_data + sector * BLOCK_SIZE, count * BLOCK_SIZE);
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+	if (pdrv != MSC_DISK_RAM || sector + count > DISK_SECTORS)
+		return RES_PARERR;
+
+	busy_us(DISK_CMD_US + count * DISK_SECTOR_US);
+	disk_busy_us += DISK_CMD_US + count * DISK_SECTOR_US;
+
+	memcpy(disk_data + sector * BLOCK_SIZE, buff, count * BLOCK_SIZE);
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+	switch (cmd) {
+	case GET_SECTOR_COUNT:
+		*(u32_t *)buff = DISK_SECTORS;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(u32_t *)buff = BLOCK_SIZE;
+		return RES_OK;
+	case DISK_HW_DETECT:
+		*(u8_t *)buff = STA_DISK_OK;
+		return RES_OK;
+	default:
+		return RES_PARERR;
+	}
+}
+
+static int ep_post(int idx, u8_t *data, u32_t len)
+{
+	mtx_lock(&bus_mutex);
+	zassert_false(ep_req[idx].pending, "second transfer queued");
+	ep_req[idx].buf = data;
+	ep_req[idx].len = len;
+	ep_req[idx].pending = true;
+	cnd_broadcast(&bus_cond);
+	mtx_unlock(&bus_mutex);
+	return 0;
+}
+
+int usb_write(u8_t ep, const u8_t *data, u32_t data_len, u32_t *bytes_ret)
+{
+	zassert_equal(ep, CONFIG_MASS_STORAGE_IN_EP_ADDR, NULL);
+	return ep_post(MSD_IN_EP_IDX, (u8_t *)data, data_len);
+}
+
+int usb_read_async(u8_t ep, u8_t *data, u32_t max_data_len, u32_t *ret_bytes)
+{
+	zassert_equal(ep, CONFIG_MASS_STORAGE_OUT_EP_ADDR, NULL);
+	return ep_post(MSD_OUT_EP_IDX, data, max_data_len);
+}
+
+int usb_ep_set_stall(u8_t ep)
+{
+	zassert_unreachable("endpoint stalled");
+	return 0;
+}
+
+int usb_dc_ep_flush(const u8_t ep)
+{
+	return 0;
+}
+
+int usb_device_register_string_descriptor(enum usb_device_str_desc type,
+					  u8_t *str, u8_t len)
+{
+	return 0;
+}
+
+void usb_device_register_descriptors(const u8_t *usb_fs_descriptors,
+				     const u8_t *usb_hs_descriptors)
+{
+}
+
+int usb_set_config(const struct usb_cfg_data *config)
+{
+	return 0;
+}
+
+int usb_enable(const struct usb_cfg_data *config)
+{
+	return 0;
+}
+
+int usb_disable(void)
+{
+	return 0;
+}
+
+int usb_deconfig(void)
+{
+	return 0;
+}
+
+void k_sem_init(struct k_sem *sem, unsigned int initial_count, unsigned int limit)
+{
+	mtx_lock(&sem_mutex);
+	sem->count = initial_count;
+	sem->limit = limit;
+	mtx_unlock(&sem_mutex);
+}
+
+void k_sem_give(struct k_sem *sem)
+{
+	mtx_lock(&sem_mutex);
+	if (sem->count < sem->limit)
+		sem->count++;
+	cnd_broadcast(&sem_cond);
+	mtx_unlock(&sem_mutex);
+}
+
+int k_sem_take(struct k_sem *sem, s32_t timeout)
+{
+	struct timespec ts;
+	int ret = 0;
+
+	deadline(&ts, timeout == K_FOREVER ? 3600 * 1000 : timeout);
+
+	mtx_lock(&sem_mutex);
+	while (!sem->count && ret == thrd_success)
+		ret = cnd_timedwait(&sem_cond, &sem_mutex, &ts);
+	if (sem->count) {
+		sem->count--;
+		ret = 0;
+	} else {
+		ret = -EAGAIN;
+	}
+	mtx_unlock(&sem_mutex);
+
+	return ret;
+}
+
+void k_sleep(s32_t duration)
+{
+	busy_us(duration * 1000);
+}
+
+void k_busy_wait(u32_t usec_to_wait)
+{
+	busy_us(usec_to_wait);
+}
+
+/*
+ * Host side: move data of the transfer the device posted on an
+ * endpoint, take the bus time, then complete it like the controller.
+ */
+static void host_transfer(int idx, u8_t *data, u32_t len)
+{
+	struct timespec ts;
+	u32_t n;
+
+	while (len) {
+		deadline(&ts, 5000);
+
+		mtx_lock(&bus_mutex);
+		while (!ep_req[idx].pending) {
+			zassert_equal(cnd_timedwait(&bus_cond, &bus_mutex, &ts), thrd_success,
+				      "no transfer posted");
+		}
+		n = ep_req[idx].len;
+		zassert_true(n <= len, "transfer too long");
+		if (idx == MSD_IN_EP_IDX)
+			memcpy(data, ep_req[idx].buf, n);
+		else
+			memcpy(ep_req[idx].buf, data, n);
+		ep_req[idx].pending = false;
+		mtx_unlock(&bus_mutex);
+
+		busy_us(USB_XFER_US + n * USB_KB_US / 1024);
+		usb_busy_us += USB_XFER_US + n * USB_KB_US / 1024;
+
+		irq_lock();
+		if (idx == MSD_IN_EP_IDX)
+			mass_storage_bulk_in(CONFIG_MASS_STORAGE_IN_EP_ADDR, USB_DC_EP_DATA_IN);
+		else
+			mass_storage_bulk_out(CONFIG_MASS_STORAGE_OUT_EP_ADDR, USB_DC_EP_DATA_OUT);
+		irq_unlock(0);
+
+		data += n;
+		len -= n;
+	}
+}
+
+static void host_command(u8_t op, u32_t lba, u32_t blocks, u8_t *data)
+{
+	struct CBW cmd;
+	struct CSW status;
+
+	busy_us(HOST_CMD_US);
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.Signature = CBW_Signature;
+	cmd.Tag = ++tag;
+	cmd.DataLength = blocks * BLOCK_SIZE;
+	cmd.Flags = (op == READ10) ? CBW_DIRECTION_DATA_IN : 0;
+	cmd.CBLength = 10;
+	cmd.CB[0] = op;
+	sys_put_be32(lba, &cmd.CB[2]);
+	sys_put_be16(blocks, &cmd.CB[7]);
+	host_transfer(MSD_OUT_EP_IDX, (u8_t *)&cmd, sizeof(cmd));
+
+	host_transfer((op == READ10) ? MSD_IN_EP_IDX : MSD_OUT_EP_IDX, data,
+		      blocks * BLOCK_SIZE);
+
+	host_transfer(MSD_IN_EP_IDX, (u8_t *)&status, sizeof(status));
+	zassert_equal(status.Signature, CSW_Signature, NULL);
+	zassert_equal(status.Tag, tag, NULL);
+	zassert_equal(status.Status, CSW_PASSED, NULL);
+	zassert_equal(status.DataResidue, 0, NULL);
+}
+
+static void check_read(u32_t lba, u32_t blocks)
+{
+	host_command(READ10, lba, blocks, host_buf);
+	zassert_true(!memcmp(host_buf, disk_data + lba * BLOCK_SIZE, blocks * BLOCK_SIZE),
+		     "wrong data read");
+}
+
+static void check_write(u32_t lba, u32_t blocks, u32_t seed)
+{
+	u32_t i;
+
+	for (i = 0; i < blocks * BLOCK_SIZE; i++)
+		host_buf[i] = (u8_t)(seed + i * 7 + (i >> 9));
+
+	host_command(WRITE10, lba, blocks, host_buf);
+	zassert_true(!memcmp(host_buf, disk_data + lba * BLOCK_SIZE, blocks * BLOCK_SIZE),
+		     "wrong data written");
+}
+
+static int msc_thread_entry(void *arg)
+{
+	usb_mass_storage_thread(NULL, NULL, NULL);
+	return 0;
+}
+
+static void test_init(void)
+{
+	int i;
+
+	mtx_init(&irq_mutex, mtx_plain | mtx_recursive);
+	mtx_init(&bus_mutex, mtx_plain);
+	mtx_init(&sem_mutex, mtx_plain);
+	cnd_init(&bus_cond);
+	cnd_init(&sem_cond);
+
+	disk_data = malloc(DISK_SECTORS * BLOCK_SIZE);
+	host_buf = malloc(BENCH_CMD);
+	zassert_not_null(disk_data, NULL);
+	zassert_not_null(host_buf, NULL);
+	for (i = 0; i < DISK_SECTORS * BLOCK_SIZE; i++)
+		disk_data[i] = (u8_t)(i * 31 + (i >> 9));
+
+	usb_mass_storage_register(MSC_DISK_RAM);
+	zassert_equal(usb_mass_storage_init(NULL), 0, NULL);
+	zassert_equal(block_count, DISK_SECTORS, NULL);
+	zassert_equal(thrd_create(&msc_thread, msc_thread_entry, NULL), thrd_success, NULL);
+
+	irq_lock();
+	mass_storage_status_cb(USB_DC_HIGHSPEED, NULL);
+	mass_storage_status_cb(USB_DC_CONFIGURED, NULL);
+	irq_unlock(0);
+}
+
+static void test_read(void)
+{
+	u32_t seed = 3, lba, blocks;
+	int i;
+
+	/* odd sizes, partial buffers and more commands than buffers */
+	check_read(0, 1);
+	check_read(1, 7);
+	check_read(8, PAGE_SIZE / BLOCK_SIZE);
+	check_read(100, 3 * PAGE_SIZE / BLOCK_SIZE + 5);
+
+	for (i = 0; i < 50; i++) {
+		seed = seed * 1103515245 + 12345;
+		blocks = 1 + (seed >> 8) % (BENCH_CMD / BLOCK_SIZE);
+		lba = (seed >> 4) % (DISK_SECTORS - blocks);
+		check_read(lba, blocks);
+		/* sometimes go on where the last one stopped */
+		if (seed & 0x10000)
+			check_read(lba + blocks, blocks / 2 + 1);
+	}
+
+	/* read ahead stays inside the disk */
+	check_read(DISK_SECTORS - 3, 3);
+	check_read(DISK_SECTORS - 2 * PAGE_SIZE / BLOCK_SIZE, 2 * PAGE_SIZE / BLOCK_SIZE);
+}
+
+static void test_write(void)
+{
+	u32_t seed = 11, lba, blocks;
+	int i;
+
+	check_write(0, 1, 1);
+	check_write(1, 3 * PAGE_SIZE / BLOCK_SIZE + 5, 2);
+	check_read(0, 3 * PAGE_SIZE / BLOCK_SIZE + 6);
+
+	for (i = 0; i < 30; i++) {
+		seed = seed * 1103515245 + 12345;
+		blocks = 1 + (seed >> 8) % (BENCH_CMD / BLOCK_SIZE);
+		lba = (seed >> 4) % (DISK_SECTORS - blocks);
+		check_write(lba, blocks, seed);
+		check_read(lba, blocks);
+	}
+
+	/* data read ahead is dropped when the blocks are written */
+	check_read(1000, 16);
+	check_write(1016, 16, 77);
+	check_read(1016, 16);
+}
+
+static void test_benchmark(void)
+{
+	u64_t start, elapsed, disk_busy, usb_busy;
+	u32_t lba;
+	int reads;
+
+	/* sequential read like a host copying a file off the card */
+	disk_busy = disk_busy_us;
+	usb_busy = usb_busy_us;
+	reads = disk_reads;
+	start = now_us();
+	for (lba = 0; lba < BENCH_SIZE / BLOCK_SIZE; lba += BENCH_CMD / BLOCK_SIZE)
+		check_read(lba, BENCH_CMD / BLOCK_SIZE);
+	elapsed = now_us() - start;
+	disk_busy = disk_busy_us - disk_busy;
+	usb_busy = usb_busy_us - usb_busy;
+
+	printf("read  %d KB: %u ms, disk busy %u ms, usb busy %u ms, %d disk reads\n",
+	       BENCH_SIZE / 1024, (u32_t)(elapsed / 1000), (u32_t)(disk_busy / 1000),
+	       (u32_t)(usb_busy / 1000), disk_reads - reads);
+	zassert_true(elapsed < (disk_busy + usb_busy) * 9 / 10, "disk and usb not overlapped");
+	zassert_true(disk_reads - reads <= BENCH_SIZE / PAGE_SIZE + READ_AHEAD_NUM,
+		     "data read ahead not used");
+
+	disk_busy = disk_busy_us;
+	usb_busy = usb_busy_us;
+	start = now_us();
+	for (lba = 0; lba < BENCH_SIZE / BLOCK_SIZE; lba += BENCH_CMD / BLOCK_SIZE)
+		check_write(lba, BENCH_CMD / BLOCK_SIZE, lba);
+	elapsed = now_us() - start;
+	disk_busy = disk_busy_us - disk_busy;
+	usb_busy = usb_busy_us - usb_busy;
+
+	printf("write %d KB: %u ms, disk busy %u ms, usb busy %u ms\n",
+	       BENCH_SIZE / 1024, (u32_t)(elapsed / 1000), (u32_t)(disk_busy / 1000),
+	       (u32_t)(usb_busy / 1000));
+	zassert_true(elapsed < (disk_busy + usb_busy) * 9 / 10, "disk and usb not overlapped");
+}
+
+static void test_exit(void)
+{
+	zassert_equal(usb_mass_storage_exit(), 0, NULL);
+	zassert_equal(thrd_join(msc_thread, NULL), thrd_success, NULL);
+
+	free(host_buf);
+	free(disk_data);
+}
+
+void test_main(void)
+{
+	ztest_test_suite(mass_storage_test,
+		ztest_unit_test(test_init),
+		ztest_unit_test(test_read),
+		ztest_unit_test(test_write),
+		ztest_unit_test(test_benchmark),
+		ztest_unit_test(test_exit)
+	);
+
+	ztest_run_test_suite(mass_storage_test);
+}
@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2019 Actions Semiconductor Co., Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* stands for the generated kernel version header */
+#ifndef _KERNEL_VERSION_H_
+#define _KERNEL_VERSION_H_
+
+#define KERNEL_VERSION_MAJOR	1
+#define KERNEL_VERSION_MINOR	9
+
+#endif /* _KERNEL_VERSION_H_ */